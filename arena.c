@@ -0,0 +1,142 @@
+/*
+*     arena.c
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN (2 * sizeof (void*))
+
+#define ARENA_ALIGN_SIZE(size) (((size) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/*
+  Chunk of an arena. The memory of the chunk follows the header.
+*/
+typedef struct arena_chunk
+{
+  struct arena_chunk* next;
+
+  /* Size of the memory of the chunk */
+  size_t size;
+
+  /* Bytes of the memory in use */
+  size_t used;
+
+} arena_chunk;
+
+/****************************************************************************************
+* Function name - arena_calloc
+*
+* Description - Allocates zeroed and aligned memory for an array of objects from 
+*               an arena. An arena, zeroed by memset or calloc, is ready for use.
+*
+* Input -       *a - pointer to the arena
+*               obj_num - number of the objects
+*               obj_size - size of an object
+* Return Code/Output - On success - pointer to memory, on error - NULL
+****************************************************************************************/
+void* arena_calloc (arena* a, size_t obj_num, size_t obj_size)
+{
+  arena_chunk* chunk = a->chunks;
+  size_t size;
+
+  if (!obj_num || !obj_size)
+    {
+      return NULL;
+    }
+
+  if (obj_num > ((size_t) -1 - ARENA_ALIGN) / obj_size)
+    {
+      fprintf (stderr, "%s - error: size overflow.\n", __func__);
+      return NULL;
+    }
+
+  size = ARENA_ALIGN_SIZE (obj_num * obj_size);
+
+  if (! chunk || chunk->size - chunk->used < size)
+    {
+      const size_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+
+      /* 
+         calloc () of a large chunk takes zeroed pages from the kernel, thus the 
+         memory is touched only, when used. 
+      */
+      if (! (chunk = calloc (1, ARENA_ALIGN_SIZE (sizeof (arena_chunk)) + chunk_size)))
+        {
+          fprintf (stderr, "%s - error: calloc () failed for %lu bytes.\n", 
+                   __func__, (unsigned long) chunk_size);
+          return NULL;
+        }
+
+      chunk->size = chunk_size;
+
+      /* 
+         A chunk of its own is kept behind the current one, so that the rest 
+         of the current chunk is still used.
+      */
+      if (a->chunks && size > ARENA_CHUNK_SIZE)
+        {
+          chunk->next = a->chunks->next;
+          a->chunks->next = chunk;
+        }
+      else
+        {
+          chunk->next = a->chunks;
+          a->chunks = chunk;
+        }
+    }
+
+  void* ptr = (char *) chunk + ARENA_ALIGN_SIZE (sizeof (arena_chunk)) + chunk->used;
+
+  chunk->used += size;
+  a->allocated += size;
+
+  return ptr;
+}
+
+/****************************************************************************************
+* Function name - arena_release
+*
+* Description - Releases all memory of an arena, leaving the arena empty
+*
+* Input -       *a - pointer to the arena
+* Return Code/Output - None
+****************************************************************************************/
+void arena_release (arena* a)
+{
+  arena_chunk* chunk = a->chunks;
+
+  while (chunk)
+    {
+      arena_chunk* next = chunk->next;
+
+      free (chunk);
+      chunk = next;
+    }
+
+  a->chunks = NULL;
+  a->allocated = 0;
+}
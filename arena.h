@@ -0,0 +1,81 @@
+/*
+*     arena.h
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+  Arena of a batch.
+
+  The per-client buffers and side arrays of a batch, like the POST-ing buffers,
+  the url fetch decisions, the upload offsets, the response token keyvals and
+  the hyper-mode socket infos, are allocated from the arena of the batch as
+  arrays, laid out contiguously by the client index. The memory is taken from
+  the heap in large chunks, and a request above the chunk size gets a chunk of
+  its own. Nothing is returned to the arena; all its chunks are released at
+  once, when the batch is released.
+
+  The arena is not locked and is used by the thread of the batch, or when
+  parsing the configuration.
+*/
+
+/* Default size of an arena chunk */
+#define ARENA_CHUNK_SIZE (1024*1024)
+
+struct arena_chunk;
+
+typedef struct arena
+{
+  /* List of the chunks, the current one is the first */
+  struct arena_chunk* chunks;
+
+  /* Bytes handed out by the arena */
+  size_t allocated;
+
+} arena;
+
+/****************************************************************************************
+* Function name - arena_calloc
+*
+* Description - Allocates zeroed and aligned memory for an array of objects from 
+*               an arena. An arena, zeroed by memset or calloc, is ready for use.
+*
+* Input -       *a - pointer to the arena
+*               obj_num - number of the objects
+*               obj_size - size of an object
+* Return Code/Output - On success - pointer to memory, on error - NULL
+****************************************************************************************/
+void* arena_calloc (arena* a, size_t obj_num, size_t obj_size);
+
+/****************************************************************************************
+* Function name - arena_release
+*
+* Description - Releases all memory of an arena, leaving the arena empty
+*
+* Input -       *a - pointer to the arena
+* Return Code/Output - None
+****************************************************************************************/
+void arena_release (arena* a);
+
+#endif /* ARENA_H */
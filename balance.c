@@ -0,0 +1,414 @@
+/*
+*     balance.c
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "balance.h"
+#include "batch.h"
+#include "client.h"
+#include "loader.h"
+#include "conf.h"
+
+static int handle_balance_timer (timer_node* tn,
+                                 void* pvoid_param,
+                                 unsigned long ulong_param);
+static void balance_receive (batch_context* bctx);
+static int balance_move (batch_context* bctx,
+                         batch_context* to,
+                         int num,
+                         unsigned long now_time);
+
+
+/****************************************************************************************
+* Function name - clients_balance_init
+*
+* Description - Tests, whether the clients of the batch threads may be rebalanced,
+*               and, when yes, initializes the rebalancing. Otherwise, prints the
+*               reason and disables the rebalancing.
+*
+* Input -       *bc_arr - array of the batch contexts of the loading threads
+*               batches_num - number of the loading threads
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int clients_balance_init (batch_context* bc_arr, int batches_num)
+{
+  const char* reason = 0;
+  int i;
+
+  if (! bc_arr[0].clients_balance)
+    return 0;
+
+  if (batches_num < 2)
+    reason = "runs only with several threads (-t)";
+  else if (subbatches_processes)
+    reason = "does not move clients between processes (-p)";
+  else if (distrib_agents || distrib_agent_port)
+    reason = "does not move clients between hosts (-g)";
+  else if (loading_mode == LOAD_MODE_HYPER)
+    reason = "does not run in hyper-mode (-m 0)";
+  else if (bc_arr[0].native_engine)
+    reason = "does not move clients of the NATIVE_ENGINE";
+  else if (bc_arr[0].req_rate)
+    reason = "does not move clients sending at REQ_RATE";
+  else if (bc_arr[0].pipeline_depth || bc_arr[0].http2_streams)
+    reason = "does not move clients sharing connections";
+  else
+    {
+      /* FTP connections keep the handle of their last client for closing */
+      for (i = 0; i < bc_arr[0].urls_num; i++)
+        {
+          if (bc_arr[0].url_ctx_array[i].url_appl_type == URL_APPL_FTP ||
+              bc_arr[0].url_ctx_array[i].url_appl_type == URL_APPL_FTPS)
+            reason = "does not move clients of FTP urls";
+        }
+    }
+
+  if (reason)
+    {
+      fprintf (stderr, "%s - warning: CLIENTS_BALANCE %s, the clients are not "
+               "rebalanced.\n", __func__, reason);
+      bc_arr[0].clients_balance = 0;
+      return 0;
+    }
+
+  for (i = 0; i < batches_num; i++)
+    {
+      if (pthread_mutex_init (&bc_arr[i].balance_lock, NULL))
+        {
+          fprintf (stderr, "%s - error: pthread_mutex_init () failed.\n", __func__);
+          return -1;
+        }
+
+      /* Opened by the thread, when it starts loading */
+      bc_arr[i].balance_closed = 1;
+    }
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - clients_balance_start
+*
+* Description - Schedules the periodic rebalancing timer of the thread
+*
+* Input -       *bctx - pointer to the batch context of the thread
+*               now_time - current time in msec
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int clients_balance_start (batch_context* bctx, unsigned long now_time)
+{
+  if (! bctx->clients_balance)
+    return 0;
+
+  bctx->balance_timer_node.next_timer = now_time + BALANCE_PERIOD;
+  bctx->balance_timer_node.period = BALANCE_PERIOD;
+  bctx->balance_timer_node.func_timer = handle_balance_timer;
+
+  if (tq_schedule_timer (bctx->waiting_queue, &bctx->balance_timer_node) == -1)
+    {
+      fprintf (stderr, "%s - error: tq_schedule_timer () failed.\n", __func__);
+      return -1;
+    }
+
+  pthread_mutex_lock (&bctx->balance_lock);
+  __atomic_store_n (&bctx->balance_closed, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock (&bctx->balance_lock);
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - clients_balance_keep_loading
+*
+* Description - Called by the thread, that has no more clients to load. Tells,
+*               whether to keep loading, waiting for clients from other threads.
+*               When not, the thread is closed for moving clients to it.
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - When to keep loading - 1, when not - 0
+****************************************************************************************/
+int clients_balance_keep_loading (batch_context* bctx)
+{
+  batch_context* first = bctx - bctx->batch_id;
+  int keep = 0, i;
+
+  if (! bctx->clients_balance)
+    return 0;
+
+  __atomic_store_n (&bctx->balance_load, 0, __ATOMIC_RELAXED);
+
+  pthread_mutex_lock (&bctx->balance_lock);
+
+  if (bctx->balance_inbox)
+    {
+      keep = 1;
+    }
+  else
+    {
+      for (i = 0; i < threads_subbatches_num && !keep; i++)
+        {
+          batch_context* peer = first + i;
+
+          if (peer != bctx &&
+              ! __atomic_load_n (&peer->balance_closed, __ATOMIC_RELAXED) &&
+              __atomic_load_n (&peer->balance_load, __ATOMIC_RELAXED) > 1)
+            keep = 1;
+        }
+
+      if (! keep)
+        __atomic_store_n (&bctx->balance_closed, 1, __ATOMIC_RELAXED);
+    }
+
+  pthread_mutex_unlock (&bctx->balance_lock);
+
+  return keep;
+}
+
+/****************************************************************************************
+* Function name - clients_balance_release
+*
+* Description - Called at the end of loading by the thread. Returns the clients of
+*               other threads and waits for its own clients to be returned.
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - None
+****************************************************************************************/
+void clients_balance_release (batch_context* bctx)
+{
+  client_context* cctx;
+  client_context* inbox;
+
+  if (! bctx->clients_balance)
+    return;
+
+  pthread_mutex_lock (&bctx->balance_lock);
+  __atomic_store_n (&bctx->balance_closed, 1, __ATOMIC_RELAXED);
+  inbox = bctx->balance_inbox;
+  bctx->balance_inbox = 0;
+  pthread_mutex_unlock (&bctx->balance_lock);
+
+  /* Clients not received yet are in no multi-handle */
+  while ((cctx = inbox))
+    {
+      inbox = cctx->balance_next;
+      __atomic_sub_fetch (&cctx->home_bctx->balance_emigrants, 1, __ATOMIC_RELEASE);
+    }
+
+  while ((cctx = bctx->balance_guests))
+    {
+      bctx->balance_guests = cctx->balance_next;
+
+      if (cctx->handle)
+        curl_multi_remove_handle (cctx->multi_handle, cctx->handle);
+
+      __atomic_sub_fetch (&cctx->home_bctx->balance_emigrants, 1, __ATOMIC_RELEASE);
+    }
+
+  while (__atomic_load_n (&bctx->balance_emigrants, __ATOMIC_ACQUIRE) > 0)
+    usleep (1000);
+}
+
+/****************************************************************************************
+* Function name - handle_balance_timer
+*
+* Description - Periodic rebalancing of the thread: receives the clients, moved from
+*               other threads, publishes the number of its clients and, when above
+*               the average, moves some of its sleeping clients to threads below.
+*
+* Input -       *tn          - pointer to timer node structure
+*               *pvoid_param - pointer to some extra data; here batch context
+*               ulong_param  - current time in msec
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int handle_balance_timer (timer_node* tn,
+                                 void* pvoid_param,
+                                 unsigned long ulong_param)
+{
+  batch_context* bctx = (batch_context *) pvoid_param;
+  batch_context* first = bctx - bctx->batch_id;
+  const unsigned long now_time = ulong_param;
+  int i, load, total = 0, open = 0, mean, margin;
+  (void) tn;
+
+  balance_receive (bctx);
+
+  load = bctx->rt->active_clients_count + bctx->rt->sleeping_clients_count;
+  __atomic_store_n (&bctx->balance_load, load, __ATOMIC_RELAXED);
+
+  for (i = 0; i < threads_subbatches_num; i++)
+    {
+      if (! __atomic_load_n (&first[i].balance_closed, __ATOMIC_RELAXED))
+        {
+          total += __atomic_load_n (&first[i].balance_load, __ATOMIC_RELAXED);
+          open++;
+        }
+    }
+
+  if (open < 2)
+    return 0;
+
+  mean = total / open;
+  margin = mean / 8 + 1;
+
+  for (i = 0; i < threads_subbatches_num && load - mean > margin; i++)
+    {
+      batch_context* peer = first + i;
+      int deficit, num;
+
+      if (peer == bctx || __atomic_load_n (&peer->balance_closed, __ATOMIC_RELAXED))
+        continue;
+
+      deficit = mean - __atomic_load_n (&peer->balance_load, __ATOMIC_RELAXED);
+
+      if (deficit <= margin)
+        continue;
+
+      num = deficit < load - mean ? deficit : load - mean;
+      if (num > BALANCE_MAX_MOVE)
+        num = BALANCE_MAX_MOVE;
+
+      load -= balance_move (bctx, peer, num, now_time);
+    }
+
+  __atomic_store_n (&bctx->balance_load, load, __ATOMIC_RELAXED);
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - balance_receive
+*
+* Description - Adds the clients, moved to the thread, to its multi-handles and
+*               re-schedules their sleeping timers in its waiting queue
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - None
+****************************************************************************************/
+static void balance_receive (batch_context* bctx)
+{
+  client_context* cctx;
+  client_context* inbox;
+
+  pthread_mutex_lock (&bctx->balance_lock);
+  inbox = bctx->balance_inbox;
+  bctx->balance_inbox = 0;
+  pthread_mutex_unlock (&bctx->balance_lock);
+
+  while ((cctx = inbox))
+    {
+      inbox = cctx->balance_next;
+
+      cctx->multi_handle =
+        bctx->multi_handles[cctx->client_index % bctx->multi_handles_num];
+      if (cctx->handle)
+        curl_easy_setopt (cctx->handle, CURLOPT_ERRORBUFFER, bctx->error_buffer);
+
+      cctx->balance_next = bctx->balance_guests;
+      bctx->balance_guests = cctx;
+
+      if (client_sleeping_schedule (cctx, cctx->tn.next_timer) == -1)
+        {
+          fprintf (stderr, "%s - error: client_sleeping_schedule () failed.\n",
+                   __func__);
+        }
+    }
+}
+
+/****************************************************************************************
+* Function name - balance_move
+*
+* Description - Moves up to <num> own sleeping clients of the thread to another
+*               thread, unless the other thread is closed
+*
+* Input -       *bctx - pointer to the batch context of the thread
+*               *to   - pointer to the batch context of the other thread
+*               num   - number of clients to move
+*               now_time - current time in msec
+* Return Code/Output - Number of clients moved
+****************************************************************************************/
+static int balance_move (batch_context* bctx,
+                         batch_context* to,
+                         int num,
+                         unsigned long now_time)
+{
+  client_context* list = 0;
+  client_context* cctx;
+  int moved = 0, k;
+
+  for (k = 0; k < bctx->client_num_max && moved < num; k++)
+    {
+      cctx = &bctx->cctx_array[bctx->balance_cursor];
+
+      if (++bctx->balance_cursor == bctx->client_num_max)
+        bctx->balance_cursor = 0;
+
+      /* Clients of other threads are not moved further */
+      if (cctx->bctx != bctx || cctx->tid_sleeping == -1 ||
+          cctx->tn.next_timer < now_time + BALANCE_MIN_SLEEP)
+        continue;
+
+      client_sleeping_cancel (cctx);
+      cctx->balance_next = list;
+      list = cctx;
+      moved++;
+    }
+
+  if (! moved)
+    return 0;
+
+  __atomic_add_fetch (&bctx->balance_emigrants, moved, __ATOMIC_RELAXED);
+
+  pthread_mutex_lock (&to->balance_lock);
+
+  if (! to->balance_closed)
+    {
+      while ((cctx = list))
+        {
+          list = cctx->balance_next;
+          cctx->bctx = to;
+          cctx->balance_next = to->balance_inbox;
+          to->balance_inbox = cctx;
+        }
+    }
+
+  pthread_mutex_unlock (&to->balance_lock);
+
+  if (list)
+    {
+      /* The thread has been closed, keep the clients */
+      __atomic_sub_fetch (&bctx->balance_emigrants, moved, __ATOMIC_RELAXED);
+
+      while ((cctx = list))
+        {
+          list = cctx->balance_next;
+          client_sleeping_schedule (cctx, cctx->tn.next_timer);
+        }
+      return 0;
+    }
+
+  return moved;
+}
@@ -0,0 +1,101 @@
+/*
+*     balance.h
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef BALANCE_H
+#define BALANCE_H
+
+/*
+  Rebalancing of clients between the loading threads (CLIENTS_BALANCE).
+
+  The timer queue and the multi-handles of a thread are accessed only by
+  the thread. Therefore, each BALANCE_PERIOD a thread, having more active and
+  sleeping clients, than the average of the threads, cancels the sleeping
+  timers of some of its own clients and passes the clients to a thread with
+  less clients via its inbox, guarded by a mutex. The receiving thread adds
+  the clients to its multi-handles and re-schedules their sleeping timers in
+  its own waiting queue, thus the clients keep their think time.
+
+  A thread without clients keeps running to receive more, while other threads
+  have clients to pass. At the end of loading each thread returns the clients
+  of other threads, and waits for its own clients to be returned, before
+  releasing the clients and the multi-handles.
+*/
+
+/* Period in msec of clients rebalancing by a thread */
+#define BALANCE_PERIOD 100
+
+/* Minimal sleeping time in msec left to a client to be moved to another thread */
+#define BALANCE_MIN_SLEEP (2*BALANCE_PERIOD)
+
+/* Maximum number of clients moved by a thread each period */
+#define BALANCE_MAX_MOVE 64
+
+struct batch_context;
+
+/****************************************************************************************
+* Function name - clients_balance_init
+*
+* Description - Tests, whether the clients of the batch threads may be rebalanced,
+*               and, when yes, initializes the rebalancing. Otherwise, prints the
+*               reason and disables the rebalancing.
+*
+* Input -       *bc_arr - array of the batch contexts of the loading threads
+*               batches_num - number of the loading threads
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int clients_balance_init (struct batch_context* bc_arr, int batches_num);
+
+/****************************************************************************************
+* Function name - clients_balance_start
+*
+* Description - Schedules the periodic rebalancing timer of the thread
+*
+* Input -       *bctx - pointer to the batch context of the thread
+*               now_time - current time in msec
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int clients_balance_start (struct batch_context* bctx, unsigned long now_time);
+
+/****************************************************************************************
+* Function name - clients_balance_keep_loading
+*
+* Description - Called by the thread, that has no more clients to load. Tells,
+*               whether to keep loading, waiting for clients from other threads.
+*               When not, the thread is closed for moving clients to it.
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - When to keep loading - 1, when not - 0
+****************************************************************************************/
+int clients_balance_keep_loading (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - clients_balance_release
+*
+* Description - Called at the end of loading by the thread. Returns the clients of
+*               other threads and waits for its own clients to be returned.
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - None
+****************************************************************************************/
+void clients_balance_release (struct batch_context* bctx);
+
+#endif /* BALANCE_H */
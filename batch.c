@@ -22,28 +22,177 @@
 // must be the first include
 #include "fdsetsize.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
 #include "batch.h"
 
 int is_batch_group_leader (batch_context* bctx)
 {
-  return !bctx->batch_id;
+  /* The statistics thread, when running, reports for all loading threads */
+  return !bctx->batch_id && !stat_thread_enabled;
 }
 
-size_t next_ipv4_shared_index (batch_context* bctx)
+/****************************************************************************************
+* Function name - batch_runtime_init
+*
+* Description - Allocates the run-time counters of the batch. Called by the loading 
+*               thread after binding to its CPU: the block is written first by the 
+*               thread, thus its pages are placed at the NUMA node of the thread. 
+*               The block takes whole cache lines, not shared with other allocations.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int batch_runtime_init (batch_context* bctx)
 {
-  size_t to_return = bctx->ipv4_shared_index;
+  const size_t size = (sizeof (batch_runtime) + CACHE_LINE_SIZE - 1) & 
+    ~((size_t) CACHE_LINE_SIZE - 1);
+  void* rt = 0;
+  int error;
+
+  if ((error = posix_memalign (&rt, CACHE_LINE_SIZE, size)))
+    {
+      fprintf (stderr, "%s - error: posix_memalign () failed with error %d.\n", 
+               __func__, error);
+      return -1;
+    }
+
+  memset (rt, 0, size);
 
-  if (++bctx->ipv4_shared_index == (size_t)bctx->ip_shared_num)
-    bctx->ipv4_shared_index = 0;
+  if (op_stat_point_init (&((batch_runtime *) rt)->op_delta, bctx->urls_num) == -1)
+    {
+      fprintf (stderr, "%s - error: op_stat_point_init () failed.\n", __func__);
+      free (rt);
+      return -1;
+    }
 
-  return to_return;
+  bctx->rt = (batch_runtime *) rt;
+  return 0;
 }
-size_t next_ipv6_shared_index (batch_context* bctx)
+
+/****************************************************************************************
+* Function name - batch_runtime_release
+*
+* Description - Releases the run-time counters, allocated by batch_runtime_init ()
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void batch_runtime_release (batch_context* bctx)
 {
-  size_t to_return = bctx->ipv6_shared_index;
+  if (! bctx->rt)
+    return;
+
+  op_stat_point_release (&bctx->rt->op_delta);
+  free (bctx->rt);
+  bctx->rt = 0;
+}
+
+/*
+  Offset of the ip-address of a client from the minimal ip-address of the batch.
+  Shared ip-addresses are assigned to the clients round-robin.
+*/
+static size_t client_ip_offset (batch_context* bctx, size_t client_index)
+{
+  return bctx->ip_shared_num ? 
+    client_index % (size_t) bctx->ip_shared_num : client_index;
+}
+
+/****************************************************************************************
+* Function name - batch_client_ip_addr
+*
+* Description - Computes the ip-address of a client from the minimal ip-address of 
+*               the batch and the index of the client, thus the addresses are not kept 
+*               per client
+*
+* Input -       *bctx - pointer to the batch context, which created the client
+*               client_index - index of the client in the batch
+* Output -      *addr - the ip-address of the client with zero port
+*               *addr_len - length of the address
+* Return Code/Output - On success - 0, on error, like passing the IPv6 scope, -1
+****************************************************************************************/
+int batch_client_ip_addr (batch_context* bctx, 
+                          size_t client_index,
+                          struct sockaddr_storage* addr,
+                          socklen_t* addr_len)
+{
+  size_t offset = client_ip_offset (bctx, client_index);
+
+  memset (addr, 0, sizeof (*addr));
+
+  if (! bctx->ipv6)
+    {
+      struct sockaddr_in* sa = (struct sockaddr_in *) addr;
+
+      sa->sin_family = AF_INET;
+      sa->sin_addr.s_addr = htonl (bctx->ip_addr_min + offset);
+      *addr_len = sizeof (struct sockaddr_in);
+    }
+  else
+    {
+      struct sockaddr_in6* sa6 = (struct sockaddr_in6 *) addr;
+      int i;
+
+      sa6->sin6_family = AF_INET6;
+      sa6->sin6_addr = bctx->ipv6_addr_min;
+
+      /* Add the offset, keeping the scope in the two upper bytes */
+      for (i = 15; i > 1 && offset; i--)
+        {
+          offset += sa6->sin6_addr.s6_addr[i];
+          sa6->sin6_addr.s6_addr[i] = offset & 0xff;
+          offset >>= 8;
+        }
+
+      if (offset)
+        {
+          fprintf (stderr, "%s - error: passing the scope.\n "
+                   "Check you IPv6 range to be within the same scope.\n", __func__);
+          return -1;
+        }
+
+      *addr_len = sizeof (struct sockaddr_in6);
+    }
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - batch_client_ip_addr_str
+*
+* Description - Prints the text presentation of the ip-address of a client
+*
+* Input -       *bctx - pointer to the batch context, which created the client
+*               client_index - index of the client in the batch
+*               buf_len - size of the buffer, at least INET6_ADDRSTRLEN for IPv6
+* Output -      *buf - the buffer to print to
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int batch_client_ip_addr_str (batch_context* bctx, 
+                              size_t client_index,
+                              char* buf,
+                              size_t buf_len)
+{
+  struct sockaddr_storage addr;
+  socklen_t addr_len;
+
+  if (batch_client_ip_addr (bctx, client_index, &addr, &addr_len) == -1)
+    return -1;
 
-  if (++bctx->ipv6_shared_index == (size_t)bctx->ip_shared_num)
-    bctx->ipv6_shared_index = 0;
+  if (! inet_ntop (addr.ss_family, 
+                   bctx->ipv6 ? 
+                   (void *) &((struct sockaddr_in6 *) &addr)->sin6_addr :
+                   (void *) &((struct sockaddr_in *) &addr)->sin_addr,
+                   buf, buf_len))
+    {
+      fprintf (stderr, "%s - error: inet_ntop () failed with errno %d.\n", 
+               __func__, errno);
+      return -1;
+    }
 
-  return to_return;
+  return 0;
 }
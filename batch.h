@@ -26,6 +26,7 @@
 #define BATCH_H
 
 #include <stddef.h>
+#include <sys/socket.h>
 #include <netinet/in.h>
 #include <pthread.h>
 
@@ -35,6 +36,7 @@
 #include "timer_node.h"
 #include "url.h"
 #include "statistics.h"
+#include "arena.h"
 
 #define BATCH_NAME_SIZE 64
 #define BATCH_NAME_EXTRA_SIZE 12
@@ -42,6 +44,13 @@
 
 #define CUSTOM_HDRS_MAX_NUM 64
 
+/* 
+   Size of a CPU cache line. Batch contexts of loading threads are placed 
+   in an array, thus their run-time parts are aligned to the cache line 
+   to keep the state of neighbouring threads on different lines.
+*/
+#define CACHE_LINE_SIZE 64
+
 typedef enum form_usagetype
 {
     FORM_USAGETYPE_START = 0,
@@ -58,6 +67,38 @@ typedef enum form_usagetype
 struct client_context;
 struct event_base;
 struct event;
+struct mpool;
+struct native_batch;
+
+/**********************
+  struct batch_runtime
+
+  The counters of a loading thread, updated on each request. Allocated by 
+  the thread itself after binding to its CPU (see batch_runtime_init ()), 
+  thus placed at the NUMA node of the thread and at own cache lines, apart 
+  from the configuration in the batch context and from other threads.
+*/
+typedef struct batch_runtime
+{
+  /* Counter used mainly by smooth mode: active clients */
+  int active_clients_count;
+
+  /* Number of clients "sleeping" their after url timeout. */
+  int sleeping_clients_count;
+
+  /* Number of open connections, counted, when pipelining */
+  int pipe_connections_open;
+
+  /* HTTP counters since the last measurements */
+  stat_point http_delta;
+
+  /* HTTPS counters since the last measurements */
+  stat_point https_delta;
+
+  /* Operations statistics since the last measurements */
+  op_stat_point op_delta;
+
+} batch_runtime;
 
 /**********************
   struct batch_context
@@ -115,8 +156,6 @@ typedef struct batch_context
    */
   int ip_shared_num;
 
-  size_t ipv4_shared_index;
-
   /* 
      CIDR netmask number from 0 to 128, like 16 or 24, etc. If the input netmask is
      a dotted IPv4 address, we convert it to CIDR by calculating number of 1 bits.
@@ -131,10 +170,6 @@ typedef struct batch_context
 
   /* Miximum IPv6-address of a client in the batch. */
   struct in6_addr ipv6_addr_max;
-
-  struct in6_addr in6_prev, in6_new;
-
-  size_t ipv6_shared_index;
  
    /* 
       Number of cycles to repeat the urls downloads and afterwards sleeping 
@@ -153,6 +188,44 @@ typedef struct batch_context
   */
   int req_rate;
 
+  /*
+      Number of libcurl multi-handles (shards) to spread the batch clients
+      among. All of them are serviced by the same event loop of the batch.
+      Keeps the cost of libcurl multi-handle operations flat, when there
+      are tens of thousands of clients per batch. Default is 1.
+  */
+  int multi_handles_num;
+
+  /*
+      When true, the batch urls are fetched by the native HTTP/1.1 engine
+      in epoll-mode, bypassing libcurl, provided all of them are plain
+      HTTP GET or POST. Default is no.
+  */
+  int native_engine;
+
+  /*
+      When positive, libcurl multi-handles of the batch pipeline HTTP/1.1
+      GET requests of the clients sharing an IP-address and a server on the
+      same connection, up to <pipeline_depth> requests in flight per
+      connection. Default is 0 - no pipelining.
+  */
+  int pipeline_depth;
+
+  /*
+      When positive, the batch clients fetch their urls by HTTP/2, sharing
+      multiplexed connections with up to <http2_streams> concurrent streams
+      per connection. Requires libcurl with HTTP/2 support, otherwise falls
+      back to HTTP/1.1 pipelining. Default is 0 - no HTTP/2.
+  */
+  int http2_streams;
+
+  /*
+      When true, the loading threads (-t) rebalance their clients: a thread
+      with less clients than others takes sleeping clients from them during
+      their think time. Default is no.
+  */
+  int clients_balance;
+
    /* 
       User-agent string to appear in the HTTP 1/1 requests.
   */
@@ -192,19 +265,40 @@ typedef struct batch_context
 
   /* 
      The sequence num of a batch in batch_array. Zero batch is the batch group 
-     leader and is in charge for statistics presentation on behave of all other batches
+     leader and is in charge for statistics presentation on behave of all other batches.
+
+     The configuration above is not written, when loading. The run-time state
+     starts here at a new cache line, so that the leader, reading configuration 
+     of other threads, does not share the lines with their state.
   */
-  size_t batch_id;
+  size_t batch_id __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+  /* The counters, updated on each request, allocated by the loading thread */
+  batch_runtime* rt;
 
   /* Thread id, filled by pthread_create (). Used by pthread_join () syscall */
   pthread_t thread_id;
 
-  /* Multiple handle for curl. Contains all curl handles of a batch */
-  CURLM *multiple_handle;
-  
-   /* Assisting array of pointers to ip-addresses */
-  char** ip_addr_array;
+  /* 
+     Multiple handles for curl, <multi_handles_num> shards. Each one 
+     contains curl handles of the batch clients assigned to it.
+  */
+  CURLM** multi_handles;
+
+  /* 
+     Pool of the CURL handles, not used by the clients at the moment, up to
+     <handles_free_max> handles (see handle_pool.h).
+  */
+  CURL** handles_free;
+
+  /* CURLOPT_INTERFACE buffers of the handles, parallel to handles_free */
+  char** handles_free_dev;
+  int handles_free_num;
+  int handles_free_max;
 
+  /* Flag, whether sleeping clients return their CURL handles to the pool */
+  int handles_pool_sleep;
+  
   /* Current parsing state. Used on reading and parsing conf-file. */ 
   size_t batch_init_state; 
 
@@ -214,6 +308,12 @@ typedef struct batch_context
   /* Array of all client contexts for the batch */
   struct client_context* cctx_array;
 
+  /* 
+     Arena of the per-client buffers and side arrays of the batch, released 
+     at once with the batch (see arena.h).
+  */
+  arena client_arena;
+
   /* Number of clients free to send fixed rate requests */
   int free_clients_count;
 
@@ -226,12 +326,6 @@ typedef struct batch_context
   /* Request rate timer invocation sequence number within a second */
   int req_rate_timer_invocation;
 
-  /* Counter used mainly by smooth mode: active clients */
-  int active_clients_count;
-
-  /* Number of clients "sleeping" their after url timeout. */
-  int sleeping_clients_count;
-
   /* 
      Whether to do gradual increase of loading clients to prevent
      a simulteneous huge flow of client requests to server.
@@ -240,6 +334,12 @@ typedef struct batch_context
 
   int stop_client_num_gradual_increase;
 
+  /* 
+     Number of clients to add, posted by the statistics thread on keyboard
+     input and added by the loading thread at its screen input timer.
+  */
+  int screen_clients_add;
+
   /* 
      Number of already scheduled clients. Used to schedule new
      clients in a gradual fashion, when <clients_rampup_inc> is positive. 
@@ -261,14 +361,68 @@ typedef struct batch_context
   /* The timer-node for fixed request rate timer. */
   timer_node req_rate_timer_node;
 
-  /* Event base from event_init () of libevent. */
+  /* The timer-node for clients rebalancing timer. */
+  timer_node balance_timer_node;
+
+  /* 
+     Clients rebalancing between threads. Clients, moved to the thread and not 
+     yet received by it, and the flag, that the thread does not receive more
+     clients, are guarded by the <balance_lock>. 
+  */
+  pthread_mutex_t balance_lock;
+  struct client_context* balance_inbox;
+  int balance_closed;
+
+  /* Clients received from other threads, returned at the end of loading */
+  struct client_context* balance_guests;
+
+  /* Number of own clients moved to other threads and not yet returned */
+  int balance_emigrants;
+
+  /* Number of active and sleeping clients, published for other threads */
+  int balance_load;
+
+  /* Index in <cctx_array> to continue looking for clients to move from */
+  int balance_cursor;
+
+  /* 
+     Standby of the thread (see standby.h). The request to be on standby, the flag,
+     that the thread is counted as loading, and the flag, that the thread has 
+     completed, are guarded by the standby lock.
+  */
+  int standby;
+  int standby_loading;
+  int standby_done;
+
+  /* Set, when the thread is on standby and parks its clients */
+  int standby_on;
+
+  /* Ramp-up of the clients, paused by standby */
+  int standby_gradual;
+
+  /* Clients parked by the thread on standby */
+  struct client_context* standby_parked;
+
+  /* 
+     Set, when the loading is stopped by SIGINT and the thread, not being the 
+     batch group leader, completes its requests in flight (see loader_fsm.c).
+  */
+  int stopping;
+
+  /* Event base of the thread from event_base_new () of libevent. */
   struct event_base* eb;
 
   /* Pointer to structure used by lebevent. */
   struct event* timer_event;
 
-  /* Pointer to structure used by lebevent. */
-  struct event* timer_next_load_event;
+  /* Descriptor from epoll_create () in epoll-mode. */
+  int epoll_fd;
+
+  /* Memory pool of per-socket structures in epoll-mode. */
+  struct mpool* sock_info_mpool;
+
+  /* The native HTTP engine of the batch, when enabled and suitable. */
+  struct native_batch* native;
 
 
   /*--------------- STATISTICS  --------------------------------------------*/
@@ -288,20 +442,32 @@ typedef struct batch_context
   /* The last timestamp */
   unsigned long last_measure;
 
-  /* HTTP counters since the last measurements */
-  stat_point http_delta;
-  /* HTTP counters since the loading started */
+  /* 
+     HTTP, HTTPS and operations counters since the loading started. The 
+     counters since the last measurements are in <rt>.
+  */
   stat_point http_total;
-
-  /* HTTPS counters since the last measurements */
-  stat_point https_delta;
-  /* HTTPS counters since the loading started */
   stat_point https_total;
-
-  /* Operations statistics */
-  op_stat_point op_delta;
   op_stat_point op_total;
 
+  /* 
+     Statistics of the thread, published for the batch group leader, 
+     when loading by several threads or processes. Read by the leader, thus 
+     allocated at own cache lines apart from the counters updated on each 
+     request, and in shared memory for processes (see stat_published_init ()).
+  */
+  stat_snapshot* stat_published;
+
+  /* Timestamp of the latest publishing */
+  unsigned long stat_published_time;
+
+  /* 
+     Used by the leader only: the latest snapshot of the thread statistics 
+     merged, and the snapshot being read.
+  */
+  stat_snapshot stat_merged __attribute__ ((aligned (CACHE_LINE_SIZE)));
+  stat_snapshot stat_read;
+
   /* Count of response times dumped before new-line,
    used to limit line length */
   int ct_resps;
@@ -311,8 +477,17 @@ typedef struct batch_context
 
 int is_batch_group_leader (batch_context* bctx);
 
-size_t next_ipv4_shared_index (batch_context* bctx);
-size_t next_ipv6_shared_index (batch_context* bctx);
+int batch_runtime_init (batch_context* bctx);
+void batch_runtime_release (batch_context* bctx);
+
+int batch_client_ip_addr (batch_context* bctx, 
+                          size_t client_index,
+                          struct sockaddr_storage* addr,
+                          socklen_t* addr_len);
+int batch_client_ip_addr_str (batch_context* bctx, 
+                              size_t client_index,
+                              char* buf,
+                              size_t buf_len);
 
 
 
@@ -0,0 +1,346 @@
+/*
+*     tq_bench.c
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+  Benchmark of the timer queues. Schedules and cancels millions of timers by
+  the binary heap and by the hierarchical timing wheel, and compares the heap
+  with the former cancelling by the context, which walked the heap array.
+
+  Build by "make bench" and run as bench/tq-bench [timers number].
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "timer_queue.h"
+#include "timer_node.h"
+#include "heap.h"
+#include "conf.h"
+
+/* Default number of the timers */
+#define BENCH_TIMERS_NUM 1000000
+
+/* Number of timers, cancelled by the former linear walk of the heap */
+#define BENCH_OLD_CANCEL_NUM 200
+
+/* The timers are spread over the next minute */
+#define BENCH_TIMERS_RANGE 60000
+
+/*
+   The timer queue links only timer_queue.c, heap.c, twheel.c, mpool.c
+   and cl_alloc.c. Supply the globals of conf.c and statistics.c, they use.
+*/
+int timer_queue_type = TQ_TYPE_DEFAULT;
+
+static unsigned long bench_now = 0;
+
+unsigned long get_tick_count ()
+{
+  return bench_now;
+}
+
+static unsigned long rand_state = 88172645463325252UL;
+
+/****************************************************************************************
+* Function name - bench_rand
+*
+* Description - xorshift pseudo-random numbers, reproducible from run to run
+*
+* Return Code/Output - pseudo-random number
+****************************************************************************************/
+static unsigned long bench_rand (void)
+{
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 7;
+  rand_state ^= rand_state << 17;
+  return rand_state;
+}
+
+/****************************************************************************************
+* Function name - usec_now
+*
+* Description - Reads the monotonic clock
+*
+* Return Code/Output - time in microseconds
+****************************************************************************************/
+static double usec_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/****************************************************************************************
+* Function name - report
+*
+* Description - Prints the time of an operation on the timers
+*
+* Input -       *name - name of the operation
+*               ops - number of operations
+*               usec - time of the operations in microseconds
+* Return Code/Output - None
+****************************************************************************************/
+static void report (const char* name, size_t ops, double usec)
+{
+  fprintf (stdout, "  %-28s %9lu ops %10.1f msec %8.1f nsec/op\n",
+           name, (unsigned long) ops, usec / 1e3, usec * 1e3 / ops);
+}
+
+/****************************************************************************************
+* Function name - shuffle
+*
+* Description - Shuffles the order of the timer nodes
+*
+* Input/Output - **order - array of pointers to the timer nodes
+* Input -       num - number of the nodes
+* Return Code/Output - None
+****************************************************************************************/
+static void shuffle (timer_node** order, size_t num)
+{
+  size_t i;
+
+  for (i = num - 1; i > 0; i--)
+    {
+      size_t j = bench_rand () % (i + 1);
+      timer_node* tmp = order[i];
+
+      order[i] = order[j];
+      order[j] = tmp;
+    }
+}
+
+/****************************************************************************************
+* Function name - schedule_all
+*
+* Description - Schedules the timers of all the nodes
+*
+* Input -       *tq - pointer to the timer queue
+*               *nodes - array of the timer nodes
+*               num - number of the nodes
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int schedule_all (timer_queue* tq, timer_node* nodes, size_t num)
+{
+  size_t i;
+
+  for (i = 0; i < num; i++)
+    {
+      nodes[i].next_timer = bench_now + 1 + bench_rand () % BENCH_TIMERS_RANGE;
+      nodes[i].period = 0;
+      nodes[i].func_timer = 0;
+
+      if (tq_schedule_timer (tq, &nodes[i]) == -1)
+        {
+          fprintf (stderr, "%s - error: tq_schedule_timer () failed.\n", __func__);
+          return -1;
+        }
+    }
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - old_cancel_timers
+*
+* Description - The former heap path of tq_cancel_timers (): walks the heap array
+*               for the nodes of the context
+*
+* Input -       *h - pointer to the heap
+*               *tnode - pointer to the timer node
+* Return Code/Output - On success - number of the cancelled timers, on error -1
+****************************************************************************************/
+static int old_cancel_timers (heap* h, timer_node* tnode)
+{
+  hnode* node = 0;
+  size_t index = 0;
+  int counter = 0;
+
+  for (index = 0; index < h->curr_heap_size;)
+    {
+      if (h->heap[index]->ctx == tnode)
+        {
+          if (! (node = heap_remove_node (h, index, 0)))
+            {
+              fprintf (stderr, "%s - error: node removal failed.\n", __func__);
+              return -1;
+            }
+
+          node_reset (node);
+          mpool_return_obj (h->nodes_mpool, (allocatable *) node);
+          counter++;
+        }
+      else
+        {
+          ++index;
+        }
+    }
+
+  return counter;
+}
+
+/****************************************************************************************
+* Function name - bench_queue
+*
+* Description - Schedules and cancels the timers by a timer queue of the type
+*
+* Input -       type - type of the timer queue
+*               *nodes - array of the timer nodes
+*               **order - array for the random order of cancelling
+*               num - number of the nodes
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int bench_queue (int type, timer_node* nodes, timer_node** order, size_t num)
+{
+  timer_queue* tq = 0;
+  double start;
+  size_t i;
+  int rval = -1;
+
+  timer_queue_type = type;
+
+  fprintf (stdout, "%s:\n", type == TQ_TYPE_WHEEL ? "timing wheel" : "heap");
+
+  if (! (tq = calloc (1, tq_object_size ())) ||
+      tq_init (tq, num, 10, num) == -1)
+    {
+      fprintf (stderr, "%s - error: failed to initialize the timer queue.\n", __func__);
+      free (tq);
+      return -1;
+    }
+
+  for (i = 0; i < num; i++)
+    order[i] = &nodes[i];
+
+  /* Schedule and cancel by the timer-ids in random order */
+  start = usec_now ();
+  if (schedule_all (tq, nodes, num) == -1)
+    goto release;
+  report ("schedule", num, usec_now () - start);
+
+  shuffle (order, num);
+
+  start = usec_now ();
+  for (i = 0; i < num; i++)
+    {
+      if (tq_cancel_timer (tq, order[i]->timer_id) == -1)
+        {
+          fprintf (stderr, "%s - error: tq_cancel_timer () failed.\n", __func__);
+          goto release;
+        }
+    }
+  report ("cancel by timer-id", num, usec_now () - start);
+
+  /* Schedule again, reusing the freed ids, and cancel by the timer contexts */
+  start = usec_now ();
+  if (schedule_all (tq, nodes, num) == -1)
+    goto release;
+  report ("re-schedule", num, usec_now () - start);
+
+  start = usec_now ();
+  for (i = 0; i < num; i++)
+    {
+      if (tq_cancel_timers (tq, order[i]) != 1)
+        {
+          fprintf (stderr, "%s - error: tq_cancel_timers () failed.\n", __func__);
+          goto release;
+        }
+    }
+  report ("cancel by context", num, usec_now () - start);
+
+  if (type == TQ_TYPE_HEAP)
+    {
+      /*
+         The former walk of the heap is quadratic, thus measured by a sample
+         of the timers, cancelled out of the full heap.
+      */
+      const size_t sample = num < BENCH_OLD_CANCEL_NUM ? num : BENCH_OLD_CANCEL_NUM;
+      double usec;
+
+      if (schedule_all (tq, nodes, num) == -1)
+        goto release;
+
+      start = usec_now ();
+      for (i = 0; i < sample; i++)
+        {
+          if (old_cancel_timers ((heap *) tq, order[i]) != 1)
+            {
+              fprintf (stderr, "%s - error: old_cancel_timers () failed.\n", __func__);
+              goto release;
+            }
+        }
+      usec = usec_now () - start;
+
+      report ("cancel by context, old path", sample, usec);
+      fprintf (stdout, "  %-28s %9lu ops %10.1f msec, estimated\n",
+               "", (unsigned long) num, usec * num / sample / 1e3);
+
+      /* The nodes are to be returned to the pool before its release */
+      for (i = sample; i < num; i++)
+        tq_cancel_timers (tq, order[i]);
+    }
+
+  rval = 0;
+
+ release:
+  tq_release (tq);
+  free (tq);
+  return rval;
+}
+
+int main (int argc, char* argv[])
+{
+  size_t num = BENCH_TIMERS_NUM;
+  timer_node* nodes = 0;
+  timer_node** order = 0;
+  int rval = 0;
+
+  if (argc > 1 && (num = (size_t) atol (argv[1])) < 1)
+    {
+      fprintf (stderr, "usage: %s [timers number]\n", argv[0]);
+      return 1;
+    }
+
+  if (! (nodes = calloc (num, sizeof (*nodes))) ||
+      ! (order = calloc (num, sizeof (*order))))
+    {
+      fprintf (stderr, "%s - error: allocation of %lu timers failed.\n",
+               __func__, (unsigned long) num);
+      return 1;
+    }
+
+  bench_now = 1000;
+
+  if (bench_queue (TQ_TYPE_HEAP, nodes, order, num) == -1 ||
+      bench_queue (TQ_TYPE_WHEEL, nodes, order, num) == -1)
+    {
+      rval = 1;
+    }
+
+  free (order);
+  free (nodes);
+  return rval;
+}
@@ -26,11 +26,12 @@
 
 #include "client.h"
 #include "batch.h"
+#include "cl_alloc.h"
 
 
 /*
-  Accessors to the flags-counters of headers.
-  Incrementing counters for the flags-counters of headers.
+  Accessors to the flags of headers.
+  Setting the flags of headers, when the first header has been seen.
 */
 int first_hdr_req (client_context* cctx)
 {
@@ -38,7 +39,7 @@ int first_hdr_req (client_context* cctx)
 }
 void first_hdr_req_inc (client_context* cctx)
 {
-  cctx->first_hdr_req++;
+  cctx->first_hdr_req = 1;
 }
 int first_hdr_1xx (client_context* cctx)
 {
@@ -46,7 +47,7 @@ int first_hdr_1xx (client_context* cctx)
 }
 void first_hdr_1xx_inc (client_context* cctx)
 {
-  cctx->first_hdr_1xx++;
+  cctx->first_hdr_1xx = 1;
 }
 int first_hdr_2xx (client_context* cctx)
 {
@@ -54,15 +55,15 @@ int first_hdr_2xx (client_context* cctx)
 }
 void first_hdr_2xx_inc (client_context* cctx)
 {
-  cctx->first_hdr_2xx++;
+  cctx->first_hdr_2xx = 1;
 }
 int first_hdr_3xx (client_context* cctx)
 {
-  return cctx->first_hdr_3xx++;
+  return cctx->first_hdr_3xx;
 }
 void first_hdr_3xx_inc (client_context* cctx)
 {
-  cctx->first_hdr_3xx++;
+  cctx->first_hdr_3xx = 1;
 }
 
 int first_hdr_4xx (client_context* cctx)
@@ -71,7 +72,7 @@ int first_hdr_4xx (client_context* cctx)
 }
 void first_hdr_4xx_inc (client_context* cctx)
 {
-  cctx->first_hdr_4xx++;
+  cctx->first_hdr_4xx = 1;
 }
 int first_hdr_5xx (client_context* cctx)
 {
@@ -79,12 +80,12 @@ int first_hdr_5xx (client_context* cctx)
 }
 void first_hdr_5xx_inc (client_context* cctx)
 {
-  cctx->first_hdr_5xx++;
+  cctx->first_hdr_5xx = 1;
 }
 
 
 /*
-  Reseting to zero counters for the flags-counters of headers.
+  Reseting to zero the flags of headers.
 */
 void first_hdrs_clear_all (client_context* cctx)
 {
@@ -123,104 +124,90 @@ void first_hdrs_clear_non_5xx (client_context* cctx)
 
 void stat_data_out_add (client_context* cctx, unsigned long bytes)
 {
-  cctx->st.data_out += bytes;
+  cctx->cold->st.data_out += bytes;
 
-  cctx->is_https ? (cctx->bctx->https_delta.data_out += bytes) :
-    (cctx->bctx->http_delta.data_out += bytes);
+  cctx->is_https ? (cctx->bctx->rt->https_delta.data_out += bytes) :
+    (cctx->bctx->rt->http_delta.data_out += bytes);
 }
 
 void stat_data_in_add (client_context* cctx, unsigned long bytes)
 {
-  cctx->st.data_in += bytes;
+  cctx->cold->st.data_in += bytes;
   
-  cctx->is_https ? (cctx->bctx->https_delta.data_in += bytes) :
-    (cctx->bctx->http_delta.data_in += bytes);
+  cctx->is_https ? (cctx->bctx->rt->https_delta.data_in += bytes) :
+    (cctx->bctx->rt->http_delta.data_in += bytes);
 }
 
 void stat_err_inc (client_context* cctx)
 {
-  cctx->st.other_errs++;
-  cctx->is_https ? cctx->bctx->https_delta.other_errs++ :
-    cctx->bctx->http_delta.other_errs++;
+  cctx->cold->st.other_errs++;
+  cctx->is_https ? cctx->bctx->rt->https_delta.other_errs++ :
+    cctx->bctx->rt->http_delta.other_errs++;
 }
 
 void stat_url_timeout_err_inc (client_context* cctx)
 {
-  cctx->st.url_timeout_errs++;
-  cctx->is_https ? cctx->bctx->https_delta.url_timeout_errs++ :
-    cctx->bctx->http_delta.url_timeout_errs++;
+  cctx->cold->st.url_timeout_errs++;
+  cctx->is_https ? cctx->bctx->rt->https_delta.url_timeout_errs++ :
+    cctx->bctx->rt->http_delta.url_timeout_errs++;
 }
 void stat_req_inc (client_context* cctx)
 {
-  cctx->st.requests++;
-  cctx->is_https ? cctx->bctx->https_delta.requests++ :
-    cctx->bctx->http_delta.requests++;
+  cctx->cold->st.requests++;
+  cctx->is_https ? cctx->bctx->rt->https_delta.requests++ :
+    cctx->bctx->rt->http_delta.requests++;
 }
 void stat_1xx_inc (client_context* cctx)
 {
-  cctx->st.resp_1xx++;
-  cctx->is_https ? cctx->bctx->https_delta.resp_1xx++ :
-    cctx->bctx->http_delta.resp_1xx++;
+  cctx->cold->st.resp_1xx++;
+  cctx->is_https ? cctx->bctx->rt->https_delta.resp_1xx++ :
+    cctx->bctx->rt->http_delta.resp_1xx++;
 }
 void stat_2xx_inc (client_context* cctx)
 {
-  cctx->st.resp_2xx++;
-  cctx->is_https ? cctx->bctx->https_delta.resp_2xx++ :
-    cctx->bctx->http_delta.resp_2xx++;
+  cctx->cold->st.resp_2xx++;
+  cctx->is_https ? cctx->bctx->rt->https_delta.resp_2xx++ :
+    cctx->bctx->rt->http_delta.resp_2xx++;
 }
 void stat_3xx_inc (client_context* cctx)
 {
-  cctx->st.resp_3xx++;
-  cctx->is_https ? cctx->bctx->https_delta.resp_3xx++ :
-    cctx->bctx->http_delta.resp_3xx++;
+  cctx->cold->st.resp_3xx++;
+  cctx->is_https ? cctx->bctx->rt->https_delta.resp_3xx++ :
+    cctx->bctx->rt->http_delta.resp_3xx++;
 }
 void stat_4xx_inc (client_context* cctx)
 {
-  cctx->st.resp_4xx++;
-  cctx->is_https ? cctx->bctx->https_delta.resp_4xx++ :
-    cctx->bctx->http_delta.resp_4xx++;
+  cctx->cold->st.resp_4xx++;
+  cctx->is_https ? cctx->bctx->rt->https_delta.resp_4xx++ :
+    cctx->bctx->rt->http_delta.resp_4xx++;
 }
 void stat_5xx_inc (client_context* cctx)
 {
-  cctx->st.resp_5xx++;
-  cctx->is_https ? cctx->bctx->https_delta.resp_5xx++ :
-    cctx->bctx->http_delta.resp_5xx++;
+  cctx->cold->st.resp_5xx++;
+  cctx->is_https ? cctx->bctx->rt->https_delta.resp_5xx++ :
+    cctx->bctx->rt->http_delta.resp_5xx++;
 }
 
-void stat_appl_delay_add (client_context* cctx, unsigned long resp_timestamp)
+void stat_appl_delay_add (client_context* cctx, unsigned long long resp_timestamp)
 {
   if (resp_timestamp > cctx->req_sent_timestamp)
     {
-      if (cctx->is_https)
-        {
-          cctx->bctx->https_delta.appl_delay = 
-            (cctx->bctx->https_delta.appl_delay * cctx->bctx->https_delta.appl_delay_points +
-             resp_timestamp - cctx->req_sent_timestamp) / ++cctx->bctx->https_delta.appl_delay_points;
-        }
-      else
-        {
-          cctx->bctx->http_delta.appl_delay = 
-            (cctx->bctx->http_delta.appl_delay * cctx->bctx->http_delta.appl_delay_points +
-             resp_timestamp - cctx->req_sent_timestamp) / ++cctx->bctx->http_delta.appl_delay_points;
-        }
+      stat_point* sp = cctx->is_https ? &cctx->bctx->rt->https_delta : 
+        &cctx->bctx->rt->http_delta;
+
+      sp->appl_delay_sum += resp_timestamp - cctx->req_sent_timestamp;
+      sp->appl_delay = sp->appl_delay_sum / ++sp->appl_delay_points;
     }
 }
-void stat_appl_delay_2xx_add (client_context* cctx, unsigned long resp_timestamp)
+void stat_appl_delay_2xx_add (client_context* cctx, unsigned long long resp_timestamp)
 {
     if (resp_timestamp > cctx->req_sent_timestamp)
     {
-      if (cctx->is_https)
-        {
-          cctx->bctx->https_delta.appl_delay_2xx = 
-            (cctx->bctx->https_delta.appl_delay_2xx * cctx->bctx->https_delta.appl_delay_2xx_points +
-             resp_timestamp - cctx->req_sent_timestamp) / ++cctx->bctx->https_delta.appl_delay_2xx_points;
-        }
-      else
-        {
-          cctx->bctx->http_delta.appl_delay_2xx = 
-            (cctx->bctx->http_delta.appl_delay_2xx * cctx->bctx->http_delta.appl_delay_2xx_points +
-             resp_timestamp - cctx->req_sent_timestamp) / ++cctx->bctx->http_delta.appl_delay_2xx_points;
-        }
+      stat_point* sp = cctx->is_https ? &cctx->bctx->rt->https_delta : 
+        &cctx->bctx->rt->http_delta;
+
+      sp->appl_delay_2xx_sum += resp_timestamp - cctx->req_sent_timestamp;
+      sp->appl_delay_2xx = sp->appl_delay_2xx_sum / ++sp->appl_delay_2xx_points;
     }
 }
 
@@ -232,13 +219,46 @@ void dump_client (FILE* file, client_context* cctx)
 
   fprintf (file, 
            "%s,cycles:%ld,state:%d,b-in:%lld,b-out:%lld,req:%ld,1xx:%ld,2xx:%ld,3xx:%ld,4xx:%ld,5xx:%ld,err:%ld,T-err:%ld\n", 
-           cctx->client_name, cctx->cycle_num, cctx->client_state, 
-           cctx->st.data_in,  cctx->st.data_out, cctx->st.requests, 
-           cctx->st.resp_1xx, cctx->st.resp_2xx, cctx->st.resp_3xx, cctx->st.resp_4xx, cctx->st.resp_5xx, 
-           cctx->st.other_errs, cctx->st.url_timeout_errs);
+           cctx->cold->client_name, cctx->cycle_num, cctx->client_state, 
+           cctx->cold->st.data_in,  cctx->cold->st.data_out, cctx->cold->st.requests, 
+           cctx->cold->st.resp_1xx, cctx->cold->st.resp_2xx, cctx->cold->st.resp_3xx, cctx->cold->st.resp_4xx, cctx->cold->st.resp_5xx, 
+           cctx->cold->st.other_errs, cctx->cold->st.url_timeout_errs);
   fflush (file);
 }
 
 
 
 
+
+/****************************************************************************************
+* Function name - client_array_alloc
+*
+* Description - Allocates the array of client contexts of a batch together with the
+*               side table of their cold parts. The table is placed after the array
+*               in the same allocation and is released by free () of the array.
+*
+* Input -       clients_num - number of the clients in the batch
+* Return Code/Output - On success - pointer to the array, on error - NULL
+****************************************************************************************/
+client_context* client_array_alloc (int clients_num)
+{
+  client_context* cctx_array;
+  client_cold* cold_array;
+  int i;
+
+  if (!(cctx_array = (client_context *) cl_calloc (clients_num, 
+                                                   sizeof (client_context) + 
+                                                   sizeof (client_cold))))
+    {
+      return NULL;
+    }
+
+  cold_array = (client_cold *) (cctx_array + clients_num);
+
+  for (i = 0; i < clients_num; i++)
+    {
+      cctx_array[i].cold = &cold_array[i];
+    }
+
+  return cctx_array;
+}
@@ -61,19 +61,74 @@ typedef enum cstate
 /* Forward declarations */
 struct batch_context;
 
+/*
+  client_cold - the cold part of a virtual client: its name, logging, 
+  POST-buffers and client-based statistics. 
+
+  These are touched on a verbose logging, on building of a request with a 
+  form and on the final dump of the clients, whereas the scheduler works 
+  only with the client_context. The cold parts of the batch clients are kept 
+  in a side table, allocated together with the array of the client contexts
+  (see client_array_alloc ()), thus, the array of client contexts is dense
+  and the working set of the scheduler fits the cache better.
+*/
+typedef struct client_cold
+{
+   /*
+      <Current Cycle Num> space <Client Sequence Num> space <Client IP-address> 
+   */
+  char client_name[CLIENT_NAME_LEN];
+
+  /* 
+     The file to be used as an output channel for this particular 
+     client (normally used a file-per-batch logging strategy) 
+  */
+  FILE* file_output;
+
+  /* 
+     The buffers for the POST method login and logoff are allocated only, 
+     when a single url is configured to make some POST-ing and has 
+     filled <form_str>
+  */
+  char* post_data;
+
+  size_t post_data_len;
+
+  char* get_url_form_data;
+
+  size_t get_url_form_data_len;
+
+  FILE* logfile_headers;
+
+  FILE* logfile_bodies;
+
+  char* url_fetch_decision;
+
+  /* 
+     Cookies of the client in the Netscape format, one per line, kept while 
+     the client has no CURL handle (see handle_pool.h). 
+  */
+  char* cookies;
+
+  /*
+    Client-based statistics. Parallel to updating batch statistics, 
+    client-based statistics is also updated.
+  */
+  stat_point st;
+
+} client_cold;
+
 /*
   client_context -the structure is the placeholder of  a virtual client 
-  stateful information.
+  stateful information, used by the scheduler.
   
   Client context is passed to curl handle as the private data to be returned 
   back to the tracing function for output to logfile.
 
-  Client context is also heavily used for login/logoff operations, keeping
-  client-specific POST-buffers, is a placeholder for loading statistics and 
-  counters, assisting to collect such statistics.
-  
   Client context keeps client specific context for loading, e.g. pointer to 
-  libcurl handle (CURL* handle), number of cycles done, etc.
+  libcurl handle (CURL* handle), number of cycles done, etc. The name, 
+  logging, POST-buffers and statistics of the client are in its cold part 
+  <cold> (see client_cold).
 
   client_context inherits from timer_node (the first field) to enable usage of 
   client_context in timer-queue.
@@ -95,116 +150,108 @@ typedef struct client_context
 
   long tid_url_completion;
 
-   /*
-      <Current Cycle Num> space <Client Sequence Num> space <Client IP-address> 
-   */
-  char client_name[CLIENT_NAME_LEN];
-
   /* 
      Library handle, representing all knowledge about the client from the
      side of libcurl library. We set to it url, timeouts, etc, using libcurl API.
   */
   CURL* handle;
- 
+
   /* 
-     Current cycle number.
+     CURLOPT_INTERFACE string with the client ip-address, kept together 
+     with the handle (see handle_pool.h).
   */
-  long cycle_num;
+  char* bind_dev;
 
   /* 
-     The file to be used as an output channel for this particular 
-     client (normally used a file-per-batch logging strategy) 
+     The libcurl multi-handle (shard) of the batch, where the client handle
+     is added to load.
   */
-  FILE* file_output;
-
-/* 
-   Batch context, which is running the client. Used for getting configs, like 
-   urls and writing collected client statistics to the batch summary statistics. 
-*/
-  struct batch_context* bctx;
-
-  /* Index of the client within its batch. */
-  size_t client_index;
+  CURLM* multi_handle;
+ 
+  /* 
+     Current cycle number.
+  */
+  long cycle_num;
 
   /* Index of the currently used url. */
   size_t url_curr_index;
 
-  /* Remember here preload url. */
-  size_t preload_url_curr_index;
-
    /* Current state of the client. */
   cstate client_state;
 
   /* Remember here pre-load state of a client. */
   cstate preload_state;
 
-   /* Number of errors */ 
-  int errors_num;
+  /* Remember here preload url. */
+  size_t preload_url_curr_index;
+
+/* 
+   Batch context, which is running the client. Used for getting configs, like 
+   urls and writing collected client statistics to the batch summary statistics. 
+*/
+  struct batch_context* bctx;
 
-  /* Whether to update statistics of https or http. What about ftp: TODO */
-  int is_https;
- 
   /* 
-     The buffers for the POST method login and logoff are allocated only, 
-     when a single url is configured to make some POST-ing and has 
-     filled <form_str>
+     Batch context, which created the client and keeps its ip-address. Differs 
+     from <bctx>, when the client was moved to another thread (CLIENTS_BALANCE).
   */
-  char* post_data;
+  struct batch_context* home_bctx;
 
-  size_t post_data_len;
-
-  char* get_url_form_data;
-
-  size_t get_url_form_data_len;
+  /* Link in the lists of clients moved between threads (see balance.h) */
+  struct client_context* balance_next;
 
-  FILE* logfile_headers;
+  /* Link in the list of clients parked by a thread on standby (see standby.h) */
+  struct client_context* standby_next;
 
-  FILE* logfile_bodies;
+  /* Index of the client within its batch. */
+  size_t client_index;
 
-  
-  char* url_fetch_decision;
+   /* Number of errors */ 
+  int errors_num;
 
+  /* Whether to update statistics of https or http. What about ftp: TODO */
+  int is_https;
 
   /* 
-     Counter of the headers going in or out.  For the first header in request
-     or response, the respective counter is zero, whereas next headers of the same
-     request/response are positive numbers.
+     Flags of the headers going in or out.  For the first header in request
+     or response, the respective flag is zero, whereas it is set for the next 
+     headers of the same request/response.
 
      Indication of the first header is used to collect statistics. Statistics is
      updated only once on the first header of req/resp.
   */
-  int first_hdr_req;
-  int first_hdr_1xx;
-  int first_hdr_2xx;
-  int first_hdr_3xx;
-  int first_hdr_4xx;
-  int first_hdr_5xx;
+  unsigned int first_hdr_req:1;
+  unsigned int first_hdr_1xx:1;
+  unsigned int first_hdr_2xx:1;
+  unsigned int first_hdr_3xx:1;
+  unsigned int first_hdr_4xx:1;
+  unsigned int first_hdr_5xx:1;
+
+   /*
+      GF
+      The previous curl_infotype seen by this client in a server response.
+      Used by scan_response() for url-set
+    */
+  curl_infotype previous_type;
 
   /* 
-     Timestamp of a request sent. Used to calculate server 
+     Timestamp in usec of a request sent. Used to calculate server 
      application response delay. 
   */
-  unsigned long req_sent_timestamp;
-
-  /*
-    Client-based statistics. Parallel to updating batch statistics, 
-    client-based statistics is also updated.
-  */
-  stat_point st;
+  unsigned long long req_sent_timestamp;
 
   /*
      Pointer to socket data used by hyper-mode
    */
   void * ext_data;
-  
-  
-   /*
-      GF
-      The previous curl_infotype seen by this client in a server response.
-      Used by scan_response() for url-set
-    */
-  curl_infotype previous_type;
 
+  /*
+     The connection of the native HTTP engine, when it is used by the batch.
+  */
+  struct native_conn* native_conn;
+
+  /* The cold part of the client in the side table of the batch */
+  client_cold* cold;
 
 } client_context;
 
@@ -245,11 +292,13 @@ void stat_3xx_inc (client_context* cctx);
 void stat_4xx_inc (client_context* cctx);
 void stat_5xx_inc (client_context* cctx);
 
-void stat_appl_delay_add (client_context* cctx, unsigned long resp_timestamp);
-void stat_appl_delay_2xx_add (client_context* cctx, unsigned long resp_timestamp);
+void stat_appl_delay_add (client_context* cctx, unsigned long long resp_timestamp);
+void stat_appl_delay_2xx_add (client_context* cctx, unsigned long long resp_timestamp);
 
 void dump_client (FILE* file, client_context* cctx);
 
+client_context* client_array_alloc (int clients_num);
+
 /* Currently, in smooth mode */
 int pending_active_and_waiting_clients_num (struct batch_context* bctx);
 
@@ -29,6 +29,8 @@
 #include <string.h>
 
 #include "conf.h"
+#include "distrib.h"
+#include "timer_queue.h"
 
 /*
   Command line configuration options. Setting defaults here.
@@ -42,6 +44,27 @@ int verbose_logging = 0;
 /* Flag, whether to run batches as batch per thread. */
 int threads_subbatches_num = 0;
 
+/* Flag, whether to run the sub-batches in processes rather than threads. */
+int subbatches_processes = 0;
+
+/* Number of the loading threads to start with, others are on standby. */
+int threads_active_num = 0;
+
+/* Whether libcurl allocates by the system malloc instead of the slab allocator */
+int curl_system_alloc = 0;
+
+/* CPUs to bind the loading threads to and CPUs to keep free of them */
+const char* cpu_affinity_list = 0;
+const char* cpu_reserved_list = 0;
+
+/* 
+   Distributed loading: agents of the coordinator, listening address and 
+   port of an agent 
+*/
+const char* distrib_agents = 0;
+const char* distrib_agent_addr = "127.0.0.1";
+int distrib_agent_port = 0;
+
 /* 
    Time in seconds between snapshot statistics printouts to
    screen as well as to the statistics file
@@ -61,6 +84,9 @@ int stderr_print_client_msg = 0;
 /* Storming or smooth loading */
 int loading_mode = LOAD_MODE_DEFAULT;
 
+/* Timer queue: heap or timing wheel */
+int timer_queue_type = TQ_TYPE_DEFAULT;
+
  /* Whether to include url to all log outputs. */
 int url_logging = 0;
 
@@ -87,10 +113,23 @@ int parse_command_line (int argc, char *argv [])
 {
   int rget_opt = 0;
 
-    while ((rget_opt = getopt (argc, argv, "c:dehf:i:l:m:op:rst:vuwx:")) != EOF) 
+    while ((rget_opt = getopt (argc, argv, "a:bc:dehf:g:i:j:k:l:m:n:op:q:rst:vuwx:")) != EOF) 
     {
       switch (rget_opt) 
         {
+        case 'a': /* CPUs to bind the loading threads to */
+          if (!optarg)
+            {
+              fprintf (stderr, "%s error: -a option should be followed by a CPU list.\n", __func__);
+              return -1;
+            }
+          cpu_affinity_list = optarg;
+          break;
+
+        case 'b': /* libcurl allocates by the system malloc */
+          curl_system_alloc = 1;
+          break;
+
         case 'c': /* Connection establishment timeout */
           if (!optarg || (connect_timeout = atoi (optarg)) <= 0)
             {
@@ -121,6 +160,15 @@ int parse_command_line (int argc, char *argv [])
             }
           break;
 
+        case 'g': /* Coordinate the loading by agents at other hosts */
+          if (!optarg)
+            {
+              fprintf (stderr, "%s error: -g option should be followed by a list of agents.\n", __func__);
+              return -1;
+            }
+          distrib_agents = optarg;
+          break;
+
           case 'i': /* Statistics snapshot timeout */
           if (!optarg ||
               (snapshot_statistics_timeout = atoi (optarg)) < 1)
@@ -131,6 +179,46 @@ int parse_command_line (int argc, char *argv [])
             }
           break;
             
+        case 'j': /* Number of the loading threads to start with */
+          if (!optarg || (threads_active_num = atoi (optarg)) < 1)
+            {
+              fprintf (stderr, "%s error: -j option should be followed by a number >= 1.\n", 
+                       __func__);
+              return -1;
+            }
+          break;
+
+        case 'k': /* Run as an agent, waiting for a coordinator at [address:]port */
+          {
+            char* port = optarg ? strrchr (optarg, ':') : 0;
+
+            if (port)
+              {
+                /* Listen at the address, like "10.0.0.1:7000" or "[::]:7000" */
+                *port++ = '\0';
+                distrib_agent_addr = optarg;
+
+                if (*optarg == '[' && port[-2] == ']')
+                  {
+                    port[-2] = '\0';
+                    distrib_agent_addr = optarg + 1;
+                  }
+              }
+            else
+              {
+                port = optarg;
+              }
+
+            if (!port || !*distrib_agent_addr ||
+                (distrib_agent_port = atoi (port)) <= 0 || distrib_agent_port > 65535)
+              {
+                fprintf (stderr, "%s error: -k option should be followed by "
+                         "[address:]port.\n", __func__);
+                return -1;
+              }
+          }
+          break;
+
         case 'l': /* Number of cycles before a logfile rewinds. */
           if (!optarg || 
               (logfile_rewind_size = atol (optarg)) < 2)
@@ -145,19 +233,60 @@ int parse_command_line (int argc, char *argv [])
 
             if (!optarg || 
                 (((loading_mode = atol (optarg)) != LOAD_MODE_SMOOTH && 
-                  loading_mode != LOAD_MODE_HYPER )))
+                  loading_mode != LOAD_MODE_HYPER &&
+                  loading_mode != LOAD_MODE_EPOLL &&
+                  loading_mode != LOAD_MODE_URING)))
             {
-              fprintf (stderr, "%s error: -m to be followed by a number either %d or %d.\n",
-                       __func__, LOAD_MODE_SMOOTH, LOAD_MODE_HYPER);
+              fprintf (stderr, "%s error: -m to be followed by a number %d, %d, %d or %d.\n",
+                       __func__, LOAD_MODE_HYPER, LOAD_MODE_SMOOTH, LOAD_MODE_EPOLL, 
+                       LOAD_MODE_URING);
               return -1;
             }
 
           break;
 
+        case 'n': /* CPUs reserved e.g. for NIC interrupts, not used by loading threads */
+          if (!optarg)
+            {
+              fprintf (stderr, "%s error: -n option should be followed by a CPU list.\n", __func__);
+              return -1;
+            }
+          cpu_reserved_list = optarg;
+          break;
+
         case 'o': /* Print body of the file to stdout. Default - just skip it. */
           output_to_stdout = 1;
           break;
 
+        case 'p': /* Create sub-batches and run each sub-batch of clients 
+                     in a dedicated worker process. */
+          if (threads_subbatches_num && !subbatches_processes)
+            {
+              fprintf (stderr, "%s error: -t and -p options are mutually exclusive.\n", 
+                       __func__);
+              return -1;
+            }
+          if (!optarg ||
+              (threads_subbatches_num = atoi (optarg)) < 2)
+            {
+              fprintf (stderr, "%s error: -p option should be followed by a number >= 2.\n", 
+                       __func__);
+              return -1;
+            }
+          subbatches_processes = 1;
+          break;
+
+        case 'q': /* Timer queue: heap or timing wheel */
+          if (!optarg || 
+              ((timer_queue_type = atoi (optarg)) != TQ_TYPE_HEAP && 
+               timer_queue_type != TQ_TYPE_WHEEL))
+            {
+              fprintf (stderr, "%s error: -q to be followed by a number %d or %d.\n",
+                       __func__, TQ_TYPE_HEAP, TQ_TYPE_WHEEL);
+              return -1;
+            }
+          break;
+
         case 'r':
           break;
 
@@ -167,6 +296,12 @@ int parse_command_line (int argc, char *argv [])
 
         case 't': /* Create sub-batches and run each sub-batch of clients 
                      in a dedicated thread. */
+          if (subbatches_processes)
+            {
+              fprintf (stderr, "%s error: -t and -p options are mutually exclusive.\n", 
+                       __func__);
+              return -1;
+            }
           if (!optarg ||
               (threads_subbatches_num = atoi (optarg)) < 2)
             {
@@ -215,6 +350,26 @@ int parse_command_line (int argc, char *argv [])
       return -1;
     }
 
+  if ((distrib_agents || distrib_agent_port) && threads_subbatches_num)
+    {
+      fprintf (stderr, "%s error: -g and -k options exclude -t and -p options.\n", __func__);
+      return -1;
+    }
+
+  if (threads_active_num && 
+      (subbatches_processes || threads_active_num > threads_subbatches_num))
+    {
+      fprintf (stderr, "%s error: -j option requires -t option with at least as many "
+               "threads.\n", __func__);
+      return -1;
+    }
+
+  if (distrib_agents && distrib_agent_port)
+    {
+      fprintf (stderr, "%s error: -g and -k options are mutually exclusive.\n", __func__);
+      return -1;
+    }
+
   return 0;
 }
 
@@ -223,12 +378,23 @@ void print_help ()
   fprintf (stderr, "Note, to run your load, create your batch configuration file.\n\n");
   fprintf (stderr, "usage: run as a root:\n");
   fprintf (stderr, "./curl-loader -f <configuration file name> with [other options below]:\n");
+  fprintf (stderr, " -a[ffinity] \"<cpu list>\", like \"0-3,8\". Binds the loading threads round-robin to the CPUs]\n");
+  fprintf (stderr, " -b[asic memory allocation of libcurl by the system malloc instead of the thread-local slab allocator]\n");
   fprintf (stderr, " -c[onnection establishment timeout, seconds]\n");
   fprintf (stderr, " -d[etailed logging; outputs to logfile headers and bodies of requests/responses. Good for text pages/files]\n");
   fprintf (stderr, " -e[rror drop client (smooth mode). Client on error doesn't attempt next cycle]\n");
+  fprintf (stderr, " -g[roup of agents] \"<host:port,host:port>\". Coordinates the loading by the agents, started with -k]\n");
   fprintf (stderr, " -i[ntermediate (snapshot) statistics time interval (default 3 sec)]\n");
+  fprintf (stderr, " -j[ust threads number to start loading out of -t threads. Others are on standby, keys [>] and [<] activate and retire threads]\n");
+  fprintf (stderr, " -k[eep waiting as an agent] <[address:]port>. Loads a sub-batch of the coordinator (-g), sending the batch configuration]\n");
+  fprintf (stderr, "    The agent runs the received configuration as root: it reads the files and adds the IP-addresses of the configuration.\n");
+  fprintf (stderr, "    It listens at 127.0.0.1 by default and accepts only coordinators with the same secret in %s.\n", DISTRIB_SECRET_ENV);
+  fprintf (stderr, "    The messages are not encrypted; across untrusted networks use e.g. an ssh tunnel]\n");
   fprintf (stderr, " -l[ogfile max size in MB (default 1024). On the size reached, file pointer rewinded]\n");
-  fprintf (stderr, " -m[ode of loading, 0 - hyper  (default), 1 - smooth]\n");
+  fprintf (stderr, " -m[ode of loading, 0 - hyper  (default), 1 - smooth, 2 - epoll, 3 - io_uring]\n");
+  fprintf (stderr, " -n[ic cpus] \"<cpu list>\", reserved for NIC interrupts. The loading threads are bound to other CPUs]\n");
+  fprintf (stderr, " -p[rocesses number to run batch clients as sub-batches in several worker processes, not sharing libcurl and openssl]\n");
+  fprintf (stderr, " -q[ueue of timers, 0 - heap (default), 1 - hierarchical timing wheel]\n");
   fprintf (stderr, " -r[euse onnections disabled. Close connections and re-open them. Try with and without]\n");
   fprintf (stderr, " -t[hreads number to run batch clients as sub-batches in several threads. Works to utilize SMP/m-core HW]\n");
   fprintf (stderr, " -v[erbose output to the logfiles; includes info about headers sent/received]\n");
@@ -53,6 +53,48 @@ extern int verbose_logging;
 */
 extern int threads_subbatches_num;
 
+/*
+   Flag, whether to run the sub-batches in worker processes rather than in
+   threads, by using -p <N> command line option. The processes share neither
+   libcurl, nor openssl, nor the memory allocator, and a crash of a worker
+   does not stop the others. Their statistics are collected via shared memory.
+*/
+extern int subbatches_processes;
+
+/*
+   Number of the loading threads (-t) to start loading, by using -j <N> command 
+   line option. Other threads are on standby and may be activated at run time.
+*/
+extern int threads_active_num;
+
+/*
+   Whether libcurl allocates by the system malloc, set by -b command line
+   option. By default, libcurl uses the thread-local slab allocator (see 
+   slab_alloc.h).
+*/
+extern int curl_system_alloc;
+
+/*
+   CPU lists, like "0-3,8,10-11", from -a and -n command line options.
+   The loading threads are bound round-robin to the CPUs of <cpu_affinity_list>
+   (by default, the CPUs allowed for the process), except the CPUs from
+   <cpu_reserved_list>, that are kept free e.g. for NIC interrupts.
+   When none is specified, the threads are not bound.
+*/
+extern const char* cpu_affinity_list;
+extern const char* cpu_reserved_list;
+
+/*
+   Distributed loading. The coordinator, started with -g "host:port,host:port",
+   sends the batch configuration to the agents, started at the hosts with
+   -k [address:]port, and loads a sub-batch itself, while each agent loads 
+   another sub-batch. The coordinator merges the statistics of the agents.
+   An agent listens at the loopback address, unless another one is given.
+*/
+extern const char* distrib_agents;
+extern const char* distrib_agent_addr;
+extern int distrib_agent_port;
+
 /* 
    Time in seconds between intermediate statistics printouts to
    screen as well as to the statistics file
@@ -90,13 +132,21 @@ extern unsigned long error_recovery_client;
 enum load_mode
   {
     LOAD_MODE_HYPER = 0, /* Hyper-mode via epoll () */
-    LOAD_MODE_SMOOTH = 1,    /* Smooth mode via select () */
+    LOAD_MODE_SMOOTH = 1,    /* Smooth mode via level-triggered epoll () */
+    LOAD_MODE_EPOLL = 2,    /* Native epoll () without libevent */
+    LOAD_MODE_URING = 3,    /* io_uring multishot poll */
   };
 
 #define LOAD_MODE_DEFAULT LOAD_MODE_HYPER
 
 extern int loading_mode;
 
+/*
+  Timer queue implementation: binary heap (default) or hierarchical 
+  timing wheel (see enum tq_type at timer_queue.h).
+*/
+extern int timer_queue_type;
+
 /* 
    Whether to include url name string to all log outputs. May be useful,
    normally used with verbose logging, like '-v -u' in command line.
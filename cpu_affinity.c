@@ -0,0 +1,202 @@
+/*
+*     cpu_affinity.c
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* CPU_SET () and pthread_setaffinity_np () are GNU extensions */
+#define _GNU_SOURCE
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "cpu_affinity.h"
+
+/* CPUs to bind the loading threads to, empty, when not binding */
+static int cpu_arr[CPU_SETSIZE];
+static int cpu_num = 0;
+
+static int cpu_list_parse (const char* list, cpu_set_t* set);
+
+
+/****************************************************************************************
+* Function name - cpu_affinity_init
+*
+* Description - Prepares the list of CPUs to bind the loading threads to. The CPUs
+*               are taken from <cpus> or, when not specified, from the CPUs allowed
+*               for the process. CPUs from <reserved> (e.g. for NIC interrupts) are
+*               excluded. When both lists are not specified, threads are not bound.
+*
+* Input -       *cpus - CPU list like "0-3,8,10-11" or NULL
+*               *reserved - CPU list or NULL
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int cpu_affinity_init (const char* cpus, const char* reserved)
+{
+  cpu_set_t allowed, set, res;
+  int cpu;
+
+  cpu_num = 0;
+
+  if (!cpus && !reserved)
+    return 0;
+
+  if (sched_getaffinity (0, sizeof (allowed), &allowed) == -1)
+    {
+      fprintf (stderr, "%s - error: sched_getaffinity () failed with errno %d.\n",
+               __func__, errno);
+      return -1;
+    }
+
+  if (cpus)
+    {
+      if (cpu_list_parse (cpus, &set) == -1)
+        return -1;
+    }
+  else
+    {
+      set = allowed;
+    }
+
+  CPU_ZERO (&res);
+  if (reserved && cpu_list_parse (reserved, &res) == -1)
+    return -1;
+
+  for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+      if (!CPU_ISSET (cpu, &set) || CPU_ISSET (cpu, &res))
+        continue;
+
+      if (!CPU_ISSET (cpu, &allowed))
+        {
+          fprintf (stderr, "%s - error: CPU %d is not available for the process.\n",
+                   __func__, cpu);
+          return -1;
+        }
+
+      cpu_arr[cpu_num++] = cpu;
+    }
+
+  if (!cpu_num)
+    {
+      fprintf (stderr, "%s - error: no CPUs left to bind the loading threads to.\n",
+               __func__);
+      return -1;
+    }
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - cpu_affinity_bind
+*
+* Description - Binds the calling thread to the CPU, selected for the thread index
+*               round-robin from the CPU list. Does nothing, when binding is disabled.
+*
+* Input -       index - index of the loading thread (batch id)
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int cpu_affinity_bind (int index)
+{
+  cpu_set_t set;
+  int error;
+
+  if (!cpu_num)
+    return 0;
+
+  CPU_ZERO (&set);
+  CPU_SET (cpu_arr[index % cpu_num], &set);
+
+  if ((error = pthread_setaffinity_np (pthread_self (), sizeof (set), &set)))
+    {
+      fprintf (stderr, "%s - error: pthread_setaffinity_np () failed with error %d.\n",
+               __func__, error);
+      return -1;
+    }
+
+  fprintf (stderr, "%s - note: thread %d bound to CPU %d.\n",
+           __func__, index, cpu_arr[index % cpu_num]);
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - cpu_list_parse
+*
+* Description - Parses a comma-separated list of CPU numbers and ranges
+*
+* Input -       *list - CPU list like "0-3,8,10-11"
+* Output -      *set - the CPU set
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int cpu_list_parse (const char* list, cpu_set_t* set)
+{
+  const char* p = list;
+  char* end = 0;
+  long first, last;
+
+  CPU_ZERO (set);
+
+  while (*p)
+    {
+      first = last = strtol (p, &end, 10);
+
+      if (end == p)
+        goto bad_list;
+
+      if (*end == '-')
+        {
+          p = end + 1;
+          last = strtol (p, &end, 10);
+
+          if (end == p)
+            goto bad_list;
+        }
+
+      if (first < 0 || last < first || last >= CPU_SETSIZE)
+        goto bad_list;
+
+      for (; first <= last; first++)
+        CPU_SET (first, set);
+
+      if (*end == ',')
+        end++;
+      else if (*end)
+        goto bad_list;
+
+      p = end;
+    }
+
+  if (!CPU_COUNT (set))
+    goto bad_list;
+
+  return 0;
+
+ bad_list:
+  fprintf (stderr, "%s - error: wrong CPU list \"%s\". Use like \"0-3,8,10-11\".\n",
+           __func__, list);
+  return -1;
+}
@@ -0,0 +1,60 @@
+/*
+*     cpu_affinity.h
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+/*
+  Binding of loading threads to CPUs.
+
+  Each batch (sub-batch) thread binds itself to a CPU before allocating its
+  client contexts, handles and buffers. Thus, by the first-touch policy of the
+  kernel, the memory of the thread is placed at the NUMA node of its CPU, and
+  the thread does not migrate across sockets.
+*/
+
+/****************************************************************************************
+* Function name - cpu_affinity_init
+*
+* Description - Prepares the list of CPUs to bind the loading threads to. The CPUs
+*               are taken from <cpus> or, when not specified, from the CPUs allowed
+*               for the process. CPUs from <reserved> (e.g. for NIC interrupts) are
+*               excluded. When both lists are not specified, threads are not bound.
+*
+* Input -       *cpus - CPU list like "0-3,8,10-11" or NULL
+*               *reserved - CPU list or NULL
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int cpu_affinity_init (const char* cpus, const char* reserved);
+
+/****************************************************************************************
+* Function name - cpu_affinity_bind
+*
+* Description - Binds the calling thread to the CPU, selected for the thread index
+*               round-robin from the CPU list. Does nothing, when binding is disabled.
+*
+* Input -       index - index of the loading thread (batch id)
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int cpu_affinity_bind (int index);
+
+#endif /* CPU_AFFINITY_H */
@@ -0,0 +1,1122 @@
+/*
+*     distrib.c
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include "distrib.h"
+#include "batch.h"
+#include "client.h"
+#include "loader.h"
+#include "conf.h"
+#include "statistics.h"
+
+/* Protocol and build of the coordinator and agents */
+#define DISTRIB_MAGIC 0x434c4432
+
+/* Message types */
+enum distrib_msg_type
+  {
+    DISTRIB_MSG_CONFIG = 1, /* Coordinator: the batch configuration */
+    DISTRIB_MSG_READY,      /* Agent: the sub-batch is prepared */
+    DISTRIB_MSG_START,      /* Coordinator: delay to the start in msec */
+    DISTRIB_MSG_STATS,      /* Agent: the statistics snapshot */
+    DISTRIB_MSG_STOP,       /* Coordinator: stop the loading */
+  };
+
+/* Message header, the fields are in the network order */
+typedef struct distrib_msg_hdr
+{
+  uint32_t type;
+  uint32_t len;
+} distrib_msg_hdr;
+
+/* Header of the configuration message, followed by the configuration text */
+typedef struct distrib_config
+{
+  uint32_t magic;
+  uint32_t stats_size;
+  uint32_t index;
+  uint32_t batches_num;
+  /* The shared secret, padded by zeros */
+  char secret[DISTRIB_SECRET_MAX + 1];
+} distrib_config;
+
+/*
+   Statistics message, followed by the url counters: ok, failed and timeouted.
+   The same curl-loader build runs at the hosts, thus the fields are binary.
+*/
+typedef struct distrib_stats
+{
+  int final;
+  int clients;
+  stat_point http;
+  stat_point https;
+  unsigned long call_init_count;
+  unsigned long pipe_requests;
+  unsigned long pipe_connections;
+  unsigned long pipe_inflight_sum;
+  unsigned long pipe_open_sum;
+  unsigned long pipe_depth_max;
+  unsigned long url_num;
+} distrib_stats;
+
+/* An agent, as seen by the coordinator */
+typedef struct distrib_agent
+{
+  char host[NI_MAXHOST];
+  char port[NI_MAXSERV];
+  int fd;
+  /* Set, when the final statistics are received or the agent is lost */
+  int final;
+} distrib_agent;
+
+static distrib_agent agents[BATCHES_MAX_NUM];
+static int agents_num = 0;
+static batch_context* agents_bc_arr = 0;
+static pthread_t collector_tid;
+static int collector_running = 0;
+
+/* Connection of an agent to its coordinator */
+static int coordinator_fd = -1;
+
+static const char* distrib_secret (void);
+static int secret_equal (const char* a, const char* b);
+static int agent_connect (distrib_agent* agent, char* address);
+static void* collect_agents (void* arg);
+static void agent_lost (distrib_agent* agent, batch_context* bctx);
+static char* config_read (const char* config_file, size_t* size);
+static int send_all (int fd, const void* buf, size_t len, int flags);
+static int recv_all (int fd, void* buf, size_t len);
+static int msg_send (int fd, uint32_t type, const void* payload, size_t len);
+static int msg_recv (int fd, uint32_t* type, char** payload, size_t* len);
+static size_t stats_size (size_t url_num);
+static void stats_encode (stat_snapshot* snap, char* buf);
+static int stats_decode (const char* buf, size_t len, stat_snapshot* snap);
+
+
+/****************************************************************************************
+* Function name - distrib_coordinator_connect
+*
+* Description - Connects the coordinator to the agents from the -g list and sets
+*               the number of sub-batches to the number of agents plus one.
+*
+* Return Code/Output - On success - number of agents, on error -1
+****************************************************************************************/
+int distrib_coordinator_connect (void)
+{
+  char* list = strdup (distrib_agents);
+  char* save = 0;
+  char* address;
+
+  if (!distrib_secret ())
+    {
+      free (list);
+      return -1;
+    }
+
+  if (!list)
+    {
+      fprintf (stderr, "%s - error: strdup () failed.\n", __func__);
+      return -1;
+    }
+
+  for (address = strtok_r (list, ",", &save); address;
+       address = strtok_r (0, ",", &save))
+    {
+      if (agents_num == BATCHES_MAX_NUM - 1)
+        {
+          fprintf (stderr, "%s - error: the number of agents is limited by %d.\n",
+                   __func__, BATCHES_MAX_NUM - 1);
+          free (list);
+          return -1;
+        }
+
+      if (agent_connect (&agents[agents_num], address) == -1)
+        {
+          free (list);
+          return -1;
+        }
+
+      agents_num++;
+    }
+
+  free (list);
+
+  if (!agents_num)
+    {
+      fprintf (stderr, "%s - error: no agents in the list \"%s\".\n",
+               __func__, distrib_agents);
+      return -1;
+    }
+
+  /* The coordinator loads the sub-batch 0 itself */
+  threads_subbatches_num = agents_num + 1;
+
+  return agents_num;
+}
+
+/****************************************************************************************
+* Function name - agent_connect
+*
+* Description - Connects to an agent
+*
+* Input -       *address - address of the agent like "host:port" or "[ipv6]:port"
+* Output -      *agent - the connected agent
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int agent_connect (distrib_agent* agent, char* address)
+{
+  struct addrinfo hints, *res = 0, *ai;
+  char* colon = strrchr (address, ':');
+  char* host = address;
+  int error, one = 1;
+
+  if (!colon || colon == address || !colon[1])
+    {
+      fprintf (stderr, "%s - error: wrong agent \"%s\". Use like \"host:port\".\n",
+               __func__, address);
+      return -1;
+    }
+
+  *colon = '\0';
+
+  if (*host == '[' && colon[-1] == ']')
+    {
+      host++;
+      colon[-1] = '\0';
+    }
+
+  strncpy (agent->host, host, sizeof (agent->host) - 1);
+  strncpy (agent->port, colon + 1, sizeof (agent->port) - 1);
+  agent->fd = -1;
+
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  if ((error = getaddrinfo (agent->host, agent->port, &hints, &res)))
+    {
+      fprintf (stderr, "%s - error: agent %s:%s is not resolved - %s.\n",
+               __func__, agent->host, agent->port, gai_strerror (error));
+      return -1;
+    }
+
+  for (ai = res; ai; ai = ai->ai_next)
+    {
+      if ((agent->fd = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol)) == -1)
+        continue;
+
+      if (connect (agent->fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        break;
+
+      close (agent->fd);
+      agent->fd = -1;
+    }
+
+  freeaddrinfo (res);
+
+  if (agent->fd == -1)
+    {
+      fprintf (stderr, "%s - error: failed to connect to agent %s:%s, errno %d.\n",
+               __func__, agent->host, agent->port, errno);
+      return -1;
+    }
+
+  setsockopt (agent->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+
+  fprintf (stderr, "%s - note: connected to agent %s:%s.\n",
+           __func__, agent->host, agent->port);
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - distrib_coordinator_start
+*
+* Description - Sends the batch configuration and the sub-batch indexes to the agents,
+*               waits for the agents to prepare their sub-batches, tells them to start
+*               and starts collecting their statistics. Returns at the start instant.
+*
+* Input -       *bc_arr - array of the batch contexts of the sub-batches
+*               *config_file - name of the batch configuration file
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int distrib_coordinator_start (batch_context* bc_arr, const char* config_file)
+{
+  distrib_config* config;
+  size_t size = 0;
+  unsigned long start_time, now;
+  uint32_t type, delay;
+  char* payload = 0;
+  size_t len = 0;
+  int i;
+
+  if (!(config = (distrib_config *) config_read (config_file, &size)))
+    return -1;
+
+  config->magic = htonl (DISTRIB_MAGIC);
+  config->stats_size = htonl (sizeof (distrib_stats));
+  config->batches_num = htonl (agents_num + 1);
+  strncpy (config->secret, distrib_secret (), DISTRIB_SECRET_MAX);
+
+  for (i = 0; i < agents_num; i++)
+    {
+      config->index = htonl (i + 1);
+
+      if (msg_send (agents[i].fd, DISTRIB_MSG_CONFIG, config, size) == -1)
+        {
+          fprintf (stderr, "%s - error: failed to send the configuration to agent %s:%s.\n",
+                   __func__, agents[i].host, agents[i].port);
+          free (config);
+          return -1;
+        }
+    }
+
+  free (config);
+
+  /* The agents add their IP-addresses and prepare the loading */
+  for (i = 0; i < agents_num; i++)
+    {
+      if (msg_recv (agents[i].fd, &type, &payload, &len) == -1 ||
+          type != DISTRIB_MSG_READY)
+        {
+          fprintf (stderr, "%s - error: agent %s:%s failed to prepare the loading. "
+                   "Look at the agent output.\n", __func__, agents[i].host, agents[i].port);
+          free (payload);
+          return -1;
+        }
+
+      free (payload);
+      payload = 0;
+    }
+
+  /* Each agent starts after the delay, less the time of telling the previous ones */
+  start_time = get_tick_count ();
+
+  for (i = 0; i < agents_num; i++)
+    {
+      now = get_tick_count ();
+      delay = now - start_time < DISTRIB_START_DELAY ?
+        DISTRIB_START_DELAY - (now - start_time) : 0;
+      delay = htonl (delay);
+
+      if (msg_send (agents[i].fd, DISTRIB_MSG_START, &delay, sizeof (delay)) == -1)
+        {
+          fprintf (stderr, "%s - error: failed to start agent %s:%s.\n",
+                   __func__, agents[i].host, agents[i].port);
+          return -1;
+        }
+    }
+
+  agents_bc_arr = bc_arr;
+
+  if (pthread_create (&collector_tid, NULL, collect_agents, NULL))
+    {
+      fprintf (stderr, "%s - error: failed to start collecting statistics.\n", __func__);
+      return -1;
+    }
+
+  collector_running = 1;
+
+  now = get_tick_count ();
+  if (now - start_time < DISTRIB_START_DELAY)
+    usleep ((DISTRIB_START_DELAY - (now - start_time)) * 1000);
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - distrib_coordinator_stop
+*
+* Description - Waits for the final statistics of the agents and disconnects them
+*
+* Return Code/Output - None
+****************************************************************************************/
+void distrib_coordinator_stop (void)
+{
+  int i;
+
+  if (collector_running)
+    {
+      pthread_join (collector_tid, NULL);
+      collector_running = 0;
+    }
+
+  for (i = 0; i < agents_num; i++)
+    {
+      if (agents[i].fd != -1)
+        {
+          close (agents[i].fd);
+          agents[i].fd = -1;
+        }
+    }
+}
+
+/****************************************************************************************
+* Function name - collect_agents
+*
+* Description - Thread of the coordinator, writing the statistics snapshots of the
+*               agents to the published snapshots of their sub-batches, till the
+*               final ones. Tells the agents to stop, when the loading is stopped.
+*
+* Input -       *arg - not used
+* Return Code/Output - NULL
+****************************************************************************************/
+static void* collect_agents (void* arg)
+{
+  struct pollfd pfd[BATCHES_MAX_NUM];
+  distrib_agent* polled[BATCHES_MAX_NUM];
+  stat_snapshot snap;
+  unsigned long stop_time = 0;
+  int i, n, running = agents_num;
+
+  (void) arg;
+
+  if (stat_snapshot_init (&snap, agents_bc_arr->urls_num) == -1)
+    {
+      fprintf (stderr, "%s - error: stat_snapshot_init () failed.\n", __func__);
+      running = 0;
+    }
+
+  while (running > 0)
+    {
+      if (stop_loading && !stop_time)
+        {
+          stop_time = get_tick_count ();
+
+          for (i = 0; i < agents_num; i++)
+            {
+              if (!agents[i].final)
+                msg_send (agents[i].fd, DISTRIB_MSG_STOP, 0, 0);
+            }
+        }
+
+      if (stop_time && get_tick_count () - stop_time > DISTRIB_STOP_TIMEOUT)
+        {
+          fprintf (stderr, "%s - warning: no final statistics from %d agents.\n",
+                   __func__, running);
+          break;
+        }
+
+      for (i = 0, n = 0; i < agents_num; i++)
+        {
+          if (agents[i].final)
+            continue;
+
+          pfd[n].fd = agents[i].fd;
+          pfd[n].events = POLLIN;
+          pfd[n].revents = 0;
+          polled[n++] = &agents[i];
+        }
+
+      if (poll (pfd, n, STAT_PUBLISH_PERIOD) == -1 && errno != EINTR)
+        {
+          fprintf (stderr, "%s - error: poll () failed with errno %d.\n", __func__, errno);
+          break;
+        }
+
+      for (i = 0; i < n; i++)
+        {
+          distrib_agent* agent = polled[i];
+          batch_context* bctx = agents_bc_arr + (agent - agents) + 1;
+          uint32_t type = 0;
+          char* payload = 0;
+          size_t len = 0;
+
+          if (!pfd[i].revents)
+            continue;
+
+          if (msg_recv (agent->fd, &type, &payload, &len) == -1 ||
+              type != DISTRIB_MSG_STATS ||
+              stats_decode (payload, len, &snap) == -1)
+            {
+              agent_lost (agent, bctx);
+              running--;
+            }
+          else
+            {
+              stat_published_write (bctx, &snap);
+
+              if (snap.final)
+                {
+                  agent->final = 1;
+                  running--;
+                }
+            }
+
+          free (payload);
+        }
+    }
+
+  /* The leader does not wait for the agents, that have not reported */
+  for (i = 0; i < agents_num; i++)
+    {
+      if (!agents[i].final)
+        agent_lost (&agents[i], agents_bc_arr + i + 1);
+    }
+
+  stat_snapshot_release (&snap);
+
+  return NULL;
+}
+
+/****************************************************************************************
+* Function name - agent_lost
+*
+* Description - Disconnects an agent, that failed to report, and releases the leader
+*               from waiting for the final statistics of the agent
+*
+* Input -       *agent - the agent
+*               *bctx  - pointer to the batch context of the sub-batch of the agent
+* Return Code/Output - None
+****************************************************************************************/
+static void agent_lost (distrib_agent* agent, batch_context* bctx)
+{
+  if (!stop_loading)
+    {
+      fprintf (stderr, "%s - error: lost agent %s:%s, its statistics are partial.\n",
+               __func__, agent->host, agent->port);
+    }
+
+  agent->final = 1;
+  close (agent->fd);
+  agent->fd = -1;
+
+  __atomic_store_n (&bctx->stat_published->final, 1, __ATOMIC_RELEASE);
+}
+
+/****************************************************************************************
+* Function name - config_read
+*
+* Description - Reads the batch configuration file after a room for the
+*               configuration message header
+*
+* Input -       *config_file - name of the file
+* Output -      *size - size of the message
+* Return Code/Output - On success - allocated message, on error NULL
+****************************************************************************************/
+static char* config_read (const char* config_file, size_t* size)
+{
+  FILE* fp = fopen (config_file, "r");
+  char* buf = 0;
+  long file_size;
+
+  if (!fp)
+    {
+      fprintf (stderr, "%s - error: failed to open \"%s\", errno %d.\n",
+               __func__, config_file, errno);
+      return NULL;
+    }
+
+  if (fseek (fp, 0, SEEK_END) == -1 || (file_size = ftell (fp)) == -1 ||
+      fseek (fp, 0, SEEK_SET) == -1)
+    {
+      fprintf (stderr, "%s - error: failed to read \"%s\".\n", __func__, config_file);
+      fclose (fp);
+      return NULL;
+    }
+
+  *size = sizeof (distrib_config) + file_size;
+
+  if (*size > DISTRIB_MSG_MAX)
+    {
+      fprintf (stderr, "%s - error: \"%s\" is above %d bytes.\n",
+               __func__, config_file, DISTRIB_MSG_MAX);
+      fclose (fp);
+      return NULL;
+    }
+
+  if (!(buf = calloc (1, *size)) ||
+      fread (buf + sizeof (distrib_config), 1, file_size, fp) != (size_t) file_size)
+    {
+      fprintf (stderr, "%s - error: failed to read \"%s\".\n", __func__, config_file);
+      free (buf);
+      fclose (fp);
+      return NULL;
+    }
+
+  fclose (fp);
+  return buf;
+}
+
+/****************************************************************************************
+* Function name - distrib_secret
+*
+* Description - Takes the secret, shared by the coordinator and the agents, from
+*               the environment
+*
+* Return Code/Output - On success - the secret, on error NULL
+****************************************************************************************/
+static const char* distrib_secret (void)
+{
+  const char* secret = getenv (DISTRIB_SECRET_ENV);
+
+  if (!secret || !*secret || strlen (secret) > DISTRIB_SECRET_MAX)
+    {
+      fprintf (stderr, "%s - error: set the secret, shared by the coordinator and the "
+               "agents, to %s environment variable, up to %d characters.\n",
+               __func__, DISTRIB_SECRET_ENV, DISTRIB_SECRET_MAX);
+      return NULL;
+    }
+
+  return secret;
+}
+
+/****************************************************************************************
+* Function name - secret_equal
+*
+* Description - Compares secrets, padded by zeros, in time not depending on the
+*               position of the first difference
+*
+* Input -       *a, *b - the secrets of DISTRIB_SECRET_MAX + 1 bytes
+* Return Code/Output - When equal - 1, otherwise 0
+****************************************************************************************/
+static int secret_equal (const char* a, const char* b)
+{
+  unsigned char diff = 0;
+  int i;
+
+  for (i = 0; i < DISTRIB_SECRET_MAX + 1; i++)
+    diff |= a[i] ^ b[i];
+
+  return !diff;
+}
+
+/****************************************************************************************
+* Function name - distrib_agent_accept
+*
+* Description - Waits at the address and port for connections of coordinators. 
+*               Serves each coordinator by a child process, where the function returns.
+*
+* Input -       *address - numeric IPv4 or IPv6 address to listen at
+*               port - TCP port to listen at
+* Return Code/Output - In the child process - 0, on error -1
+****************************************************************************************/
+int distrib_agent_accept (const char* address, int port)
+{
+  struct addrinfo hints, *res = 0;
+  char service[NI_MAXSERV];
+  int listen_fd, fd, one = 1, error;
+  pid_t pid;
+
+  if (!distrib_secret ())
+    return -1;
+
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST | AI_NUMERICSERV;
+  snprintf (service, sizeof (service), "%d", port);
+
+  if ((error = getaddrinfo (address, service, &hints, &res)))
+    {
+      fprintf (stderr, "%s - error: wrong address \"%s\" to listen at - %s.\n",
+               __func__, address, gai_strerror (error));
+      return -1;
+    }
+
+  if ((listen_fd = socket (res->ai_family, res->ai_socktype, res->ai_protocol)) == -1)
+    {
+      fprintf (stderr, "%s - error: socket () failed with errno %d.\n", __func__, errno);
+      freeaddrinfo (res);
+      return -1;
+    }
+
+  setsockopt (listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+
+  if (bind (listen_fd, res->ai_addr, res->ai_addrlen) == -1 ||
+      listen (listen_fd, 4) == -1)
+    {
+      fprintf (stderr, "%s - error: failed to listen at %s port %d, errno %d.\n",
+               __func__, address, port, errno);
+      freeaddrinfo (res);
+      close (listen_fd);
+      return -1;
+    }
+
+  freeaddrinfo (res);
+
+  /* The served coordinators are not waited for */
+  signal (SIGCHLD, SIG_IGN);
+
+  fprintf (stderr, "%s - note: agent is waiting for a coordinator at %s port %d.\n",
+           __func__, address, port);
+
+  for (;;)
+    {
+      if ((fd = accept (listen_fd, NULL, NULL)) == -1)
+        {
+          if (errno == EINTR || errno == ECONNABORTED)
+            continue;
+
+          fprintf (stderr, "%s - error: accept () failed with errno %d.\n",
+                   __func__, errno);
+          close (listen_fd);
+          return -1;
+        }
+
+      fflush (stdout);
+      fflush (stderr);
+
+      if ((pid = fork ()) == -1)
+        {
+          fprintf (stderr, "%s - error: fork () failed with errno %d.\n", __func__, errno);
+          close (fd);
+          continue;
+        }
+
+      if (!pid)
+        {
+          close (listen_fd);
+          signal (SIGCHLD, SIG_DFL);
+
+          setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+          coordinator_fd = fd;
+          return 0;
+        }
+
+      fprintf (stderr, "%s - note: coordinator served by process %d.\n",
+               __func__, (int) pid);
+      close (fd);
+    }
+}
+
+/****************************************************************************************
+* Function name - distrib_agent_config
+*
+* Description - Receives from the coordinator the batch configuration and saves it
+*               to a temporary file
+*
+* Input/Output - *config_name - template of the temporary file name, like for mkstemp ()
+* Output -       *index - index of the sub-batch of the agent
+*                *batches_num - number of the sub-batches
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int distrib_agent_config (char* config_name, int* index, int* batches_num)
+{
+  distrib_config* config;
+  uint32_t type = 0;
+  char* payload = 0;
+  size_t len = 0, text_len;
+  char secret[DISTRIB_SECRET_MAX + 1];
+  int fd;
+
+  if (!distrib_secret ())
+    return -1;
+
+  memset (secret, 0, sizeof (secret));
+  strncpy (secret, distrib_secret (), DISTRIB_SECRET_MAX);
+
+  if (msg_recv (coordinator_fd, &type, &payload, &len) == -1 ||
+      type != DISTRIB_MSG_CONFIG || len < sizeof (distrib_config))
+    {
+      fprintf (stderr, "%s - error: failed to receive the configuration.\n", __func__);
+      free (payload);
+      return -1;
+    }
+
+  config = (distrib_config *) payload;
+
+  if (ntohl (config->magic) != DISTRIB_MAGIC ||
+      ntohl (config->stats_size) != sizeof (distrib_stats))
+    {
+      fprintf (stderr, "%s - error: the coordinator runs another curl-loader build.\n",
+               __func__);
+      free (payload);
+      return -1;
+    }
+
+  /* The configuration makes the agent read files and add IP-addresses */
+  if (!secret_equal (config->secret, secret))
+    {
+      fprintf (stderr, "%s - error: the coordinator has a wrong secret.\n", __func__);
+      free (payload);
+      return -1;
+    }
+
+  *index = (int) ntohl (config->index);
+  *batches_num = (int) ntohl (config->batches_num);
+
+  if (*index < 1 || *index >= *batches_num || *batches_num > BATCHES_MAX_NUM)
+    {
+      fprintf (stderr, "%s - error: wrong sub-batch %d of %d.\n",
+               __func__, *index, *batches_num);
+      free (payload);
+      return -1;
+    }
+
+  text_len = len - sizeof (distrib_config);
+
+  if ((fd = mkstemp (config_name)) == -1 ||
+      write (fd, payload + sizeof (distrib_config), text_len) != (ssize_t) text_len)
+    {
+      fprintf (stderr, "%s - error: failed to save the configuration, errno %d.\n",
+               __func__, errno);
+      if (fd != -1)
+        {
+          close (fd);
+          unlink (config_name);
+        }
+      free (payload);
+      return -1;
+    }
+
+  close (fd);
+  free (payload);
+
+  fprintf (stderr, "%s - note: loading sub-batch %d of %d.\n",
+           __func__, *index, *batches_num);
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - distrib_agent_start
+*
+* Description - Tells the coordinator, that the agent is ready, and returns at the
+*               start instant, set by the coordinator
+*
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int distrib_agent_start (void)
+{
+  uint32_t type = 0, delay;
+  char* payload = 0;
+  size_t len = 0;
+
+  if (msg_send (coordinator_fd, DISTRIB_MSG_READY, 0, 0) == -1 ||
+      msg_recv (coordinator_fd, &type, &payload, &len) == -1 ||
+      type != DISTRIB_MSG_START || len != sizeof (delay))
+    {
+      fprintf (stderr, "%s - error: the coordinator has not started the loading.\n",
+               __func__);
+      free (payload);
+      return -1;
+    }
+
+  memcpy (&delay, payload, sizeof (delay));
+  free (payload);
+
+  usleep (ntohl (delay) * 1000);
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - distrib_agent_report
+*
+* Description - Sends the statistics, published by the loading thread of the agent,
+*               to the coordinator till the final ones. Stops the loading, when told
+*               by the coordinator or when the coordinator is lost.
+*
+* Input -       *bctx - pointer to the batch context of the loading thread
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int distrib_agent_report (batch_context* bctx)
+{
+  const size_t size = stats_size (bctx->urls_num);
+  stat_snapshot snap;
+  struct pollfd pfd;
+  char* buf = 0;
+  int final = 0, lost = 0;
+
+  if (stat_snapshot_init (&snap, bctx->urls_num) == -1 || !(buf = calloc (1, size)))
+    {
+      fprintf (stderr, "%s - error: allocation failed.\n", __func__);
+      stop_loading = 1;
+      return -1;
+    }
+
+  while (!final)
+    {
+      pfd.fd = coordinator_fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+
+      if (lost)
+        usleep (STAT_PUBLISH_PERIOD * 1000);
+      else if (poll (&pfd, 1, STAT_PUBLISH_PERIOD) > 0)
+        {
+          uint32_t type = 0;
+          char* payload = 0;
+          size_t len = 0;
+
+          if (msg_recv (coordinator_fd, &type, &payload, &len) == -1)
+            lost = 1;
+          else if (type == DISTRIB_MSG_STOP)
+            stop_loading = 1;
+
+          free (payload);
+        }
+
+      final = stat_published_read (bctx, &snap);
+
+      if (!lost)
+        {
+          stats_encode (&snap, buf);
+
+          if (msg_send (coordinator_fd, DISTRIB_MSG_STATS, buf, size) == -1)
+            lost = 1;
+        }
+
+      if (lost && !stop_loading)
+        {
+          fprintf (stderr, "%s - error: lost the coordinator, stopping.\n", __func__);
+          stop_loading = 1;
+        }
+    }
+
+  close (coordinator_fd);
+  coordinator_fd = -1;
+
+  free (buf);
+  stat_snapshot_release (&snap);
+
+  return lost ? -1 : 0;
+}
+
+/****************************************************************************************
+* Function name - send_all
+*
+* Description - Sends the buffer to a blocking socket
+*
+* Input -       fd - the socket
+*               *buf - the buffer
+*               len - length of the buffer
+*               flags - flags of send ()
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int send_all (int fd, const void* buf, size_t len, int flags)
+{
+  const char* p = buf;
+  ssize_t sent;
+
+  while (len > 0)
+    {
+      if ((sent = send (fd, p, len, flags | MSG_NOSIGNAL)) == -1)
+        {
+          if (errno == EINTR)
+            continue;
+          return -1;
+        }
+
+      p += sent;
+      len -= sent;
+    }
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - recv_all
+*
+* Description - Receives the buffer from a blocking socket
+*
+* Input -       fd - the socket
+*               len - length of the buffer
+* Output -      *buf - the buffer
+* Return Code/Output - On success - 0, on error or closed connection -1
+****************************************************************************************/
+static int recv_all (int fd, void* buf, size_t len)
+{
+  char* p = buf;
+  ssize_t received;
+
+  while (len > 0)
+    {
+      if ((received = recv (fd, p, len, 0)) <= 0)
+        {
+          if (received == -1 && errno == EINTR)
+            continue;
+          return -1;
+        }
+
+      p += received;
+      len -= received;
+    }
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - msg_send
+*
+* Description - Sends a message
+*
+* Input -       fd - the socket
+*               type - the message type
+*               *payload - the message payload or NULL
+*               len - length of the payload
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int msg_send (int fd, uint32_t type, const void* payload, size_t len)
+{
+  distrib_msg_hdr hdr;
+
+  hdr.type = htonl (type);
+  hdr.len = htonl ((uint32_t) len);
+
+  if (send_all (fd, &hdr, sizeof (hdr), len ? MSG_MORE : 0) == -1)
+    return -1;
+
+  return len ? send_all (fd, payload, len, 0) : 0;
+}
+
+/****************************************************************************************
+* Function name - msg_recv
+*
+* Description - Receives a message
+*
+* Input -       fd - the socket
+* Output -      *type - the message type
+*               **payload - the payload, allocated with a terminating zero.
+*                           To be released by the caller.
+*               *len - length of the payload
+* Return Code/Output - On success - 0, on error or closed connection -1
+****************************************************************************************/
+static int msg_recv (int fd, uint32_t* type, char** payload, size_t* len)
+{
+  distrib_msg_hdr hdr;
+
+  *payload = 0;
+
+  if (recv_all (fd, &hdr, sizeof (hdr)) == -1)
+    return -1;
+
+  *type = ntohl (hdr.type);
+  *len = ntohl (hdr.len);
+
+  if (*len > DISTRIB_MSG_MAX)
+    {
+      fprintf (stderr, "%s - error: message of %lu bytes is too long.\n",
+               __func__, (unsigned long) *len);
+      return -1;
+    }
+
+  if (!(*payload = calloc (1, *len + 1)))
+    {
+      fprintf (stderr, "%s - error: allocation failed.\n", __func__);
+      return -1;
+    }
+
+  return recv_all (fd, *payload, *len);
+}
+
+/****************************************************************************************
+* Function name - stats_size
+*
+* Description - Returns size of the statistics message
+*
+* Input -       url_num - number of urls
+* Return Code/Output - Size in bytes
+****************************************************************************************/
+static size_t stats_size (size_t url_num)
+{
+  return sizeof (distrib_stats) + 3 * url_num * sizeof (unsigned long);
+}
+
+/****************************************************************************************
+* Function name - stats_encode
+*
+* Description - Encodes a statistics snapshot to the statistics message
+*
+* Input -       *snap - the snapshot
+* Output -      *buf - the message of stats_size () bytes
+* Return Code/Output - None
+****************************************************************************************/
+static void stats_encode (stat_snapshot* snap, char* buf)
+{
+  distrib_stats* stats = (distrib_stats *) buf;
+  unsigned long* urls = (unsigned long *) (stats + 1);
+  const size_t url_num = snap->op.url_num;
+
+  stats->final = snap->final;
+  stats->clients = snap->clients;
+  stats->http = snap->http;
+  stats->https = snap->https;
+  stats->call_init_count = snap->op.call_init_count;
+  stats->pipe_requests = snap->op.pipe_requests;
+  stats->pipe_connections = snap->op.pipe_connections;
+  stats->pipe_inflight_sum = snap->op.pipe_inflight_sum;
+  stats->pipe_open_sum = snap->op.pipe_open_sum;
+  stats->pipe_depth_max = snap->op.pipe_depth_max;
+  stats->url_num = url_num;
+
+  memcpy (urls, snap->op.url_ok, url_num * sizeof (*urls));
+  memcpy (urls + url_num, snap->op.url_failed, url_num * sizeof (*urls));
+  memcpy (urls + 2 * url_num, snap->op.url_timeouted, url_num * sizeof (*urls));
+}
+
+/****************************************************************************************
+* Function name - stats_decode
+*
+* Description - Decodes the statistics message to a statistics snapshot
+*
+* Input -       *buf - the message
+*               len - length of the message
+* Output -      *snap - the snapshot, initialized by stat_snapshot_init ()
+* Return Code/Output - On success - 0, on a wrong message -1
+****************************************************************************************/
+static int stats_decode (const char* buf, size_t len, stat_snapshot* snap)
+{
+  const distrib_stats* stats = (const distrib_stats *) buf;
+  const unsigned long* urls = (const unsigned long *) (stats + 1);
+  const size_t url_num = snap->op.url_num;
+
+  if (len != stats_size (url_num) || stats->url_num != url_num)
+    {
+      fprintf (stderr, "%s - error: wrong statistics message.\n", __func__);
+      return -1;
+    }
+
+  snap->final = stats->final;
+  snap->clients = stats->clients;
+  snap->http = stats->http;
+  snap->https = stats->https;
+  snap->op.call_init_count = stats->call_init_count;
+  snap->op.pipe_requests = stats->pipe_requests;
+  snap->op.pipe_connections = stats->pipe_connections;
+  snap->op.pipe_inflight_sum = stats->pipe_inflight_sum;
+  snap->op.pipe_open_sum = stats->pipe_open_sum;
+  snap->op.pipe_depth_max = stats->pipe_depth_max;
+
+  memcpy (snap->op.url_ok, urls, url_num * sizeof (*urls));
+  memcpy (snap->op.url_failed, urls + url_num, url_num * sizeof (*urls));
+  memcpy (snap->op.url_timeouted, urls + 2 * url_num, url_num * sizeof (*urls));
+
+  return 0;
+}
@@ -0,0 +1,146 @@
+/*
+*     distrib.h
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef DISTRIB_H
+#define DISTRIB_H
+
+/*
+  Distributed loading by a coordinator (-g) and agents (-k) at several hosts.
+
+  The batch is cut to sub-batches like for the loading threads (-t): the
+  coordinator loads the sub-batch 0 as the batch group leader and each of N
+  agents loads one of the sub-batches 1..N with its own clients and IP
+  addresses. The coordinator sends to the agents over TCP the batch
+  configuration and the sub-batch index, waits for all of them to be ready
+  and tells them to start at the same instant.
+
+  An agent publishes the statistics of its loading thread as a usual
+  sub-batch and sends the snapshot to the coordinator each STAT_PUBLISH_PERIOD.
+  The coordinator writes the snapshots of the agents to the published
+  snapshots of their sub-batches, thus the leader merges them as the snapshots
+  of loading threads. The coordinator and the agents should run the same
+  curl-loader build.
+
+  An agent, normally run as root, reads the files and adds the IP-addresses of
+  the received configuration. Thus it listens at the loopback address, unless
+  told otherwise, and accepts the configuration only with the shared secret,
+  taken by the coordinator and the agents from DISTRIB_SECRET_ENV. The messages
+  are not encrypted.
+*/
+
+/* Environment variable with the secret, shared by the coordinator and agents */
+#define DISTRIB_SECRET_ENV "CURL_LOADER_SECRET"
+
+/* Maximum length of the secret */
+#define DISTRIB_SECRET_MAX 63
+
+/* Delay in msec from the coordinator start command to the start of loading */
+#define DISTRIB_START_DELAY 1000
+
+/* Time in msec to wait for the final statistics of the agents after stop */
+#define DISTRIB_STOP_TIMEOUT 5000
+
+/* Maximum size of a message, limiting the batch configuration file */
+#define DISTRIB_MSG_MAX (1024*1024)
+
+struct batch_context;
+
+/****************************************************************************************
+* Function name - distrib_coordinator_connect
+*
+* Description - Connects the coordinator to the agents from the -g list and sets
+*               the number of sub-batches to the number of agents plus one.
+*
+* Return Code/Output - On success - number of agents, on error -1
+****************************************************************************************/
+int distrib_coordinator_connect (void);
+
+/****************************************************************************************
+* Function name - distrib_coordinator_start
+*
+* Description - Sends the batch configuration and the sub-batch indexes to the agents,
+*               waits for the agents to prepare their sub-batches, tells them to start
+*               and starts collecting their statistics. Returns at the start instant.
+*
+* Input -       *bc_arr - array of the batch contexts of the sub-batches
+*               *config_file - name of the batch configuration file
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int distrib_coordinator_start (struct batch_context* bc_arr, const char* config_file);
+
+/****************************************************************************************
+* Function name - distrib_coordinator_stop
+*
+* Description - Waits for the final statistics of the agents and disconnects them
+*
+* Return Code/Output - None
+****************************************************************************************/
+void distrib_coordinator_stop (void);
+
+/****************************************************************************************
+* Function name - distrib_agent_accept
+*
+* Description - Waits at the address and port for connections of coordinators. 
+*               Serves each coordinator by a child process, where the function returns.
+*
+* Input -       *address - numeric IPv4 or IPv6 address to listen at
+*               port - TCP port to listen at
+* Return Code/Output - In the child process - 0, on error -1
+****************************************************************************************/
+int distrib_agent_accept (const char* address, int port);
+
+/****************************************************************************************
+* Function name - distrib_agent_config
+*
+* Description - Receives from the coordinator the batch configuration and, when
+*               the coordinator has the shared secret, saves it to a temporary file
+*
+* Input/Output - *config_name - template of the temporary file name, like for mkstemp ()
+* Output -       *index - index of the sub-batch of the agent
+*                *batches_num - number of the sub-batches
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int distrib_agent_config (char* config_name, int* index, int* batches_num);
+
+/****************************************************************************************
+* Function name - distrib_agent_start
+*
+* Description - Tells the coordinator, that the agent is ready, and returns at the
+*               start instant, set by the coordinator
+*
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int distrib_agent_start (void);
+
+/****************************************************************************************
+* Function name - distrib_agent_report
+*
+* Description - Sends the statistics, published by the loading thread of the agent,
+*               to the coordinator till the final ones. Stops the loading, when told
+*               by the coordinator or when the coordinator is lost.
+*
+* Input -       *bctx - pointer to the batch context of the loading thread
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int distrib_agent_report (struct batch_context* bctx);
+
+#endif /* DISTRIB_H */
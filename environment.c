@@ -64,26 +64,6 @@ int test_environment (batch_context* bctx)
       return -1;
     }
 
-  /* 
-     Protection of the smooth and storm modes from select fd_set smashing.
-  */
-  if (loading_mode != LOAD_MODE_HYPER)
-  {
-      if (!ret && file_limit.rlim_cur > CURL_LOADER_FD_SETSIZE)
-      {
-          fprintf(stderr, 
-                  "%s - ERROR: The limit of open descriptors in your shell is \n"
-                  "larger than allowed for modes using poll/select (to prevent fd_set smashing).\n"
-                  "The limit for non-Hyper modes is %d fdescriptors, whereas the current shell limit is %d\n"
-                  "Edit CURL_LOADER_FD_SETSIZE value in Makefile and recompile the program.\n"
-                  "Alternatively, decrease the shell limit by e.g.      ulimit -n %d  or "
-                  "use epoll-based hyper-mode (add \"-m 0\" to your command line).\n",
-                  __func__ , CURL_LOADER_FD_SETSIZE, (int) file_limit.rlim_cur,
-                  CURL_LOADER_FD_SETSIZE - 1);   
-          return -1;
-      }
-  }
-
   /* 
      Suggestion to increase the current descriptor limit
      and/or recycle sockets
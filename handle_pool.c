@@ -0,0 +1,273 @@
+/*
+*     handle_pool.c
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "handle_pool.h"
+#include "batch.h"
+#include "client.h"
+#include "cl_alloc.h"
+
+static char* cookies_export (CURL* handle);
+static void cookies_import (CURL* handle, char* cookies);
+
+
+/****************************************************************************************
+* Function name - handle_pool_init
+*
+* Description - Initializes the empty pool of CURL handles of a batch
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int handle_pool_init (batch_context* bctx)
+{
+  bctx->handles_free_num = 0;
+  bctx->handles_free_max = bctx->client_num_max;
+
+  if (! (bctx->handles_free = 
+         (CURL **) cl_calloc (bctx->handles_free_max, sizeof (CURL *))) ||
+      ! (bctx->handles_free_dev = 
+         (char **) cl_calloc (bctx->handles_free_max, sizeof (char *))))
+    {
+      fprintf (stderr, "%s - error: allocation of the pool failed.\n", __func__);
+      return -1;
+    }
+
+  /* Shared connections keep the handles of their clients */
+  bctx->handles_pool_sleep = 
+    ! bctx->native && ! bctx->pipeline_depth && ! bctx->http2_streams;
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - handle_pool_take
+*
+* Description - Takes a CURL handle for the client from the pool or allocates a new one,
+*               when the pool is empty. Restores the cookies of the client to the handle
+*               and formats the client ip-address to the bind_dev of the client.
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - On success - the handle, also set to the client, on error - NULL
+****************************************************************************************/
+CURL* handle_pool_take (client_context* cctx)
+{
+  batch_context* bctx = cctx->bctx;
+  CURL* handle;
+  char* dev;
+
+  if (bctx->handles_free_num > 0)
+    {
+      --bctx->handles_free_num;
+      handle = bctx->handles_free[bctx->handles_free_num];
+      dev = bctx->handles_free_dev[bctx->handles_free_num];
+    }
+  else if (! (handle = curl_easy_init ()))
+    {
+      fprintf (stderr, "%s - error: curl_easy_init () failed.\n", __func__);
+      return NULL;
+    }
+  else if (! (dev = malloc (HANDLE_BIND_DEV_LEN)))
+    {
+      fprintf (stderr, "%s - error: allocation of bind_dev failed.\n", __func__);
+      curl_easy_cleanup (handle);
+      return NULL;
+    }
+
+  /* 
+     The "host!" prefix tells libcurl, that the string is an address and 
+     not a name of a network interface to look up.
+  */
+  memcpy (dev, "host!", 5);
+  if (batch_client_ip_addr_str (cctx->home_bctx, cctx->client_index, 
+                                dev + 5, HANDLE_BIND_DEV_LEN - 5) == -1)
+    {
+      fprintf (stderr, "%s - error: batch_client_ip_addr_str () failed.\n", 
+               __func__);
+      curl_easy_cleanup (handle);
+      free (dev);
+      return NULL;
+    }
+  cctx->bind_dev = dev;
+
+  if (cctx->cold->cookies)
+    {
+      cookies_import (handle, cctx->cold->cookies);
+      free (cctx->cold->cookies);
+      cctx->cold->cookies = NULL;
+    }
+
+  return cctx->handle = handle;
+}
+
+/****************************************************************************************
+* Function name - handle_pool_return
+*
+* Description - Returns the CURL handle of the client together with its bind_dev buffer
+*               to the pool. The handle should be outside of any multi-handle.
+*
+* Input -       *cctx - pointer to the client context
+*               keep_cookies - when true, the cookies of the client are kept to be
+*                              restored to the next handle of the client
+* Return Code/Output - None
+****************************************************************************************/
+void handle_pool_return (client_context* cctx, int keep_cookies)
+{
+  batch_context* bctx = cctx->bctx;
+  CURL* handle = cctx->handle;
+  char* dev = cctx->bind_dev;
+
+  if (! handle)
+    return;
+
+  cctx->handle = NULL;
+  cctx->bind_dev = NULL;
+
+  if (keep_cookies)
+    {
+      free (cctx->cold->cookies);
+      cctx->cold->cookies = cookies_export (handle);
+    }
+
+  /* The next client of the handle starts without cookies */
+  curl_easy_setopt (handle, CURLOPT_COOKIELIST, "ALL");
+
+  /* Handles of the clients, moved from other threads, may overfill the pool */
+  if (bctx->handles_free_num < bctx->handles_free_max)
+    {
+      bctx->handles_free[bctx->handles_free_num] = handle;
+      bctx->handles_free_dev[bctx->handles_free_num++] = dev;
+    }
+  else
+    {
+      curl_easy_cleanup (handle);
+      free (dev);
+    }
+}
+
+/****************************************************************************************
+* Function name - handle_pool_release
+*
+* Description - Cleans up all CURL handles in the pool with their buffers and releases 
+*               the pool
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void handle_pool_release (batch_context* bctx)
+{
+  if (! bctx->handles_free)
+    return;
+
+  while (bctx->handles_free_num > 0)
+    {
+      --bctx->handles_free_num;
+      curl_easy_cleanup (bctx->handles_free[bctx->handles_free_num]);
+      free (bctx->handles_free_dev[bctx->handles_free_num]);
+    }
+
+  free (bctx->handles_free);
+  bctx->handles_free = NULL;
+  free (bctx->handles_free_dev);
+  bctx->handles_free_dev = NULL;
+}
+
+/****************************************************************************************
+* Function name - cookies_export
+*
+* Description - Copies the cookies of a CURL handle to a buffer, a cookie per line
+*
+* Input -       *handle - pointer to the CURL handle
+* Return Code/Output - The allocated buffer or NULL, when there are no cookies
+****************************************************************************************/
+static char* cookies_export (CURL* handle)
+{
+  struct curl_slist* cookies_list = NULL;
+  struct curl_slist* item;
+  char* cookies = NULL;
+  size_t len = 0;
+
+  if (curl_easy_getinfo (handle, CURLINFO_COOKIELIST, &cookies_list) != CURLE_OK ||
+      ! cookies_list)
+    {
+      return NULL;
+    }
+
+  for (item = cookies_list; item; item = item->next)
+    len += strlen (item->data) + 1;
+
+  if ((cookies = (char *) malloc (len + 1)))
+    {
+      char* pos = cookies;
+
+      for (item = cookies_list; item; item = item->next)
+        {
+          const size_t item_len = strlen (item->data);
+
+          memcpy (pos, item->data, item_len);
+          pos += item_len;
+          *pos++ = '\n';
+        }
+      *pos = '\0';
+    }
+  else
+    {
+      fprintf (stderr, "%s - error: allocation failed, the cookies are lost.\n", 
+               __func__);
+    }
+
+  curl_slist_free_all (cookies_list);
+
+  return cookies;
+}
+
+/****************************************************************************************
+* Function name - cookies_import
+*
+* Description - Adds the cookies from a buffer, a cookie per line, to a CURL handle.
+*               The buffer is modified.
+*
+* Input -       *handle - pointer to the CURL handle
+*               *cookies - the buffer of cookies
+* Return Code/Output - None
+****************************************************************************************/
+static void cookies_import (CURL* handle, char* cookies)
+{
+  char* line = cookies;
+  char* end;
+
+  while (line && *line)
+    {
+      if ((end = strchr (line, '\n')))
+        *end = '\0';
+
+      curl_easy_setopt (handle, CURLOPT_COOKIELIST, line);
+
+      line = end ? end + 1 : NULL;
+    }
+}
@@ -0,0 +1,107 @@
+/*
+*     handle_pool.h
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef HANDLE_POOL_H
+#define HANDLE_POOL_H
+
+#include <curl/curl.h>
+
+/* 
+   Length of the CURLOPT_INTERFACE buffer of a handle: "host!" prefix and
+   an IPv6 address.
+*/
+#define HANDLE_BIND_DEV_LEN 64
+
+/*
+  Pool of the CURL handles of a batch.
+
+  A client takes a CURL handle from the pool of its thread, when its url
+  is set up to be fetched, and returns the handle, when it goes to sleep 
+  after the url, as well as when it completes or fails. Thus, the number of 
+  the handles follows the number of the clients loading at the same time 
+  rather than the number of the clients. The handles are allocated by 
+  curl_easy_init () only, when the pool is empty.
+
+  Cookies of a sleeping client are kept in its client_cold and restored to
+  the handle, taken on its wake-up. Other options, like credentials, are set 
+  by the url setup anyway. Clients keep their handles over sleeping, when 
+  the connections are shared by pipelining or HTTP/2, and before an url, 
+  fetched by the url of the handle (URL_USE_CURRENT).
+
+  Each handle goes with a buffer for the CURLOPT_INTERFACE string of its 
+  client, formatted from the client ip-address, when the handle is taken. 
+  Thus, the addresses are formatted once per a take and not per an url, 
+  and only for the clients loading at the same time.
+
+  The pool is not locked and is used only by the thread of the batch.
+*/
+
+struct batch_context;
+struct client_context;
+
+/****************************************************************************************
+* Function name - handle_pool_init
+*
+* Description - Initializes the empty pool of CURL handles of a batch
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int handle_pool_init (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - handle_pool_take
+*
+* Description - Takes a CURL handle for the client from the pool or allocates a new one,
+*               when the pool is empty. Restores the cookies of the client to the handle
+*               and formats the client ip-address to the bind_dev of the client.
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - On success - the handle, also set to the client, on error - NULL
+****************************************************************************************/
+CURL* handle_pool_take (struct client_context* cctx);
+
+/****************************************************************************************
+* Function name - handle_pool_return
+*
+* Description - Returns the CURL handle of the client together with its bind_dev buffer
+*               to the pool. The handle should be outside of any multi-handle.
+*
+* Input -       *cctx - pointer to the client context
+*               keep_cookies - when true, the cookies of the client are kept to be
+*                              restored to the next handle of the client
+* Return Code/Output - None
+****************************************************************************************/
+void handle_pool_return (struct client_context* cctx, int keep_cookies);
+
+/****************************************************************************************
+* Function name - handle_pool_release
+*
+* Description - Cleans up all CURL handles in the pool with their buffers and releases 
+*               the pool
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void handle_pool_release (struct batch_context* bctx);
+
+#endif /* HANDLE_POOL_H */
@@ -67,6 +67,7 @@ void node_reset (hnode*const node)
 	  return;
 
 	node->node_id = 0;
+	node->slot = 0;
 	node->ctx = 0;
 	node->alloc.link.next = 0;
 }
@@ -108,18 +109,20 @@ int heap_init (heap*const h,
       return -1;
     }
 	
-  /* Alloc array of node-ids */
-  if (! (h->ids_arr = calloc (initial_heap_size, sizeof (long))) )
+  /* Alloc array of node-ids and the stack of free node-ids */
+  if (! (h->ids_arr = calloc (initial_heap_size, sizeof (hnode*))) ||
+      ! (h->ids_free = calloc (initial_heap_size, sizeof (long))))
     {
-      fprintf(stderr, "%s - error: alloc of nodes-ids array failed\n", __func__);
+      fprintf(stderr, "%s - error: alloc of nodes-ids arrays failed\n", __func__);
       return -1;
     }
 	
-  /* Invalidate node-ids array indexes */
+  /* All node-ids are free, the lowest to be taken first */
   for (i = 0; i < initial_heap_size; i++)
     {
-      h->ids_arr[i] = -1; /* non-valid id is -1 */
+      h->ids_free[i] = (long) (initial_heap_size - 1 - i);
     }
+  h->ids_free_num = initial_heap_size;
 	
   h->max_heap_size = initial_heap_size;
   h->heap_increase_step = increase_step;
@@ -171,6 +174,10 @@ void heap_reset (heap*const h)
     {
       free (h->ids_arr);
     }
+  if (h->ids_free)
+    {
+      free (h->ids_free);
+    }
   if (h->nodes_mpool)
     {
       mpool_free (h->nodes_mpool);
@@ -303,9 +310,10 @@ int heap_empty (heap*const h)
 ****************************************************************************************/
 int heap_increase (heap*const h)
 {
-  hnode** new_heap = 0, **old_heap = 0;
-  long* new_ids = 0, *old_ids = 0;
-  int new_size = 0, i = 0;
+  hnode** new_heap = 0;
+  hnode** new_ids = 0;
+  long* new_free = 0;
+  size_t new_size = 0, i = 0;
 
   if (!h || h->heap_increase_step <= 0)
     {
@@ -315,40 +323,38 @@ int heap_increase (heap*const h)
 	
   new_size = h->max_heap_size + h->heap_increase_step;
 	
-  /* Allocate new arrays for heap and ids */
-  if ((new_heap = calloc (new_size, sizeof (hnode*))) == 0)
+  /* Re-allocate arrays for heap, ids and free ids */
+  if ((new_heap = realloc (h->heap, new_size * sizeof (hnode*))) == 0)
     {
       fprintf(stderr, "%s - error: alloc of the new heap array failed\n", __func__);
       return -1;
     }
+  h->heap = new_heap;
 	
-  if ((new_ids = calloc (new_size, sizeof (long)) ) == 0)
+  if ((new_ids = realloc (h->ids_arr, new_size * sizeof (hnode*))) == 0)
     {
       fprintf(stderr, "%s - error: alloc of the new nodes-ids array failed\n", __func__);
       return -1;
     }
-	
-  /* mark all node-ids in the new_ids array as non-valid */
-  for (i = 0; i < new_size; i++)
+  h->ids_arr = new_ids;
+
+  if ((new_free = realloc (h->ids_free, new_size * sizeof (long))) == 0)
     {
-      new_ids[i] = -1;
+      fprintf(stderr, "%s - error: alloc of the new free nodes-ids array failed\n", 
+              __func__);
+      return -1;
     }
+  h->ids_free = new_free;
 	
-  memcpy (new_heap, h->heap, sizeof (hnode*) * h->max_heap_size);
-  memcpy (new_ids, h->ids_arr, sizeof (long) * h->max_heap_size);
-	
-  /* Keep the old heap and old nodes-ids*/
-  old_heap = h->heap;
-  old_ids = h->ids_arr;
+  /* The new node-ids are free, the lowest to be taken first */
+  for (i = h->max_heap_size; i < new_size; i++)
+    {
+      h->heap[i] = 0;
+      h->ids_arr[i] = 0;
+      h->ids_free[h->ids_free_num++] = (long) (new_size - 1 - (i - h->max_heap_size));
+    }
 	
-  /* Switch the arrays and correct max_curr_heap_size */
-  h->heap = new_heap;
-  h->ids_arr = new_ids;
   h->max_heap_size = new_size;
-	
-  /* Release mem */
-  free (old_heap);
-  free (old_ids);
   
   return 0;
 }
@@ -391,7 +397,11 @@ long heap_push (heap* const h, hnode* const nd, int keep_node_id)
   else
     {
       /* Get free node-id */
-      new_node_id = heap_get_node_id (h);
+      if ((new_node_id = heap_get_node_id (h)) == -1)
+        {
+          fprintf(stderr, "%s - error: heap_get_node_id() failed\n", __func__);
+          return -1;
+        }
 	
       /* 
          Set node-id to the hnode, it will be further passed from 
@@ -416,23 +426,23 @@ long heap_push (heap* const h, hnode* const nd, int keep_node_id)
 /****************************************************************************************
 * Function name - heap_get_node_id
 *
-* Description -  Provides a "free" id
+* Description -  Provides a "free" id from the stack of free node-ids
 *
 * Input -        *h - pointer to an initialized heap
-* Return Code/Output - node-id
+* Return Code/Output - On success - node-id, on error - (-1)
 ****************************************************************************************/
 long heap_get_node_id (heap*const h)
 {
-  while (++h->ids_last < h->max_heap_size && h->ids_arr[h->ids_last] >= 0)
-    ;
-
-  if (h->ids_last == h->max_heap_size && h->ids_min_free < h->max_heap_size)
+  /* 
+     Node-ids, reserved by nodes out of the heap, may exhaust the
+     free ones before the heap array itself.
+  */
+  if (! h->ids_free_num && heap_increase (h) == -1)
     {
-      h->ids_last = h->ids_min_free;
-      h->ids_min_free = h->max_heap_size;
+      return -1;
     }
-  
-  return (long) h->ids_last;
+
+  return h->ids_free[--h->ids_free_num];
 }
 
 /****************************************************************************************
@@ -450,8 +460,9 @@ void heap_put_node_to_slot (heap*const h, size_t slot, hnode*const nd)
   /* Insert node into the specified slot of the heap */
   h->heap[slot] = nd;
   
-  /* Update slot in the parallel ids-array */
-  h->ids_arr[nd->node_id] = slot;
+  /* Update slot kept by the node and the parallel ids-array */
+  nd->slot = slot;
+  h->ids_arr[nd->node_id] = nd;
 }
 
 /****************************************************************************************
@@ -510,11 +521,18 @@ hnode* heap_remove_node (heap*const h, const size_t slot, int reserve_slot)
         }
     }
 	
-  /* Mark the node-id entry as free. */
+  /* 
+     Mark the node-id entry as free, or, when reserving, keep the node-id 
+     out of both the free ids and the valid ones.
+  */
   if (! reserve_slot)
     {
       release_node_id (h, removed_node_id);
     }
+  else
+    {
+      h->ids_arr[removed_node_id] = 0;
+    }
 
   return removed_node;
 }
@@ -522,13 +540,8 @@ hnode* heap_remove_node (heap*const h, const size_t slot, int reserve_slot)
 
 void release_node_id (heap*const h, const size_t node_id)
 {
-  h->ids_arr [node_id] = -1;
-  
-  if (node_id < h->ids_min_free  &&  node_id <= h->ids_last)
-    {
-      h->ids_min_free_restore = h->ids_min_free;
-      h->ids_min_free = node_id;
-    }
+  h->ids_arr [node_id] = 0;
+  h->ids_free [h->ids_free_num++] = (long) node_id;
 }
 
 /****************************************************************************************
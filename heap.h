@@ -40,6 +40,12 @@ typedef struct hnode
   */
   long node_id;
 
+  /* 
+     The current position (slot) of the node in the heap array.
+     Kept by the heap on each move of the node.
+  */
+  size_t slot;
+
   /* 
      Pointer to the user-data context to keep with the node. 
      When used in timer-queue, we place here pointer to
@@ -80,26 +86,19 @@ typedef struct heap
   size_t heap_increase_step;
 	
   /* 
-     Array of node ids to serve for mapping between node-id and place in heap,
-     containing node with the id.
-		
-     When ids_arr[i] is -(-1), it is free and may be used for a newcoming node. 
-     But, when ids_arr[i] >=0, it does contain some valid node-id corresponding
-     to a valid node in the <heap> array.	
+     Array of pointers to the nodes, indexed by the node-id. When ids_arr[i]
+     is NULL, the node-id is either free or reserved for a node taken out 
+     of the heap to be pushed back (periodic timer). Position of a node in 
+     the heap is kept by the node itself.
   */
-  long* ids_arr;
-	
-  /* The last provided slot from <ids_arr> (node-id) */
-  size_t ids_last;
-	
-  /* The lowest freed node-id */
-  size_t ids_min_free;
-	
+  hnode** ids_arr;
+
   /* 
-     Keeping <ids_min_free> in order to restore the value for a
-     node to be re-scheduled.
+     Stack of free node-ids, sized as <ids_arr>, and the number of 
+     node-ids in it.
   */
-  size_t ids_min_free_restore;
+  long* ids_free;
+  size_t ids_free_num;
 
   /* Comparator function for nodes. */
   heap_cmp_func fcomp;
@@ -244,6 +243,15 @@ int heap_empty (heap*const h);
 ****************************************************************************************/
 int heap_size (heap*const h);
 
+/****************************************************************************************
+* Function name - release_node_id
+*
+* Description -  Returns a node-id to the stack of free node-ids
+*
+* Input -        *h - pointer to an initialized heap
+*                node_id - the node-id to release
+* Return Code/Output - none
+****************************************************************************************/
 void release_node_id (heap*const h, const size_t node_id);
 
 #endif /* HEAP_H */
@@ -36,6 +36,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <pthread.h>
@@ -57,6 +58,12 @@
 #include "ssl_thr_lock.h"
 #include "screen.h"
 #include "cl_alloc.h"
+#include "cpu_affinity.h"
+#include "balance.h"
+#include "distrib.h"
+#include "standby.h"
+#include "handle_pool.h"
+#include "slab_alloc.h"
 
 
 static int client_tracing_function (CURL *handle, 
@@ -75,19 +82,16 @@ static void* batch_function (void *batch_data);
 static int initial_handles_init (struct client_context*const cdata);
 static int setup_curl_handle_appl (struct client_context*const cctx,  
                                    url_context* url_ctx);
-static int init_client_formed_buffer (client_context* cctx, 
-                                      url_context* url,
-                                      char* buffer,
-                                      size_t buffer_len);
 static int init_client_contexts (batch_context* bctx, FILE* output_file);
 static void free_batch_data_allocations (struct batch_context* bctx);
 static void free_url (url_context* url, int clients_max);
 static int ipv6_increment(const struct in6_addr *const src, 
                           struct in6_addr *const dest);
 static int create_thr_subbatches (batch_context *bc_arr, int subbatches_num);
-static int ip_addr_str_allocate_init (batch_context* bctx, 
-                                      int client_index, 
-                                      char** addr_str);
+static int run_subbatches_processes (batch_context *bc_arr, int subbatches_num);
+static int run_distrib_agent (batch_context *bc_arr);
+static int add_subbatch_ip_addrs (batch_context* bctx);
+static int add_batch_ip_addrs (batch_context* bctx);
 
 int stop_loading = 0;
 
@@ -96,6 +100,13 @@ static void sigint_handler (int signum)
 {
   (void) signum;
 
+  /* 
+     Loading threads complete their requests in flight, before the final 
+     statistics. A second SIGINT does not wait for them.
+  */
+  if (stop_loading)
+    _exit (1);
+
   stop_loading = 1;
 
   screen_release ();
@@ -108,13 +119,16 @@ static void sigint_handler (int signum)
 typedef int (*pf_user_activity) (struct client_context*const);
 
 /*
- * Batch functions for the 2 loading modes: 
- * hyper (epoll-based) and smooth (poll-based).
+ * Batch functions for the 4 loading modes: 
+ * hyper (libevent-based), smooth (poll-based), epoll (native epoll) 
+ * and io_uring.
 */
-static pf_user_activity ua_array[2] = 
+static pf_user_activity ua_array[4] = 
 { 
   user_activity_hyper,
-  user_activity_smooth
+  user_activity_smooth,
+  user_activity_epoll,
+  user_activity_uring
 };
 
 static FILE *create_file (batch_context* bctx, char* fname)
@@ -131,6 +145,7 @@ main (int argc, char *argv [])
 {
   batch_context bc_arr[BATCHES_MAX_NUM];
   pthread_t tid[BATCHES_MAX_NUM];
+  char batch_name[BATCH_NAME_SIZE];
   int batches_num = 0; 
   int i = 0, error = 0;
 
@@ -144,6 +159,13 @@ main (int argc, char *argv [])
       return -1;
     }
 
+  if (cpu_affinity_init (cpu_affinity_list, cpu_reserved_list) == -1)
+    {
+      fprintf (stderr, 
+               "%s - error: failed to prepare CPUs for the loading threads.\n", __func__);
+      return -1;
+    }
+
   if (geteuid())
     {
       fprintf (stderr, 
@@ -151,8 +173,24 @@ main (int argc, char *argv [])
       return -1;
     }
   
+  /* 
+     libcurl is initialized with its memory allocator before any other call 
+     to libcurl, including the parsing of the configuration.
+  */
+  if (slab_alloc_curl_init (curl_system_alloc) == -1)
+    {
+      fprintf (stderr, "%s - error: slab_alloc_curl_init () failed.\n", __func__);
+      return -1;
+    }
+
    memset(bc_arr, 0, sizeof(bc_arr));
 
+  /* An agent receives the batch configuration from a coordinator */
+  if (distrib_agent_port)
+    {
+      return run_distrib_agent (bc_arr);
+    }
+
   /* 
      Parse the configuration file. 
   */
@@ -177,9 +215,19 @@ main (int argc, char *argv [])
    
   /* 
      Add ip-addresses to the loading network interfaces
-     and keep them in batch-contexts. 
+     and keep them in batch-contexts. A coordinator of distributed
+     loading adds only the addresses of its own sub-batch.
   */
-  if (create_ip_addrs (bc_arr, batches_num) == -1)
+  if (distrib_agents)
+    {
+      if (distrib_coordinator_connect () == -1)
+        {
+          fprintf (stderr, "%s - error: distrib_coordinator_connect () failed. \n", 
+                   __func__);
+          return -1;
+        }
+    }
+  else if (create_ip_addrs (bc_arr, batches_num) == -1)
     {
       fprintf (stderr, "%s - error: create_ip_addrs () failed. \n", __func__);
       return -1;
@@ -191,6 +239,12 @@ main (int argc, char *argv [])
                __func__);
     }
 
+  if (clients_balance_init (bc_arr, threads_subbatches_num) == -1)
+    {
+      fprintf (stderr, "%s - error: clients_balance_init () failed.\n", __func__);
+      return -1;
+    }
+
   signal (SIGINT, sigint_handler);
 
   screen_init ();
@@ -203,6 +257,64 @@ main (int argc, char *argv [])
       fprintf (stderr, "Exited batch_function\n");
       screen_release ();
     }
+  else if (distrib_agents)
+    {
+      fprintf (stderr, "\n%s - RUNNING LOAD, STARTING AGENTS\n\n", __func__);
+
+      /* The name of the batch is kept for its total statistics */
+      strcpy (batch_name, bc_arr[0].batch_name);
+
+      /* The sub-batch 0 is loaded by the coordinator, others - by the agents */
+      if (create_thr_subbatches (bc_arr, threads_subbatches_num) == -1 ||
+          stat_published_init (bc_arr, threads_subbatches_num, 0) == -1 ||
+          add_subbatch_ip_addrs (&bc_arr[0]) == -1 ||
+          distrib_coordinator_start (bc_arr, config_file) == -1 ||
+          stat_thread_start (bc_arr, threads_subbatches_num, batch_name) == -1)
+        {
+          fprintf (stderr, "%s - error: failed to start the agents.\n", __func__);
+          screen_release ();
+          distrib_coordinator_stop ();
+          return -1;
+        }
+
+      batch_function (&bc_arr[0]);
+
+      distrib_coordinator_stop ();
+
+      stat_thread_stop ();
+
+      stat_published_release (bc_arr, threads_subbatches_num);
+
+      for (i = 0 ; i < threads_subbatches_num ; i++) 
+        {
+          stat_snapshot_release (&bc_arr[i].stat_merged);
+          stat_snapshot_release (&bc_arr[i].stat_read);
+        }
+    }
+  else if (subbatches_processes)
+    {
+      fprintf (stderr, "\n%s - RUNNING LOAD, STARTING PROCESSES\n\n", __func__);
+      sleep (1);
+
+      create_thr_subbatches (bc_arr, threads_subbatches_num); 
+
+      /* The statistics of the processes are collected via shared memory */
+      if (stat_published_init (bc_arr, threads_subbatches_num, 1) == -1)
+        {
+          fprintf (stderr, "%s - error: stat_published_init () failed.\n", __func__);
+          return -1;
+        }
+
+      run_subbatches_processes (bc_arr, threads_subbatches_num);
+
+      stat_published_release (bc_arr, threads_subbatches_num);
+
+      for (i = 0 ; i < threads_subbatches_num ; i++) 
+        {
+          stat_snapshot_release (&bc_arr[i].stat_merged);
+          stat_snapshot_release (&bc_arr[i].stat_read);
+        }
+    }
   else
     {
       fprintf (stderr, "\n%s - RUNNING LOAD, STARTING THREADS\n\n", __func__);
@@ -215,7 +327,29 @@ main (int argc, char *argv [])
           return -1;
         }
 
+      strcpy (batch_name, bc_arr[0].batch_name);
+
       create_thr_subbatches (bc_arr, threads_subbatches_num); 
+
+      if (stat_published_init (bc_arr, threads_subbatches_num, 0) == -1)
+        {
+          fprintf (stderr, "%s - error: stat_published_init () failed.\n", __func__);
+          return -1;
+        }
+
+      /* Threads above -j start on standby */
+      if (threads_standby_init (bc_arr, threads_subbatches_num, threads_active_num) == -1)
+        {
+          fprintf (stderr, "%s - error: threads_standby_init () failed.\n", __func__);
+          return -1;
+        }
+
+      /* The statistics thread reports the total statistics of the batch */
+      if (stat_thread_start (bc_arr, threads_subbatches_num, batch_name) == -1)
+        {
+          fprintf (stderr, "%s - error: stat_thread_start () failed.\n", __func__);
+          return -1;
+        }
       
       /* 
          Opening threads for the batches of clients 
@@ -246,12 +380,102 @@ main (int argc, char *argv [])
           fprintf(stderr, "%s - note: Thread %d terminated normally\n", __func__, i) ;
         }
 
+      stat_thread_stop ();
+
+      stat_published_release (bc_arr, threads_subbatches_num);
+
+      for (i = 0 ; i < threads_subbatches_num ; i++) 
+        {
+          stat_snapshot_release (&bc_arr[i].stat_merged);
+          stat_snapshot_release (&bc_arr[i].stat_read);
+        }
+
       thread_openssl_cleanup ();
     }
    
   return 0;
 }
 
+/****************************************************************************************
+* Function name - run_distrib_agent
+*
+* Description - Runs an agent of distributed loading. For each coordinator the agent
+*               receives the batch configuration, cuts the batch to the sub-batches
+*               like the coordinator, and loads its sub-batch in a thread, reporting
+*               the statistics of the thread to the coordinator.
+*
+* Input -       *bc_arr - array of the batch contexts
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int run_distrib_agent (batch_context *bc_arr)
+{
+  char config_name[] = "/tmp/curl-loader-agent-XXXXXX";
+  int index = 0, batches_num = 0, i, error = 0;
+  pthread_t tid;
+
+  /* Returns in the process, serving a coordinator */
+  if (distrib_agent_accept (distrib_agent_addr, distrib_agent_port) == -1 ||
+      distrib_agent_config (config_name, &index, &batches_num) == -1)
+    {
+      return -1;
+    }
+
+  error = parse_config_file (config_name, bc_arr, BATCHES_MAX_NUM) <= 0;
+  unlink (config_name);
+
+  if (error)
+    {
+      fprintf (stderr, "%s - error: parse_config_file () failed.\n", __func__);
+      return -1;
+    }
+
+  if (test_environment (&bc_arr[0]) == -1)
+    {
+      fprintf (stderr, "%s - error: test_environment () - error.\n", __func__);
+      return -1;
+    }
+
+  threads_subbatches_num = batches_num;
+
+  if (clients_balance_init (bc_arr, batches_num) == -1 ||
+      create_thr_subbatches (bc_arr, batches_num) == -1 ||
+      stat_published_init (bc_arr, batches_num, 0) == -1 ||
+      add_subbatch_ip_addrs (&bc_arr[index]) == -1)
+    {
+      fprintf (stderr, "%s - error: failed to prepare sub-batch %d.\n", 
+               __func__, index);
+      return -1;
+    }
+
+  if (distrib_agent_start () == -1)
+    {
+      return -1;
+    }
+
+  bc_arr[index].batch_id = index;
+
+  if ((error = pthread_create (&tid, NULL, batch_function, &bc_arr[index])))
+    {
+      fprintf (stderr, "%s - error: Couldn't run the loading thread, error %d\n", 
+               __func__, error);
+      return -1;
+    }
+
+  distrib_agent_report (&bc_arr[index]);
+
+  pthread_join (tid, NULL);
+
+  stat_published_release (bc_arr, batches_num);
+
+  for (i = 0 ; i < batches_num ; i++) 
+    {
+      stat_snapshot_release (&bc_arr[i].stat_merged);
+      stat_snapshot_release (&bc_arr[i].stat_read);
+    }
+
+  return 0;
+}
+
 /****************************************************************************************
 * Function name - batch_function
 * Description -   Runs the batch test either within the main-thread or in a separate thread.
@@ -276,6 +500,26 @@ static void* batch_function (void * batch_data)
       return NULL;
     }
 
+  /* 
+     Bind to a CPU before any allocations, so that the run-time counters, 
+     client contexts, handles and buffers are placed at the NUMA node of 
+     the thread.
+  */
+  if (cpu_affinity_bind ((int) bctx->batch_id) == -1)
+    {
+      fprintf (stderr, "%s - error: failed to bind batch \"%s\" to a CPU.\n", 
+               __func__, bctx->batch_name);
+      return NULL;
+    }
+
+  /* The run-time counters are released by the cleanup, as on any exit below */
+  if (batch_runtime_init (bctx) == -1)
+    {
+      fprintf (stderr, "%s - error: batch_runtime_init () failed for batch \"%s\".\n", 
+               __func__, bctx->batch_name);
+      return NULL;
+    }
+
   if (! stderr_print_client_msg)
     {
       /*
@@ -283,7 +527,7 @@ static void* batch_function (void * batch_data)
       */
       (void)sprintf (bctx-> batch_logfile, "./%s.log", bctx->batch_name);
       if (!(log_file = create_file(bctx,bctx->batch_logfile)))
-          return NULL;
+          goto cleanup;
       else
         {
           char tbuf[256];
@@ -299,7 +543,7 @@ static void* batch_function (void * batch_data)
   (void)sprintf (bctx->batch_statistics, "./%s.txt", bctx->batch_name);
   if (!(bctx->statistics_file = statistics_file = create_file(bctx,
     bctx->batch_statistics)))
-      return NULL;
+      goto cleanup;
   else
       print_statistics_header (statistics_file);
   
@@ -311,7 +555,7 @@ static void* batch_function (void * batch_data)
       (void)sprintf (bctx->batch_opstats, "./%s.ops", bctx->batch_name);
       if (!(bctx->opstats_file = opstats_file = create_file(bctx,
        bctx->batch_opstats)))
-          return NULL;
+          goto cleanup;
     }
   
   /* 
@@ -352,8 +596,27 @@ static void* batch_function (void * batch_data)
     }
 
  cleanup:
-  if (bctx->multiple_handle)
-    curl_multi_cleanup(bctx->multiple_handle);
+  /* Normally done by dump_final_statistics (), the leader is not kept waiting */
+  stat_publish_final (bctx, get_tick_count ());
+
+  /* Clients, moved between threads, are back before releasing them */
+  clients_balance_release (bctx);
+
+  /* The last active thread lets the threads on standby complete */
+  threads_standby_release (bctx);
+
+  if (bctx->multi_handles)
+    {
+      int m;
+
+      for (m = 0; m < bctx->multi_handles_num; m++)
+        {
+          if (bctx->multi_handles[m])
+            curl_multi_cleanup(bctx->multi_handles[m]);
+        }
+      free (bctx->multi_handles);
+      bctx->multi_handles = 0;
+    }
 
   if (log_file)
       fclose (log_file);
@@ -369,11 +632,111 @@ static void* batch_function (void * batch_data)
   return NULL;
 }
 
+/****************************************************************************************
+* Function name - run_subbatches_processes
+* Description -   Forks a worker process for each sub-batch of clients to run its 
+*                 batch_function () and supervises the workers till all terminate.
+*                 A worker, killed by a signal, is marked as reported for the batch 
+*                 group leader (worker 0), not to wait for its final statistics.
+*                 When the leader terminates on SIGINT, other workers are terminated.
+*
+* Input -         *bc_arr - array of the sub-batch contexts
+*                 subbatches_num - number of sub-batches
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int run_subbatches_processes (batch_context *bc_arr, int subbatches_num)
+{
+  pid_t pid[BATCHES_MAX_NUM];
+  int i, status, running = 0;
+
+  /* Not to output the buffered data by each worker */
+  fflush (stdout);
+  fflush (stderr);
+
+  for (i = 0 ; i < subbatches_num ; i++) 
+    {
+      bc_arr[i].batch_id = i;
+
+      if ((pid[i] = fork ()) == -1)
+        {
+          fprintf (stderr, "%s - error: Couldn't run process number %d, errno %d\n", 
+                   __func__, i, errno);
+          __atomic_store_n (&bc_arr[i].stat_published->final, 1, __ATOMIC_RELEASE);
+          continue;
+        }
+
+      if (! pid[i])
+        {
+          /* Worker process */
+          batch_function (&bc_arr[i]);
+          exit (0);
+        }
+
+      running++;
+      fprintf (stderr, "%s - note: Process %d (pid %d), started normally\n", 
+               __func__, i, (int) pid[i]);
+    }
+
+  /* Waiting for all running processes to terminate */
+  while (running > 0)
+    {
+      pid_t done = waitpid (-1, &status, 0);
+
+      if (done == -1)
+        {
+          if (errno == EINTR)
+            continue;
+
+          fprintf (stderr, "%s - error: waitpid () failed with errno %d\n", 
+                   __func__, errno);
+          return -1;
+        }
+
+      for (i = 0 ; i < subbatches_num && pid[i] != done; i++)
+        ;
+
+      if (i == subbatches_num)
+        continue;
+
+      running--;
+      pid[i] = -1;
+
+      if (WIFSIGNALED (status))
+        {
+          /* The leader does not wait for the statistics of the process */
+          __atomic_store_n (&bc_arr[i].stat_published->final, 1, __ATOMIC_RELEASE);
+        }
+
+      if (WIFSIGNALED (status) && !stop_loading)
+        {
+          fprintf (stderr, "%s - error: Process %d killed by signal %d\n", 
+                   __func__, i, WTERMSIG (status));
+        }
+      else
+        {
+          fprintf (stderr, "%s - note: Process %d terminated normally\n", __func__, i);
+        }
+
+      if (! i && stop_loading)
+        {
+          int k;
+
+          for (k = 1 ; k < subbatches_num; k++)
+            {
+              if (pid[k] > 0)
+                kill (pid[k], SIGTERM);
+            }
+        }
+    }
+
+  return 0;
+}
+
 /****************************************************************************************
 * Function name - initial_handles_init
 *
-* Description - Libcurl initialization of curl multi-handle and the curl handles (clients), 
-*               used in the batch
+* Description - Libcurl initialization of curl multi-handle and the pool of curl handles
+*               (clients), used in the batch
 *
 * Input -       *ctx_array - array of clients for a particular batch/sub-batch of clients
 * Return Code/Output - On Success - 0, on Error -1
@@ -383,29 +746,125 @@ static int initial_handles_init (client_context*const ctx_array)
   batch_context* bctx = ctx_array->bctx;
   int k = 0;
 
-  /* Init CURL multi-handle. */
-  if (! (bctx->multiple_handle = curl_multi_init()) )
+  /* A sub-batch may have less clients, than the multi-handles configured */
+  if (bctx->multi_handles_num > bctx->client_num_max)
+    bctx->multi_handles_num = bctx->client_num_max;
+
+  if (bctx->multi_handles_num < 1)
+    bctx->multi_handles_num = 1;
+
+  if (! (bctx->multi_handles = 
+         (CURLM **) cl_calloc (bctx->multi_handles_num, sizeof (CURLM *))))
     {
-      fprintf (stderr, 
-               "%s - error: curl_multi_init() failed for batch \"%s\" .\n", 
-               __func__, bctx->batch_name) ;
+      fprintf (stderr, "%s - error: allocation of multi-handles failed.\n", __func__);
       return -1;
     }
 
-  /* Initialize all CURL handles */
-  for (k = 0 ; k < bctx->client_num_max ; k++)
+  /* Init CURL multi-handles. */
+  for (k = 0 ; k < bctx->multi_handles_num ; k++)
     {
-      if (!(bctx->cctx_array[k].handle = curl_easy_init ()))
+      if (! (bctx->multi_handles[k] = curl_multi_init()) )
         {
-          fprintf (stderr,"%s - error: curl_easy_init () failed for k=%d.\n",
-                   __func__, k);
+          fprintf (stderr, 
+                   "%s - error: curl_multi_init() failed for batch \"%s\" .\n", 
+                   __func__, bctx->batch_name) ;
           return -1;
         }
+
+      if (bctx->pipeline_depth > 0)
+        {
+          curl_multi_setopt (bctx->multi_handles[k], CURLMOPT_PIPELINING, 1L);
+#if LIBCURL_VERSION_NUM >= 0x071e00
+          curl_multi_setopt (bctx->multi_handles[k], CURLMOPT_MAX_PIPELINE_LENGTH,
+                             (long) bctx->pipeline_depth);
+#endif
+        }
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+      if (bctx->http2_streams > 0)
+        {
+          curl_multi_setopt (bctx->multi_handles[k], CURLMOPT_PIPELINING, 
+                             CURLPIPE_MULTIPLEX);
+#if LIBCURL_VERSION_NUM >= 0x074300
+          curl_multi_setopt (bctx->multi_handles[k], CURLMOPT_MAX_CONCURRENT_STREAMS,
+                             (long) bctx->http2_streams);
+#endif
+        }
+#endif
+    }
+
+  /* 
+     Spread the clients among the multi-handles. CURL handles are taken from 
+     the pool, when the clients are loading.
+  */
+  for (k = 0 ; k < bctx->client_num_max ; k++)
+    {
+      bctx->cctx_array[k].multi_handle = 
+        bctx->multi_handles[k % bctx->multi_handles_num];
+    }
+
+  if (handle_pool_init (bctx) == -1)
+    {
+      fprintf (stderr, "%s - error: handle_pool_init () failed.\n", __func__);
+      return -1;
     }
         
   return 0;
 }
 
+/*
+  The callback to libcurl to open a socket, counting the connections of a 
+  pipelining batch. libcurl binds the socket to the ip-address of the 
+  client, set by CURLOPT_INTERFACE, after it is opened.
+*/
+static curl_socket_t client_open_socket (void *clientp,
+                                         curlsocktype purpose,
+                                         struct curl_sockaddr *address)
+{
+  client_context* cctx = (client_context *) clientp;
+  batch_context* bctx = cctx->bctx;
+  curl_socket_t sock;
+
+  (void) purpose;
+
+  sock = socket (address->family, address->socktype, address->protocol);
+
+  if (sock == CURL_SOCKET_BAD)
+    {
+      return sock;
+    }
+
+#ifdef IP_BIND_ADDRESS_NO_PORT
+  /* The port is chosen at connect (), so that the ports are not exhausted */
+  {
+    int on = 1;
+    setsockopt (sock, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &on, sizeof (on));
+  }
+#endif
+
+  if (bctx->pipeline_depth > 0 || bctx->http2_streams > 0)
+    {
+      bctx->rt->pipe_connections_open++;
+      bctx->rt->op_delta.pipe_connections++;
+    }
+
+  return sock;
+}
+
+/*
+  The callback to libcurl to close a socket of a pipelining batch, opened 
+  by client_open_socket ().
+*/
+static int pipe_close_socket (void *clientp, curl_socket_t item)
+{
+  client_context* cctx = (client_context *) clientp;
+
+  if (cctx->bctx->rt->pipe_connections_open > 0)
+    cctx->bctx->rt->pipe_connections_open--;
+
+  return close (item);
+}
+
 /*
   The callback to libcurl to write all bytes to ptr.
 */
@@ -471,6 +930,14 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
     }
 
   batch_context* bctx = cctx->bctx;
+
+  /* The client, which has returned its handle to the pool, takes a handle */
+  if (! cctx->handle && ! handle_pool_take (cctx))
+    {
+      fprintf (stderr,"%s - error: handle_pool_take () failed.\n", __func__);
+      return -1;
+    }
+
   CURL* handle = cctx->handle;
 
   curl_easy_reset (handle);
@@ -490,9 +957,15 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
   if (bctx->ipv6)
     curl_easy_setopt (handle, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V6);
       
-  /* Bind the handle to a certain IP-address */
-  curl_easy_setopt (handle, CURLOPT_INTERFACE, 
-                    bctx->ip_addr_array [cctx->client_index]);
+  /* 
+     Bind the handle to the IP-address of the client, formatted, when the 
+     handle has been taken from the pool. The address is also matched by 
+     libcurl, when it reuses a cached connection, thus a client does not 
+     take a connection of another client.
+  */
+  curl_easy_setopt (handle, CURLOPT_INTERFACE, cctx->bind_dev);
+  curl_easy_setopt (handle, CURLOPT_OPENSOCKETFUNCTION, client_open_socket);
+  curl_easy_setopt (handle, CURLOPT_OPENSOCKETDATA, cctx);
 
   curl_easy_setopt (handle, CURLOPT_NOSIGNAL, 1);
 
@@ -515,19 +988,19 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
              GET url with form fields. If not making searches with a search
              engine, better to do it encrypted by HTTPS.
           */
-          if (!cctx->get_url_form_data || !cctx->get_url_form_data_len)
+          if (!cctx->cold->get_url_form_data || !cctx->cold->get_url_form_data_len)
             {
               fprintf (stderr,"%s - error: get_url_form_data not allocated/initialized.\n",
                        __func__);
               return -1;
             }
  
-          strcpy (cctx->get_url_form_data, url->url_str);
+          strcpy (cctx->cold->get_url_form_data, url->url_str);
           
           if (init_client_formed_buffer (cctx, 
                                          url,
-                                         cctx->get_url_form_data + url->url_str_len -1,
-                                         cctx->get_url_form_data_len - url->url_str_len) == -1)
+                                         cctx->cold->get_url_form_data + url->url_str_len -1,
+                                         cctx->cold->get_url_form_data_len - url->url_str_len) == -1)
             {
               fprintf (stderr,
                        "%s - error: init_client_formed_buffer() failed for GET form fields.\n",
@@ -535,7 +1008,7 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
               return -1;
             }
           
-          curl_easy_setopt (handle, CURLOPT_URL, cctx->get_url_form_data);
+          curl_easy_setopt (handle, CURLOPT_URL, cctx->cold->get_url_form_data);
         }
       else
         {
@@ -546,7 +1019,7 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
               char buf[1000];
               sprintf(buf,"%s.%ld.%ld.%s",url->url_str,
                   cctx->cycle_num,cctx->url_curr_index,
-                  cctx->client_name);
+                  cctx->cold->client_name);
               buf[strlen(buf)-1] = '\0'; // suppress space
               curl_easy_setopt (handle, CURLOPT_URL, buf);
 #else
@@ -639,6 +1112,32 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
   /* Set the private pointer to be used by the smooth-mode. */
   curl_easy_setopt (handle, CURLOPT_PRIVATE, cctx);
 
+#if LIBCURL_VERSION_NUM >= 0x072b00
+  if (bctx->http2_streams > 0)
+    {
+      /* 
+         Prior knowledge for http://, ALPN for https://. A new transfer waits
+         for a connection, which may be multiplexed, instead of opening
+         one more.
+      */
+#if LIBCURL_VERSION_NUM >= 0x073100
+      curl_easy_setopt (handle, CURLOPT_HTTP_VERSION, 
+                        strncasecmp (url->url_str, "https://", 8) ?
+                        CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE : CURL_HTTP_VERSION_2TLS);
+#else
+      curl_easy_setopt (handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_0);
+#endif
+      curl_easy_setopt (handle, CURLOPT_PIPEWAIT, 1L);
+    }
+#endif
+
+  if (bctx->pipeline_depth > 0 || bctx->http2_streams > 0)
+    {
+      /* Count connections for the pipelining statistics */
+      curl_easy_setopt (handle, CURLOPT_CLOSESOCKETFUNCTION, pipe_close_socket);
+      curl_easy_setopt (handle, CURLOPT_CLOSESOCKETDATA, cctx);
+    }
+
   /* Without the buffer set, we do not get any errors in tracing function. */
   curl_easy_setopt (handle, CURLOPT_ERRORBUFFER, bctx->error_buffer);
   
@@ -766,8 +1265,9 @@ int setup_curl_handle_appl (client_context*const cctx, url_context* url)
       
       /* 
          Enable cookies. This is important for various authentication schemes. 
+         A handle from the pool may be new for the client.
       */
-      if (! url->url_ind)
+      if (! url->url_ind || bctx->handles_pool_sleep)
         {
           curl_easy_setopt (handle, CURLOPT_COOKIEFILE, "");
         }
@@ -777,11 +1277,11 @@ int setup_curl_handle_appl (client_context*const cctx, url_context* url)
           /* 
              Make POST, using post buffer, if requested. 
           */
-            if (url->upload_file && url->upload_file_ptr && (!cctx->post_data || !cctx->post_data[0]))
+            if (url->upload_file && url->upload_file_ptr && (!cctx->cold->post_data || !cctx->cold->post_data[0]))
             {
                 curl_easy_setopt(handle, CURLOPT_POST, 1);
             }
-            else if (cctx->post_data || url->mpart_form_post)
+            else if (cctx->cold->post_data || url->mpart_form_post)
             {
               /* 
                  Sets POST as the HTTP request method using either:
@@ -890,9 +1390,14 @@ int setup_curl_handle_appl (client_context*const cctx, url_context* url)
 
       if (url->ftp_active)
         {
-          curl_easy_setopt(handle, 
-                           CURLOPT_FTPPORT, 
-                           bctx->ip_addr_array [cctx->client_index]);
+          char ftp_port[INET6_ADDRSTRLEN + 1];
+
+          /* libcurl copies the string */
+          if (batch_client_ip_addr_str (cctx->home_bctx, cctx->client_index, 
+                                        ftp_port, sizeof (ftp_port)) == 0)
+            {
+              curl_easy_setopt(handle, CURLOPT_FTPPORT, ftp_port);
+            }
         }
 
       /*
@@ -937,20 +1442,20 @@ int response_logfiles_set (client_context* cctx, url_context* url)
                 cctx->cycle_num
                 );
 
-      if (cctx->logfile_bodies)
+      if (cctx->cold->logfile_bodies)
         {
-          fclose (cctx->logfile_bodies);
-          cctx->logfile_bodies = NULL;
+          fclose (cctx->cold->logfile_bodies);
+          cctx->cold->logfile_bodies = NULL;
         }
 
-      if (!(cctx->logfile_bodies = fopen (body_file, "w")))
+      if (!(cctx->cold->logfile_bodies = fopen (body_file, "w")))
         {
           fprintf (stderr, "%s - error: fopen () failed with errno %d.\n",
                    __func__, errno);
           return -1;
         }
       
-      curl_easy_setopt (handle, CURLOPT_WRITEDATA, cctx->logfile_bodies);
+      curl_easy_setopt (handle, CURLOPT_WRITEDATA, cctx->cold->logfile_bodies);
       curl_easy_setopt (handle, CURLOPT_WRITEFUNCTION, writefunction);
     }
 
@@ -967,19 +1472,19 @@ int response_logfiles_set (client_context* cctx, url_context* url)
                 cctx->cycle_num
                 );
 
-      if (cctx->logfile_headers)
+      if (cctx->cold->logfile_headers)
         {
-          fclose (cctx->logfile_headers);
-          cctx->logfile_headers = NULL;
+          fclose (cctx->cold->logfile_headers);
+          cctx->cold->logfile_headers = NULL;
         }
 
-      if (!(cctx->logfile_headers = fopen (hdr_file, "w")))
+      if (!(cctx->cold->logfile_headers = fopen (hdr_file, "w")))
         {
           fprintf (stderr, "%s - error: fopen () failed with errno %d.\n",
                    __func__, errno);
           return -1;
         }
-       curl_easy_setopt (handle, CURLOPT_WRITEHEADER, cctx->logfile_headers);
+       curl_easy_setopt (handle, CURLOPT_WRITEHEADER, cctx->cold->logfile_headers);
        curl_easy_setopt (handle, CURLOPT_HEADERFUNCTION, writefunction);
     }
   return 0;
@@ -1000,15 +1505,15 @@ int init_client_url_post_data (client_context* cctx, url_context* url)
     {
       if (init_client_formed_buffer (cctx, 
                                      url,
-                                     cctx->post_data, 
-                                     cctx->post_data_len) == -1)
+                                     cctx->cold->post_data, 
+                                     cctx->cold->post_data_len) == -1)
         {
           fprintf (stderr, "%s - error: init_client_formed_buffers() failed.\n",
                    __func__);
           return -1;
         }
       
-      curl_easy_setopt (cctx->handle, CURLOPT_POSTFIELDS, cctx->post_data);
+      curl_easy_setopt (cctx->handle, CURLOPT_POSTFIELDS, cctx->cold->post_data);
     }
   else if (url->mpart_form_post)
     {
@@ -1038,10 +1543,10 @@ int init_client_url_post_data (client_context* cctx, url_context* url)
 *               *buffer_len - size of the client buffer
 * Return Code/Output - On Success - 0, on Error -1
 *************************************************************************/
-static int init_client_formed_buffer (client_context* cctx, 
-                                      url_context* url,
-                                      char* buffer,
-                                      size_t buffer_len)
+int init_client_formed_buffer (client_context* cctx, 
+                               url_context* url,
+                               char* buffer,
+                               size_t buffer_len)
 {
   int i = 0;
 
@@ -1158,14 +1663,14 @@ static int init_client_formed_buffer (client_context* cctx,
     char *end = data+strlen(data)-1;\
     if (*end == '\n')\
       *end = '\0';\
-    (void)fprintf(cctx->file_output,"%ld %ld %ld %s%s %s",\
-     offs_resp, cctx->cycle_num, cctx->url_curr_index, cctx->client_name,\
+    (void)fprintf(cctx->cold->file_output,"%ld %ld %ld %s%s %s",\
+     offs_resp, cctx->cycle_num, cctx->url_curr_index, cctx->cold->client_name,\
      ind, data);\
     if (url_print)\
-      (void)fprintf(cctx->file_output," eff-url: url %s",url);\
+      (void)fprintf(cctx->cold->file_output," eff-url: url %s",url);\
     if (url_diff)\
-      (void)fprintf(cctx->file_output," url: url %s",url_target);\
-    (void)fprintf(cctx->file_output,"\n");\
+      (void)fprintf(cctx->cold->file_output," url: url %s",url_target);\
+    (void)fprintf(cctx->cold->file_output,"\n");\
   }
 
 #define write_log_num(ind, num) \
@@ -1218,7 +1723,7 @@ static int client_tracing_function (CURL *handle,
           memcpy (detailed_buff, data, size);
               
           detailed_buff[size] = '\0';
-          fprintf(cctx->file_output, "%s\n", detailed_buff);
+          fprintf(cctx->cold->file_output, "%s\n", detailed_buff);
         }
     }
 #endif
@@ -1247,8 +1752,10 @@ static int client_tracing_function (CURL *handle,
    */
   scan_response(type, (char*) data, size, cctx);
 
-  const unsigned long time_resp = get_tick_count();
-  const unsigned long offs_resp = time_resp - cctx->bctx->start_time;
+  /* The timestamp cached by the event loop, when the data were polled */
+  const unsigned long long time_resp = cached_tick_count_usec ();
+  const unsigned long offs_resp = 
+    (unsigned long) (time_resp / 1000) - cctx->bctx->start_time;
 
   switch (type)
     {
@@ -1426,10 +1933,10 @@ static int client_tracing_function (CURL *handle,
 
     case CURLINFO_DATA_IN:     
       if (verbose_logging > 1) 
-          (void)fprintf(cctx->file_output,
+          (void)fprintf(cctx->cold->file_output,
                  "%ld %ld %ld %s<= Recv data: eff-url: %s, url: %s\n", 
                   offs_resp, cctx->cycle_num, cctx->url_curr_index,
-		  cctx->client_name,
+		  cctx->cold->client_name,
                   url_print ? url : "", url_diff ? url_target : "");
 
       stat_data_in_add (cctx,  (unsigned long) size);
@@ -1460,11 +1967,11 @@ static int client_tracing_function (CURL *handle,
       memcpy (detailed_buff, data, nbytes);
       
       detailed_buff[nbytes] = '\0';
-      fprintf(cctx->file_output, "%s%s\n\n", detailed_buff, nbytes < size? "..." : "");
+      fprintf(cctx->cold->file_output, "%s%s\n\n", detailed_buff, nbytes < size? "..." : "");
   }
 
   
-  // fflush (cctx->file_output); // Don't do it
+  // fflush (cctx->cold->file_output); // Don't do it
   return 0;
 }
 
@@ -1498,13 +2005,18 @@ static int init_client_contexts (batch_context* bctx,
       cctx->cycle_num = 0;
 
       if (verbose_logging > 1)
-         snprintf(cctx->client_name, sizeof(cctx->client_name) - 1, 
-               "%d (%s) ", 
-               i + 1, 
-               bctx->ip_addr_array[i]);
+        {
+          char ip_addr_str[INET6_ADDRSTRLEN + 1] = "";
+
+          batch_client_ip_addr_str (bctx, i, ip_addr_str, sizeof (ip_addr_str));
+          snprintf(cctx->cold->client_name, sizeof(cctx->cold->client_name) - 1, 
+                   "%d (%s) ", 
+                   i + 1, 
+                   ip_addr_str);
+        }
       else
 	 /* Shorten client name for low logging */
-         snprintf(cctx->client_name, sizeof(cctx->client_name) - 1, 
+         snprintf(cctx->cold->client_name, sizeof(cctx->cold->client_name) - 1, 
                "%d ",i+1);
 
       /* Mark timer-ids as non-valid. */
@@ -1518,13 +2030,13 @@ static int init_client_contexts (batch_context* bctx,
       cctx->url_curr_index = 0; /* Actually zeroed by calloc. */
       
       /* Set output stream for each client to be either batch logfile or stderr. */
-      cctx->file_output = stderr_print_client_msg ? stderr : log_file;
+      cctx->cold->file_output = stderr_print_client_msg ? stderr : log_file;
 
       /* 
          Set pointer in client to its batch object. The pointer will be used to get 
          configuration and set back statistics to batch.
       */
-      cctx->bctx = bctx;
+      cctx->bctx = cctx->home_bctx = bctx;
     }
 
   return 0;
@@ -1546,8 +2058,15 @@ static void free_batch_data_allocations (batch_context* bctx)
       return;
     }
 
-  op_stat_point_release (&bctx->op_delta);
+  batch_runtime_release (bctx);
   op_stat_point_release (&bctx->op_total);
+
+  /* Snapshots of the threads are read by the leader, released after joining */
+  if (! threads_subbatches_num)
+    {
+      stat_snapshot_release (&bctx->stat_merged);
+      stat_snapshot_release (&bctx->stat_read);
+    }
   
   /*
      Free client contexts 
@@ -1562,37 +2081,40 @@ static void free_batch_data_allocations (batch_context* bctx)
           {
               curl_easy_cleanup (cctx->handle);
               cctx->handle = NULL;
+              free (cctx->bind_dev);
+              cctx->bind_dev = NULL;
           }
           
-          /* Free client POST-buffers */ 
-          if (cctx->post_data)
-          {
-              free (cctx->post_data);
-              cctx->post_data = NULL;
-          }
-          
-          if (cctx->logfile_headers)
+          /* POST-buffers and fetch decisions are in the batch arena */
+          cctx->cold->post_data = NULL;
+          cctx->cold->get_url_form_data = NULL;
+          cctx->cold->url_fetch_decision = NULL;
+
+          if (cctx->cold->logfile_headers)
           {
-              fclose (cctx->logfile_headers);
-              cctx->logfile_headers= NULL;
+              fclose (cctx->cold->logfile_headers);
+              cctx->cold->logfile_headers= NULL;
           }
           
-          if (cctx->logfile_bodies)
+          if (cctx->cold->logfile_bodies)
           {
-              fclose (cctx->logfile_bodies);
-              cctx->logfile_bodies = NULL;
+              fclose (cctx->cold->logfile_bodies);
+              cctx->cold->logfile_bodies = NULL;
           }
           
-          if (cctx->url_fetch_decision)
+          if (cctx->cold->cookies)
           {
-              free (cctx->url_fetch_decision);
-              cctx->url_fetch_decision = NULL;
+              free (cctx->cold->cookies);
+              cctx->cold->cookies = NULL;
           }
       }/* from for */
       
       free(bctx->cctx_array);
       bctx->cctx_array = NULL;
   }
+
+  /* Free CURL handles, not used by the clients */
+  handle_pool_release (bctx);
   
   /* 
      Free url contexts
@@ -1612,6 +2134,9 @@ static void free_batch_data_allocations (batch_context* bctx)
       free (bctx->url_ctx_array);
       bctx->url_ctx_array = NULL;
   }
+
+  /* Free the per-client buffers and side arrays at once */
+  arena_release (&bctx->client_arena);
 }
 
 static void free_url (url_context* url, int clients_max)
@@ -1719,68 +2244,17 @@ static void free_url (url_context* url, int clients_max)
 *******************************************************************************/
 static int create_ip_addrs (batch_context* bctx_array, int bctx_num)
 {
-  int batch_index, client_index; /* Batch and client indexes */
-  char*** ip_addresses =0;
+  int batch_index;
 
   /* 
      Add secondary IP-addresses to the "loading" network interface. 
   */
-  if (!(ip_addresses = (char***)calloc (bctx_num, sizeof (char**))))
-    {
-      fprintf (stderr, "%s - error: failed to allocate ip_addresses.\n", __func__);
-      return -1;
-    }
-  
   for (batch_index = 0 ; batch_index < bctx_num ; batch_index++) 
     {
-      /* 
-         Allocate the array of IP-addresses 
-      */
-      if (!(ip_addresses[batch_index] = (char**)calloc (bctx_array[batch_index].client_num_max, 
-                                               sizeof (char *))))
+      if (add_batch_ip_addrs (&bctx_array[batch_index]) == -1)
         {
           fprintf (stderr, 
-                   "%s - error: failed to allocate array of ip-addresses for batch %d.\n", 
-                   __func__, batch_index);
-          return -1;
-        }
-
-      batch_context* bctx = &bctx_array[batch_index];
-
-      /* 
-         Set them to the batch contexts to remember them. 
-      */
-      bctx->ip_addr_array = ip_addresses[batch_index]; 
-
-      /* 
-         Allocate for each client a buffer and snprintf to it the IP-address string.
-      */
-      for (client_index = 0; client_index < bctx->client_num_max; client_index++)
-        {
-          if (ip_addr_str_allocate_init (bctx, 
-                                         client_index, 
-                                         &ip_addresses[batch_index][client_index]) == -1)
-            {
-
-              fprintf (stderr, 
-                       "%s - error: ip_addr_str_allocate_init () - failed, batch [%d], client [%d]\n", 
-                       __func__, batch_index, client_index);
-              return -1;
-            }
-        }
-
-      /* 
-         Add all the addresses to the network interface as the secondary 
-         ip-addresses, using netlink userland-kernel interface.
-      */
-      if (add_secondary_ip_addrs (bctx->net_interface,
-                                  bctx->client_num_max, 
-                                  (const char** const) ip_addresses[batch_index], 
-                                  bctx->cidr_netmask,
-                                  bctx->scope) == -1)
-        {
-          fprintf (stderr, 
-                   "%s - error: add_secondary_ip_addrs() - failed for batch = %d\n", 
+                   "%s - error: add_batch_ip_addrs() - failed for batch = %d\n", 
                    __func__, batch_index);
           return -1;
         }
@@ -1790,110 +2264,69 @@ static int create_ip_addrs (batch_context* bctx_array, int bctx_num)
 }
 
 /*****************************************************************************
-* Function name - ip_addr_str_allocate_init
+* Function name - add_subbatch_ip_addrs
 *
-* Description - Allocates a single string and inits it by printing a text presentation
-*               of an IP-address (either IPv4 or IPv6).
+* Description - Adds the IP-addresses of a sub-batch, prepared by 
+*               create_thr_subbatches (), to the loading network interface.
+*               Used by the distributed loading, where each host adds only 
+*               the addresses of the sub-batch, loaded by the host.
 *
-* Input -       *bctx        - pointer to a batch context
-*               client_index - number of client in the client-array
-* Input/Output **addr_str - second pointer a string for IP-address, allocated by the
-*                           function.
-* Return Code/Output - None
+* Input -       *bctx - pointer to the batch context of the sub-batch
+* Return Code/Output - On Success - 0, on Error -1
 *******************************************************************************/
-static int ip_addr_str_allocate_init (batch_context* bctx,
-                                      int client_index,
-                                      char** addr_str)
+static int add_subbatch_ip_addrs (batch_context* bctx)
 {
-  struct in_addr in_address;
-  char ipv6_string[INET6_ADDRSTRLEN+1];
-  char* ipv4_string = 0;
-  char* ipaddrstr = 0;
-
-  *addr_str = NULL;
-
-  if (! (ipaddrstr = (char *)calloc (bctx->ipv6 ? INET6_ADDRSTRLEN + 1 : 
-                                    INET_ADDRSTRLEN + 1, sizeof (char))))
+  if (add_batch_ip_addrs (bctx) == -1)
     {
-      fprintf (stderr, "%s - allocation of ipaddrstr failed for client %d.\n", 
-               __func__, client_index);
+      fprintf (stderr, 
+               "%s - error: add_batch_ip_addrs() - failed for batch %s\n", 
+               __func__, bctx->batch_name);
       return -1;
     }
-  
-  if (bctx->ipv6 == 0)
+
+  fprintf (stderr, "%s - added IP-addresses of %s to the loading network interface.\n", 
+           __func__, bctx->batch_name);
+  return 0;
+}
+
+/*****************************************************************************
+* Function name - add_batch_ip_addrs
+*
+* Description - Adds the ip-addresses of the clients of a batch to the loading 
+*               network interface, using netlink userland-kernel interface. 
+*               A shared ip-address is added once.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On Success - 0, on Error -1
+*******************************************************************************/
+static int add_batch_ip_addrs (batch_context* bctx)
+{
+  char ip_addr_str[INET6_ADDRSTRLEN + 1];
+  const char* ip_addrs[1] = {ip_addr_str};
+  const int addrs_num = bctx->ip_shared_num ? 
+    min (bctx->ip_shared_num, bctx->client_num_max) : bctx->client_num_max;
+  int client_index;
+
+  for (client_index = 0; client_index < addrs_num; client_index++)
     {
-      /* 
-         When clients are not using common IP, advance the 
-         IPv4-address, using client index as the offset. 
-      */
-      in_address.s_addr = htonl (bctx->ip_addr_min + 
-                                 (bctx->ip_shared_num ? next_ipv4_shared_index(bctx) :  (size_t) client_index));
-      
-      if (! (ipv4_string = inet_ntoa (in_address)))
+      if (batch_client_ip_addr_str (bctx, client_index, ip_addr_str, 
+                                    sizeof (ip_addr_str)) == -1)
         {
-          fprintf (stderr, "%s - inet_ntoa() failed for ip_addresses of client [%d]\n", 
-                   __func__, client_index) ;
+          fprintf (stderr, 
+                   "%s - error: batch_client_ip_addr_str () - failed, client [%d]\n", 
+                   __func__, client_index);
           return -1;
         }
-    }
-  else
-    {
-      ///------------------------------------------------ IPv6 -----------------------------------------------------------------///
 
-      /* 
-         Non-shared IPv6. Advance the IPv6-address by incrementing previous address. 
-      */
-      if (!bctx->ip_shared_num)
-        {
-          if (client_index == 0)
-            {
-              memcpy (&bctx->in6_prev, &bctx->ipv6_addr_min, sizeof (bctx->in6_prev));
-              memcpy (&bctx->in6_new, &bctx->ipv6_addr_min, sizeof (bctx->in6_new));
-            }
-          else
-            {
-              if (ipv6_increment (&bctx->in6_prev, &bctx->in6_new) == -1)
-                {
-                  fprintf (stderr, "%s - ipv6_increment() failed for ip_address of client [%d]\n", 
-                           __func__, client_index) ;
-                  return -1;
-                }
-            }
-          memcpy (&bctx->in6_prev, &bctx->in6_new, sizeof (bctx->in6_prev));
-        }
-      else
-        {
-          /* Shared IP-addresses */
-          memcpy (&bctx->in6_prev, &bctx->ipv6_addr_min, sizeof (bctx->in6_prev));
-          memcpy (&bctx->in6_new, &bctx->ipv6_addr_min, sizeof (bctx->in6_new));
-          
-          size_t index_step = next_ipv6_shared_index (bctx);
-          
-          size_t k;
-          for (k = 0; k < index_step; k++)
-            {
-              if (ipv6_increment (&bctx->in6_prev, &bctx->in6_new) == -1)
-                {
-                  fprintf (stderr, "%s - ipv6_increment() failed \n", __func__) ;
-                  return -1;
-                }
-              memcpy (&bctx->in6_prev, &bctx->in6_new, sizeof (bctx->in6_prev));
-            }
-        }
-      
-      /* All IPv6 addresses */
-      if (! inet_ntop (AF_INET6, &bctx->in6_new, ipv6_string, sizeof (ipv6_string)))
+      if (add_secondary_ip_addrs (bctx->net_interface,
+                                  1, 
+                                  ip_addrs, 
+                                  bctx->cidr_netmask,
+                                  bctx->scope) == -1)
         {
-          fprintf (stderr, "%s - inet_ntoa() failed for ip_addresses of client [%d]\n", 
-                   __func__, client_index) ;
           return -1;
         }
     }
-  
-  snprintf (ipaddrstr, bctx->ipv6 ? INET6_ADDRSTRLEN : INET_ADDRSTRLEN, 
-            "%s", bctx->ipv6 ? ipv6_string : ipv4_string);
-
-  *addr_str = ipaddrstr;
 
   return 0;
 }
@@ -2149,41 +2582,15 @@ static int create_thr_subbatches (batch_context *bc_arr, int subbatches_num)
 
       bc_arr[i].cycling_completed = master.cycling_completed;
 
-      /* Zero the pointer to be initialized. */
-      bc_arr[i].multiple_handle = 0;
-
-      /* 
-         Allocate the array of IP-addresses. 
-         TODO: memory leak of ip-addresses with the batch bc_arr[0] 
-      */
+      /* Zero the pointers to be initialized. */
+      bc_arr[i].multi_handles_num = master.multi_handles_num;
+      bc_arr[i].multi_handles = 0;
 
-      bc_arr[i].ip_addr_array = 0;
+      bc_arr[i].native_engine = master.native_engine;
 
-      if (!(bc_arr[i].ip_addr_array = (char**)calloc (bc_arr[i].client_num_max,
-                                               sizeof (char *))))
-        {
-          fprintf (stderr, 
-                   "%s - error: failed to allocate array of ip-addresses for batch %d.\n", 
-                   __func__, i);
-          return -1;
-        }
-      else
-        {
-          int j;
-
-          for (j = 0; j < bc_arr[i].client_num_max; j++)
-            {
-              if (ip_addr_str_allocate_init (&bc_arr[i], j, 
-	      				     &bc_arr[i].ip_addr_array[j]) == -1)
-                {
-                  fprintf (stderr, 
-                           "%s - error: ip_addr_str_allocate_init () - failed, "
-			   "batch [%d], client [%d]\n", 
-                           __func__, i, j);
-                  return -1;
-                }
-            }
-        }
+      bc_arr[i].pipeline_depth = master.pipeline_depth;
+      bc_arr[i].http2_streams = master.http2_streams;
+      bc_arr[i].clients_balance = master.clients_balance;
 
       if (i)
       {
@@ -2194,8 +2601,7 @@ static int create_thr_subbatches (batch_context *bc_arr, int subbatches_num)
             Allocate array of client contexts
           */
           if (!(bc_arr[i].cctx_array =
-                (client_context *) cl_calloc (bc_arr[i].client_num_max, 
-                                              sizeof (client_context))))
+                client_array_alloc (bc_arr[i].client_num_max)))
           {
               fprintf (stderr, "\"%s\" - %s - failed to allocate cctx.\n", 
                        bc_arr[i].batch_name, __func__);
@@ -32,8 +32,6 @@
 
 
 #define DEFAULT_SMOOTH_URL_COMPLETION_TIME 6.0
-#define TIME_RECALCULATION_CYCLES_NUM 10
-#define TIME_RECALCULATION_MSG_NUM 100
 #define PERIODIC_TIMERS_NUMBER 2
 #define LOGFILE_TEST_TIMER_PERIOD 10 /* once in 10 seconds */
 
@@ -90,6 +88,22 @@ int setup_curl_handle_init (struct client_context*const cctx, struct url_context
 ***********************************************************************/
 int init_client_url_post_data (struct client_context* cctx, struct url_context* url);
 
+/**********************************************************************
+* Function name - init_client_formed_buffer
+*
+* Description - Initialize client buffer controlled by FORM_STRING
+* 
+* Input -       *cctx       - pointer to client context
+*               *url        - pointer to url context
+*               *buffer     - the client buffer
+*               buffer_len  - size of the client buffer
+* Return Code/Output - On Success - 0, on Error -1
+***********************************************************************/
+int init_client_formed_buffer (struct client_context* cctx, 
+                               struct url_context* url,
+                               char* buffer,
+                               size_t buffer_len);
+
 /**********************************************************************
 * Function name - response_logfiles_set
 *
@@ -164,6 +178,28 @@ int parse_config_file (char* const filename,
 int rewind_logfile_above_maxsize (FILE* filepointer);
 
 
+/****************************************************************************************
+ * Function name - client_sleeping_schedule
+ *
+ * Description - Places the client to the waiting queue of its batch to sleep
+ *               till the next loading operation
+ *
+ * Input -       *cctx     - pointer to the client context
+ *               wake_time - time in msec to schedule the client to load
+ * Return Code/Output - On success -0, on error - (-1)
+ ****************************************************************************************/
+int client_sleeping_schedule (struct client_context* cctx, unsigned long wake_time);
+
+/****************************************************************************************
+ * Function name - client_sleeping_cancel
+ *
+ * Description - Removes a sleeping client from the waiting queue of its batch
+ *
+ * Input -       *cctx - pointer to the client context
+ * Return Code/Output - On success -0, when the client is not sleeping - (-1)
+ ****************************************************************************************/
+int client_sleeping_cancel (struct client_context* cctx);
+
 /****************************************************************************************
  * Function name - pending_active_and_waiting_clients_num
  *
@@ -188,6 +224,52 @@ int pending_active_and_waiting_clients_num (struct batch_context* bctx);
  ****************************************************************************************/
 int pending_active_and_waiting_clients_num_stat (struct batch_context* bctx);
 
+/****************************************************************************************
+ * Function name - multi_handles_timeout
+ *
+ * Description - Returns the nearest libcurl timeout among all multi-handles of
+ *               the batch
+ *
+ * Input -       *bctx - pointer to the batch context
+ *
+ * Return Code/Output - The nearest timeout in msec, or -1, when no multi-handle
+ *                      has a timeout set
+ ****************************************************************************************/
+long multi_handles_timeout (struct batch_context* bctx);
+
+/****************************************************************************************
+ * Function name - multi_handles_socket_timeout
+ *
+ * Description - Lets libcurl handle timeouts of the batch multi-handles by calling
+ *               curl_multi_socket_action () with CURL_SOCKET_TIMEOUT
+ *
+ * Input -       *bctx - pointer to the batch context
+ *               expired_only - when true, only the multi-handles with an expired
+ *                              timeout are processed, otherwise - all
+ *
+ * Return Code/Output - none
+ ****************************************************************************************/
+void multi_handles_socket_timeout (struct batch_context* bctx, int expired_only);
+
+/****************************************************************************************
+ * Function name - multi_handles_info_read
+ *
+ * Description - Reads the next completion message of the batch multi-handles.
+ *               Drains the multi-handles one after another, starting from 
+ *               the multi-handle with index *shard.
+ *
+ * Input -       *bctx - pointer to the batch context
+ *               *shard - index of the multi-handle to read; advanced, when the
+ *                        multi-handle has no more messages. Initialize to 0.
+ *               *msg_num - number of messages remaining in the multi-handle
+ *
+ * Return Code/Output - On success - pointer to the message, when no more
+ *                      messages - 0
+ ****************************************************************************************/
+CURLMsg* multi_handles_info_read (struct batch_context* bctx, 
+                                  int* shard, 
+                                  int* msg_num);
+
 /****************************************************************************************
  * Function name - load_next_step
  *
@@ -318,6 +400,28 @@ int user_activity_hyper (struct client_context*const cctx_array);
 ****************************************************************************************/
 int user_activity_smooth (struct client_context*const cctx_array);
 
+/*-------------- Epoll-mode loading function ----------------*/
+
+/****************************************************************************************
+* Function name - user_activity_epoll
+*
+* Description - Simulates user-activities using EPOLL-MODE
+* Input -       *cctx_array - array of client contexts (related to a certain batch of clients)
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int user_activity_epoll (struct client_context*const cctx_array);
+
+/*-------------- io_uring-mode loading function ----------------*/
+
+/****************************************************************************************
+* Function name - user_activity_uring
+*
+* Description - Simulates user-activities using IO_URING-MODE
+* Input -       *cctx_array - array of client contexts (related to a certain batch of clients)
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int user_activity_uring (struct client_context*const cctx_array);
+
 
 
 int update_url_from_set_or_template (CURL* handle, struct client_context* client, struct url_context* url);
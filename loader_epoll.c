@@ -0,0 +1,630 @@
+/*
+ *     loader_epoll.c
+ *
+ * 2006-2007 Copyright (c)
+ * Michael Moser, <moser.michael@gmail.com>
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Native epoll loading engine: the same curl_multi_socket_action ()
+ * machinery as in hyper-mode, but without libevent layer in between.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/epoll.h>
+
+#include "batch.h"
+#include "client.h"
+#include "loader.h"
+#include "conf.h"
+#include "cl_alloc.h"
+#include "balance.h"
+#include "standby.h"
+#include "mpool.h"
+#include "screen.h"
+#include "native_http.h"
+
+
+/* Maximum number of events fetched by a single epoll_wait () call */
+#define EPOLL_EVENTS_BATCH 4096
+
+/* The longest sleep in epoll_wait (), msec */
+#define EPOLL_MAX_TIMEOUT 1000
+
+
+#if 0
+#define PRINTF(args...) fprintf(stdout, ## args);
+#else
+#define PRINTF(args...)
+#endif
+
+
+/*
+  Socket information kept per each socket, that libcurl asks us to watch.
+  Assigned to the socket by curl_multi_assign () and passed back to us
+  by libcurl in socket callback as well as by the kernel in epoll_data.
+*/
+typedef struct sock_info_epoll
+{
+  /* Allocatable property to be kept in mpool. Must be the first field. */
+  allocatable alloc;
+
+  curl_socket_t sockfd;
+
+  int action;  /*CURL_POLL_IN CURL_POLL_OUT */
+
+  /* When true, the socket is registered with epoll */
+  int added;
+
+  /* The multi-handle, owning the socket */
+  CURLM* multi;
+
+} sock_info_epoll;
+
+
+static int mget_url_epoll (batch_context* bctx);
+static int mperform_epoll (batch_context* bctx, unsigned long* now_time);
+static int epoll_timeout (batch_context* bctx, unsigned long now_time);
+
+
+/************************************************************************
+ * Function name - setsock_epoll
+ *
+ * Description - Registers a socket with epoll or modifies the events of
+ *               interest of an already registered socket. A single epoll_ctl ()
+ *               system call per interest change.
+ *
+ * Input -       *bctx - pointer to batch context
+ *               *sinfo - pointer to sinfo structure of the socket
+ *               socket - socket descriptor
+ *               action - bitmask of events from curl library
+ * Return Code/Output - On Success - 0, on Error -1
+ *************************************************************************/
+static int setsock_epoll (batch_context* bctx,
+                          sock_info_epoll* sinfo,
+                          curl_socket_t socket,
+                          int action)
+{
+  struct epoll_event ev;
+  int op = sinfo->added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+  if (sinfo->added && sinfo->sockfd == socket && sinfo->action == action)
+    {
+      return 0;
+    }
+
+  memset (&ev, 0, sizeof (ev));
+
+  /*
+     Sockets of libcurl are level-triggered. For plain HTTP libcurl reads a 
+     single buffer per curl_multi_socket_action () and does not drain the 
+     socket till EAGAIN, thus an edge would be lost with the rest of a larger 
+     response. Libcurl also advances only one of the pipelined transfers, 
+     sharing a socket, per event. Only the native engine, reading till EAGAIN, 
+     registers its sockets edge-triggered (see native_http.c).
+  */
+  ev.events = 
+    (action & CURL_POLL_IN ? EPOLLIN : 0) |
+    (action & CURL_POLL_OUT ? EPOLLOUT : 0);
+  ev.data.ptr = sinfo;
+
+  sinfo->sockfd = socket;
+  sinfo->action = action;
+
+  if (epoll_ctl (bctx->epoll_fd, op, socket, &ev) == -1)
+    {
+      /*
+         The descriptor has been closed and re-used behind our back, or
+         the kernel has forgotten it on close (). Retry with the other op.
+      */
+      if (errno == ENOENT || errno == EEXIST)
+        {
+          op = (errno == ENOENT) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+
+          if (epoll_ctl (bctx->epoll_fd, op, socket, &ev) == -1)
+            {
+              fprintf (stderr, "%s - error: epoll_ctl () failed with errno %d.\n",
+                       __func__, errno);
+              return -1;
+            }
+        }
+      else
+        {
+          fprintf (stderr, "%s - error: epoll_ctl () failed with errno %d.\n",
+                   __func__, errno);
+          return -1;
+        }
+    }
+
+  sinfo->added = 1;
+  return 0;
+}
+
+/************************************************************************
+ * Function name - remsock_epoll
+ *
+ * Description - Unregisters a socket from epoll and returns its sock_info
+ *               structure to the memory pool
+ * Input -       *bctx - pointer to batch context
+ *               *sinfo - pointer to sinfo structure
+ * Return Code/Output - None
+ *************************************************************************/
+static void remsock_epoll (batch_context* bctx, sock_info_epoll* sinfo)
+{
+  if (sinfo->added)
+    {
+      /* The socket may be already closed by libcurl, ignore errors */
+      epoll_ctl (bctx->epoll_fd, EPOLL_CTL_DEL, sinfo->sockfd, 0);
+    }
+
+  /*
+     Events for the socket, which are still in the current epoll_wait ()
+     batch, are to be skipped.
+  */
+  sinfo->sockfd = CURL_SOCKET_BAD;
+  sinfo->action = 0;
+  sinfo->added = 0;
+
+  mpool_return_obj (bctx->sock_info_mpool, (allocatable *) sinfo);
+}
+
+/************************************************************************
+ * Function name - socket_callback_epoll
+ *
+ * Description - A libcurl socket callback. Called by libcurl, when libcurl
+ *               wishes to change the events of interest of a socket.
+ *
+ * Input -       *handle - pointer to CURL handle
+ *               socket - socket descriptor
+ *               what - libcurl event bitmask
+ *               *cbp - libcurl callback pointer; we pass batch context here
+ *               *sockp - pointer to the socket user-assigned private data,
+ *                        here sock_info_epoll
+ * Return Code/Output - Always 0
+ *************************************************************************/
+static int socket_callback_epoll (CURL *handle,
+                                  curl_socket_t socket,
+                                  int what,
+                                  void *cbp,
+                                  void *sockp)
+{
+  batch_context* bctx = (batch_context *) cbp;
+  sock_info_epoll* sinfo = (sock_info_epoll *) sockp;
+  client_context* cctx = NULL;
+  char* priv = NULL;
+
+  PRINTF("socket_callback_epoll: sock=%d what=%d sinfo=%p\n", socket, what, sinfo);
+
+  if (what == CURL_POLL_REMOVE)
+    {
+      if (sinfo)
+        {
+          curl_multi_assign (sinfo->multi, socket, 0);
+          remsock_epoll (bctx, sinfo);
+        }
+      return 0;
+    }
+
+  if (!sinfo)
+    {
+      curl_easy_getinfo (handle, CURLINFO_PRIVATE, &priv);
+      cctx = (client_context *) priv;
+
+      if (!cctx)
+        {
+          fprintf (stderr, "%s - error: cctx is a NULL pointer.\n", __func__);
+          return 0;
+        }
+
+      if (! (sinfo = (sock_info_epoll *) mpool_take_obj (bctx->sock_info_mpool)))
+        {
+          fprintf (stderr, "%s - error: allocation of sock_info failed.\n", __func__);
+          return 0;
+        }
+
+      sinfo->sockfd = socket;
+      sinfo->action = 0;
+      sinfo->added = 0;
+      sinfo->multi = cctx->multi_handle;
+
+      curl_multi_assign (sinfo->multi, socket, sinfo);
+    }
+
+  setsock_epoll (bctx, sinfo, socket, what);
+
+  return 0;
+}
+
+/****************************************************************************************
+ * Function name - user_activity_epoll
+ *
+ * Description - Simulates user-activities using EPOLL mode
+ * Input -       *cctx_array - array of client contexts (related to a certain batch of clients)
+ *
+ * Return Code/Output - On Success - 0, on Error -1
+ ****************************************************************************************/
+int user_activity_epoll (client_context* cctx_array)
+{
+  batch_context* bctx = cctx_array->bctx;
+  int rval = 0, m;
+
+  if (!bctx)
+    {
+      fprintf (stderr, "%s - error: bctx is a NULL pointer.\n", __func__);
+      return -1;
+    }
+
+  if ((bctx->epoll_fd = epoll_create (bctx->client_num_max + 1)) == -1)
+    {
+      fprintf (stderr, "%s - error: epoll_create () failed with errno %d.\n",
+               __func__, errno);
+      return -1;
+    }
+
+  if (! (bctx->sock_info_mpool = cl_calloc (1, sizeof (mpool))))
+    {
+      fprintf (stderr, "%s - error: allocation of sock_info_mpool failed.\n", __func__);
+      return -1;
+    }
+
+  if (mpool_init (bctx->sock_info_mpool,
+                  sizeof (sock_info_epoll),
+                  bctx->client_num_max) == -1)
+    {
+      fprintf (stderr, "%s - error: mpool_init () failed.\n", __func__);
+      return -1;
+    }
+
+  if (native_http_init (bctx) == -1)
+    {
+      fprintf (stderr, "%s - error: native_http_init () failed.\n", __func__);
+      return -1;
+    }
+
+  /* Set the socket callback on multi-handles */
+  for (m = 0; m < bctx->multi_handles_num; m++)
+    {
+      curl_multi_setopt (bctx->multi_handles[m],
+                         CURLMOPT_SOCKETFUNCTION,
+                         socket_callback_epoll);
+
+      curl_multi_setopt (bctx->multi_handles[m], CURLMOPT_SOCKETDATA, bctx);
+    }
+
+  if (alloc_init_timer_waiting_queue (
+                                      bctx->client_num_max + PERIODIC_TIMERS_NUMBER + 1,
+                                      &bctx->waiting_queue) == -1)
+    {
+      fprintf (stderr, "%s - error: failed to alloc or init timer waiting queue.\n", __func__);
+      return -1;
+    }
+
+  const unsigned long now_time = get_tick_count ();
+
+  if (init_timers_and_add_initial_clients_to_load (bctx,
+                                                   now_time) == -1)
+    {
+      fprintf (stderr,
+               "%s - error: init_timers_and_add_initial_clients_to_load () failed.\n",
+               __func__);
+      return -1;
+    }
+
+  if (is_batch_group_leader (bctx))
+    {
+      dump_snapshot_interval (bctx, now_time);
+    }
+
+  /*
+     ========= Run the loading machinery ================
+  */
+  if (mget_url_epoll (bctx) == -1)
+    {
+      fprintf (stderr, "%s error: mget_url () failed.\n", __func__) ;
+      rval = -1;
+    }
+
+  dump_final_statistics (cctx_array);
+  screen_release ();
+
+  /*
+     ======= Release resources =========================
+  */
+  if (bctx->waiting_queue)
+    {
+      /* Cancel periodic timers */
+      cancel_periodic_timers (bctx);
+
+      tq_release (bctx->waiting_queue);
+      free (bctx->waiting_queue);
+      bctx->waiting_queue = 0;
+    }
+
+  native_http_release (bctx);
+
+  close (bctx->epoll_fd);
+  bctx->epoll_fd = -1;
+
+  mpool_free (bctx->sock_info_mpool);
+  free (bctx->sock_info_mpool);
+  bctx->sock_info_mpool = 0;
+
+  return rval;
+}
+
+/****************************************************************************************
+ * Function name - mget_url_epoll
+ *
+ * Description - Performs actual fetching of urls for a whole batch. Waits in
+ *               epoll_wait () for socket events or for the nearest timeout either of
+ *               libcurl or of the waiting queue, passes the events to libcurl using
+ *               curl_multi_socket_action () and acts further using mperform_epoll ().
+ *
+ * Input -       *bctx - pointer to the batch of contexts
+ *
+ * Return Code/Output - On Success - 0, on Error -1
+ ****************************************************************************************/
+static int mget_url_epoll (batch_context* bctx)
+{
+  struct epoll_event* events = 0;
+  unsigned long now_time = get_tick_count ();
+  int still_running = 0;
+  int i, n;
+
+  if (! (events = cl_calloc (EPOLL_EVENTS_BATCH, sizeof (struct epoll_event))))
+    {
+      fprintf (stderr, "%s - error: allocation of events failed.\n", __func__);
+      return -1;
+    }
+
+  /* Start the initially scheduled clients */
+  multi_handles_socket_timeout (bctx, 0);
+
+  while (pending_active_and_waiting_clients_num (bctx) ||
+         bctx->do_client_num_gradual_increase ||
+         clients_balance_keep_loading (bctx) ||
+         threads_standby_keep_loading (bctx))
+    {
+      n = epoll_wait (bctx->epoll_fd,
+                      events,
+                      EPOLL_EVENTS_BATCH,
+                      epoll_timeout (bctx, now_time));
+
+      if (n == -1)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+
+          fprintf (stderr, "%s - error: epoll_wait () failed with errno %d.\n",
+                   __func__, errno);
+          free (events);
+          return -1;
+        }
+
+      /* Refresh the cached clock once per loop iteration */
+      now_time = get_tick_count ();
+
+      for (i = 0; i < n; i++)
+        {
+          sock_info_epoll* sinfo = (sock_info_epoll *) events[i].data.ptr;
+          int bitset = 0;
+
+          if (bctx->native)
+            {
+              /* All sockets of the batch belong to the native engine */
+              if (native_http_event (bctx, events[i].data.u64,
+                                     events[i].events, now_time) == -1)
+                {
+                  fprintf (stderr, "%s - error: native_http_event () failed.\n",
+                           __func__);
+                  free (events);
+                  return -1;
+                }
+              continue;
+            }
+
+          if (sinfo->sockfd == CURL_SOCKET_BAD)
+            {
+              continue; /* removed while processing the previous events */
+            }
+
+          if (events[i].events & (EPOLLIN | EPOLLHUP))
+            {
+              bitset |= CURL_CSELECT_IN;
+            }
+          if (events[i].events & EPOLLOUT)
+            {
+              bitset |= CURL_CSELECT_OUT;
+            }
+          if (events[i].events & EPOLLERR)
+            {
+              bitset |= CURL_CSELECT_ERR;
+            }
+
+          curl_multi_socket_action (sinfo->multi,
+                                    sinfo->sockfd,
+                                    bitset,
+                                    &still_running);
+        }
+
+      if (bctx->native)
+        {
+          if (native_http_pending (bctx) &&
+              native_http_dispatch_failed (bctx, now_time) == -1)
+            {
+              fprintf (stderr, "%s - error: native_http_dispatch_failed () failed.\n",
+                       __func__);
+              free (events);
+              return -1;
+            }
+        }
+      else
+        {
+          multi_handles_socket_timeout (bctx, 1);
+        }
+
+      if (mperform_epoll (bctx, &now_time) == -1)
+        {
+          fprintf (stderr, "%s - error: mperform_epoll () failed.\n", __func__);
+          free (events);
+          return -1;
+        }
+    }
+
+  free (events);
+  return 0;
+}
+
+/****************************************************************************************
+ * Function name - epoll_timeout
+ *
+ * Description - Calculates timeout for epoll_wait () as the nearest of libcurl
+ *               timeout and the nearest timer in the batch waiting queue.
+ *
+ * Input -       *bctx    - pointer to the batch of contexts
+ *               now_time - current time in msec
+ *
+ * Return Code/Output - Timeout in msec
+ ****************************************************************************************/
+static int epoll_timeout (batch_context* bctx, unsigned long now_time)
+{
+  long timeout = EPOLL_MAX_TIMEOUT;
+  const long curl_timeout = multi_handles_timeout (bctx);
+
+  if (curl_timeout >= 0 && curl_timeout < timeout)
+    {
+      timeout = curl_timeout;
+    }
+
+  if (native_http_pending (bctx))
+    {
+      timeout = 0;
+    }
+
+  if (! tq_empty (bctx->waiting_queue))
+    {
+      const unsigned long time_nearest =
+        tq_time_to_nearest_timer (bctx->waiting_queue);
+
+      if (time_nearest <= now_time)
+        {
+          timeout = 0;
+        }
+      else if ((long) (time_nearest - now_time) < timeout)
+        {
+          timeout = (long) (time_nearest - now_time);
+        }
+    }
+
+  return (int) timeout;
+}
+
+/****************************************************************************************
+ * Function name - mperform_epoll
+ *
+ * Description - Uses curl_multi_info_read () to test url-fetch completion events and
+ *               to proceed with the next step for the client, using load_next_step ().
+ *               Dispatches expired timers of the waiting queue and kicks libcurl to start
+ *               the newly scheduled clients. Cares about statistics at certain timeouts.
+ *
+ * Input -       *bctx - pointer to the batch of contexts;
+ * Input/Output  *now_time - current time in msec
+ *
+ * Return Code/Output - On Success - 0, on Error -1
+ ****************************************************************************************/
+static int mperform_epoll (batch_context* bctx, unsigned long* now_time)
+{
+  int msg_num = 0, shard = 0;
+  const int snapshot_timeout = snapshot_statistics_timeout*1000;
+  CURLMsg *msg;
+  int scheduled_now_count = 0, scheduled_now = 0;
+
+  /* Threads other than the leader publish their statistics for it */
+  stat_publish (bctx, *now_time, 0);
+
+  if ((long)(*now_time - bctx->last_measure) > snapshot_timeout)
+    {
+      if (is_batch_group_leader (bctx))
+        {
+          dump_snapshot_interval (bctx, *now_time);
+        }
+    }
+
+  while( (msg = multi_handles_info_read (bctx, &shard, &msg_num)) != 0)
+    {
+      if (msg->msg == CURLMSG_DONE)
+        {
+          CURL *handle = msg->easy_handle;
+          client_context *cctx = NULL;
+          char* priv = NULL;
+
+          curl_easy_getinfo (handle, CURLINFO_PRIVATE, &priv);
+          cctx = (client_context *) priv;
+
+          if (!cctx)
+            {
+              fprintf (stderr, "%s - error: cctx is a NULL pointer.\n", __func__);
+              return -1;
+            }
+
+          if (msg->data.result)
+            {
+              cctx->client_state = CSTATE_ERROR;
+            }
+
+
+          /*
+            Load next step only if request rate is not specified.
+            Otherwise requests are made on a timer.
+          */
+          if (bctx->req_rate)
+            {
+              if (put_free_client(cctx) < 0)
+                {
+                  fprintf (stderr, "%s error: cannot free a client.\n",
+                           __func__);
+                  return -1;
+                }
+            }
+          else
+            {
+              load_next_step (cctx, *now_time, &scheduled_now);
+
+              if (scheduled_now)
+                {
+                  scheduled_now_count++;
+                }
+            }
+        }
+    }
+
+  if (dispatch_expired_timers (bctx, *now_time) > 0 || scheduled_now_count)
+    {
+      /*
+         Newly added handles have their libcurl timeouts already expired.
+      */
+      multi_handles_socket_timeout (bctx, 0);
+    }
+
+  return 0;
+}
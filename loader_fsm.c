@@ -30,9 +30,13 @@
 #include "loader.h"
 #include "batch.h"
 #include "conf.h"
-#include "heap.h"
+#include "timer_queue.h"
 #include "screen.h"
 #include "cl_alloc.h"
+#include "native_http.h"
+#include "balance.h"
+#include "standby.h"
+#include "handle_pool.h"
 
 /*
    Number of request rate timer invocations per second used to
@@ -104,6 +108,7 @@ static int fetching_decision (client_context* cctx, url_context* url);
 static int orderly_sched_clients (batch_context* bctx, int clients_to_sched);
 static int req_rate_sched_clients (batch_context* bctx);
 static int get_free_client (batch_context* bctx, client_context **pcctx);
+static void loading_stop_check (batch_context* bctx);
 
 
 
@@ -124,7 +129,7 @@ int alloc_init_timer_waiting_queue (size_t size, timer_queue** wq)
 
   *wq = NULL;
 
-  if (! (tq = cl_calloc (1, sizeof (heap))))
+  if (! (tq = cl_calloc (1, tq_object_size ())))
     {
       fprintf (stderr, "%s - error: failed to allocate queue.\n", __func__);
       return -1;
@@ -180,7 +185,7 @@ int init_timers_and_add_initial_clients_to_load (batch_context* bctx,
 #if 0
    else
     {
-     fprintf (cctx->file_output, "SCHED: %s - logfile_timer_id is %ld.\n", 
+     fprintf (cctx->cold->file_output, "SCHED: %s - logfile_timer_id is %ld.\n", 
    __func__, logfile_timer_id);
     }
 #endif
@@ -200,13 +205,13 @@ int init_timers_and_add_initial_clients_to_load (batch_context* bctx,
 #if 0  
   else
     {
-     fprintf (cctx->file_output, "SCHED: %s - screen_input_timer_id is %ld.\n", 
+     fprintf (cctx->cold->file_output, "SCHED: %s - screen_input_timer_id is %ld.\n", 
               __func__, screen_input_timer_id);
     }
 #endif
 
   bctx->start_time = bctx->last_measure = now_time;
-  bctx->active_clients_count = bctx->sleeping_clients_count =0;
+  bctx->rt->active_clients_count = bctx->rt->sleeping_clients_count =0;
 
 
   if (add_loading_clients (bctx) == -1)
@@ -215,7 +220,9 @@ int init_timers_and_add_initial_clients_to_load (batch_context* bctx,
       return -1;
     }
 
-  if (bctx->do_client_num_gradual_increase)
+  /* A thread on standby from the start has its ramp-up paused */
+  if (bctx->do_client_num_gradual_increase || 
+      (bctx->standby_on && bctx->clients_rampup_inc))
     {
       /* 
          Schedule the gradual loading clients increase timer.
@@ -235,7 +242,7 @@ int init_timers_and_add_initial_clients_to_load (batch_context* bctx,
 #if 0
       else
         {
-         fprintf (cctx->file_output, "SCHED: %s - clients_num_inc_id is %ld.\n", 
+         fprintf (cctx->cold->file_output, "SCHED: %s - clients_num_inc_id is %ld.\n", 
                   __func__, clients_num_inc_id);
         }
 #endif
@@ -258,6 +265,12 @@ int init_timers_and_add_initial_clients_to_load (batch_context* bctx,
           return -1;
         }
     }
+
+  if (clients_balance_start (bctx, now_time) == -1)
+    {
+      fprintf (stderr, "%s - error: clients_balance_start () failed.\n", __func__);
+      return -1;
+    }
   return 0;
 }
 
@@ -299,6 +312,13 @@ int cancel_periodic_timers (batch_context* bctx)
       bctx->req_rate_timer_node.timer_id = -1;
     }
 
+  if (bctx->clients_balance && bctx->balance_timer_node.timer_id != -1)
+    {
+      tq_cancel_timer (bctx->waiting_queue, 
+                       bctx->balance_timer_node.timer_id);
+      bctx->balance_timer_node.timer_id = -1;
+    }
+
   return 0;
 }
 
@@ -334,7 +354,7 @@ int load_next_step (client_context* cctx,
 #if 0
       if (cctx->tid_url_completion ==  clients_num_inc_id)
       {
-          fprintf (cctx->file_output, 
+          fprintf (cctx->cold->file_output, 
                    "SCHED: %s - cctx->tid_url_completion ==  clients_num_inc_id.\n", 
                    __func__);
       }
@@ -347,6 +367,14 @@ int load_next_step (client_context* cctx,
   /* Remove handle from the multiple handle, if it was added there before. */
   if (cctx->client_state != CSTATE_INIT)
     {
+      if ((bctx->pipeline_depth > 0 || bctx->http2_streams > 0) && !bctx->native)
+        {
+          /* The request completed is still counted as in flight */
+          op_stat_pipe_sample (&bctx->rt->op_delta,
+                               bctx->rt->active_clients_count,
+                               bctx->rt->pipe_connections_open);
+        }
+
       if (client_remove_from_load (bctx, cctx) == -1)
         {
           fprintf (stderr, "%s - client_remove_from_load () failed.\n", __func__);
@@ -362,7 +390,8 @@ int load_next_step (client_context* cctx,
      Therefore, remembering here possible error state.
   */
   int recoverable_error_state = cctx->client_state;
-  if (bctx->run_time && (now_time - bctx->start_time >= bctx->run_time))
+  if (bctx->stopping ||
+      (bctx->run_time && (now_time - bctx->start_time >= bctx->run_time)))
     {
       rval_load = CSTATE_FINISHED_OK;
       bctx->requests_completed = 1;
@@ -379,7 +408,7 @@ int load_next_step (client_context* cctx,
   /* 
      Update operational statistics 
   */
-  op_stat_update (&bctx->op_delta, 
+  op_stat_update (&bctx->rt->op_delta, 
                   (recoverable_error_state == CSTATE_ERROR) ? 
 		  	recoverable_error_state : rval_load, 
                   cctx->preload_state,
@@ -389,7 +418,7 @@ int load_next_step (client_context* cctx,
   if (fetching_first_cycling_url (cctx))
     {
       /* Update CAPS numbers */
-      op_stat_call_init_count_inc (&bctx->op_delta);
+      op_stat_call_init_count_inc (&bctx->rt->op_delta);
     }
 
   /*
@@ -405,23 +434,17 @@ int load_next_step (client_context* cctx,
         clients in the batch from connecting to the server. If we wait until the end-of-batch
         general cleanup to close connections, then these other clients may never connect, and
         the only way the batch will end is to have all these waiting clients time out. So we
-        should close out this client's connections here. Setting client->handle = 0 will prevent
-        curl_easy_cleanup from being called again in the general cleanup.
+        should close out this client's connections here. The handle is returned to the
+        pool for other clients and the client takes another one, when recovered.
       */
-      // cleanup of each handle is a hint to multi-handle to 
-      // decrease the num of connections to server
-      if (cctx->handle)
-      {
-          curl_easy_cleanup (cctx->handle);
-          cctx->handle = 0;
-      }
+      handle_pool_return (cctx, 0);
 
-      if (rval_load == CSTATE_ERROR)
+      /* The same for the native engine connection */
+      if (bctx->native)
       {
-          // Re-init clients in CSTATE_ERROR state to enable their optional
-          // scheduling
-          cctx->handle = curl_easy_init ();
+          native_http_stop (cctx, 1);
       }
+
       return rval_load;
   }
 
@@ -452,24 +475,11 @@ int load_next_step (client_context* cctx,
          Postpone client scheduling for the interleave_waiting_time msec by 
          placing it to the timer queue. Schedule the timer now.
       */
-      cctx->tn.next_timer = now_time + interleave_waiting_time;
-      cctx->tn.period = 0;
-      cctx->tn.func_timer = handle_cctx_sleeping_timer;
-		
-      if ((cctx->tid_sleeping = tq_schedule_timer (bctx->waiting_queue, 
-                                             (struct timer_node *) cctx)) == -1)
+      if (client_sleeping_schedule (cctx, now_time + interleave_waiting_time) == -1)
         {
-          fprintf (stderr, "%s - error: tq_schedule_timer () failed.\n", __func__);
+          fprintf (stderr, "%s - error: client_sleeping_schedule () failed.\n", __func__);
           return -1;
         }
-      else
-        {
-#if 0
-          fprintf (cctx->file_output, "SCHED: %s - cctx->tid_sleeping is %ld.\n", 
-                   __func__, cctx->tid_sleeping);
-#endif
-           bctx->sleeping_clients_count++;
-        }
 #if 0
       fprintf (stderr, "%s - scheduled client to wq with wtime %ld\n", 
        __func__, interleave_waiting_time);
@@ -479,6 +489,62 @@ int load_next_step (client_context* cctx,
   return rval_load;
 }
 
+/******************************************************************************
+ * Function name - client_sleeping_schedule
+ *
+ * Description - Places the client to the waiting queue of its batch to sleep
+ *               till the next loading operation
+ *
+ * Input -       *cctx     - pointer to the client context
+ *               wake_time - time in msec to schedule the client to load
+ * Return Code/Output - On success -0, on error - (-1)
+ *******************************************************************************/
+int client_sleeping_schedule (client_context* cctx, unsigned long wake_time)
+{
+  batch_context* bctx = cctx->bctx;
+
+  cctx->tn.next_timer = wake_time;
+  cctx->tn.period = 0;
+  cctx->tn.func_timer = handle_cctx_sleeping_timer;
+		
+  if ((cctx->tid_sleeping = tq_schedule_timer (bctx->waiting_queue, 
+                                               (struct timer_node *) cctx)) == -1)
+    {
+      fprintf (stderr, "%s - error: tq_schedule_timer () failed.\n", __func__);
+      return -1;
+    }
+
+#if 0
+  fprintf (cctx->cold->file_output, "SCHED: %s - cctx->tid_sleeping is %ld.\n", 
+           __func__, cctx->tid_sleeping);
+#endif
+  bctx->rt->sleeping_clients_count++;
+
+  return 0;
+}
+
+/******************************************************************************
+ * Function name - client_sleeping_cancel
+ *
+ * Description - Removes a sleeping client from the waiting queue of its batch
+ *
+ * Input -       *cctx - pointer to the client context
+ * Return Code/Output - On success -0, when the client is not sleeping - (-1)
+ *******************************************************************************/
+int client_sleeping_cancel (client_context* cctx)
+{
+  batch_context* bctx = cctx->bctx;
+
+  if (cctx->tid_sleeping == -1)
+    return -1;
+
+  tq_cancel_timer (bctx->waiting_queue, cctx->tid_sleeping);
+  cctx->tid_sleeping = -1;
+  bctx->rt->sleeping_clients_count--;
+
+  return 0;
+}
+
 /******************************************************************************
  * Function name - add_loading_clients
  *
@@ -496,11 +562,12 @@ int add_loading_clients (batch_context* bctx)
 
   /* 
      Return, if initial gradual scheduling of all new clients has been stopped
+     or paused by standby of the thread.
   */
-  if (bctx->stop_client_num_gradual_increase)
+  if (bctx->stop_client_num_gradual_increase || bctx->standby_on)
     {
  #if 0
-      fprintf (cctx->file_output, 
+      fprintf (cctx->cold->file_output, 
                "SCHED: %s - returning on zero >stop_client_num_gradual_increase.\n", 
               __func__);
  #endif
@@ -514,7 +581,7 @@ int add_loading_clients (batch_context* bctx)
     {
       bctx->do_client_num_gradual_increase = 0;
 #if 0
-      fprintf (cctx->file_output, 
+      fprintf (cctx->cold->file_output, 
                "SCHED: do_client_num_gradual_increase = 0 on client_num_max %d" 
               " and clients_current_sched_num %d \n", 
               bctx->client_num_max, bctx->clients_current_sched_num);
@@ -538,7 +605,7 @@ int add_loading_clients (batch_context* bctx)
 
   //fprintf (stderr, "%s - adding %ld clients.\n", __func__, clients_to_sched);
 #if 0
-  fprintf (cctx->file_output, 
+  fprintf (cctx->cold->file_output, 
            "SCHED: clients_to_sched %ld, bctx->clients_current_sched_num %d.\n", 
            clients_to_sched, bctx->clients_current_sched_num);
 #endif
@@ -683,13 +750,25 @@ static int client_add_to_load (batch_context* bctx,
                                client_context* cctx,
                                unsigned long now_time)
 {
+  /* A thread on standby parks the client instead of starting its request */
+  if (bctx->standby_on)
+    {
+      threads_standby_park (cctx);
+      return 0;
+    }
+
+  /* A stopping thread does not start new requests */
+  if (bctx->stopping)
+    return 0;
+
   /* Remember the previous state and url index: fur operational statistics */
   cctx->preload_state = cctx->client_state;
   cctx->preload_url_curr_index = cctx->url_curr_index;
 
   /* Schedule the client immediately */
-  cctx->req_sent_timestamp = now_time;
-  if (curl_multi_add_handle (bctx->multiple_handle, cctx->handle) ==  CURLM_OK)
+  cctx->req_sent_timestamp = cached_tick_count_usec ();
+  if (bctx->native ? native_http_start (cctx) == 0 :
+      curl_multi_add_handle (cctx->multi_handle, cctx->handle) ==  CURLM_OK)
     {
       unsigned long timer_url_completion = 0;
 
@@ -721,19 +800,20 @@ static int client_add_to_load (batch_context* bctx,
 #if 0
           else
            {
-             fprintf (cctx->file_output, 
+             fprintf (cctx->cold->file_output, 
                       "SCHED: %s - cctx->tid_url_completion is %ld.\n", 
                        __func__, cctx->tid_url_completion);
            }
 #endif
         }
 
-      bctx->active_clients_count++;
+      bctx->rt->active_clients_count++;
       // fprintf (stderr, "%s - client added.\n", __func__);
     }
   else
     {
-      fprintf (stderr, "%s - curl_multi_add_handle () failed.\n", __func__);
+      fprintf (stderr, "%s - %s failed.\n", __func__, 
+               bctx->native ? "native_http_start ()" : "curl_multi_add_handle ()");
       return -1;
     }
 
@@ -744,8 +824,8 @@ static int client_add_to_load (batch_context* bctx,
  * Function name - client_remove_from_load
  *
  * Description - Removes client context to from the kept in batch context 
- * 		 multiple handle, thus, removing the client from the loading 
- * 		 machinery
+ * 		 multiple handle or from the native engine, thus, removing 
+ * 		 the client from the loading machinery
  *
  * Input -       *bctx - pointer to the batch context
  *               *cctx - pointer to the client context
@@ -753,20 +833,22 @@ static int client_add_to_load (batch_context* bctx,
  *****************************************************************************/
 static int client_remove_from_load (batch_context* bctx, client_context* cctx)
 {
-  if (curl_multi_remove_handle (bctx->multiple_handle, cctx->handle) == CURLM_OK)
+  if (bctx->native)
     {
-      if (bctx->active_clients_count > 0)
-        {
-          bctx->active_clients_count--;
-        }
-      //fprintf (stderr, "%s - client removed.\n", __func__);
+      /* Aborts an unfinished request, the connection is kept alive */
+      native_http_stop (cctx, 0);
     }
-  else
+  else if (curl_multi_remove_handle (cctx->multi_handle, cctx->handle) != CURLM_OK)
     {
       fprintf (stderr, "%s - curl_multi_remove_handle () failed.\n", __func__);
       return -1;
     }
 
+  if (bctx->rt->active_clients_count > 0)
+    {
+      bctx->rt->active_clients_count--;
+    }
+
   return 0;	
 }
 
@@ -792,20 +874,20 @@ static int handle_gradual_increase_clients_num_timer (timer_node* timer_node,
 
   //client_context* cctx = bctx->cctx_array;
 
-  //fprintf (cctx->file_output, "SCHED: %s - entered.\n", __func__);
+  //fprintf (cctx->cold->file_output, "SCHED: %s - entered.\n", __func__);
 
   if (add_loading_clients (bctx) == -1)
     {
       //fprintf (stderr, "%s add_loading_clients () returns -1.\n", __func__);
 #if 0
-      fprintf (cctx->file_output, 
+      fprintf (cctx->cold->file_output, 
                "SCHED: %s - add_loading_clients failed.\n", 
                __func__);
 #endif
       return -1;
     }
 
-  //fprintf (cctx->file_output, "SCHED: %s - returning 0.\n", __func__);
+  //fprintf (cctx->cold->file_output, "SCHED: %s - returning 0.\n", __func__);
   //fprintf (stderr, "%s - runs.\n", __func__);
   return 0;
 }
@@ -828,7 +910,7 @@ static int handle_logfile_rewinding_timer (timer_node* timer_node,
   (void) timer_node;
   (void) ulong_param;
 
-  if (rewind_logfile_above_maxsize (bctx->cctx_array->file_output) == -1)
+  if (rewind_logfile_above_maxsize (bctx->cctx_array->cold->file_output) == -1)
     {
       fprintf (stderr, "%s - rewind_logfile_above_maxsize() failed .\n", 
       	__func__);
@@ -858,7 +940,16 @@ static int handle_screen_input_timer (timer_node* timer_node,
   (void) timer_node;
   (void) ulong_param;
 
-  screen_test_keyboard_input (bctx);
+  /* With the statistics thread the input is read by it and posted to the thread */
+  if (stat_thread_enabled)
+    screen_apply_keyboard_input (bctx);
+  else
+    screen_test_keyboard_input (bctx);
+
+  /* Standby of the thread, requested by the statistics thread */
+  threads_standby_check (bctx);
+
+  loading_stop_check (bctx);
 
   //fprintf (stderr, "%s - runs.\n", __func__);
   return 0;
@@ -873,7 +964,7 @@ static int handle_screen_input_timer (timer_node* timer_node,
  *
  * Input -       *tn          - pointer to timer node structure
  *               *pvoid_param - pointer to some extra data; here batch context
- *               *ulong_param - some extra data.
+ *               ulong_param  - current time in msec
  * Return Code/Output - On success -0, on error - (-1)
  ***************************************************************************/
 int handle_cctx_sleeping_timer (timer_node* tn, 
@@ -881,18 +972,19 @@ int handle_cctx_sleeping_timer (timer_node* tn,
                                 unsigned long ulong_param)
 {
   (void)pvoid_param;
-  (void)ulong_param;
 
   client_context* cctx = (client_context *) tn;
   batch_context* bctx = cctx->bctx;
   url_context* url = &bctx->url_ctx_array[cctx->url_curr_index];
 
-  bctx->sleeping_clients_count--;
+  cctx->tid_sleeping = -1;
+  bctx->rt->sleeping_clients_count--;
 
-  if (url->fresh_connect)
+  if (url->fresh_connect || (! bctx->native && ! cctx->handle))
     {
       /*
         On a fresh connect we reset the connection and go to sleep.
+        The client, sleeping without a handle, has not set up the url.
         The call to setup_url (cctx) is postponed to the timer handler
         timer handler.
       */
@@ -901,7 +993,7 @@ int handle_cctx_sleeping_timer (timer_node* tn,
       setup_url (cctx);
     }
 
-  const unsigned long now_time = get_tick_count ();
+  const unsigned long now_time = ulong_param; /* now, dispatching the timer */
 
   return client_add_to_load (bctx, cctx, now_time);
 }
@@ -955,7 +1047,7 @@ int put_free_client (client_context* cctx)
  *
  * Input -       *tn          - pointer to timer node structure
  *               *pvoid_param - pointer to some extra data; here batch context
- *               *ulong_param - some extra data.
+ *               ulong_param  - current time in msec
  * Return Code/Output - On success -0, on error - (-1)
  ***************************************************************************/
 static int handle_cctx_url_completion_timer (timer_node* tn,
@@ -965,26 +1057,25 @@ static int handle_cctx_url_completion_timer (timer_node* tn,
   client_context* cctx = (client_context *) tn;
   batch_context* bctx = cctx->bctx;
   (void)pvoid_param;
-  (void)ulong_param;
   int sched_now;
 
   cctx->tid_url_completion = -1;
 
   // Increment operational statistics
-  op_stat_timeouted (&bctx->op_delta, cctx->url_curr_index);
+  op_stat_timeouted (&bctx->rt->op_delta, cctx->url_curr_index);
 
   // Considering url completion timeout as an error
   // TODO - make it configurable
   stat_url_timeout_err_inc (cctx);
   cctx->client_state = CSTATE_ERROR;
 
-  const unsigned long now_time = get_tick_count ();
+  const unsigned long now_time = ulong_param; /* now, dispatching the timer */
   if (verbose_logging)
     {
-      fprintf (cctx->file_output, 
+      fprintf (cctx->cold->file_output, 
                "%ld %ld %ld %s !! ERUT url completion timeout: url: %s\n", 
               now_time - bctx->start_time,
-              cctx->cycle_num, cctx->url_curr_index, cctx->client_name, 
+              cctx->cycle_num, cctx->url_curr_index, cctx->cold->client_name, 
               bctx->url_ctx_array[cctx->url_curr_index].url_str);
     }
 
@@ -1034,8 +1125,8 @@ int pending_active_and_waiting_clients_num (batch_context* bctx)
   if (bctx->req_rate && (bctx->cycling_completed || bctx->requests_completed))
     return 0;
   int total = bctx->waiting_queue ? 
-    (bctx->active_clients_count + bctx->sleeping_clients_count) :
-    bctx->active_clients_count;
+    (bctx->rt->active_clients_count + bctx->rt->sleeping_clients_count) :
+    bctx->rt->active_clients_count;
   /*
    If no clients are active, prevent loader exit in case fixed request rate
    is specified, and clients are scheduled, ie. the request rate timer did
@@ -1063,6 +1154,89 @@ int pending_active_and_waiting_clients_num_stat (batch_context* bctx)
   return total;
 }
 
+/****************************************************************************************
+ * Function name - multi_handles_timeout
+ *
+ * Description - Returns the nearest libcurl timeout among all multi-handles of
+ *               the batch
+ *
+ * Input -       *bctx - pointer to the batch context
+ * Return Code/Output - The nearest timeout in msec, or -1, when no timeout is set
+ ****************************************************************************************/
+long multi_handles_timeout (batch_context* bctx)
+{
+  long nearest = -1, timeout;
+  int m;
+
+  for (m = 0; m < bctx->multi_handles_num; m++)
+    {
+      timeout = -1;
+      curl_multi_timeout (bctx->multi_handles[m], &timeout);
+
+      if (timeout >= 0 && (nearest < 0 || timeout < nearest))
+        nearest = timeout;
+    }
+
+  return nearest;
+}
+
+/****************************************************************************************
+ * Function name - multi_handles_socket_timeout
+ *
+ * Description - Calls curl_multi_socket_action () with CURL_SOCKET_TIMEOUT for 
+ *               the multi-handles of the batch
+ *
+ * Input -       *bctx - pointer to the batch context
+ *               expired_only - when true, skips multi-handles with timeouts
+ *                              not yet expired
+ * Return Code/Output - none
+ ****************************************************************************************/
+void multi_handles_socket_timeout (batch_context* bctx, int expired_only)
+{
+  long timeout;
+  int m, st;
+
+  for (m = 0; m < bctx->multi_handles_num; m++)
+    {
+      if (expired_only)
+        {
+          timeout = -1;
+          curl_multi_timeout (bctx->multi_handles[m], &timeout);
+          if (timeout != 0)
+            continue;
+        }
+
+      while (CURLM_CALL_MULTI_PERFORM == 
+             curl_multi_socket_action (bctx->multi_handles[m], 
+                                       CURL_SOCKET_TIMEOUT, 0, &st))
+        ;
+    }
+}
+
+/****************************************************************************************
+ * Function name - multi_handles_info_read
+ *
+ * Description - Reads the next completion message, draining the multi-handles 
+ *               of the batch one after another
+ *
+ * Input -       *bctx - pointer to the batch context
+ *               *shard - index of the multi-handle to start from
+ *               *msg_num - number of messages remaining in the multi-handle
+ * Return Code/Output - On success - pointer to the message, when no more - 0
+ ****************************************************************************************/
+CURLMsg* multi_handles_info_read (batch_context* bctx, int* shard, int* msg_num)
+{
+  CURLMsg* msg;
+
+  for (; *shard < bctx->multi_handles_num; (*shard)++)
+    {
+      if ((msg = curl_multi_info_read (bctx->multi_handles[*shard], msg_num)))
+        return msg;
+    }
+
+  return 0;
+}
+
 /*================= STATIC FUNCTIONS =================== */
 
 static int fetching_first_cycling_url (client_context* cctx)
@@ -1099,7 +1273,12 @@ static int setup_url (client_context* cctx)
   batch_context* bctx = cctx->bctx;
   url_context* url = &bctx->url_ctx_array[cctx->url_curr_index];
 
-  if (! url->url_use_current)
+  if (bctx->native)
+    {
+      /* The native engine requests are prepared at start-up */
+      bctx->url_index = url->url_ind;
+    }
+  else if (! url->url_use_current)
     {
       /* 
          Setup a new url. Internally it initializes client POST-ing buffer,
@@ -1284,23 +1463,23 @@ static int fetching_decision (client_context* cctx, url_context* url)
         return 1;
     }
  
-    if (cctx->url_fetch_decision && cctx->url_fetch_decision[cctx->url_curr_index] != -1)
+    if (cctx->cold->url_fetch_decision && cctx->cold->url_fetch_decision[cctx->url_curr_index] != -1)
     {
         // Using FETCH_PROBABILITY_ONCE, which allocates 
         // fetching decision array to cache the decision and to decrease calls to random ()
         //
-        if (cctx->url_fetch_decision[cctx->url_curr_index] != -1)
+        if (cctx->cold->url_fetch_decision[cctx->url_curr_index] != -1)
         {
-            return cctx->url_fetch_decision[cctx->url_curr_index];
+            return cctx->cold->url_fetch_decision[cctx->url_curr_index];
         }
         
         if (get_prob() <= url->fetch_probability)
         {
-            return (cctx->url_fetch_decision[cctx->url_curr_index] = 1);
+            return (cctx->cold->url_fetch_decision[cctx->url_curr_index] = 1);
         }
         else
         {
-            return (cctx->url_fetch_decision[cctx->url_curr_index] = 0);
+            return (cctx->cold->url_fetch_decision[cctx->url_curr_index] = 0);
         }
     }
     else 
@@ -1357,7 +1536,16 @@ static int load_urls_state (client_context* cctx,
       }
       while (fetching_decision (cctx, url) != 1);
       
-      if (url->fresh_connect && *wait_msec)
+      if (*wait_msec && bctx->handles_pool_sleep && ! url->url_use_current)
+        {
+          /*
+            The sleeping client returns its handle to the pool, keeping
+            its cookies. Postpone the call to setup_url (cctx) and make it 
+            in the timer handler with a handle from the pool.
+          */
+          handle_pool_return (cctx, 1);
+        }
+      else if (url->fresh_connect && *wait_msec)
         {
           /*
             On a fresh connect reset the connection and go to sleep.
@@ -1408,7 +1596,7 @@ static int orderly_sched_clients (batch_context* bctx,
                                   int clients_to_sched)
 {
   int scheduled_now = 0;
-  unsigned long now_time = get_tick_count ();
+  unsigned long now_time = cached_tick_count ();
   long j;
 
   for (j = bctx->clients_current_sched_num; 
@@ -1424,7 +1612,7 @@ static int orderly_sched_clients (batch_context* bctx,
           fprintf(stderr,
             "%s error: load_next_step() initial failed\n", __func__);
 #if 0
-          fprintf (cctx->file_output, 
+          fprintf (cctx->cold->file_output, 
                    "SCHED: %s - load_next_step failed.\n", 
                    __func__);
 #endif
@@ -1446,7 +1634,7 @@ static int orderly_sched_clients (batch_context* bctx,
 static int req_rate_sched_clients (batch_context* bctx)
 {
   int scheduled_now = 0;
-  unsigned long now_time = get_tick_count ();
+  unsigned long now_time = cached_tick_count ();
   int j;
 
   /*
@@ -1515,3 +1703,46 @@ static int get_free_client (batch_context* bctx,
   *pcctx = bctx->cctx_array + free_client_no - 1;
   return 0;
 }
+
+/*****************************************************************************
+ * Function name - loading_stop_check
+ *
+ * Description - Called periodically by a loading thread. When the loading is 
+ *               stopped by SIGINT, the thread, other than the batch group leader,
+ *               stops ramp-up and starting new requests and cancels its sleeping
+ *               clients. The thread completes, when its requests in flight are
+ *               over, and publishes its final statistics.
+ *
+ * Input -       *bctx - pointer to the batch context
+ * Return Code/Output - None
+ ******************************************************************************/
+static void loading_stop_check (batch_context* bctx)
+{
+  client_context* cctx;
+  int i;
+
+  if (! stop_loading || is_batch_group_leader (bctx))
+    return;
+
+  if (! bctx->stopping)
+    {
+      bctx->stopping = 1;
+      bctx->stop_client_num_gradual_increase = 1;
+      bctx->do_client_num_gradual_increase = 0;
+      bctx->requests_completed = 1;
+    }
+
+  /* Clients of other threads may be moved here later, thus checked each time */
+  for (i = 0; i < bctx->client_num_max; i++)
+    {
+      cctx = &bctx->cctx_array[i];
+
+      if (cctx->bctx == bctx)
+        client_sleeping_cancel (cctx);
+    }
+
+  for (cctx = bctx->balance_guests; cctx; cctx = cctx->balance_next)
+    {
+      client_sleeping_cancel (cctx);
+    }
+}
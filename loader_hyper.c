@@ -30,6 +30,7 @@
 #include <netinet/in.h>
 #include <event.h>
 #include <string.h>
+#include <limits.h>
 
 #include "batch.h"
 #include "client.h"
@@ -37,12 +38,10 @@
 #include "conf.h"
 #include "cl_alloc.h"
 #include "screen.h"
-
-
-#define TIMER_NEXT_LOAD 20000
+#include "standby.h"
 
 static int mget_url_hyper (batch_context* bctx);
-static int mperform_hyper (batch_context* bctx, int* still_running);
+static int mperform_hyper (batch_context* bctx);
 
 
 #if 0
@@ -65,19 +64,18 @@ typedef struct sock_info
 
   int evset;
 
-} sock_info;
+  /* The multi-handle of the client, owning the socket */
+  CURLM* multi;
 
+  batch_context* bctx;
+
+} sock_info;
 
-int still_running;
 
 static void event_cb_hyper (int fd, short kind, void *userp);
 static void update_timeout_hyper (batch_context *bctx);
 
-static int on_exit_hyper (batch_context* bctx);
-
-
-//static struct event timer_event;
-//static struct event timer_next_load_event;
+static void on_exit_hyper (batch_context* bctx);
 
 
 /************************************************************************
@@ -86,12 +84,13 @@ static int on_exit_hyper (batch_context* bctx);
  * Description - A libevent callback. Called by libevent when we get action on a socket.
  * Input -       fd - descriptor (socket)
  *                   kind -  a bitmask of events from libevent
- *                   *userp - user pointer, we pass pointer to batch-context structure
+ *                   *userp - user pointer, we pass pointer to sock_info structure
  * Return Code/Output - None
  *************************************************************************/
 static void event_cb_hyper (int fd, short kind, void *userp)
 {
-  batch_context *bctx = (batch_context *) userp;
+  sock_info *sinfo = (sock_info *) userp;
+  batch_context *bctx = sinfo->bctx;
   int st;
   CURLMcode rc;
 
@@ -107,37 +106,33 @@ static void event_cb_hyper (int fd, short kind, void *userp)
     }
   
   PRINTF("event_cb_hyper enter\n");
+
+  /* Refresh the cached clock once per libevent dispatch */
+  get_tick_count ();
   
   /* 
      Tell libcurl to deal with the transfer associated with this socket 
   */
   do 
     {
-      rc = curl_multi_socket_action (bctx->multiple_handle, fd, bitset, &st);
-      //rc = curl_multi_socket (bctx->multiple_handle, fd, &st);
+      rc = curl_multi_socket_action (sinfo->multi, fd, bitset, &st);
     } 
   while (rc == CURLM_CALL_MULTI_PERFORM);
 
-  if(st) 
-    {
-      update_timeout_hyper(bctx);
-    } 
-  else 
-    {
-#if 0
-      PRINTF("last transfer done, kill timeout\n");
-      if (evtimer_pending(&timer_event, NULL)) {
-        evtimer_del(&timer_event);
-      }
-#endif
-    }
+  /* 
+     Handle completed transfers and re-arm the timer to the nearest deadline.
+  */
+  mperform_hyper (bctx);
+  update_timeout_hyper (bctx);
+
   PRINTF("event_cb_hyper exit\n");
 }
 
 /************************************************************************
  * Function name - timer_cb_hyper
  *
- * Description - A libevent callback. Called by libevent when timeout expires
+ * Description - A libevent callback. Called by libevent when the nearest
+ *               deadline either of libcurl or of the waiting queue expires
  * Input -       fd - descriptor (socket)
  *                   kind -  a bitmask of events from libevent
  *                   *userp - user pointer, we pass pointer to batch-context structure
@@ -148,21 +143,20 @@ static void timer_cb_hyper (int fd, short kind, void *userp)
   (void)fd;
   (void)kind;
   batch_context *bctx = (batch_context *)userp;
-  CURLMcode rc;
-  int st;
 
   //PRINTF("timer_cb_hyper enter\n");
 
-  do 
-    {
-      rc = curl_multi_socket(bctx->multiple_handle, CURL_SOCKET_TIMEOUT, &st);
-    } 
-  while (rc == CURLM_CALL_MULTI_PERFORM);
-    
-  if (still_running ) 
-    { 
-      update_timeout_hyper(bctx); 
-    }
+  /* Refresh the cached clock once per libevent dispatch */
+  get_tick_count ();
+
+  multi_handles_socket_timeout (bctx, 0);
+
+  /* 
+     Handles completed transfers and dispatches expired timers
+     of the waiting queue.
+  */
+  mperform_hyper (bctx);
+  update_timeout_hyper (bctx);
 
   //PRINTF("timer_cb_hyper exit\n");
 }
@@ -224,7 +218,7 @@ static void setsock_hyper(sock_info*sinfo,
       event_del(&sinfo->ev);
     }
 
-  event_set( &sinfo->ev, sinfo->sockfd, kind, event_cb_hyper, bctx);
+  event_set( &sinfo->ev, sinfo->sockfd, kind, event_cb_hyper, sinfo);
   event_base_set(bctx->eb, &sinfo->ev);
   
   sinfo->evset=1;
@@ -256,7 +250,7 @@ static void addsock_hyper(curl_socket_t socket,
 
   setsock_hyper (sinfo, socket, handle, action, bctx);
 
-  curl_multi_assign (bctx->multiple_handle, socket, cctx);
+  curl_multi_assign (cctx->multi_handle, socket, cctx);
 }
 
 #if 0
@@ -340,22 +334,36 @@ static int socket_callback (CURL *handle,
 /****************************************************************************************
  * Function name - update_timeout_hyper
  *
- * Description - Unclear, whether we need it? Update the event timer 
- *                     after curl_multi library calls?
+ * Description - Arms the single event timer to the nearest deadline: either
+ *                     libcurl timeout or the nearest timer in the waiting queue 
+ *                     (client sleeping, url completion, periodic timers).
  *
  * Input -       *bctx - pointer to the batch of contexts
  * Return Code/Output - None
  ****************************************************************************************/
 static void update_timeout_hyper (batch_context *bctx)
 {
-    (void) bctx;
-#if 1
-  long timeout_ms;
+  long timeout_ms = multi_handles_timeout (bctx);
   struct timeval timeout;
 
-  //PRINTF("update_timeout_hyper - enter\n");
+  if (bctx->waiting_queue && ! tq_empty (bctx->waiting_queue))
+    {
+      const unsigned long now_time = cached_tick_count ();
+      const unsigned long time_nearest = 
+        tq_time_to_nearest_timer (bctx->waiting_queue);
+      long tq_timeout_ms = 0;
 
-  curl_multi_timeout (bctx->multiple_handle, &timeout_ms);
+      if (time_nearest > now_time)
+        {
+          tq_timeout_ms = (time_nearest - now_time) > LONG_MAX ? 
+            LONG_MAX : (long) (time_nearest - now_time);
+        }
+
+      if (timeout_ms < 0 || tq_timeout_ms < timeout_ms)
+        {
+          timeout_ms = tq_timeout_ms;
+        }
+    }
 
   if (timeout_ms < 0) 
     {
@@ -364,44 +372,9 @@ static void update_timeout_hyper (batch_context *bctx)
 
   timeout.tv_sec = timeout_ms/1000;
   timeout.tv_usec = (timeout_ms%1000)*1000;
-  evtimer_add (bctx->timer_event, &timeout);
-#endif
-}
-
-
-/************************************************************************
- * Function name - next_load_cb_hyper
- *
- * Description - Called on timer. Makes next load actions and dispatches
- *                  expired timers on the waiting queue.
- *
- * Input -   fd - socket descriptor   
- *               kind - bitmask of events from libevent
- *               *userp - libevent passed pointer to user data; here is batch context
- * Return Code/Output - None
- *************************************************************************/
-static void next_load_cb_hyper (int fd, short kind, void *userp)
-{
-  (void)fd;
-  (void)kind;
-  batch_context *bctx = (batch_context *)userp;
-  int st;
 
-  PRINTF("next_load_cb_hyper\n");
-  
-  /* 
-     1. Checks completion of operations and goes to the next step;
-     2. Dispatches expired timers, adds clients from waiting queue to multihandle;
-     3. Runs multi_socket_all () to open sockets, call event_cb_hyper  and add 
-         their the sockets to the epoll.
-  */
-  mperform_hyper (bctx, &st);
-
-  struct timeval tv;
-  timerclear(&tv);
-  tv.tv_usec = TIMER_NEXT_LOAD;
-  
-  event_add (bctx->timer_next_load_event, &tv);  
+  /* Re-adding of a pending timer re-schedules it */
+  evtimer_add (bctx->timer_event, &timeout);
 }
 
 /****************************************************************************************
@@ -416,7 +389,7 @@ int user_activity_hyper (client_context* cctx_array)
 {
   batch_context* bctx = cctx_array->bctx;
   sock_info *sinfo;
-  int k, st;
+  int k, rval = 0;
 
   if (!bctx)
     {
@@ -424,8 +397,15 @@ int user_activity_hyper (client_context* cctx_array)
       return -1;
     }
 
-  /* Init libevent library */
-  bctx->eb = event_init ();
+  /* 
+     Each thread runs its own event base. Unlike event_init (), event_base_new ()
+     does not set the global current base of libevent, shared by the threads.
+  */
+  if (! (bctx->eb = event_base_new ()))
+    {
+      fprintf (stderr, "%s - error: event_base_new () failed.\n", __func__);
+      return -1;
+    }
 
   if (! (bctx->timer_event = cl_calloc (sizeof (struct event), 1)))
   {
@@ -433,31 +413,29 @@ int user_activity_hyper (client_context* cctx_array)
       return -1;
   }
 
-  if (! (bctx->timer_next_load_event = cl_calloc (sizeof (struct event), 1)))
-  {
-      fprintf (stderr, "%s - error: timer_next_load_event allocation faled.\n", __func__);
-      return -1;
-  }
-
-  /* Set the socket callback on multi-handle */ 
-  curl_multi_setopt (bctx->multiple_handle, 
-                    CURLMOPT_SOCKETFUNCTION, 
-                    socket_callback);
-
-  curl_multi_setopt (bctx->multiple_handle, CURLMOPT_SOCKETDATA, bctx);
+  /* Set the socket callback on multi-handles */ 
+  for (k = 0 ; k < bctx->multi_handles_num ; k++)
+    {
+      curl_multi_setopt (bctx->multi_handles[k], 
+                         CURLMOPT_SOCKETFUNCTION, 
+                         socket_callback);
 
+      curl_multi_setopt (bctx->multi_handles[k], CURLMOPT_SOCKETDATA, bctx);
+    }
 
-  still_running = 1; 
  
-  for (k = 0 ; k < bctx->client_num_max ; k++)
+  /* The sock_info of the clients are an array in the batch arena */
+  if (! (sinfo = arena_calloc (&bctx->client_arena, bctx->client_num_max, 
+                               sizeof (sock_info))))
     {
-      sinfo = cl_calloc (1, sizeof (sock_info));
-      if (!sinfo)
-        {
-           fprintf (stderr, "%s - error: allocation of sock_info failed.\n", __func__);
-          return -1;
-        }
+      fprintf (stderr, "%s - error: allocation of sock_info failed.\n", __func__);
+      return -1;
+    }
 
+  for (k = 0 ; k < bctx->client_num_max ; k++, sinfo++)
+    {
+      sinfo->multi = bctx->cctx_array[k].multi_handle;
+      sinfo->bctx = bctx;
       bctx->cctx_array[k].ext_data = sinfo;
     }
 
@@ -483,17 +461,8 @@ int user_activity_hyper (client_context* cctx_array)
   evtimer_set (bctx->timer_event, timer_cb_hyper, bctx);
   event_base_set(bctx->eb, bctx->timer_event);
 
-  while (CURLM_CALL_MULTI_PERFORM == 
-         curl_multi_socket_all(bctx->multiple_handle, &st))
-         ;
-
-  evtimer_set (bctx->timer_next_load_event, next_load_cb_hyper, bctx);
-  event_base_set(bctx->eb, bctx->timer_next_load_event);
-  
-  struct timeval tv;
-  timerclear(&tv);
-  tv.tv_usec = TIMER_NEXT_LOAD;	
-  event_add (bctx->timer_next_load_event, &tv);
+  /* Kick the initially added handles, their timeouts are already expired */
+  multi_handles_socket_timeout (bctx, 0);
 
   if (is_batch_group_leader (bctx))
     {
@@ -506,20 +475,27 @@ int user_activity_hyper (client_context* cctx_array)
   if (mget_url_hyper (bctx) == -1)
   {
       fprintf (stderr, "%s error: mget_url () failed.\n", __func__) ;
-      return -1;
+      rval = -1;
   }
 
-
   on_exit_hyper (bctx);
 
-  return 0;
+  return rval;
 }
 
-static int on_exit_hyper (batch_context* bctx)
+/****************************************************************************************
+ * Function name - on_exit_hyper
+ *
+ * Description - Called by the thread after its event loop is over. Dumps the final 
+ *               statistics and releases the event base and the timers of the thread,
+ *               leaving the clients and the multi-handles to batch_function ().
+ *
+ * Input -       *bctx - pointer to the batch of contexts
+ * Return Code/Output - None
+ ****************************************************************************************/
+static void on_exit_hyper (batch_context* bctx)
 {
-    //fprintf (stderr, "%s - entered.\n", __func__);
-
-    still_running =0;
+  int k;
 
   dump_final_statistics (bctx->cctx_array);
   screen_release ();
@@ -537,7 +513,35 @@ static int on_exit_hyper (batch_context* bctx)
       bctx->waiting_queue = 0;
     }
 
-  exit (0);
+  /*
+     Sockets remaining in the multi-handles still refer the clients sock_info
+  */
+  for (k = 0; k < bctx->multi_handles_num; k++)
+    {
+      curl_multi_setopt (bctx->multi_handles[k], CURLMOPT_SOCKETFUNCTION, 0);
+    }
+
+  for (k = 0; k < bctx->client_num_max; k++)
+    {
+      if (bctx->cctx_array[k].ext_data)
+        {
+          remsock ((sock_info *) bctx->cctx_array[k].ext_data);
+          bctx->cctx_array[k].ext_data = 0;
+        }
+    }
+
+  if (bctx->timer_event)
+    {
+      evtimer_del (bctx->timer_event);
+      free (bctx->timer_event);
+      bctx->timer_event = 0;
+    }
+
+  if (bctx->eb)
+    {
+      event_base_free ((struct event_base *) bctx->eb);
+      bctx->eb = 0;
+    }
 }
 
 
@@ -574,35 +578,39 @@ static int mget_url_hyper (batch_context* bctx)
 /****************************************************************************************
  * Function name - mperform_hyper
  *
- * Description - Uses curl_multi_perform () for initial url-fetch and to react on socket events.
+ * Description - Called after libcurl socket and timeout actions.
  *               Uses curl_multi_info_read () to test url-fetch completion events and to proceed
- *               with the next step for the client, using load_next_step (). Cares about statistics
+ *               with the next step for the client, using load_next_step (). Dispatches expired
+ *               timers of the waiting queue and kicks the newly added handles using 
+ *               curl_multi_socket_action () with CURL_SOCKET_TIMEOUT. Cares about statistics
  *               at certain timeouts.
  *
  * Input -       *bctx - pointer to the batch of contexts;
- *               *still_running - pointer to counter of still running clients (CURL handles)
  *               
  * Return Code/Output - On Success - 0, on Error -1
  ****************************************************************************************/
-static int mperform_hyper (batch_context* bctx, int* still_running)
+static int mperform_hyper (batch_context* bctx)
 {
-  CURLM *mhandle =  bctx->multiple_handle;
-  int cycle_counter = 0;	
-  int msg_num = 0, st;
+  int msg_num = 0, shard;
   const int snapshot_timeout = snapshot_statistics_timeout*1000;
   unsigned long now_time;
   CURLMsg *msg;
-  int scheduled_now_count = 0, scheduled_now = 0;
-
-  (void)still_running;
+  int scheduled_now_count, scheduled_now = 0;
+  int kicked = 0;
 
   if (pending_active_and_waiting_clients_num (bctx) == 0 &&
-      bctx->do_client_num_gradual_increase == 0)
+      bctx->do_client_num_gradual_increase == 0 &&
+      ! threads_standby_keep_loading (bctx))
   {
-      return on_exit_hyper (bctx);
+      /* The thread leaves its event loop, other threads keep loading */
+      event_base_loopbreak ((struct event_base *) bctx->eb);
+      return 0;
   }
     
-  now_time = get_tick_count ();
+  now_time = cached_tick_count ();
+
+  /* Threads other than the leader publish their statistics for it */
+  stat_publish (bctx, now_time, 0);
 
   if ((long)(now_time - bctx->last_measure) > snapshot_timeout) 
     {
@@ -612,78 +620,81 @@ static int mperform_hyper (batch_context* bctx, int* still_running)
         }
     }
 
-  while( (msg = curl_multi_info_read (mhandle, &msg_num)) != 0)
+  do
     {
-      if (msg->msg == CURLMSG_DONE)
+      scheduled_now_count = 0;
+
+      shard = 0;
+
+      while( (msg = multi_handles_info_read (bctx, &shard, &msg_num)) != 0)
         {
-          /* TODO: CURLMsg returns 'result' field as curl return code. We may wish to use it. */
+          if (msg->msg == CURLMSG_DONE)
+            {
+              /* TODO: CURLMsg returns 'result' field as curl return code. We may wish to use it. */
 
-          CURL *handle = msg->easy_handle;
-          client_context *cctx = NULL;
+              CURL *handle = msg->easy_handle;
+              client_context *cctx = NULL;
 
-          curl_easy_getinfo (handle, CURLINFO_PRIVATE, &cctx);
+              curl_easy_getinfo (handle, CURLINFO_PRIVATE, &cctx);
 
-          if (!cctx)
-            {
-              fprintf (stderr, "%s - error: cctx is a NULL pointer.\n", __func__);
-              return -1;
-            }
+              if (!cctx)
+                {
+                  fprintf (stderr, "%s - error: cctx is a NULL pointer.\n", __func__);
+                  return -1;
+                }
 
-          if (msg->data.result)
-            {
-              // fprintf (stderr, "res is %d ", msg->data.result);
-              cctx->client_state = CSTATE_ERROR;
+              if (msg->data.result)
+                {
+                  // fprintf (stderr, "res is %d ", msg->data.result);
+                  cctx->client_state = CSTATE_ERROR;
                 
-              // fprintf(cctx->file_output, "%ld %s !! ERROR: %d - %s\n", cctx->cycle_num, 
-              // cctx->client_name, msg->data.result, curl_easy_strerror(msg->data.result ));
-            }
+                  // fprintf(cctx->cold->file_output, "%ld %s !! ERROR: %d - %s\n", cctx->cycle_num, 
+                  // cctx->cold->client_name, msg->data.result, curl_easy_strerror(msg->data.result ));
+                }
 
-          if (! (++cycle_counter % TIME_RECALCULATION_MSG_NUM))
-            {
-              now_time = get_tick_count ();
-            }
 
-          /*
-	          Load next step only if request rate is not specified.
-		        Otherwise requests are made on a timer.
-          */
-	        if (bctx->req_rate) 
-            {
-              if (put_free_client(cctx) < 0)
+              /*
+                Load next step only if request rate is not specified.
+                Otherwise requests are made on a timer.
+              */
+              if (bctx->req_rate) 
                 {
-                  fprintf (stderr, "%s error: cannot free a client.\n",
-                   __func__);
-                  return -1;
+                  if (put_free_client(cctx) < 0)
+                    {
+                      fprintf (stderr, "%s error: cannot free a client.\n",
+                       __func__);
+                      return -1;
+                    }
                 }
-            }
-          else
-            {
-              /*cstate client_state =  */
-              load_next_step (cctx, now_time, &scheduled_now);
+              else
+                {
+                  /*cstate client_state =  */
+                  load_next_step (cctx, now_time, &scheduled_now);
 
-             if (scheduled_now)
-               {
-                 scheduled_now_count++;
-               }
+                 if (scheduled_now)
+                   {
+                     scheduled_now_count++;
+                   }
 
-             //fprintf (stderr, "%s - after load_next_step client state %d.\n", __func__, client_state);
+                 //fprintf (stderr, "%s - after load_next_step client state %d.\n", __func__, client_state);
+                }
             }
+        }
 
-          if (msg_num <= 0)
-            {
-              break;  /* If no messages left in the queue - go out */
-            }
+      kicked = 0;
 
-          cycle_counter++;
+      if (dispatch_expired_timers (bctx, now_time) > 0 || scheduled_now_count)
+        {
+          /* 
+             Only the newly added handles have their libcurl timeouts expired,
+             other sockets of the multi-handles are not touched. Completions 
+             caused by the kick are read on the next pass.
+          */
+          multi_handles_socket_timeout (bctx, 0);
+          kicked = 1;
         }
     }
-
-  if (dispatch_expired_timers (bctx, now_time) > 0 || scheduled_now_count)
-    {
-      while (CURLM_CALL_MULTI_PERFORM == 
-             curl_multi_socket_all (bctx->multiple_handle, &st))
-          ;
-    }
+  while (kicked);
 
   return 0;
 }
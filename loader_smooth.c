@@ -31,18 +31,109 @@
 #include <errno.h>
 #include <unistd.h>
 #include <netinet/in.h>
+#include <string.h>
+#include <sys/epoll.h>
 
 #include "batch.h"
 #include "client.h"
 #include "loader.h"
 #include "conf.h"
 #include "screen.h"
+#include "balance.h"
+#include "standby.h"
 
 
+/* 
+   Maximum number of events fetched by epoll_wait (). The events are used 
+   just to wake up, all sockets are served by curl_multi_socket_all ().
+*/
+#define SMOOTH_EVENTS_BATCH 1024
+
+/* The longest sleep in epoll_wait (), msec */
+#define SMOOTH_MAX_TIMEOUT 1000
+
 static int mget_url_smooth (batch_context* bctx);
 static int mperform_smooth (batch_context* bctx,
                             unsigned long* now_time,
                             int* still_running);
+static int smooth_timeout (batch_context* bctx, unsigned long now_time);
+
+/************************************************************************
+ * Function name - socket_callback_smooth
+ *
+ * Description - A libcurl socket callback. Called by libcurl, when libcurl
+ *               wishes to change the events of interest of a socket. Keeps 
+ *               the socket registered with level-triggered epoll.
+ *
+ * Input -       *handle - pointer to CURL handle
+ *               socket - socket descriptor
+ *               what - libcurl event bitmask
+ *               *cbp - libcurl callback pointer; we pass batch context here
+ *               *sockp - pointer to the socket user-assigned private data,
+ *                        the owning multi-handle, when the socket is 
+ *                        registered with epoll, otherwise zero
+ * Return Code/Output - Always 0
+ *************************************************************************/
+static int socket_callback_smooth (CURL *handle, 
+                                   curl_socket_t socket, 
+                                   int what, 
+                                   void *cbp, 
+                                   void *sockp)
+{
+  batch_context* bctx = (batch_context *) cbp;
+  struct epoll_event ev;
+  int op = sockp ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  client_context* cctx = NULL;
+  char* priv = NULL;
+
+  if (what == CURL_POLL_REMOVE)
+    {
+      if (sockp)
+        {
+          /* The socket may be already closed by libcurl, ignore errors */
+          epoll_ctl (bctx->epoll_fd, EPOLL_CTL_DEL, socket, 0);
+          curl_multi_assign ((CURLM *) sockp, socket, 0);
+        }
+      return 0;
+    }
+
+  memset (&ev, 0, sizeof (ev));
+  ev.events = 
+    (what & CURL_POLL_IN ? EPOLLIN : 0) |
+    (what & CURL_POLL_OUT ? EPOLLOUT : 0);
+  ev.data.fd = socket;
+
+  if (epoll_ctl (bctx->epoll_fd, op, socket, &ev) == -1)
+    {
+      /*
+         The descriptor has been closed and re-used behind our back, or
+         the kernel has forgotten it on close (). Retry with the other op.
+      */
+      if ((errno != ENOENT && errno != EEXIST) ||
+          epoll_ctl (bctx->epoll_fd, 
+                     errno == ENOENT ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, 
+                     socket, 
+                     &ev) == -1)
+        {
+          fprintf (stderr, "%s - error: epoll_ctl () failed with errno %d.\n",
+                   __func__, errno);
+          return 0;
+        }
+    }
+
+  if (!sockp)
+    {
+      curl_easy_getinfo (handle, CURLINFO_PRIVATE, &priv);
+      cctx = (client_context *) priv;
+
+      if (cctx)
+        {
+          curl_multi_assign (cctx->multi_handle, socket, cctx->multi_handle);
+        }
+    }
+
+  return 0;
+}
 
 /******************************************************************************
  * Function name - user_activity_smooth
@@ -55,6 +146,7 @@ static int mperform_smooth (batch_context* bctx,
 int user_activity_smooth (client_context* cctx_array)
 {
   batch_context* bctx = cctx_array->bctx;
+  int m;
 
   if (!bctx)
     {
@@ -62,6 +154,26 @@ int user_activity_smooth (client_context* cctx_array)
       return -1;
     }
 
+  /* 
+     Epoll set is sized by the kernel dynamically and, unlike select () 
+     fd_set, has no compile-time limit of descriptors.
+  */
+  if ((bctx->epoll_fd = epoll_create (bctx->client_num_max + 1)) == -1)
+    {
+      fprintf (stderr, "%s - error: epoll_create () failed with errno %d.\n",
+               __func__, errno);
+      return -1;
+    }
+
+  for (m = 0; m < bctx->multi_handles_num; m++)
+    {
+      curl_multi_setopt (bctx->multi_handles[m], 
+                         CURLMOPT_SOCKETFUNCTION, 
+                         socket_callback_smooth);
+
+      curl_multi_setopt (bctx->multi_handles[m], CURLMOPT_SOCKETDATA, bctx);
+    }
+
   if (alloc_init_timer_waiting_queue (bctx->client_num_max + PERIODIC_TIMERS_NUMBER + 1,
                                       &bctx->waiting_queue) == -1)
     {
@@ -90,7 +202,9 @@ int user_activity_smooth (client_context* cctx_array)
      ========= Run the loading machinery ================
   */
   while ((pending_active_and_waiting_clients_num (bctx)) ||
-         bctx->do_client_num_gradual_increase)
+         bctx->do_client_num_gradual_increase ||
+         clients_balance_keep_loading (bctx) ||
+         threads_standby_keep_loading (bctx))
     {
       if (mget_url_smooth (bctx) == -1)
         {
@@ -115,6 +229,9 @@ int user_activity_smooth (client_context* cctx_array)
       bctx->waiting_queue = 0;
     }
 
+  close (bctx->epoll_fd);
+  bctx->epoll_fd = -1;
+
   return 0;
 }
 
@@ -123,9 +240,10 @@ int user_activity_smooth (client_context* cctx_array)
 /*******************************************************************************
  * Function name - mget_url_smooth
  *
- * Description - Performs actual fetching of urls for a whole batch. Starts 
- *               with initial fetch by mperform_smooth () and further acts 
- *               using mperform_smooth () on select events
+ * Description - Performs actual fetching of urls for a whole batch. Waits in 
+ *               epoll_wait () for socket events or for the nearest timeout either 
+ *               of libcurl or of the waiting queue, further acts using 
+ *               mperform_smooth () and dispatches expired timers.
  *
  * Input -       *bctx - pointer to the batch of contexts
  *
@@ -133,59 +251,72 @@ int user_activity_smooth (client_context* cctx_array)
  ********************************************************************************/
 static int mget_url_smooth (batch_context* bctx)  		       
 {
-  int max_timeout_msec = 1000;
+  struct epoll_event events[SMOOTH_EVENTS_BATCH];
   unsigned long now_time = get_tick_count ();
-  int cycle_counter = 0;
-    
   int still_running = 0;
-  struct timeval timeout;
-
-  mperform_smooth (bctx, &now_time, &still_running);
 
-  while (max_timeout_msec > 0) 
+  if (epoll_wait (bctx->epoll_fd, 
+                  events, 
+                  SMOOTH_EVENTS_BATCH, 
+                  smooth_timeout (bctx, now_time)) == -1 && errno != EINTR)
     {
-      int rc, maxfd;
-      fd_set fdread, fdwrite, fdexcep;
+      fprintf (stderr, "%s - error: epoll_wait () failed with errno %d.\n",
+               __func__, errno);
+      return -1;
+    }
 
-      FD_ZERO(&fdread); FD_ZERO(&fdwrite); FD_ZERO(&fdexcep);
-      timeout.tv_sec = 0;
-      timeout.tv_usec = 250000;
+  now_time = get_tick_count ();
 
-      max_timeout_msec -= timeout.tv_sec*1000 + timeout.tv_usec * 0.001;
+  mperform_smooth (bctx, &now_time, &still_running);
 
-      curl_multi_fdset(bctx->multiple_handle, &fdread, &fdwrite, &fdexcep, &maxfd);
+  dispatch_expired_timers (bctx, now_time);
 
-      //fprintf (stderr, "%s - Waiting for %d clients with seconds %f.\n", 
-      //name, still_running, max_timeout);
+  return 0;
+}
 
-      rc = select (maxfd + 1, &fdread, &fdwrite, &fdexcep, &timeout);
+/****************************************************************************************
+ * Function name - smooth_timeout
+ *
+ * Description - Calculates timeout for epoll_wait () as the nearest of libcurl
+ *               timeout and the nearest timer in the batch waiting queue.
+ *
+ * Input -       *bctx    - pointer to the batch of contexts
+ *               now_time - current time in msec
+ *
+ * Return Code/Output - Timeout in msec
+ ****************************************************************************************/
+static int smooth_timeout (batch_context* bctx, unsigned long now_time)
+{
+  long timeout = SMOOTH_MAX_TIMEOUT;
+  const long curl_timeout = multi_handles_timeout (bctx);
 
-      switch(rc)
+  if (curl_timeout >= 0 && curl_timeout < timeout)
+    {
+      timeout = curl_timeout;
+    }
+
+  if (! tq_empty (bctx->waiting_queue))
+    {
+      const unsigned long time_nearest = 
+        tq_time_to_nearest_timer (bctx->waiting_queue);
+
+      if (time_nearest <= now_time)
         {
-        case -1: /* select error */
-          break;
-
-        case 0: /* timeout */
-          now_time = get_tick_count ();
-        default: /* timeout or readable/writable sockets */
-          mperform_smooth (bctx, &now_time, &still_running);            
-          break;
+          timeout = 0;
         }
-          
-      if (! (++cycle_counter % TIME_RECALCULATION_CYCLES_NUM))
+      else if ((long) (time_nearest - now_time) < timeout)
         {
-          now_time = get_tick_count ();
+          timeout = (long) (time_nearest - now_time);
         }
+    }
 
-      dispatch_expired_timers (bctx, now_time);
-    } 
-  return 0;
+  return (int) timeout;
 }
 
 /****************************************************************************************
  * Function name - mperform_smooth
  *
- * Description - Uses curl_multi_perform () for initial url-fetch and to react 
+ * Description - Uses curl_multi_socket_all () for initial url-fetch and to react 
  *               on socket events. It calls curl_multi_info_read () to test url-fetch 
  *               completion events and to proceed with the next step for a client, 
  *               using load_next_step (). It cares about statistics at certain timeouts.
@@ -199,16 +330,27 @@ static int mperform_smooth (batch_context* bctx,
                             unsigned long* now_time, 
                             int* still_running)
 {
-  CURLM *mhandle =  bctx->multiple_handle;
-  int cycle_counter = 0;	
-  int msg_num = 0;
+  int msg_num = 0, shard, running;
   const int snapshot_timeout = snapshot_statistics_timeout*1000;
   CURLMsg *msg;
   int sched_now = 0; 
     
-  while (CURLM_CALL_MULTI_PERFORM == 
-        curl_multi_perform(mhandle, still_running))
-    ;
+  /* 
+     Performs all handles as curl_multi_perform () does and, unlike it, 
+     updates the events of interest by socket callbacks for the epoll set.
+  */
+  *still_running = 0;
+  for (shard = 0; shard < bctx->multi_handles_num; shard++)
+    {
+      running = 0;
+      while (CURLM_CALL_MULTI_PERFORM == 
+             curl_multi_socket_all (bctx->multi_handles[shard], &running))
+        ;
+      *still_running += running;
+    }
+
+  /* Threads other than the leader publish their statistics for it */
+  stat_publish (bctx, *now_time, 0);
 
   if ((long)(*now_time - bctx->last_measure) > snapshot_timeout) 
     {
@@ -218,7 +360,9 @@ static int mperform_smooth (batch_context* bctx,
         }
     }
 
-  while( (msg = curl_multi_info_read (mhandle, &msg_num)) != 0)
+  shard = 0;
+
+  while( (msg = multi_handles_info_read (bctx, &shard, &msg_num)) != 0)
     {
       if (msg->msg == CURLMSG_DONE)
         {
@@ -243,14 +387,10 @@ static int mperform_smooth (batch_context* bctx,
               // fprintf (stderr, "res is %d ", msg->data.result);
               cctx->client_state = CSTATE_ERROR;
                 
-              // fprintf(cctx->file_output, "%ld %s !! ERROR: %d - %s\n", cctx->cycle_num, 
-              // cctx->client_name, msg->data.result, curl_easy_strerror(msg->data.result ));
+              // fprintf(cctx->cold->file_output, "%ld %s !! ERROR: %d - %s\n", cctx->cycle_num, 
+              // cctx->cold->client_name, msg->data.result, curl_easy_strerror(msg->data.result ));
             }
 
-          if (! (++cycle_counter % TIME_RECALCULATION_MSG_NUM))
-            {
-              *now_time = get_tick_count ();
-            }
 
             /*
               Load next step only if request rate is not specified.
@@ -272,13 +412,6 @@ static int mperform_smooth (batch_context* bctx,
 
               //fprintf (stderr, "%s - after load_next_step client state %d.\n", __func__, client_state);
             }
-
-          if (msg_num <= 0)
-            {
-              break;  /* If no messages left in the queue - go out */
-            }
-
-          cycle_counter++;
         }
     }
 
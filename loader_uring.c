@@ -0,0 +1,935 @@
+/*
+ *     loader_uring.c
+ *
+ * 2006-2007 Copyright (c)
+ * Michael Moser, <moser.michael@gmail.com>
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * io_uring loading engine. Sockets of libcurl are watched by one-shot
+ * IORING_OP_POLL_ADD requests, re-armed after each event; submission of the interest changes and
+ * waiting for completions are done by a single io_uring_enter () per loop.
+ * The ring is used via raw system calls, no liburing required.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "batch.h"
+#include "client.h"
+#include "loader.h"
+#include "conf.h"
+#include "cl_alloc.h"
+#include "balance.h"
+#include "standby.h"
+#include "mpool.h"
+#include "screen.h"
+
+
+/* Number of submission queue entries */
+#define URING_SQ_ENTRIES 4096
+
+/* The longest sleep in io_uring_enter (), msec */
+#define URING_MAX_TIMEOUT 1000
+
+/*
+   Tags in the low bit of user_data of SQE. Poll requests are tagged
+   by 0, poll remove/update requests - by 1.
+*/
+#define URING_TAG_POLL 0x0
+#define URING_TAG_CTL 0x1
+#define URING_TAG_MASK 0x1
+
+
+#if 0
+#define PRINTF(args...) fprintf(stdout, ## args);
+#else
+#define PRINTF(args...)
+#endif
+
+
+/*
+  Socket information kept per each socket, that libcurl asks us to watch.
+  Assigned to the socket by curl_multi_assign () and passed back to us
+  by the kernel in user_data of completions.
+*/
+typedef struct sock_info_uring
+{
+  /* Allocatable property to be kept in mpool. Must be the first field. */
+  allocatable alloc;
+
+  curl_socket_t sockfd;
+
+  int action;  /*CURL_POLL_IN CURL_POLL_OUT */
+
+  /* When true, a poll request is active in the kernel */
+  int armed;
+
+  /* Number of requests in the kernel still to complete with the final CQE */
+  int inflight;
+
+  /* The multi-handle, owning the socket */
+  CURLM* multi;
+
+} sock_info_uring;
+
+/*
+  io_uring rings mapped to the user-space.
+*/
+typedef struct uring_context
+{
+  batch_context* bctx;
+
+  int ring_fd;
+
+  /* Submission queue ring */
+  void* sq_ptr;
+  size_t sq_ring_sz;
+  unsigned* sq_head;
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  unsigned sq_entries;
+  unsigned sq_local_tail;
+
+  /* Submission queue entries */
+  struct io_uring_sqe* sqes;
+  size_t sqes_sz;
+
+  /* Completion queue ring */
+  void* cq_ptr;
+  size_t cq_ring_sz;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_cqe* cqes;
+
+} uring_context;
+
+
+static int mget_url_uring (uring_context* uctx);
+static int mperform_uring (batch_context* bctx, unsigned long* now_time);
+static int uring_timeout (batch_context* bctx, unsigned long now_time);
+
+
+/************************************************************************
+ * Function name - uring_enter
+ *
+ * Description - Submits the queued SQEs and, optionally, waits for a completion.
+ *
+ * Input -       *uctx - pointer to the uring context
+ *               min_complete - number of completions to wait for
+ *               timeout_msec - maximum time to wait, when <min_complete> is positive
+ * Return Code/Output - On Success - 0, on Error -1
+ *************************************************************************/
+static int uring_enter (uring_context* uctx, unsigned min_complete, int timeout_msec)
+{
+  struct __kernel_timespec ts;
+  struct io_uring_getevents_arg arg;
+  unsigned to_submit =
+    uctx->sq_local_tail - __atomic_load_n (uctx->sq_head, __ATOMIC_ACQUIRE);
+  unsigned flags = 0;
+  void* argp = 0;
+  size_t argsz = 0;
+
+  if (min_complete)
+    {
+      ts.tv_sec = timeout_msec / 1000;
+      ts.tv_nsec = (timeout_msec % 1000) * 1000000;
+
+      memset (&arg, 0, sizeof (arg));
+      arg.ts = (unsigned long) &ts;
+
+      flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+      argp = &arg;
+      argsz = sizeof (arg);
+    }
+  else if (!to_submit)
+    {
+      return 0;
+    }
+
+  if (syscall (__NR_io_uring_enter, uctx->ring_fd, to_submit,
+               min_complete, flags, argp, argsz) == -1)
+    {
+      if (errno == ETIME || errno == EINTR || errno == EBUSY)
+        {
+          return 0;
+        }
+
+      fprintf (stderr, "%s - error: io_uring_enter () failed with errno %d.\n",
+               __func__, errno);
+      return -1;
+    }
+
+  return 0;
+}
+
+/************************************************************************
+ * Function name - uring_get_sqe
+ *
+ * Description - Takes the next free SQE. When the submission queue is full,
+ *               submits the queued entries to the kernel.
+ *
+ * Input -       *uctx - pointer to the uring context
+ * Return Code/Output - On Success - pointer to a zeroed SQE, on Error - NULL
+ *************************************************************************/
+static struct io_uring_sqe* uring_get_sqe (uring_context* uctx)
+{
+  struct io_uring_sqe* sqe;
+  unsigned index;
+
+  if (uctx->sq_local_tail - __atomic_load_n (uctx->sq_head, __ATOMIC_ACQUIRE) >=
+      uctx->sq_entries)
+    {
+      if (uring_enter (uctx, 0, 0) == -1)
+        {
+          return 0;
+        }
+    }
+
+  index = uctx->sq_local_tail & *uctx->sq_mask;
+  sqe = &uctx->sqes[index];
+  memset (sqe, 0, sizeof (*sqe));
+
+  uctx->sq_array[index] = index;
+  uctx->sq_local_tail++;
+
+  return sqe;
+}
+
+/************************************************************************
+ * Function name - uring_flush_sqe
+ *
+ * Description - Makes the filled SQEs visible to the kernel
+ *
+ * Input -       *uctx - pointer to the uring context
+ * Return Code/Output - None
+ *************************************************************************/
+static void uring_flush_sqe (uring_context* uctx)
+{
+  __atomic_store_n (uctx->sq_tail, uctx->sq_local_tail, __ATOMIC_RELEASE);
+}
+
+/************************************************************************
+ * Function name - poll_mask
+ *
+ * Description - Converts libcurl action to poll events mask
+ *
+ * Input -       action - bitmask of events from curl library
+ * Return Code/Output - poll events mask
+ *************************************************************************/
+static unsigned poll_mask (int action)
+{
+  return (action & CURL_POLL_IN ? POLLIN : 0) |
+    (action & CURL_POLL_OUT ? POLLOUT : 0);
+}
+
+/************************************************************************
+ * Function name - arm_sock_uring
+ *
+ * Description - Queues a one-shot poll request for a socket. Libcurl does not
+ *               read a socket till EAGAIN, thus its sockets are polled level-style:
+ *               the request is re-armed after each event and completes at once,
+ *               when the data left unread is still there.
+ *
+ * Input -       *uctx - pointer to the uring context
+ *               *sinfo - pointer to sinfo structure of the socket
+ * Return Code/Output - On Success - 0, on Error -1
+ *************************************************************************/
+static int arm_sock_uring (uring_context* uctx, sock_info_uring* sinfo)
+{
+  struct io_uring_sqe* sqe = uring_get_sqe (uctx);
+
+  if (!sqe)
+    {
+      return -1;
+    }
+
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = sinfo->sockfd;
+  sqe->poll32_events = poll_mask (sinfo->action);
+  sqe->user_data = (unsigned long) sinfo | URING_TAG_POLL;
+  uring_flush_sqe (uctx);
+
+  sinfo->armed = 1;
+  sinfo->inflight++;
+  return 0;
+}
+
+/************************************************************************
+ * Function name - ctl_sock_uring
+ *
+ * Description - Queues removal of the poll request of a socket or,
+ *               when <action> is positive, update of its events of interest.
+ *
+ * Input -       *uctx - pointer to the uring context
+ *               *sinfo - pointer to sinfo structure of the socket
+ *               action - bitmask of events from curl library for update,
+ *                        0 for removal
+ * Return Code/Output - On Success - 0, on Error -1
+ *************************************************************************/
+static int ctl_sock_uring (uring_context* uctx, sock_info_uring* sinfo, int action)
+{
+  struct io_uring_sqe* sqe = uring_get_sqe (uctx);
+
+  if (!sqe)
+    {
+      return -1;
+    }
+
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = (unsigned long) sinfo | URING_TAG_POLL;
+  sqe->user_data = (unsigned long) sinfo | URING_TAG_CTL;
+
+  if (action)
+    {
+      sqe->len = IORING_POLL_UPDATE_EVENTS;
+      sqe->poll32_events = poll_mask (action);
+    }
+  uring_flush_sqe (uctx);
+
+  sinfo->inflight++;
+  return 0;
+}
+
+/************************************************************************
+ * Function name - release_sock_uring
+ *
+ * Description - Returns sock_info structure of a removed socket to the memory
+ *               pool, when the kernel has no more requests referring it.
+ *
+ * Input -       *bctx - pointer to batch context
+ *               *sinfo - pointer to sinfo structure
+ * Return Code/Output - None
+ *************************************************************************/
+static void release_sock_uring (batch_context* bctx, sock_info_uring* sinfo)
+{
+  if (sinfo->sockfd == CURL_SOCKET_BAD && !sinfo->inflight)
+    {
+      mpool_return_obj (bctx->sock_info_mpool, (allocatable *) sinfo);
+    }
+}
+
+/************************************************************************
+ * Function name - socket_callback_uring
+ *
+ * Description - A libcurl socket callback. Called by libcurl, when libcurl
+ *               wishes to change the events of interest of a socket.
+ *
+ * Input -       *handle - pointer to CURL handle
+ *               socket - socket descriptor
+ *               what - libcurl event bitmask
+ *               *cbp - libcurl callback pointer; we pass uring context here
+ *               *sockp - pointer to the socket user-assigned private data,
+ *                        here sock_info_uring
+ * Return Code/Output - Always 0
+ *************************************************************************/
+static int socket_callback_uring (CURL *handle,
+                                  curl_socket_t socket,
+                                  int what,
+                                  void *cbp,
+                                  void *sockp)
+{
+  uring_context* uctx = (uring_context *) cbp;
+  batch_context* bctx = uctx->bctx;
+  sock_info_uring* sinfo = (sock_info_uring *) sockp;
+  client_context* cctx = NULL;
+  char* priv = NULL;
+
+  PRINTF("socket_callback_uring: sock=%d what=%d sinfo=%p\n", socket, what, sinfo);
+
+  if (what == CURL_POLL_REMOVE)
+    {
+      if (sinfo)
+        {
+          curl_multi_assign (sinfo->multi, socket, 0);
+
+          sinfo->sockfd = CURL_SOCKET_BAD;
+          sinfo->action = 0;
+
+          if (sinfo->armed)
+            {
+              ctl_sock_uring (uctx, sinfo, 0);
+            }
+
+          release_sock_uring (bctx, sinfo);
+        }
+      return 0;
+    }
+
+  if (!sinfo)
+    {
+      curl_easy_getinfo (handle, CURLINFO_PRIVATE, &priv);
+      cctx = (client_context *) priv;
+
+      if (!cctx)
+        {
+          fprintf (stderr, "%s - error: cctx is a NULL pointer.\n", __func__);
+          return 0;
+        }
+
+      if (! (sinfo = (sock_info_uring *) mpool_take_obj (bctx->sock_info_mpool)))
+        {
+          fprintf (stderr, "%s - error: allocation of sock_info failed.\n", __func__);
+          return 0;
+        }
+
+      sinfo->sockfd = socket;
+      sinfo->action = 0;
+      sinfo->armed = 0;
+      sinfo->inflight = 0;
+      sinfo->multi = cctx->multi_handle;
+
+      curl_multi_assign (sinfo->multi, socket, sinfo);
+    }
+
+  if (sinfo->action == what && sinfo->armed)
+    {
+      return 0;
+    }
+
+  sinfo->action = what;
+
+  if (sinfo->armed)
+    {
+      ctl_sock_uring (uctx, sinfo, what);
+    }
+  else if (!sinfo->inflight)
+    {
+      /*
+         Otherwise, the poll request is just terminated and to be re-armed
+         with the current action, when its final completion is handled.
+      */
+      arm_sock_uring (uctx, sinfo);
+    }
+
+  return 0;
+}
+
+/************************************************************************
+ * Function name - uring_init
+ *
+ * Description - Sets up an io_uring instance and maps its rings.
+ *
+ * Input -       *uctx - pointer to the uring context
+ *               cq_entries - required size of completion queue
+ * Return Code/Output - On Success - 0, on Error -1
+ *************************************************************************/
+static int uring_init (uring_context* uctx, unsigned cq_entries)
+{
+  struct io_uring_params p;
+
+  memset (&p, 0, sizeof (p));
+  p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+  p.cq_entries = cq_entries;
+
+  if ((uctx->ring_fd = syscall (__NR_io_uring_setup, URING_SQ_ENTRIES, &p)) == -1)
+    {
+      fprintf (stderr, "%s - io_uring_setup () failed with errno %d.\n",
+               __func__, errno);
+      return -1;
+    }
+
+  /*
+     Extended arguments of io_uring_enter () are from linux-5.11,
+     update of poll requests - from linux-5.13, as well as resource tags.
+  */
+  if (! (p.features & IORING_FEAT_EXT_ARG) ||
+      ! (p.features & IORING_FEAT_RSRC_TAGS))
+    {
+      fprintf (stderr, "%s - io_uring of the kernel is too old.\n", __func__);
+      close (uctx->ring_fd);
+      return -1;
+    }
+
+  uctx->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+  uctx->cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+      if (uctx->cq_ring_sz > uctx->sq_ring_sz)
+        {
+          uctx->sq_ring_sz = uctx->cq_ring_sz;
+        }
+      uctx->cq_ring_sz = uctx->sq_ring_sz;
+    }
+
+  uctx->sq_ptr = mmap (0, uctx->sq_ring_sz, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, uctx->ring_fd, IORING_OFF_SQ_RING);
+  if (uctx->sq_ptr == MAP_FAILED)
+    {
+      fprintf (stderr, "%s - error: mmap () of sq ring failed.\n", __func__);
+      close (uctx->ring_fd);
+      return -1;
+    }
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+      uctx->cq_ptr = uctx->sq_ptr;
+    }
+  else
+    {
+      uctx->cq_ptr = mmap (0, uctx->cq_ring_sz, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, uctx->ring_fd, IORING_OFF_CQ_RING);
+      if (uctx->cq_ptr == MAP_FAILED)
+        {
+          fprintf (stderr, "%s - error: mmap () of cq ring failed.\n", __func__);
+          munmap (uctx->sq_ptr, uctx->sq_ring_sz);
+          close (uctx->ring_fd);
+          return -1;
+        }
+    }
+
+  uctx->sqes_sz = p.sq_entries * sizeof (struct io_uring_sqe);
+  uctx->sqes = mmap (0, uctx->sqes_sz, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, uctx->ring_fd, IORING_OFF_SQES);
+  if (uctx->sqes == MAP_FAILED)
+    {
+      fprintf (stderr, "%s - error: mmap () of sqes failed.\n", __func__);
+      if (uctx->cq_ptr != uctx->sq_ptr)
+        {
+          munmap (uctx->cq_ptr, uctx->cq_ring_sz);
+        }
+      munmap (uctx->sq_ptr, uctx->sq_ring_sz);
+      close (uctx->ring_fd);
+      return -1;
+    }
+
+  uctx->sq_head = (unsigned *) ((char *) uctx->sq_ptr + p.sq_off.head);
+  uctx->sq_tail = (unsigned *) ((char *) uctx->sq_ptr + p.sq_off.tail);
+  uctx->sq_mask = (unsigned *) ((char *) uctx->sq_ptr + p.sq_off.ring_mask);
+  uctx->sq_array = (unsigned *) ((char *) uctx->sq_ptr + p.sq_off.array);
+  uctx->sq_entries = p.sq_entries;
+  uctx->sq_local_tail = *uctx->sq_tail;
+
+  uctx->cq_head = (unsigned *) ((char *) uctx->cq_ptr + p.cq_off.head);
+  uctx->cq_tail = (unsigned *) ((char *) uctx->cq_ptr + p.cq_off.tail);
+  uctx->cq_mask = (unsigned *) ((char *) uctx->cq_ptr + p.cq_off.ring_mask);
+  uctx->cqes = (struct io_uring_cqe *) ((char *) uctx->cq_ptr + p.cq_off.cqes);
+
+  return 0;
+}
+
+/************************************************************************
+ * Function name - uring_release
+ *
+ * Description - Unmaps the rings and closes io_uring instance.
+ *
+ * Input -       *uctx - pointer to the uring context
+ * Return Code/Output - None
+ *************************************************************************/
+static void uring_release (uring_context* uctx)
+{
+  munmap (uctx->sqes, uctx->sqes_sz);
+  if (uctx->cq_ptr != uctx->sq_ptr)
+    {
+      munmap (uctx->cq_ptr, uctx->cq_ring_sz);
+    }
+  munmap (uctx->sq_ptr, uctx->sq_ring_sz);
+  close (uctx->ring_fd);
+  uctx->ring_fd = -1;
+}
+
+/****************************************************************************************
+ * Function name - user_activity_uring
+ *
+ * Description - Simulates user-activities using IO_URING mode. When io_uring
+ *               is not supported by the kernel, falls back to EPOLL mode.
+ * Input -       *cctx_array - array of client contexts (related to a certain batch of clients)
+ *
+ * Return Code/Output - On Success - 0, on Error -1
+ ****************************************************************************************/
+int user_activity_uring (client_context* cctx_array)
+{
+  batch_context* bctx = cctx_array->bctx;
+  uring_context uctx;
+  int rval = 0, m;
+
+  if (!bctx)
+    {
+      fprintf (stderr, "%s - error: bctx is a NULL pointer.\n", __func__);
+      return -1;
+    }
+
+  memset (&uctx, 0, sizeof (uctx));
+  uctx.bctx = bctx;
+
+  if (uring_init (&uctx, 2 * (bctx->client_num_max + URING_SQ_ENTRIES)) == -1)
+    {
+      fprintf (stderr, "%s - io_uring is not available, falling back to epoll mode.\n",
+               __func__);
+      return user_activity_epoll (cctx_array);
+    }
+
+  if (! (bctx->sock_info_mpool = cl_calloc (1, sizeof (mpool))))
+    {
+      fprintf (stderr, "%s - error: allocation of sock_info_mpool failed.\n", __func__);
+      return -1;
+    }
+
+  if (mpool_init (bctx->sock_info_mpool,
+                  sizeof (sock_info_uring),
+                  bctx->client_num_max) == -1)
+    {
+      fprintf (stderr, "%s - error: mpool_init () failed.\n", __func__);
+      return -1;
+    }
+
+  /* Set the socket callback on multi-handles */
+  for (m = 0; m < bctx->multi_handles_num; m++)
+    {
+      curl_multi_setopt (bctx->multi_handles[m],
+                         CURLMOPT_SOCKETFUNCTION,
+                         socket_callback_uring);
+
+      curl_multi_setopt (bctx->multi_handles[m], CURLMOPT_SOCKETDATA, &uctx);
+    }
+
+  if (alloc_init_timer_waiting_queue (
+                                      bctx->client_num_max + PERIODIC_TIMERS_NUMBER + 1,
+                                      &bctx->waiting_queue) == -1)
+    {
+      fprintf (stderr, "%s - error: failed to alloc or init timer waiting queue.\n", __func__);
+      return -1;
+    }
+
+  const unsigned long now_time = get_tick_count ();
+
+  if (init_timers_and_add_initial_clients_to_load (bctx,
+                                                   now_time) == -1)
+    {
+      fprintf (stderr,
+               "%s - error: init_timers_and_add_initial_clients_to_load () failed.\n",
+               __func__);
+      return -1;
+    }
+
+  if (is_batch_group_leader (bctx))
+    {
+      dump_snapshot_interval (bctx, now_time);
+    }
+
+  /*
+     ========= Run the loading machinery ================
+  */
+  if (mget_url_uring (&uctx) == -1)
+    {
+      fprintf (stderr, "%s error: mget_url () failed.\n", __func__) ;
+      rval = -1;
+    }
+
+  dump_final_statistics (cctx_array);
+  screen_release ();
+
+  /*
+     ======= Release resources =========================
+  */
+  if (bctx->waiting_queue)
+    {
+      /* Cancel periodic timers */
+      cancel_periodic_timers (bctx);
+
+      tq_release (bctx->waiting_queue);
+      free (bctx->waiting_queue);
+      bctx->waiting_queue = 0;
+    }
+
+  /*
+     Sockets remaining in the multi-handles still refer the context
+  */
+  for (m = 0; m < bctx->multi_handles_num; m++)
+    {
+      curl_multi_setopt (bctx->multi_handles[m], CURLMOPT_SOCKETFUNCTION, 0);
+    }
+
+  uring_release (&uctx);
+
+  mpool_free (bctx->sock_info_mpool);
+  free (bctx->sock_info_mpool);
+  bctx->sock_info_mpool = 0;
+
+  return rval;
+}
+
+/****************************************************************************************
+ * Function name - mget_url_uring
+ *
+ * Description - Performs actual fetching of urls for a whole batch. By a single
+ *               io_uring_enter () per loop submits the queued poll requests and waits
+ *               for completions or for the nearest timeout either of libcurl or of the
+ *               waiting queue. Passes the socket events to libcurl using
+ *               curl_multi_socket_action () and acts further using mperform_uring ().
+ *
+ * Input -       *uctx - pointer to the uring context
+ *
+ * Return Code/Output - On Success - 0, on Error -1
+ ****************************************************************************************/
+static int mget_url_uring (uring_context* uctx)
+{
+  batch_context* bctx = uctx->bctx;
+  unsigned long now_time = get_tick_count ();
+  int still_running = 0;
+
+  /* Start the initially scheduled clients */
+  multi_handles_socket_timeout (bctx, 0);
+
+  while (pending_active_and_waiting_clients_num (bctx) ||
+         bctx->do_client_num_gradual_increase ||
+         clients_balance_keep_loading (bctx) ||
+         threads_standby_keep_loading (bctx))
+    {
+      unsigned head, tail;
+
+      if (uring_enter (uctx, 1, uring_timeout (bctx, now_time)) == -1)
+        {
+          return -1;
+        }
+
+      /* Refresh the cached clock once per loop iteration */
+      now_time = get_tick_count ();
+
+      head = *uctx->cq_head;
+      tail = __atomic_load_n (uctx->cq_tail, __ATOMIC_ACQUIRE);
+
+      while (head != tail)
+        {
+          struct io_uring_cqe* cqe = &uctx->cqes[head & *uctx->cq_mask];
+          const unsigned long user_data = (unsigned long) cqe->user_data;
+          const int res = cqe->res;
+          sock_info_uring* sinfo =
+            (sock_info_uring *) (user_data & ~(unsigned long) URING_TAG_MASK);
+
+          /* Release the CQE slot before calling libcurl */
+          __atomic_store_n (uctx->cq_head, ++head, __ATOMIC_RELEASE);
+
+          if ((user_data & URING_TAG_MASK) == URING_TAG_CTL)
+            {
+              sinfo->inflight--;
+            }
+          else
+            {
+              /*
+                 The poll request is counted as inflight till libcurl handles
+                 its event, so that sinfo is not released to the pool, when
+                 libcurl removes the socket from within the call.
+              */
+              sinfo->armed = 0;
+
+              if (res > 0 && sinfo->sockfd != CURL_SOCKET_BAD)
+                {
+                  int bitset = 0;
+
+                  if (res & (POLLIN | POLLHUP))
+                    {
+                      bitset |= CURL_CSELECT_IN;
+                    }
+                  if (res & POLLOUT)
+                    {
+                      bitset |= CURL_CSELECT_OUT;
+                    }
+                  if (res & POLLERR)
+                    {
+                      bitset |= CURL_CSELECT_ERR;
+                    }
+
+                  curl_multi_socket_action (sinfo->multi,
+                                            sinfo->sockfd,
+                                            bitset,
+                                            &still_running);
+                }
+
+              sinfo->inflight--;
+            }
+
+          /*
+             Re-arm the one-shot poll with the current events of interest
+             after libcurl has handled the event.
+          */
+          if (! sinfo->armed && ! sinfo->inflight &&
+              sinfo->sockfd != CURL_SOCKET_BAD)
+            {
+              arm_sock_uring (uctx, sinfo);
+            }
+
+          release_sock_uring (bctx, sinfo);
+
+          tail = __atomic_load_n (uctx->cq_tail, __ATOMIC_ACQUIRE);
+        }
+
+      if (bctx->pipeline_depth > 0)
+        {
+          /*
+             libcurl advances only one of the pipelined transfers sharing a
+             socket per event, and the data already read by libcurl is not
+             reported by poll. Perform all the transfers, as smooth-mode does.
+          */
+          int m;
+
+          for (m = 0; m < bctx->multi_handles_num; m++)
+            {
+              curl_multi_socket_all (bctx->multi_handles[m], &still_running);
+            }
+        }
+
+      multi_handles_socket_timeout (bctx, 1);
+
+      if (mperform_uring (bctx, &now_time) == -1)
+        {
+          fprintf (stderr, "%s - error: mperform_uring () failed.\n", __func__);
+          return -1;
+        }
+    }
+
+  return 0;
+}
+
+/****************************************************************************************
+ * Function name - uring_timeout
+ *
+ * Description - Calculates timeout for io_uring_enter () as the nearest of libcurl
+ *               timeout and the nearest timer in the batch waiting queue.
+ *
+ * Input -       *bctx    - pointer to the batch of contexts
+ *               now_time - current time in msec
+ *
+ * Return Code/Output - Timeout in msec
+ ****************************************************************************************/
+static int uring_timeout (batch_context* bctx, unsigned long now_time)
+{
+  long timeout = URING_MAX_TIMEOUT;
+  const long curl_timeout = multi_handles_timeout (bctx);
+
+  if (curl_timeout >= 0 && curl_timeout < timeout)
+    {
+      timeout = curl_timeout;
+    }
+
+  if (! tq_empty (bctx->waiting_queue))
+    {
+      const unsigned long time_nearest =
+        tq_time_to_nearest_timer (bctx->waiting_queue);
+
+      if (time_nearest <= now_time)
+        {
+          timeout = 0;
+        }
+      else if ((long) (time_nearest - now_time) < timeout)
+        {
+          timeout = (long) (time_nearest - now_time);
+        }
+    }
+
+  return (int) timeout;
+}
+
+/****************************************************************************************
+ * Function name - mperform_uring
+ *
+ * Description - Uses curl_multi_info_read () to test url-fetch completion events and
+ *               to proceed with the next step for the client, using load_next_step ().
+ *               Dispatches expired timers of the waiting queue and kicks libcurl to start
+ *               the newly scheduled clients. Cares about statistics at certain timeouts.
+ *
+ * Input -       *bctx - pointer to the batch of contexts;
+ * Input/Output  *now_time - current time in msec
+ *
+ * Return Code/Output - On Success - 0, on Error -1
+ ****************************************************************************************/
+static int mperform_uring (batch_context* bctx, unsigned long* now_time)
+{
+  int msg_num = 0, shard = 0;
+  const int snapshot_timeout = snapshot_statistics_timeout*1000;
+  CURLMsg *msg;
+  int scheduled_now_count = 0, scheduled_now = 0;
+
+  /* Threads other than the leader publish their statistics for it */
+  stat_publish (bctx, *now_time, 0);
+
+  if ((long)(*now_time - bctx->last_measure) > snapshot_timeout)
+    {
+      if (is_batch_group_leader (bctx))
+        {
+          dump_snapshot_interval (bctx, *now_time);
+        }
+    }
+
+  while( (msg = multi_handles_info_read (bctx, &shard, &msg_num)) != 0)
+    {
+      if (msg->msg == CURLMSG_DONE)
+        {
+          CURL *handle = msg->easy_handle;
+          client_context *cctx = NULL;
+          char* priv = NULL;
+
+          curl_easy_getinfo (handle, CURLINFO_PRIVATE, &priv);
+          cctx = (client_context *) priv;
+
+          if (!cctx)
+            {
+              fprintf (stderr, "%s - error: cctx is a NULL pointer.\n", __func__);
+              return -1;
+            }
+
+          if (msg->data.result)
+            {
+              cctx->client_state = CSTATE_ERROR;
+            }
+
+
+          /*
+            Load next step only if request rate is not specified.
+            Otherwise requests are made on a timer.
+          */
+          if (bctx->req_rate)
+            {
+              if (put_free_client(cctx) < 0)
+                {
+                  fprintf (stderr, "%s error: cannot free a client.\n",
+                           __func__);
+                  return -1;
+                }
+            }
+          else
+            {
+              load_next_step (cctx, *now_time, &scheduled_now);
+
+              if (scheduled_now)
+                {
+                  scheduled_now_count++;
+                }
+            }
+        }
+    }
+
+  if (dispatch_expired_timers (bctx, *now_time) > 0 || scheduled_now_count)
+    {
+      /*
+         Newly added handles have their libcurl timeouts already expired.
+      */
+      multi_handles_socket_timeout (bctx, 0);
+    }
+
+  return 0;
+}
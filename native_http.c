@@ -0,0 +1,1416 @@
+/*
+*     native_http.c
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "native_http.h"
+#include "batch.h"
+#include "client.h"
+#include "loader.h"
+#include "conf.h"
+#include "cl_alloc.h"
+
+
+/* The receive buffer, shared by all connections of a batch */
+#define NATIVE_RECV_BUFFER_SIZE 65536
+
+/*
+   Only the beginning of a response header line is kept. It is enough for
+   the headers of interest: Content-Length, Transfer-Encoding and Connection.
+*/
+#define NATIVE_LINE_LEN 64
+
+#define NATIVE_CL_HDR_LEN 96
+
+#define NATIVE_DEFAULT_PORT "80"
+
+
+/*
+  native_url - the url prepared for the native engine: resolved server
+  address and the request, serialized once at start-up.
+*/
+typedef struct native_url
+{
+  struct sockaddr_storage addr;
+
+  socklen_t addr_len;
+
+  /*
+     Request line and headers. For GET completed by the empty line, for
+     POST the Content-Length header and the body are added per request.
+  */
+  char* req;
+
+  size_t req_len;
+
+  /* When true, POST with a form body */
+  int post;
+
+} native_url;
+
+/*
+  States of a native connection.
+*/
+typedef enum native_state
+{
+  NSTATE_IDLE = 0, /* No request in progress, may keep a connection alive */
+  NSTATE_CONNECTING,
+  NSTATE_SENDING,
+  NSTATE_RECEIVING,
+  NSTATE_FAILED, /* Waiting for native_http_dispatch_failed () */
+} native_state;
+
+/*
+  States of the response parser.
+*/
+typedef enum parse_state
+{
+  PSTATE_STATUS = 0,
+  PSTATE_HEADER,
+  PSTATE_BODY,
+  PSTATE_CHUNK_SIZE,
+  PSTATE_CHUNK_DATA,
+  PSTATE_CHUNK_CRLF,
+  PSTATE_TRAILER,
+  PSTATE_UNTIL_CLOSE,
+} parse_state;
+
+/*
+  native_conn - the connection of a client.
+*/
+typedef struct native_conn
+{
+  client_context* cctx;
+
+  /* Socket descriptor, -1, when not connected */
+  int fd;
+
+  /*
+     Incremented on each close. Kept in epoll data together with the
+     connection index to skip stale events of a closed descriptor.
+  */
+  uint32_t gen;
+
+  native_state state;
+
+  /* Client local address to bind to */
+  struct sockaddr_storage local;
+
+  socklen_t local_len;
+
+  /* Server address, the socket is connected to */
+  struct sockaddr_storage peer;
+
+  socklen_t peer_len;
+
+  /* When true, the connection is re-used from a previous request */
+  int reused;
+
+  /* When true, the request has been re-tried on a new connection */
+  int retried;
+
+  /* When true, the connection is on the list of failed */
+  int in_failed;
+
+  /* When true, the request has been counted in statistics */
+  int req_counted;
+
+  /* The request being sent */
+  struct iovec iov[3];
+
+  int iov_num;
+
+  char cl_hdr[NATIVE_CL_HDR_LEN];
+
+  /* The response parsing */
+  parse_state pstate;
+
+  /* When true, some bytes of the response have been received */
+  int got_data;
+
+  long status;
+
+  int keep_alive;
+
+  int chunked;
+
+  long long content_length;
+
+  /* Bytes left in the body or in the current chunk */
+  unsigned long long left;
+
+  char line[NATIVE_LINE_LEN];
+
+  size_t line_len;
+
+} native_conn;
+
+/*
+  native_batch - the native engine of a batch.
+*/
+typedef struct native_batch
+{
+  /* Prepared urls, parallel to url_ctx_array of the batch */
+  native_url* urls;
+
+  /* Connections of the clients, parallel to cctx_array of the batch */
+  native_conn* conns;
+
+  /* Connections, that failed to fetch a url */
+  native_conn** failed;
+
+  int failed_num;
+
+  char* rbuf;
+
+} native_batch;
+
+
+static const char* native_url_unsuitable (url_context* url);
+static int native_url_prepare (batch_context* bctx,
+                               url_context* url,
+                               native_url* nurl);
+static int conn_connect (batch_context* bctx, native_conn* c);
+static void conn_close (batch_context* bctx, native_conn* c);
+static void conn_fail (batch_context* bctx, native_conn* c);
+static int conn_send (batch_context* bctx, native_conn* c);
+static int conn_recv (batch_context* bctx, native_conn* c, unsigned long now_time);
+static int conn_complete (native_conn* c, unsigned long now_time);
+static int parse_response (native_conn* c, const char* data, size_t len);
+static int parse_line (native_conn* c);
+static int response_headers_done (native_conn* c);
+static int value_has_token (const char* value, const char* token);
+
+
+/****************************************************************************************
+* Function name - native_http_init
+*
+* Description - Tests the batch urls and prepares the native engine, when suitable
+*
+* Input -       *bctx - pointer to the batch context with epoll descriptor created
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int native_http_init (batch_context* bctx)
+{
+  native_batch* nb = 0;
+  const char* reason = 0;
+  int i;
+
+  bctx->native = 0;
+
+  if (! bctx->native_engine)
+    {
+      return 0;
+    }
+
+  if (config_proxy[0])
+    {
+      reason = "proxy is configured";
+    }
+
+  for (i = 0; i < bctx->urls_num && !reason; i++)
+    {
+      reason = native_url_unsuitable (&bctx->url_ctx_array[i]);
+    }
+
+  if (reason)
+    {
+      fprintf (stderr,
+               "%s - warning: batch \"%s\": %s, loading by libcurl.\n",
+               __func__, bctx->batch_name, reason);
+      return 0;
+    }
+
+  if (! (nb = cl_calloc (1, sizeof (native_batch))) ||
+      ! (nb->urls = cl_calloc (bctx->urls_num, sizeof (native_url))) ||
+      ! (nb->conns = cl_calloc (bctx->client_num_max, sizeof (native_conn))) ||
+      ! (nb->failed = cl_calloc (bctx->client_num_max, sizeof (native_conn *))) ||
+      ! (nb->rbuf = cl_calloc (NATIVE_RECV_BUFFER_SIZE, sizeof (char))))
+    {
+      fprintf (stderr, "%s - error: allocation failed.\n", __func__);
+      goto error;
+    }
+
+  bctx->native = nb;
+
+  for (i = 0; i < bctx->urls_num; i++)
+    {
+      if (native_url_prepare (bctx, &bctx->url_ctx_array[i], &nb->urls[i]) == -1)
+        {
+          fprintf (stderr, "%s - error: native_url_prepare () failed.\n", __func__);
+          goto error;
+        }
+    }
+
+  for (i = 0; i < bctx->client_num_max; i++)
+    {
+      native_conn* c = &nb->conns[i];
+
+      c->cctx = &bctx->cctx_array[i];
+      c->fd = -1;
+      c->content_length = -1;
+      bctx->cctx_array[i].native_conn = c;
+
+      /* The socket of the connection is bound to the address of the client */
+      if (batch_client_ip_addr (bctx, i, &c->local, &c->local_len) == -1)
+        c->local_len = 0;
+    }
+
+  return 0;
+
+ error:
+  if (nb)
+    {
+      bctx->native = nb;
+      native_http_release (bctx);
+    }
+  return -1;
+}
+
+/****************************************************************************************
+* Function name - native_http_release
+*
+* Description - Closes connections and releases resources of the native engine
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - none
+****************************************************************************************/
+void native_http_release (batch_context* bctx)
+{
+  native_batch* nb = bctx->native;
+  int i;
+
+  if (!nb)
+    {
+      return;
+    }
+
+  if (nb->conns)
+    {
+      for (i = 0; i < bctx->client_num_max; i++)
+        {
+          if (nb->conns[i].fd >= 0)
+            {
+              close (nb->conns[i].fd);
+            }
+          bctx->cctx_array[i].native_conn = 0;
+        }
+      free (nb->conns);
+    }
+
+  if (nb->urls)
+    {
+      for (i = 0; i < bctx->urls_num; i++)
+        {
+          free (nb->urls[i].req);
+        }
+      free (nb->urls);
+    }
+
+  free (nb->failed);
+  free (nb->rbuf);
+  free (nb);
+  bctx->native = 0;
+}
+
+/****************************************************************************************
+* Function name - native_http_start
+*
+* Description - Starts fetching of the current url of the client
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int native_http_start (client_context* cctx)
+{
+  batch_context* bctx = cctx->bctx;
+  url_context* url = &bctx->url_ctx_array[cctx->url_curr_index];
+  native_url* nurl = &bctx->native->urls[cctx->url_curr_index];
+  native_conn* c = cctx->native_conn;
+
+  if (c->state != NSTATE_IDLE || (url->fresh_connect && c->fd >= 0) ||
+      (c->fd >= 0 && (c->peer_len != nurl->addr_len ||
+                      memcmp (&c->peer, &nurl->addr, nurl->addr_len))))
+    {
+      /* Kept-alive connection is not re-used for a url of another server */
+      conn_close (bctx, c);
+    }
+
+  c->iov[0].iov_base = nurl->req;
+  c->iov[0].iov_len = nurl->req_len;
+  c->iov_num = 1;
+
+  if (nurl->post)
+    {
+      if (init_client_formed_buffer (cctx, url,
+                                     cctx->cold->post_data,
+                                     cctx->cold->post_data_len) == -1)
+        {
+          fprintf (stderr, "%s - error: init_client_formed_buffer () failed.\n",
+                   __func__);
+          return -1;
+        }
+
+      const size_t body_len = strlen (cctx->cold->post_data);
+
+      c->iov[1].iov_base = c->cl_hdr;
+      c->iov[1].iov_len = snprintf (c->cl_hdr, sizeof (c->cl_hdr),
+                                    "Content-Length: %lu\r\n\r\n",
+                                    (unsigned long) body_len);
+      c->iov[2].iov_base = cctx->cold->post_data;
+      c->iov[2].iov_len = body_len;
+      c->iov_num = 3;
+    }
+
+  c->pstate = PSTATE_STATUS;
+  c->got_data = 0;
+  c->req_counted = 0;
+  c->retried = 0;
+  c->status = 0;
+  c->line_len = 0;
+
+  if (c->fd >= 0)
+    {
+      c->reused = 1;
+      c->state = NSTATE_SENDING;
+
+      return conn_send (bctx, c);
+    }
+
+  c->reused = 0;
+  return conn_connect (bctx, c);
+}
+
+/****************************************************************************************
+* Function name - native_http_stop
+*
+* Description - Removes the client from loading, aborting an unfinished request
+*
+* Input -       *cctx - pointer to the client context
+*               close_conn - flag, whether to close the kept-alive connection
+* Return Code/Output - none
+****************************************************************************************/
+void native_http_stop (client_context* cctx, int close_conn)
+{
+  native_conn* c = cctx->native_conn;
+
+  if (!c)
+    {
+      return;
+    }
+
+  if (close_conn || c->state != NSTATE_IDLE)
+    {
+      conn_close (cctx->bctx, c);
+    }
+}
+
+/****************************************************************************************
+* Function name - native_http_event
+*
+* Description - Handles epoll events of a native engine connection
+*
+* Input -       *bctx - pointer to the batch context
+*               data - epoll data of the event
+*               events - epoll events bitmask
+*               now_time - current time in msec
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int native_http_event (batch_context* bctx,
+                       uint64_t data,
+                       uint32_t events,
+                       unsigned long now_time)
+{
+  native_conn* c = &bctx->native->conns[(uint32_t) data];
+  int err = 0;
+  socklen_t err_len = sizeof (err);
+
+  if (c->fd < 0 || c->gen != (uint32_t) (data >> 32))
+    {
+      return 0; /* The descriptor has been closed while processing the batch */
+    }
+
+  switch (c->state)
+    {
+    case NSTATE_IDLE:
+      /* A kept-alive connection closed by server or unsolicited data */
+      if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+          conn_close (bctx, c);
+        }
+      return 0;
+
+    case NSTATE_CONNECTING:
+      if (getsockopt (c->fd, SOL_SOCKET, SO_ERROR, &err, &err_len) == -1 || err)
+        {
+          conn_fail (bctx, c);
+          return 0;
+        }
+
+      if (! (events & EPOLLOUT))
+        {
+          return 0;
+        }
+
+      c->state = NSTATE_SENDING;
+      return conn_send (bctx, c);
+
+    case NSTATE_SENDING:
+      if (events & EPOLLERR)
+        {
+          conn_fail (bctx, c);
+          return 0;
+        }
+
+      if (! (events & EPOLLOUT))
+        {
+          return 0;
+        }
+      return conn_send (bctx, c);
+
+    case NSTATE_RECEIVING:
+      if (! (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+        {
+          return 0;
+        }
+      return conn_recv (bctx, c, now_time);
+
+    default:
+      break;
+    }
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - native_http_dispatch_failed
+*
+* Description - Advances to the next step the clients, that failed their requests
+*
+* Input -       *bctx - pointer to the batch context
+*               now_time - current time in msec
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int native_http_dispatch_failed (batch_context* bctx, unsigned long now_time)
+{
+  native_batch* nb = bctx->native;
+  const int num = nb->failed_num;
+  int i, rval = 0;
+
+  /* Clients failing again are appended and dispatched next time */
+  for (i = 0; i < num; i++)
+    {
+      native_conn* c = nb->failed[i];
+
+      c->in_failed = 0;
+
+      if (c->state == NSTATE_FAILED)
+        {
+          c->state = NSTATE_IDLE;
+
+          if (conn_complete (c, now_time) == -1)
+            {
+              rval = -1;
+            }
+        }
+    }
+
+  nb->failed_num -= num;
+  memmove (nb->failed, nb->failed + num, nb->failed_num * sizeof (native_conn *));
+
+  return rval;
+}
+
+/****************************************************************************************
+* Function name - native_http_pending
+*
+* Description - Tells, whether there are clients with failed requests to be dispatched
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - If there are - positive number, if not - 0
+****************************************************************************************/
+int native_http_pending (batch_context* bctx)
+{
+  return bctx->native ? bctx->native->failed_num : 0;
+}
+
+/*================= STATIC FUNCTIONS =================== */
+
+/*******************************************************************************
+* Function name - native_url_unsuitable
+*
+* Description - Tests, whether the url may be fetched by the native engine
+*
+* Input -       *url - pointer to the url context
+* Return Code/Output - The reason, when unsuitable, or 0, when suitable
+********************************************************************************/
+static const char* native_url_unsuitable (url_context* url)
+{
+  if (url->url_appl_type != URL_APPL_HTTP)
+    return "not an HTTP url";
+
+  if (url->req_type != HTTP_REQ_TYPE_GET && url->req_type != HTTP_REQ_TYPE_POST)
+    return "request type is neither GET nor POST";
+
+  if (url->req_type == HTTP_REQ_TYPE_GET && url->form_str)
+    return "GET with form fields";
+
+  if (url->req_type == HTTP_REQ_TYPE_POST && !url->form_str)
+    return "POST without FORM_STRING";
+
+  if (url->url_use_current || is_template (url) || url->set.n_urles ||
+      url->random_hrange)
+    return "url is not static";
+
+  if (url->upload_file || url->mpart_form_post)
+    return "upload or multipart form-data";
+
+  if (url->web_auth_method || url->proxy_auth_method)
+    return "authentication";
+
+  if (url->log_resp_headers || url->log_resp_bodies)
+    return "logging of responses";
+
+  if (url->transfer_limit_rate || url->ignore_content_length ||
+      url->response.n_tokens)
+    return "transfer limit rate, response tokens or ignoring content length";
+
+  if (!url->url_str || strncasecmp (url->url_str, "http://", 7) ||
+      strchr (url->url_str + 7, '@'))
+    return "url is not of http://host[:port][/path] form";
+
+  return 0;
+}
+
+/*******************************************************************************
+* Function name - native_url_prepare
+*
+* Description - Resolves the server address and serializes the url request
+*
+* Input -       *bctx - pointer to the batch context
+*               *url - pointer to the url context
+*               *nurl - pointer to the native url to fill
+* Return Code/Output - On success - 0, on error -1
+********************************************************************************/
+static int native_url_prepare (batch_context* bctx,
+                               url_context* url,
+                               native_url* nurl)
+{
+  char host[256];
+  char port[16];
+  const char* hostport = url->url_str + 7;
+  const char* path = strchr (hostport, '/');
+  const size_t hostport_len = path ? (size_t) (path - hostport) : strlen (hostport);
+  const char* host_begin = hostport;
+  size_t host_len = hostport_len;
+  const char* colon;
+  struct addrinfo hints, *res = 0;
+  struct curl_slist* hdr;
+  int rc, has_ua = 0, has_accept = 0, has_ctype = 0;
+  size_t len;
+
+  if (!path)
+    {
+      path = "/";
+    }
+
+  strcpy (port, NATIVE_DEFAULT_PORT);
+
+  if (hostport[0] == '[')
+    {
+      /* IPv6 literal, like [::1]:8080 */
+      const char* end = memchr (hostport, ']', hostport_len);
+
+      if (!end)
+        {
+          fprintf (stderr, "%s - error: wrong url \"%s\".\n", __func__, url->url_str);
+          return -1;
+        }
+      host_begin = hostport + 1;
+      host_len = end - host_begin;
+      colon = (end + 1 < hostport + hostport_len && end[1] == ':') ? end + 1 : 0;
+    }
+  else
+    {
+      colon = memchr (hostport, ':', hostport_len);
+      if (colon)
+        {
+          host_len = colon - hostport;
+        }
+    }
+
+  if (colon)
+    {
+      len = hostport + hostport_len - colon - 1;
+      if (!len || len >= sizeof (port))
+        {
+          fprintf (stderr, "%s - error: wrong port in url \"%s\".\n",
+                   __func__, url->url_str);
+          return -1;
+        }
+      memcpy (port, colon + 1, len);
+      port[len] = '\0';
+    }
+
+  if (!host_len || host_len >= sizeof (host))
+    {
+      fprintf (stderr, "%s - error: wrong host in url \"%s\".\n",
+               __func__, url->url_str);
+      return -1;
+    }
+  memcpy (host, host_begin, host_len);
+  host[host_len] = '\0';
+
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = bctx->ipv6 ? AF_INET6 : AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  if ((rc = getaddrinfo (host, port, &hints, &res)) || !res)
+    {
+      fprintf (stderr, "%s - error: failed to resolve \"%s\": %s.\n",
+               __func__, host, gai_strerror (rc));
+      return -1;
+    }
+
+  memcpy (&nurl->addr, res->ai_addr, res->ai_addrlen);
+  nurl->addr_len = res->ai_addrlen;
+  freeaddrinfo (res);
+
+  /* Custom headers, which replace the default ones */
+  for (hdr = url->custom_http_hdrs; hdr; hdr = hdr->next)
+    {
+      if (!strncasecmp (hdr->data, "User-Agent:", 11))
+        has_ua = 1;
+      else if (!strncasecmp (hdr->data, "Accept:", 7))
+        has_accept = 1;
+      else if (!strncasecmp (hdr->data, "Content-Type:", 13))
+        has_ctype = 1;
+    }
+
+  nurl->post = (url->req_type == HTTP_REQ_TYPE_POST);
+
+  /* Calculate the length of the request with some spare room */
+  len = strlen (path) + hostport_len + strlen (bctx->user_agent) + 128;
+  for (hdr = url->custom_http_hdrs; hdr; hdr = hdr->next)
+    {
+      len += strlen (hdr->data) + 2;
+    }
+
+  if (! (nurl->req = cl_calloc (len, sizeof (char))))
+    {
+      fprintf (stderr, "%s - error: allocation of request failed.\n", __func__);
+      return -1;
+    }
+
+  nurl->req_len = snprintf (nurl->req, len,
+                            "%s %s HTTP/1.1\r\nHost: %.*s\r\n",
+                            nurl->post ? "POST" : "GET",
+                            path,
+                            (int) hostport_len, hostport);
+
+  if (!has_ua && bctx->user_agent[0])
+    {
+      nurl->req_len += snprintf (nurl->req + nurl->req_len, len - nurl->req_len,
+                                 "User-Agent: %s\r\n", bctx->user_agent);
+    }
+
+  if (!has_accept)
+    {
+      nurl->req_len += snprintf (nurl->req + nurl->req_len, len - nurl->req_len,
+                                 "Accept: */*\r\n");
+    }
+
+  for (hdr = url->custom_http_hdrs; hdr; hdr = hdr->next)
+    {
+      const char* value = strchr (hdr->data, ':');
+
+      /* As with libcurl, a header with empty value is not sent */
+      if (value && value[1 + strspn (value + 1, " \t")] == '\0')
+        {
+          continue;
+        }
+
+      nurl->req_len += snprintf (nurl->req + nurl->req_len, len - nurl->req_len,
+                                 "%s\r\n", hdr->data);
+    }
+
+  if (nurl->post && !has_ctype)
+    {
+      nurl->req_len += snprintf (nurl->req + nurl->req_len, len - nurl->req_len,
+                                 "Content-Type: application/x-www-form-urlencoded\r\n");
+    }
+
+  if (!nurl->post)
+    {
+      nurl->req_len += snprintf (nurl->req + nurl->req_len, len - nurl->req_len,
+                                 "\r\n");
+    }
+
+  return 0;
+}
+
+/*******************************************************************************
+* Function name - conn_connect
+*
+* Description - Initiates a non-blocking connection to the server of the client
+*               current url
+*
+* Input -       *bctx - pointer to the batch context
+*               *c - pointer to the connection
+* Return Code/Output - On success - 0, on error -1
+********************************************************************************/
+static int conn_connect (batch_context* bctx, native_conn* c)
+{
+  native_url* nurl = &bctx->native->urls[c->cctx->url_curr_index];
+  struct epoll_event ev;
+  const int on = 1;
+
+  if ((c->fd = socket (nurl->addr.ss_family,
+                       SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                       0)) == -1)
+    {
+      conn_fail (bctx, c);
+      return 0;
+    }
+
+  setsockopt (c->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof (on));
+
+  if (c->local_len &&
+      bind (c->fd, (struct sockaddr *) &c->local, c->local_len) == -1)
+    {
+      c->retried = 1;
+      conn_fail (bctx, c);
+      return 0;
+    }
+
+  memcpy (&c->peer, &nurl->addr, nurl->addr_len);
+  c->peer_len = nurl->addr_len;
+
+  memset (&ev, 0, sizeof (ev));
+  ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  ev.data.u64 = ((uint64_t) c->gen << 32) |
+    (uint32_t) (c - bctx->native->conns);
+
+  if (epoll_ctl (bctx->epoll_fd, EPOLL_CTL_ADD, c->fd, &ev) == -1)
+    {
+      fprintf (stderr, "%s - error: epoll_ctl () failed with errno %d.\n",
+               __func__, errno);
+      return -1;
+    }
+
+  if (connect (c->fd, (struct sockaddr *) &nurl->addr, nurl->addr_len) == -1)
+    {
+      if (errno != EINPROGRESS)
+        {
+          c->retried = 1;
+          conn_fail (bctx, c);
+          return 0;
+        }
+
+      c->state = NSTATE_CONNECTING;
+      return 0;
+    }
+
+  /* Connected at once, e.g. to localhost */
+  c->state = NSTATE_SENDING;
+  return conn_send (bctx, c);
+}
+
+/*******************************************************************************
+* Function name - conn_close
+*
+* Description - Closes the connection socket
+*
+* Input -       *bctx - pointer to the batch context
+*               *c - pointer to the connection
+* Return Code/Output - none
+********************************************************************************/
+static void conn_close (batch_context* bctx, native_conn* c)
+{
+  (void) bctx;
+
+  if (c->fd >= 0)
+    {
+      /* Closing removes the descriptor from the epoll set */
+      close (c->fd);
+      c->fd = -1;
+      c->gen++;
+    }
+
+  c->state = NSTATE_IDLE;
+}
+
+/*******************************************************************************
+* Function name - conn_fail
+*
+* Description - Handles a failure of the connection. A request on a re-used
+*               connection, closed by server before any response, is re-tried
+*               once on a new connection. Otherwise the client is marked to
+*               be in error and is placed to the list of failed.
+*
+* Input -       *bctx - pointer to the batch context
+*               *c - pointer to the connection
+* Return Code/Output - none
+********************************************************************************/
+static void conn_fail (batch_context* bctx, native_conn* c)
+{
+  native_batch* nb = bctx->native;
+
+  conn_close (bctx, c);
+
+  if (c->reused && !c->got_data && !c->retried)
+    {
+      c->reused = 0;
+      c->retried = 1;
+      c->iov[0].iov_base = nb->urls[c->cctx->url_curr_index].req;
+      c->iov[0].iov_len = nb->urls[c->cctx->url_curr_index].req_len;
+      if (c->iov_num == 3)
+        {
+          c->iov[1].iov_base = c->cl_hdr;
+          c->iov[1].iov_len = strlen (c->cl_hdr);
+          c->iov[2].iov_base = c->cctx->cold->post_data;
+          c->iov[2].iov_len = strlen (c->cctx->cold->post_data);
+        }
+
+      if (conn_connect (bctx, c) == 0)
+        {
+          return;
+        }
+      conn_close (bctx, c);
+    }
+
+  if (verbose_logging)
+    {
+      fprintf (c->cctx->cold->file_output,
+               "%ld %ld %s !! ERROR: connection failed: url: %s\n",
+               c->cctx->cycle_num, (long) c->cctx->url_curr_index,
+               c->cctx->cold->client_name,
+               bctx->url_ctx_array[c->cctx->url_curr_index].url_str);
+    }
+
+  stat_err_inc (c->cctx);
+  c->cctx->client_state = CSTATE_ERROR;
+  c->state = NSTATE_FAILED;
+
+  if (!c->in_failed)
+    {
+      c->in_failed = 1;
+      nb->failed[nb->failed_num++] = c;
+    }
+}
+
+/*******************************************************************************
+* Function name - conn_send
+*
+* Description - Sends the rest of the request. When sent, the response is
+*               waited for with the next EPOLLIN edge.
+*
+* Input -       *bctx - pointer to the batch context
+*               *c - pointer to the connection
+* Return Code/Output - On success - 0, on error -1
+********************************************************************************/
+static int conn_send (batch_context* bctx, native_conn* c)
+{
+  struct iovec* iov = c->iov;
+  int iov_num = c->iov_num;
+  ssize_t n;
+
+  while (iov_num)
+    {
+      n = writev (c->fd, iov, iov_num);
+
+      if (n == -1)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+              /* Keep the rest for the next EPOLLOUT */
+              memmove (c->iov, iov, iov_num * sizeof (struct iovec));
+              c->iov_num = iov_num;
+              return 0;
+            }
+
+          conn_fail (bctx, c);
+          return 0;
+        }
+
+      if (!c->req_counted)
+        {
+          c->req_counted = 1;
+          stat_req_inc (c->cctx);
+        }
+      stat_data_out_add (c->cctx, (unsigned long) n);
+
+      while (iov_num && (size_t) n >= iov->iov_len)
+        {
+          n -= iov->iov_len;
+          iov++;
+          iov_num--;
+        }
+
+      if (iov_num)
+        {
+          iov->iov_base = (char *) iov->iov_base + n;
+          iov->iov_len -= n;
+        }
+    }
+
+  c->iov_num = 0;
+  c->state = NSTATE_RECEIVING;
+  return 0;
+}
+
+/*******************************************************************************
+* Function name - conn_recv
+*
+* Description - Reads and parses the response till the socket is drained
+*               or the response is completed
+*
+* Input -       *bctx - pointer to the batch context
+*               *c - pointer to the connection
+*               now_time - current time in msec
+* Return Code/Output - On success - 0, on error -1
+********************************************************************************/
+static int conn_recv (batch_context* bctx, native_conn* c, unsigned long now_time)
+{
+  char* rbuf = bctx->native->rbuf;
+  ssize_t n;
+  int rc;
+
+  for (;;)
+    {
+      n = recv (c->fd, rbuf, NATIVE_RECV_BUFFER_SIZE, 0);
+
+      if (n > 0)
+        {
+          c->got_data = 1;
+          stat_data_in_add (c->cctx, (unsigned long) n);
+
+          if ((rc = parse_response (c, rbuf, (size_t) n)) == -1)
+            {
+              c->retried = 1;
+              conn_fail (bctx, c);
+              return 0;
+            }
+          else if (rc == 1)
+            {
+              break;
+            }
+        }
+      else if (n == 0)
+        {
+          if (c->pstate != PSTATE_UNTIL_CLOSE)
+            {
+              conn_fail (bctx, c);
+              return 0;
+            }
+
+          /* The body is delimited by connection close */
+          c->keep_alive = 0;
+          break;
+        }
+      else if (errno == EINTR)
+        {
+          continue;
+        }
+      else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+          return 0;
+        }
+      else
+        {
+          conn_fail (bctx, c);
+          return 0;
+        }
+    }
+
+  if (c->keep_alive)
+    {
+      c->state = NSTATE_IDLE;
+    }
+  else
+    {
+      conn_close (bctx, c);
+    }
+
+  return conn_complete (c, now_time);
+}
+
+/*******************************************************************************
+* Function name - conn_complete
+*
+* Description - Advances the client with the completed (or failed) request
+*               to the next step of loading
+*
+* Input -       *c - pointer to the connection
+*               now_time - current time in msec
+* Return Code/Output - On success - 0, on error -1
+********************************************************************************/
+static int conn_complete (native_conn* c, unsigned long now_time)
+{
+  client_context* cctx = c->cctx;
+  int sched_now = 0;
+
+  /*
+    Load next step only if request rate is not specified.
+    Otherwise requests are made on a timer.
+  */
+  if (cctx->bctx->req_rate)
+    {
+      if (put_free_client (cctx) < 0)
+        {
+          fprintf (stderr, "%s error: cannot free a client.\n", __func__);
+          return -1;
+        }
+      return 0;
+    }
+
+  /* As in the event loops, the returned client state is not an error */
+  load_next_step (cctx, now_time, &sched_now);
+  return 0;
+}
+
+/*******************************************************************************
+* Function name - parse_response
+*
+* Description - Parses a portion of the response. Keeps only the state between
+*               portions; the body is skipped.
+*
+* Input -       *c - pointer to the connection
+*               *data - the received data
+*               len - length of the data
+* Return Code/Output - 1, when the response is completed, 0 - when more data
+*                      expected, on error -1
+********************************************************************************/
+static int parse_response (native_conn* c, const char* data, size_t len)
+{
+  const char* end = data + len;
+  size_t chunk;
+
+  while (data < end)
+    {
+      switch (c->pstate)
+        {
+        case PSTATE_STATUS:
+        case PSTATE_HEADER:
+        case PSTATE_CHUNK_SIZE:
+        case PSTATE_CHUNK_CRLF:
+        case PSTATE_TRAILER:
+          {
+            const char* nl = memchr (data, '\n', end - data);
+            const size_t part = (nl ? nl : end) - data;
+
+            if (c->line_len < NATIVE_LINE_LEN - 1)
+              {
+                chunk = NATIVE_LINE_LEN - 1 - c->line_len;
+                if (chunk > part)
+                  chunk = part;
+                memcpy (c->line + c->line_len, data, chunk);
+                c->line_len += chunk;
+              }
+
+            if (!nl)
+              {
+                return 0;
+              }
+
+            data = nl + 1;
+
+            while (c->line_len && c->line[c->line_len - 1] == '\r')
+              {
+                c->line_len--;
+              }
+            c->line[c->line_len] = '\0';
+
+            if (parse_line (c) == -1)
+              {
+                return -1;
+              }
+            c->line_len = 0;
+
+            if (c->pstate == PSTATE_STATUS && c->status == -1)
+              {
+                if (data < end)
+                  {
+                    /* Unexpected data after the response */
+                    c->keep_alive = 0;
+                  }
+                return 1; /* The response is completed */
+              }
+          }
+          break;
+
+        case PSTATE_BODY:
+        case PSTATE_CHUNK_DATA:
+          chunk = (size_t) (end - data);
+          if (chunk > c->left)
+            chunk = (size_t) c->left;
+
+          data += chunk;
+          c->left -= chunk;
+
+          if (!c->left)
+            {
+              if (c->pstate == PSTATE_BODY)
+                {
+                  if (data < end)
+                    {
+                      /* Unexpected data after the response */
+                      c->keep_alive = 0;
+                    }
+                  return 1;
+                }
+              c->pstate = PSTATE_CHUNK_CRLF;
+            }
+          break;
+
+        case PSTATE_UNTIL_CLOSE:
+          return 0;
+        }
+    }
+
+  return 0;
+}
+
+/*******************************************************************************
+* Function name - parse_line
+*
+* Description - Parses a complete line of the response: status line, header,
+*               chunk size or trailer
+*
+* Input -       *c - pointer to the connection with the line
+* Return Code/Output - On success - 0, on error -1
+********************************************************************************/
+static int parse_line (native_conn* c)
+{
+  char* line = c->line;
+  char* value;
+
+  switch (c->pstate)
+    {
+    case PSTATE_STATUS:
+      if (!c->line_len)
+        {
+          return 0; /* Tolerate empty lines before the status line */
+        }
+
+      if (strncmp (line, "HTTP/1.", 7) || c->line_len < 12)
+        {
+          return -1;
+        }
+
+      c->status = strtol (line + 9, 0, 10);
+      c->keep_alive = (line[7] != '0');
+      c->chunked = 0;
+      c->content_length = -1;
+      c->pstate = PSTATE_HEADER;
+      return 0;
+
+    case PSTATE_HEADER:
+      if (!c->line_len)
+        {
+          return response_headers_done (c);
+        }
+
+      if (! (value = strchr (line, ':')))
+        {
+          return 0;
+        }
+
+      *value++ = '\0';
+      value += strspn (value, " \t");
+
+      if (!strcasecmp (line, "Content-Length"))
+        {
+          c->content_length = strtoll (value, 0, 10);
+        }
+      else if (!strcasecmp (line, "Transfer-Encoding"))
+        {
+          c->chunked = value_has_token (value, "chunked");
+        }
+      else if (!strcasecmp (line, "Connection"))
+        {
+          if (value_has_token (value, "close"))
+            c->keep_alive = 0;
+          else if (value_has_token (value, "keep-alive"))
+            c->keep_alive = 1;
+        }
+      return 0;
+
+    case PSTATE_CHUNK_SIZE:
+      c->left = strtoull (line, 0, 16);
+      c->pstate = c->left ? PSTATE_CHUNK_DATA : PSTATE_TRAILER;
+      return 0;
+
+    case PSTATE_CHUNK_CRLF:
+      c->pstate = PSTATE_CHUNK_SIZE;
+      return 0;
+
+    case PSTATE_TRAILER:
+      if (!c->line_len)
+        {
+          /* The last chunk and trailers are completed */
+          c->pstate = PSTATE_STATUS;
+          c->status = -1;
+        }
+      return 0;
+
+    default:
+      break;
+    }
+
+  return 0;
+}
+
+/*******************************************************************************
+* Function name - response_headers_done
+*
+* Description - Updates statistics and the client state on the response
+*               headers completed, and sets up the body framing. As in
+*               client_tracing_function () for libcurl.
+*
+* Input -       *c - pointer to the connection
+* Return Code/Output - On success - 0, on error -1
+********************************************************************************/
+static int response_headers_done (native_conn* c)
+{
+  client_context* cctx = c->cctx;
+  url_context* url = &cctx->bctx->url_ctx_array[cctx->url_curr_index];
+  const unsigned long long time_resp = cached_tick_count_usec ();
+  const long status = c->status;
+
+  switch (status / 100)
+    {
+    case 1:
+      /* Interim response, the final one follows */
+      stat_1xx_inc (cctx);
+      stat_appl_delay_add (cctx, time_resp);
+      c->pstate = PSTATE_STATUS;
+      return 0;
+
+    case 2:
+      stat_2xx_inc (cctx);
+      stat_appl_delay_2xx_add (cctx, time_resp);
+      stat_appl_delay_add (cctx, time_resp);
+      break;
+
+    case 3:
+      stat_3xx_inc (cctx);
+      stat_appl_delay_add (cctx, time_resp);
+      break;
+
+    case 4:
+      stat_4xx_inc (cctx);
+      stat_appl_delay_add (cctx, time_resp);
+      break;
+
+    case 5:
+      stat_5xx_inc (cctx);
+      stat_appl_delay_add (cctx, time_resp);
+      break;
+
+    default:
+      return -1;
+    }
+
+  if (url->resp_status_errors_tbl)
+    {
+      if (status > URL_RESPONSE_STATUS_ERRORS_TABLE_SIZE ||
+          url->resp_status_errors_tbl[status])
+        {
+          cctx->client_state = CSTATE_ERROR;
+        }
+    }
+  else if (status >= 400 && status != 401 && status != 407)
+    {
+      cctx->client_state = CSTATE_ERROR;
+    }
+
+  if (status == 204 || status == 304)
+    {
+      c->pstate = PSTATE_STATUS;
+      c->status = -1;
+    }
+  else if (c->chunked)
+    {
+      c->pstate = PSTATE_CHUNK_SIZE;
+    }
+  else if (c->content_length > 0)
+    {
+      c->left = (unsigned long long) c->content_length;
+      c->pstate = PSTATE_BODY;
+    }
+  else if (c->content_length == 0)
+    {
+      c->pstate = PSTATE_STATUS;
+      c->status = -1;
+    }
+  else
+    {
+      c->keep_alive = 0;
+      c->pstate = PSTATE_UNTIL_CLOSE;
+    }
+
+  return 0;
+}
+
+/*******************************************************************************
+* Function name - value_has_token
+*
+* Description - Case-insensitive search of a token in a header value
+*
+* Input -       *value - the header value
+*               *token - the token to search
+* Return Code/Output - If found - 1, if not - 0
+********************************************************************************/
+static int value_has_token (const char* value, const char* token)
+{
+  const size_t token_len = strlen (token);
+
+  for (; *value; value++)
+    {
+      if (!strncasecmp (value, token, token_len))
+        {
+          return 1;
+        }
+    }
+
+  return 0;
+}
@@ -0,0 +1,129 @@
+/*
+*     native_http.h
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef NATIVE_HTTP_H
+#define NATIVE_HTTP_H
+
+#include <stdint.h>
+
+/*
+  Native HTTP/1.1 engine.
+
+  For batches made only of plain HTTP GET and POST urls, the engine bypasses
+  libcurl: requests are serialized once at start-up, and the clients do
+  non-blocking connect/send/recv on keep-alive connections directly from the
+  epoll-mode event loop. Responses are framed by a minimal parser, that
+  understands status line, Content-Length, chunked transfer encoding and
+  connection close.
+*/
+
+struct batch_context;
+struct client_context;
+
+/****************************************************************************************
+* Function name - native_http_init
+*
+* Description - Tests, whether all urls of the batch may be fetched by the native
+*               engine, and, when yes, prepares the requests and the per-client
+*               connections. When the urls are not suitable, prints the reason,
+*               leaves the engine disabled and the batch is loaded by libcurl.
+*
+* Input -       *bctx - pointer to the batch context with epoll descriptor created
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int native_http_init (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - native_http_release
+*
+* Description - Closes connections and releases resources of the native engine
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - none
+****************************************************************************************/
+void native_http_release (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - native_http_start
+*
+* Description - Starts fetching of the current url of the client: re-uses the kept-alive
+*               connection or initiates a new one and sends the request. Failures are
+*               reported asynchronously by native_http_dispatch_failed ().
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int native_http_start (struct client_context* cctx);
+
+/****************************************************************************************
+* Function name - native_http_stop
+*
+* Description - Removes the client from loading. An unfinished request is aborted
+*               and its connection closed. When <close_conn> is true, closes also
+*               a kept-alive connection.
+*
+* Input -       *cctx - pointer to the client context
+*               close_conn - flag, whether to close the kept-alive connection
+* Return Code/Output - none
+****************************************************************************************/
+void native_http_stop (struct client_context* cctx, int close_conn);
+
+/****************************************************************************************
+* Function name - native_http_event
+*
+* Description - Handles epoll events of a native engine connection. Completed requests
+*               advance the client to the next step of loading.
+*
+* Input -       *bctx - pointer to the batch context
+*               data - epoll data of the event
+*               events - epoll events bitmask
+*               now_time - current time in msec
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int native_http_event (struct batch_context* bctx,
+                       uint64_t data,
+                       uint32_t events,
+                       unsigned long now_time);
+
+/****************************************************************************************
+* Function name - native_http_dispatch_failed
+*
+* Description - Advances to the next step of loading the clients, that failed
+*               to start their requests
+*
+* Input -       *bctx - pointer to the batch context
+*               now_time - current time in msec
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int native_http_dispatch_failed (struct batch_context* bctx, unsigned long now_time);
+
+/****************************************************************************************
+* Function name - native_http_pending
+*
+* Description - Tells, whether there are clients with failed requests to be dispatched
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - If there are - positive number, if not - 0
+****************************************************************************************/
+int native_http_pending (struct batch_context* bctx);
+
+#endif /* NATIVE_HTTP_H */
@@ -115,6 +115,11 @@ static int user_agent_parser (batch_context*const bctx, char*const value);
 static int urls_num_parser (batch_context*const bctx, char*const value);
 static int dump_opstats_parser (batch_context*const bctx, char*const value);
 static int req_rate_parser (batch_context*const bctx, char*const value);
+static int multi_handles_num_parser (batch_context*const bctx, char*const value);
+static int native_engine_parser (batch_context*const bctx, char*const value);
+static int pipeline_depth_parser (batch_context*const bctx, char*const value);
+static int http2_streams_parser (batch_context*const bctx, char*const value);
+static int clients_balance_parser (batch_context*const bctx, char*const value);
 
 /*
  * URL section tag parsers. 
@@ -192,6 +197,11 @@ static const tag_parser_pair tp_map [] =
     {"URLS_NUM", urls_num_parser},
     {"DUMP_OPSTATS", dump_opstats_parser},
     {"REQ_RATE", req_rate_parser},
+    {"MULTI_HANDLES_NUM", multi_handles_num_parser},
+    {"NATIVE_ENGINE", native_engine_parser},
+    {"PIPELINE_DEPTH", pipeline_depth_parser},
+    {"HTTP2_STREAMS", http2_streams_parser},
+    {"CLIENTS_BALANCE", clients_balance_parser},
     
 
     /*------------------------ URL SECTION -------------------------------- */
@@ -1003,6 +1013,72 @@ static int req_rate_parser (batch_context*const bctx, char*const value)
     return 0;
 }
 
+static int multi_handles_num_parser (batch_context*const bctx, char*const value)
+{
+    bctx->multi_handles_num = atoi (value);
+    if (bctx->multi_handles_num < 1)
+    {
+        fprintf (stderr, "%s - error: MULTI_HANDLES_NUM should be a positive number.\n",
+                 __func__);
+        return -1;
+    }
+    return 0;
+}
+
+static int native_engine_parser (batch_context*const bctx, char*const value)
+{
+    if (value[0] == 'Y' || value[0] == 'y' ||
+      value[0] == 'N' || value[0] == 'n')
+    	bctx->native_engine = (value[0] == 'Y' || value[0] == 'y');
+    else
+    {
+        fprintf (stderr, 
+           "%s - error: NATIVE_ENGINE value (%s) must start with Y|y|N|n.\n",
+                 __func__, value);
+        return -1;
+    }
+    return 0;
+}
+
+static int clients_balance_parser (batch_context*const bctx, char*const value)
+{
+    if (value[0] == 'Y' || value[0] == 'y' ||
+      value[0] == 'N' || value[0] == 'n')
+    	bctx->clients_balance = (value[0] == 'Y' || value[0] == 'y');
+    else
+    {
+        fprintf (stderr, 
+           "%s - error: CLIENTS_BALANCE value (%s) must start with Y|y|N|n.\n",
+                 __func__, value);
+        return -1;
+    }
+    return 0;
+}
+
+static int pipeline_depth_parser (batch_context*const bctx, char*const value)
+{
+    bctx->pipeline_depth = atoi (value);
+    if (bctx->pipeline_depth < 0)
+    {
+        fprintf (stderr, "%s - error: PIPELINE_DEPTH should not be negative.\n",
+                 __func__);
+        return -1;
+    }
+    return 0;
+}
+
+static int http2_streams_parser (batch_context*const bctx, char*const value)
+{
+    bctx->http2_streams = atoi (value);
+    if (bctx->http2_streams < 0)
+    {
+        fprintf (stderr, "%s - error: HTTP2_STREAMS should not be negative.\n",
+                 __func__);
+        return -1;
+    }
+    return 0;
+}
+
 static int url_parser (batch_context*const bctx, char*const value)
 {
     size_t url_length = 0;
@@ -2271,6 +2347,58 @@ static int validate_batch_general (batch_context*const bctx)
                  __func__);
         return -1;
     }
+
+    if (! bctx->multi_handles_num)
+    {
+        bctx->multi_handles_num = 1;
+    }
+    else if (bctx->multi_handles_num > bctx->client_num_max)
+    {
+        fprintf (stderr, "%s - error: MULTI_HANDLES_NUM exceeds CLIENTS_NUM_MAX.\n",
+                 __func__);
+        return -1;
+    }
+
+    if (bctx->native_engine && loading_mode != LOAD_MODE_EPOLL)
+    {
+        fprintf (stderr, "%s - warning: NATIVE_ENGINE works only in epoll-mode "
+                 "(-m %d), loading by libcurl.\n", __func__, LOAD_MODE_EPOLL);
+        bctx->native_engine = 0;
+    }
+
+    if (bctx->http2_streams > 0)
+    {
+#if LIBCURL_VERSION_NUM >= 0x072b00
+        if (! (curl_version_info (CURLVERSION_NOW)->features & CURL_VERSION_HTTP2))
+#endif
+        {
+            /* The nearest to multiplexing, that libcurl can do */
+            fprintf (stderr, "%s - warning: libcurl %s has no HTTP/2 multiplexing, "
+                     "HTTP2_STREAMS falls back to HTTP/1.1 pipelining.\n",
+                     __func__, curl_version_info (CURLVERSION_NOW)->version);
+            if (! bctx->pipeline_depth)
+            {
+                bctx->pipeline_depth = bctx->http2_streams;
+            }
+            bctx->http2_streams = 0;
+        }
+    }
+
+    if (bctx->native_engine && (bctx->http2_streams || bctx->pipeline_depth))
+    {
+        fprintf (stderr, "%s - warning: NATIVE_ENGINE does neither HTTP/2 nor "
+                 "pipelining, loading by libcurl.\n", __func__);
+        bctx->native_engine = 0;
+    }
+
+#if LIBCURL_VERSION_NUM < 0x071e00
+    if (bctx->pipeline_depth > 1)
+    {
+        fprintf (stderr, "%s - warning: libcurl %s does not limit the pipeline length, "
+                 "PIPELINE_DEPTH is used only to enable pipelining.\n",
+                 __func__, LIBCURL_VERSION);
+    }
+#endif
   
     return 0;
 }
@@ -2543,74 +2671,86 @@ int alloc_client_formed_buffers (batch_context* bctx)
   for (k = 0; k < bctx->urls_num; k++)
     {
       url_context* url = &bctx->url_ctx_array[k];
+      size_t form_string_len;
+      char* buffers;
+      int i;
+
+      if (!url->form_str || !(form_string_len = strlen (url->form_str)))
+        {
+          continue;
+        }
       
       /*
         Allocate posting buffers for clients (login, logoff other posting), 
         if at least a single url contains method HTTP POST and 
-        FORM_STRING.
+        FORM_STRING. The buffers of all clients are a single array of the 
+        batch arena, indexed by the client index.
       */
-      if (url->req_type == HTTP_REQ_TYPE_POST && url->form_str)
+      if (url->req_type == HTTP_REQ_TYPE_POST)
         {
-          int i;
+          client_context* cctx = &bctx->cctx_array[0];
+
+          if (cctx->cold->post_data || cctx->cold->post_data_len)
+            {
+              continue;
+            }
+
+          const size_t post_data_len = form_string_len + 1 +
+            FORM_RECORDS_MAX_TOKENS_NUM*
+            (FORM_RECORDS_TOKEN_MAX_LEN + FORM_RECORDS_SEQ_NUM_LEN);
+
+          if (! (buffers = (char *) arena_calloc (&bctx->client_arena, 
+                                                  bctx->client_num_max, 
+                                                  post_data_len)))
+            {
+              fprintf (stderr,
+                       "\"%s\" error: failed to allocate client "
+                       "post_data buffers.\n", 
+                       __func__) ;
+              return -1;
+            }
+
           for (i = 0;  i < bctx->client_num_max; i++)
             {
-              client_context* cctx = &bctx->cctx_array[i];
-              
-              if (!cctx->post_data && !cctx->post_data_len)
-                {
-                  size_t form_string_len = strlen (url->form_str);
-                  
-                  if (form_string_len)
-                    {
-                      cctx->post_data_len = form_string_len + 1 +
-                        FORM_RECORDS_MAX_TOKENS_NUM*
-                        (FORM_RECORDS_TOKEN_MAX_LEN +
-                         FORM_RECORDS_SEQ_NUM_LEN);
-                      
-                      if (! (cctx->post_data = 
-                             (char *) calloc (cctx->post_data_len, sizeof (char))))
-                        {
-                          fprintf (stderr,
-                                   "\"%s\" error: failed to allocate client "
-				   "post_data buffer.\n", 
-                                   __func__) ;
-                          return -1;
-                        }
-                    }
-                }
+              cctx = &bctx->cctx_array[i];
+
+              cctx->cold->post_data_len = post_data_len;
+              cctx->cold->post_data = buffers + i * post_data_len;
             }
         } /* end of post-ing buffers allocation */
       
-      else if ((url->req_type == HTTP_REQ_TYPE_GET && url->form_str) ||  
-			  (url->req_type == HTTP_REQ_TYPE_HEAD && url->form_str) || 
-			  (url->req_type == HTTP_REQ_TYPE_DELETE && url->form_str))
+      else if (url->req_type == HTTP_REQ_TYPE_GET ||  
+               url->req_type == HTTP_REQ_TYPE_HEAD || 
+               url->req_type == HTTP_REQ_TYPE_DELETE)
         {
-          int j;
-          for (j = 0;  j < bctx->client_num_max; j++)
+          client_context* cctx = &bctx->cctx_array[0];
+
+          if (cctx->cold->get_url_form_data || cctx->cold->get_url_form_data_len)
             {
-              client_context* cctx = &bctx->cctx_array[j];
-              
-              if (!cctx->get_url_form_data && !cctx->get_url_form_data_len)
-                {
-                  size_t form_string_len = strlen (url->form_str);
-                  
-                  if (form_string_len)
-                    {
-                      cctx->get_url_form_data_len = url->url_str_len + 
-		        form_string_len + 1 +
-                        FORM_RECORDS_MAX_TOKENS_NUM*
-                        (FORM_RECORDS_TOKEN_MAX_LEN + FORM_RECORDS_SEQ_NUM_LEN);
-                      
-                      if (! (cctx->get_url_form_data = 
-                             (char *) calloc (cctx->get_url_form_data_len, sizeof (char))))
-                        {
-                          fprintf (stderr,
-                                   "\"%s\" error: failed to allocate client "
-				   "get_url_form_data buffer.\n", __func__) ;
-                          return -1;
-                        }
-                    }
-                }
+              continue;
+            }
+
+          const size_t get_url_form_data_len = url->url_str_len + 
+            form_string_len + 1 +
+            FORM_RECORDS_MAX_TOKENS_NUM*
+            (FORM_RECORDS_TOKEN_MAX_LEN + FORM_RECORDS_SEQ_NUM_LEN);
+
+          if (! (buffers = (char *) arena_calloc (&bctx->client_arena, 
+                                                  bctx->client_num_max, 
+                                                  get_url_form_data_len)))
+            {
+              fprintf (stderr,
+                       "\"%s\" error: failed to allocate client "
+                       "get_url_form_data buffers.\n", __func__) ;
+              return -1;
+            }
+
+          for (i = 0;  i < bctx->client_num_max; i++)
+            {
+              cctx = &bctx->cctx_array[i];
+
+              cctx->cold->get_url_form_data_len = get_url_form_data_len;
+              cctx->cold->get_url_form_data = buffers + i * get_url_form_data_len;
             }
         } /* end of get-url-form buffers allocation */
       
@@ -2624,7 +2764,8 @@ int alloc_client_formed_buffers (batch_context* bctx)
 *
 * Description - Allocates client URL fetch decision arrays to be used, when 
 *                    fetching decision to be done only during the first cycle 
-*                    and remembered (in fetch_decision_array).
+*                    and remembered (in fetch_decision_array). The arrays of all
+*                    clients are a single array of the batch arena.
 * 
 * Input -      *bctx - pointer to the initialized batch context to validate
 * Return Code/Output - On success - 0, on failure - (-1)
@@ -2639,21 +2780,27 @@ int alloc_client_fetch_decision_array (batch_context* bctx)
       
       if (url->fetch_probability && url->fetch_probability_once)
       {
+          char* decisions;
           int i;
+
+          if (bctx->cctx_array[0].cold->url_fetch_decision)
+              return 0;
+
+          if (!(decisions = arena_calloc (&bctx->client_arena, 
+                                          bctx->client_num_max, 
+                                          bctx->urls_num)))
+          {
+              fprintf (stderr, "\"%s\" error: failed to allocate client url_fetch_decision buffers.\n", __func__) ;
+              return -1;
+          }
+          memset (decisions, -1, (size_t) bctx->client_num_max * bctx->urls_num);
+
           for (i = 0;  i < bctx->client_num_max; i++)
           {
-              client_context* cctx = &bctx->cctx_array[i];
-              
-              if (!cctx->url_fetch_decision)
-              {
-                  if (!(cctx->url_fetch_decision = calloc (bctx->urls_num, sizeof (char))))
-                  {
-                      fprintf (stderr, "\"%s\" error: failed to allocate client url_fetch_decision buffer.\n", __func__) ;
-                      return -1;
-                  }
-                  memset (cctx->url_fetch_decision, -1, bctx->urls_num);
-              }
+              bctx->cctx_array[i].cold->url_fetch_decision = 
+                  decisions + (size_t) i * bctx->urls_num;
           }
+          return 0;
       }
   }
   return 0;
@@ -2669,17 +2816,18 @@ int alloc_client_fetch_decision_array (batch_context* bctx)
 *******************************************************************************/
 int init_operational_statistics(batch_context* bctx)
 {
-  if (op_stat_point_init(&bctx->op_delta,
+  /* The counters since the last measurements are allocated by the thread */
+  if (op_stat_point_init(&bctx->op_total,
                          bctx->urls_num) == -1)
     {
-      fprintf (stderr, "%s - error: init of op_delta failed.\n",__func__);
+      fprintf (stderr, "%s - error: init of op_total failed.",__func__);
       return -1;
     }
-  
-  if (op_stat_point_init(&bctx->op_total,
-                         bctx->urls_num) == -1)
+
+  if (stat_snapshot_init (&bctx->stat_merged, bctx->urls_num) == -1 ||
+      stat_snapshot_init (&bctx->stat_read, bctx->urls_num) == -1)
     {
-      fprintf (stderr, "%s - error: init of op_total failed.",__func__);
+      fprintf (stderr, "%s - error: init of statistics snapshots failed.\n",__func__);
       return -1;
     }
 
@@ -2702,9 +2850,7 @@ static int post_validate_init (batch_context*const bctx)
   */
   if (!bctx->cctx_array)
     {
-      if (!(bctx->cctx_array =
-            (client_context *) cl_calloc (bctx->client_num_max, 
-                                          sizeof (client_context))))
+      if (!(bctx->cctx_array = client_array_alloc (bctx->client_num_max)))
         {
           fprintf (stderr, "\"%s\" - %s - failed to allocate cctx.\n", 
                    bctx->batch_name, __func__);
@@ -3264,12 +3410,13 @@ static void		free_url_template(url_template* t);
 static void		free_url_set(url_set* set);
 
 static int		keyval_start(int nqueues);
-static int		keyval_create(int index, void* context, char* word);
+static int		keyval_create(int index, void* context, char* word, void* k);
 static int		keyval_init(int index, void* context);
 static void		keyval_scan(int index, void* context, char* data, int size);
 static void		keyval_flush(int index, void* context);
 static char*	keyval_lookup(char* word, int index);
 static void		keyval_stop();
+static size_t	keyval_object_size();
 
 static char*	string_copy(char* src, char* dst);
 static char*	get_line(char* buf, int size, FILE* file);
@@ -3559,14 +3706,27 @@ response_token_parser (batch_context* const batch, char* const word)
 {
    url_context* url = &batch->url_ctx_array[batch->url_index];
    int nclients = batch->client_num_max;
+   size_t keyval_size = keyval_object_size();
+   char* keyvals;
+   char* key;
    int i;
 	
    if (keyval_start(nclients) < 0)
        return -1;
+
+   /*
+     The keyvals of all clients and their common keyword are
+     allocated from the batch arena
+   */
+   if ((keyvals = arena_calloc(&batch->client_arena, nclients, keyval_size)) == 0 ||
+       (key = arena_calloc(&batch->client_arena, strlen(word) + 1, sizeof (char))) == 0)
+       return error("cannot allocate keyvals");
+
+   strcpy(key, word);
 	
    for (i = 0; i < nclients; i++)
    {
-       if (keyval_create(i, url, word) < 0)
+       if (keyval_create(i, url, key, keyvals + i * keyval_size) < 0)
            return -1;
        
        url->response.n_tokens++;
@@ -3940,7 +4100,7 @@ static int upload_file_streams_alloc(batch_context* batch)
 {
     url_context* url = &batch->url_ctx_array[batch->url_index];
 	
-    if ((url->upload_offsets = (off_t*) calloc(batch->client_num_max, sizeof (off_t))) == 0)
+    if ((url->upload_offsets = (off_t*) arena_calloc(&batch->client_arena, batch->client_num_max, sizeof (off_t))) == 0)
         return error("cannot allocate upload streams");
 	
     return 0;
@@ -4027,7 +4187,7 @@ void free_url_extensions(url_context* url)
 {
     free_url_set(&url->set);
     free_url_template(&url->template);
-    freeze(url->upload_offsets);
+    url->upload_offsets = 0; /* allocated from the batch arena */
     keyval_stop();
 }
 
@@ -4141,19 +4301,26 @@ keyval_start(int nqueues)
 }
 
 /*
-  Create a keyval for a given keyword
+  Size of a keyval to be allocated by the caller
+*/
+static size_t
+keyval_object_size()
+{
+    return sizeof (keyval);
+}
+
+/*
+  Create a keyval for a given keyword in the zeroed memory,
+  allocated by the caller. The keyword is not copied.
 */
 static int
-keyval_create(int index, void* context, char* word)
+keyval_create(int index, void* context, char* word, void* kmem)
 {
-    keyval* k;
+    keyval* k = kmem;
 	
     if (index >= num_queues)
         return error("index out of range");
 	
-    if ((k = calloc(1, sizeof *k)) == 0)
-        return error("cannot allocate keyval");
-	
     if (kv_create(k, word) < 0)
         return -1;
 	
@@ -4268,8 +4435,8 @@ q_insert(keyq* q, keyval* k)
 static int
 kv_create(keyval* k, char* word)
 {
-    if ((k->key.word = strdup(word)) == 0)
-        return error("cannot allocate word");	
+    if ((k->key.word = word) == 0)
+        return error("missing word");	
     return 0;
 }
 
@@ -4433,10 +4600,10 @@ kv_init(keyval* k)
 static void
 kv_free(keyval* k)
 {
+    /* The keyval and its keyword are released with the batch arena */
     if (k != 0)
     {
-        free(k->key.word);
-        free(k);
+        k->key.word = 0;
     }
 }
 
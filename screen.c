@@ -38,6 +38,7 @@
 #include "batch.h"
 #include "client.h"
 #include "loader.h"
+#include "standby.h"
 
 //static int test_fd_readable (int fd);
 static int on_keybord_input (int key, batch_context* bctx);
@@ -159,6 +160,83 @@ int screen_test_keyboard_input (batch_context* bctx)
   return on_keybord_input (the_key, bctx);
 }
 
+/****************************************************************************************
+* Function name - screen_post_keyboard_input
+*
+* Description - Called by the statistics thread to pass the keyboard input to the 
+*               loading threads. Switching of the automatic ramp-up applies to all
+*               threads, more clients are added by the threads in turn. Threads are
+*               activated from standby and put on standby one by one.
+*
+* Input -       *bc_arr     - array of the batch contexts of the loading threads
+*               batches_num - number of the loading threads
+* Return Code/Output - None
+****************************************************************************************/
+void screen_post_keyboard_input (batch_context* bc_arr, int batches_num)
+{
+  static int next_batch = 0;
+  int the_key;
+  char ch;
+  int i;
+
+  if ((the_key = getch ())== -1)
+    return;
+
+  switch (ch = the_key) 
+    {
+    case 'm':
+    case 'M':
+    case 'a':
+    case 'A':
+      for (i = 0; i < batches_num; i++)
+        {
+          __atomic_store_n (&bc_arr[i].stop_client_num_gradual_increase, 
+                            (ch == 'm' || ch == 'M'), 
+                            __ATOMIC_RELAXED);
+        }
+      break;
+
+    case '+':
+    case '*':
+      __atomic_add_fetch (&bc_arr[next_batch].screen_clients_add, 
+                          ch == '+' ? 1 : 10, 
+                          __ATOMIC_RELAXED);
+      next_batch = (next_batch + 1) % batches_num;
+      break;
+
+    case '>':
+      threads_standby_activate ();
+      break;
+
+    case '<':
+      threads_standby_retire ();
+      break;
+
+    default:
+      return;
+    }
+
+  fprintf(stderr, "%s - got %c\n", __func__, ch);
+}
+
+/****************************************************************************************
+* Function name - screen_apply_keyboard_input
+*
+* Description - Called by a loading thread to add the clients, posted to it by
+*               screen_post_keyboard_input ()
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - None
+****************************************************************************************/
+void screen_apply_keyboard_input (batch_context* bctx)
+{
+  const int add_number = 
+    __atomic_exchange_n (&bctx->screen_clients_add, 0, __ATOMIC_RELAXED);
+
+  if (add_number)
+    add_loading_clients_num (bctx, add_number);
+}
+
 int on_keybord_input (int key, batch_context* bctx)
 {
   char ch = key;
@@ -28,6 +28,8 @@ struct batch_context;
 void screen_init ();
 void screen_release ();
 int screen_test_keyboard_input (struct batch_context* bctx);
+void screen_post_keyboard_input (struct batch_context* bc_arr, int batches_num);
+void screen_apply_keyboard_input (struct batch_context* bctx);
 
 
 #endif /* SCREEN_H */
@@ -0,0 +1,405 @@
+/*
+*     slab_alloc.c
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <curl/curl.h>
+
+#include "slab_alloc.h"
+
+/* Number of the size classes */
+#define SLAB_CLASSES_NUM 23
+
+/* Class of the blocks, allocated by malloc */
+#define SLAB_CLASS_LARGE SLAB_CLASSES_NUM
+
+/* Size of a chunk of memory, cut to the blocks of a class */
+#define SLAB_CHUNK_SIZE (64*1024)
+
+/* Minimal number of the blocks, cut from a chunk */
+#define SLAB_CHUNK_BLOCKS_MIN 4
+
+#define SLAB_MAGIC 0x51ab51abU
+
+/*
+  Header of a block. The memory, given to libcurl, follows the header and 
+  is aligned as by malloc.
+*/
+typedef struct slab_block
+{
+  union
+  {
+    /* Next free block of the class, when the block is free */
+    struct slab_block* next;
+
+    /* Size, requested by libcurl, when the block is in use */
+    size_t size;
+  } u;
+
+  /* Size class of the block, or SLAB_CLASS_LARGE */
+  unsigned int class_index;
+
+  unsigned int magic;
+
+} __attribute__ ((aligned (16))) slab_block;
+
+/*
+  Free lists and statistics of a thread. The caches of all threads are 
+  linked to collect the statistics.
+*/
+typedef struct slab_cache
+{
+  slab_block* free_list[SLAB_CLASSES_NUM];
+
+  struct slab_cache* next;
+
+  /* Number of allocations, served from the free lists */
+  unsigned long allocs;
+
+  /* Number of allocations, which cut a new chunk */
+  unsigned long refills;
+
+  /* Number of allocations above SLAB_SIZE_MAX, served by malloc */
+  unsigned long large_allocs;
+
+  unsigned long frees;
+
+  /* Bytes of the chunks, allocated by the thread */
+  size_t chunk_bytes;
+
+} slab_cache;
+
+/* Sizes of the memory of the blocks of the classes */
+static const size_t slab_class_size[SLAB_CLASSES_NUM] =
+  {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 
+    3072, 4096, 6144, 8192, 12288, 16384, 20480, 24576, SLAB_SIZE_MAX
+  };
+
+/* Size class of each 16 bytes of the size up to SLAB_SIZE_MAX */
+static unsigned char slab_class_of[(SLAB_SIZE_MAX >> 4) + 1];
+
+static int slab_alloc_enabled = 0;
+
+static __thread slab_cache* slab_thread_cache = 0;
+
+static slab_cache* slab_caches = 0;
+static int slab_caches_num = 0;
+static pthread_mutex_t slab_caches_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void* slab_malloc (size_t size);
+static void slab_free (void* ptr);
+static void* slab_realloc (void* ptr, size_t size);
+static char* slab_strdup (const char* str);
+static void* slab_calloc (size_t nmemb, size_t size);
+
+/****************************************************************************************
+* Function name - slab_alloc_curl_init
+*
+* Description - Initializes libcurl globally with the memory allocator, or with the 
+*               system malloc, when the allocator is disabled (-b option)
+*
+* Input -       system_alloc - when true, libcurl uses the system malloc
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int slab_alloc_curl_init (int system_alloc)
+{
+  size_t size;
+  int index = 0;
+
+  if (system_alloc)
+    {
+      if (curl_global_init (CURL_GLOBAL_ALL))
+        {
+          fprintf (stderr, "%s - error: curl_global_init () failed.\n", __func__);
+          return -1;
+        }
+      return 0;
+    }
+
+  for (size = 0; size <= SLAB_SIZE_MAX; size += 16)
+    {
+      while (slab_class_size[index] < size)
+        index++;
+
+      slab_class_of[size >> 4] = (unsigned char) index;
+    }
+
+  if (curl_global_init_mem (CURL_GLOBAL_ALL, slab_malloc, slab_free, 
+                            slab_realloc, slab_strdup, slab_calloc))
+    {
+      fprintf (stderr, "%s - error: curl_global_init_mem () failed.\n", __func__);
+      return -1;
+    }
+
+  slab_alloc_enabled = 1;
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - slab_alloc_dump_statistics
+*
+* Description - Prints the statistics of the memory allocator, collected from all 
+*               threads of the process, when the allocator is in use
+*
+* Input -       *file - pointer to the file to print to
+* Return Code/Output - None
+****************************************************************************************/
+void slab_alloc_dump_statistics (FILE* file)
+{
+  unsigned long allocs = 0, refills = 0, large_allocs = 0, frees = 0;
+  size_t chunk_bytes = 0;
+  slab_cache* cache;
+
+  if (! slab_alloc_enabled)
+    return;
+
+  /* The counters of the running threads are read without locking */
+  pthread_mutex_lock (&slab_caches_lock);
+
+  for (cache = slab_caches; cache; cache = cache->next)
+    {
+      allocs += cache->allocs;
+      refills += cache->refills;
+      large_allocs += cache->large_allocs;
+      frees += cache->frees;
+      chunk_bytes += cache->chunk_bytes;
+    }
+
+  pthread_mutex_unlock (&slab_caches_lock);
+
+  const unsigned long total = allocs + refills + large_allocs;
+
+  fprintf (file, "libcurl memory: allocs %lu, frees %lu, from free lists %.1f%%, "
+           "chunks %lu, large %lu, slab memory %lu KB in %d threads\n",
+           total, frees, total ? 100.0 * allocs / total : 0.0, refills, 
+           large_allocs, (unsigned long) (chunk_bytes >> 10), slab_caches_num);
+}
+
+/****************************************************************************************
+* Function name - slab_cache_get
+*
+* Description - Returns the cache of the calling thread, allocating it on the first use
+*
+* Return Code/Output - On success - pointer to the cache, on error - NULL
+****************************************************************************************/
+static slab_cache* slab_cache_get (void)
+{
+  slab_cache* cache = slab_thread_cache;
+
+  if (cache)
+    return cache;
+
+  if (! (cache = calloc (1, sizeof (slab_cache))))
+    return NULL;
+
+  pthread_mutex_lock (&slab_caches_lock);
+  cache->next = slab_caches;
+  slab_caches = cache;
+  slab_caches_num++;
+  pthread_mutex_unlock (&slab_caches_lock);
+
+  return (slab_thread_cache = cache);
+}
+
+/****************************************************************************************
+* Function name - slab_refill
+*
+* Description - Cuts a new chunk of memory to the blocks of a class and puts them
+*               to the free list of the class
+*
+* Input -       *cache - pointer to the cache of the thread
+*               class_index - size class
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int slab_refill (slab_cache* cache, unsigned int class_index)
+{
+  const size_t block_size = sizeof (slab_block) + slab_class_size[class_index];
+  size_t blocks_num = SLAB_CHUNK_SIZE / block_size;
+  unsigned char* chunk;
+  size_t i;
+
+  if (blocks_num < SLAB_CHUNK_BLOCKS_MIN)
+    blocks_num = SLAB_CHUNK_BLOCKS_MIN;
+
+  if (! (chunk = malloc (blocks_num * block_size)))
+    return -1;
+
+  for (i = 0; i < blocks_num; i++)
+    {
+      slab_block* block = (slab_block *) (chunk + i * block_size);
+
+      block->class_index = class_index;
+      block->magic = SLAB_MAGIC;
+      block->u.next = cache->free_list[class_index];
+      cache->free_list[class_index] = block;
+    }
+
+  cache->chunk_bytes += blocks_num * block_size;
+  cache->refills++;
+
+  return 0;
+}
+
+/*
+  The malloc callback of libcurl.
+*/
+static void* slab_malloc (size_t size)
+{
+  slab_cache* cache = slab_cache_get ();
+  slab_block* block;
+
+  if (! cache)
+    return NULL;
+
+  if (size > SLAB_SIZE_MAX)
+    {
+      if (size > (size_t) -1 - sizeof (slab_block) ||
+          ! (block = malloc (sizeof (slab_block) + size)))
+        return NULL;
+
+      block->class_index = SLAB_CLASS_LARGE;
+      block->magic = SLAB_MAGIC;
+      cache->large_allocs++;
+    }
+  else
+    {
+      const unsigned int class_index = slab_class_of[(size + 15) >> 4];
+
+      if ((block = cache->free_list[class_index]))
+        cache->allocs++;
+      else if (slab_refill (cache, class_index) == -1)
+        return NULL;
+      else
+        block = cache->free_list[class_index];
+
+      cache->free_list[class_index] = block->u.next;
+    }
+
+  block->u.size = size;
+  return block + 1;
+}
+
+/*
+  The free callback of libcurl.
+*/
+static void slab_free (void* ptr)
+{
+  slab_cache* cache;
+  slab_block* block;
+
+  if (! ptr)
+    return;
+
+  block = (slab_block *) ptr - 1;
+
+  /* Memory, allocated by libcurl before the allocator was registered */
+  if (block->magic != SLAB_MAGIC)
+    {
+      free (ptr);
+      return;
+    }
+
+  if ((cache = slab_cache_get ()))
+    cache->frees++;
+
+  if (block->class_index == SLAB_CLASS_LARGE)
+    {
+      block->magic = 0;
+      free (block);
+      return;
+    }
+
+  if (! cache)
+    return;
+
+  block->u.next = cache->free_list[block->class_index];
+  cache->free_list[block->class_index] = block;
+}
+
+/*
+  The realloc callback of libcurl.
+*/
+static void* slab_realloc (void* ptr, size_t size)
+{
+  slab_block* block;
+  void* new_ptr;
+
+  if (! ptr)
+    return slab_malloc (size);
+
+  block = (slab_block *) ptr - 1;
+
+  if (block->magic != SLAB_MAGIC)
+    return realloc (ptr, size);
+
+  /* The block is kept, when the size fits its class */
+  if (block->class_index != SLAB_CLASS_LARGE && 
+      size <= slab_class_size[block->class_index])
+    {
+      block->u.size = size;
+      return ptr;
+    }
+
+  if (! (new_ptr = slab_malloc (size)))
+    return NULL;
+
+  memcpy (new_ptr, ptr, block->u.size < size ? block->u.size : size);
+  slab_free (ptr);
+
+  return new_ptr;
+}
+
+/*
+  The strdup callback of libcurl.
+*/
+static char* slab_strdup (const char* str)
+{
+  const size_t len = strlen (str) + 1;
+  char* copy;
+
+  if ((copy = slab_malloc (len)))
+    memcpy (copy, str, len);
+
+  return copy;
+}
+
+/*
+  The calloc callback of libcurl.
+*/
+static void* slab_calloc (size_t nmemb, size_t size)
+{
+  void* ptr;
+
+  if (size && nmemb > (size_t) -1 / size)
+    return NULL;
+
+  if ((ptr = slab_malloc (nmemb * size)))
+    memset (ptr, 0, nmemb * size);
+
+  return ptr;
+}
@@ -0,0 +1,70 @@
+/*
+*     slab_alloc.h
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef SLAB_ALLOC_H
+#define SLAB_ALLOC_H
+
+#include <stdio.h>
+
+/*
+  Memory allocator of libcurl.
+
+  libcurl allocates and frees its headers, connection structures and
+  buffers on each request. The allocator, registered to libcurl by 
+  curl_global_init_mem (), keeps the free blocks of each thread in its own 
+  free lists of size classes up to SLAB_SIZE_MAX, so that the loading 
+  threads do not contend on the locks of malloc. 
+
+  Like mpool, the blocks are cut from chunks of memory, allocated from 
+  the system, and the chunks are never returned. A block, freed by another 
+  thread, goes to the free list of that thread. Larger blocks are allocated 
+  by malloc.
+
+  The allocator is to be registered before any call to libcurl.
+*/
+
+/* Size of the largest block of the size classes */
+#define SLAB_SIZE_MAX (32*1024)
+
+/****************************************************************************************
+* Function name - slab_alloc_curl_init
+*
+* Description - Initializes libcurl globally with the memory allocator, or with the 
+*               system malloc, when the allocator is disabled (-b option)
+*
+* Input -       system_alloc - when true, libcurl uses the system malloc
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int slab_alloc_curl_init (int system_alloc);
+
+/****************************************************************************************
+* Function name - slab_alloc_dump_statistics
+*
+* Description - Prints the statistics of the memory allocator, collected from all 
+*               threads of the process, when the allocator is in use
+*
+* Input -       *file - pointer to the file to print to
+* Return Code/Output - None
+****************************************************************************************/
+void slab_alloc_dump_statistics (FILE* file);
+
+#endif /* SLAB_ALLOC_H */
@@ -0,0 +1,397 @@
+/*
+*     standby.c
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "standby.h"
+#include "batch.h"
+#include "client.h"
+#include "loader.h"
+#include "conf.h"
+
+/* Period in msec of testing SIGINT by the threads, waiting on standby */
+#define STANDBY_WAIT_PERIOD 100
+
+static void standby_enter (batch_context* bctx);
+static void standby_leave (batch_context* bctx);
+
+/*
+   The standby requests of the threads, <standby> fields of their batch contexts,
+   and the number of the threads loading are guarded by the <standby_lock>.
+*/
+static pthread_mutex_t standby_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t standby_cond = PTHREAD_COND_INITIALIZER;
+static batch_context* standby_bc_arr = 0;
+static int standby_batches_num = 0;
+
+/* Number of the threads, neither waiting on standby, nor completed */
+static int standby_loading_num = 0;
+
+
+/****************************************************************************************
+* Function name - threads_standby_init
+*
+* Description - Tests, whether the loading threads may be put on standby, and, when
+*               yes, puts on standby the threads above <active_num>. Otherwise, prints
+*               the reason and keeps all threads active.
+*
+* Input -       *bc_arr - array of the batch contexts of the loading threads
+*               batches_num - number of the loading threads
+*               active_num - number of the threads to start loading, 0 for all
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int threads_standby_init (batch_context* bc_arr, int batches_num, int active_num)
+{
+  const char* reason = 0;
+  int i;
+
+  if (! active_num || active_num > batches_num)
+    active_num = batches_num;
+
+  if (bc_arr[0].clients_balance)
+    reason = "does not run with CLIENTS_BALANCE";
+  else if (bc_arr[0].req_rate)
+    reason = "does not run with REQ_RATE";
+
+  if (reason)
+    {
+      if (active_num < batches_num)
+        fprintf (stderr, "%s - warning: standby of the threads %s, all %d threads "
+                 "are loading.\n", __func__, reason, batches_num);
+      return 0;
+    }
+
+  for (i = 0; i < batches_num; i++)
+    {
+      bc_arr[i].standby_loading = (i < active_num);
+      bc_arr[i].standby = bc_arr[i].standby_on = !bc_arr[i].standby_loading;
+    }
+
+  standby_bc_arr = bc_arr;
+  standby_batches_num = batches_num;
+  standby_loading_num = active_num;
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - threads_standby_activate
+*
+* Description - Called by the statistics thread to activate the first thread on
+*               standby
+*
+* Return Code/Output - Index of the thread activated, or -1, when none
+****************************************************************************************/
+int threads_standby_activate (void)
+{
+  int i, index = -1;
+
+  if (! standby_bc_arr)
+    return -1;
+
+  pthread_mutex_lock (&standby_lock);
+
+  for (i = 0; i < standby_batches_num && index == -1; i++)
+    {
+      batch_context* bctx = standby_bc_arr + i;
+
+      if (bctx->standby && ! bctx->standby_done)
+        {
+          bctx->standby = 0;
+
+          /* Counted at once, so that other threads do not complete the loading */
+          if (! bctx->standby_loading)
+            {
+              bctx->standby_loading = 1;
+              standby_loading_num++;
+            }
+          index = i;
+        }
+    }
+
+  pthread_cond_broadcast (&standby_cond);
+  pthread_mutex_unlock (&standby_lock);
+
+  return index;
+}
+
+/****************************************************************************************
+* Function name - threads_standby_retire
+*
+* Description - Called by the statistics thread to put the last active thread on
+*               standby. The last active thread keeps loading.
+*
+* Return Code/Output - Index of the thread put on standby, or -1, when none
+****************************************************************************************/
+int threads_standby_retire (void)
+{
+  int i, active = 0, index = -1;
+
+  if (! standby_bc_arr)
+    return -1;
+
+  pthread_mutex_lock (&standby_lock);
+
+  for (i = standby_batches_num - 1; i >= 0; i--)
+    {
+      batch_context* bctx = standby_bc_arr + i;
+
+      if (! bctx->standby && ! bctx->standby_done)
+        {
+          if (index == -1)
+            index = i;
+          active++;
+        }
+    }
+
+  if (active > 1)
+    standby_bc_arr[index].standby = 1;
+  else
+    index = -1;
+
+  pthread_mutex_unlock (&standby_lock);
+
+  return index;
+}
+
+/****************************************************************************************
+* Function name - threads_standby_active_num
+*
+* Description - Returns the number of the threads, that are not on standby
+*
+* Return Code/Output - Number of the threads, or -1, when the standby is disabled
+****************************************************************************************/
+int threads_standby_active_num (void)
+{
+  int i, active = 0;
+
+  if (! standby_bc_arr)
+    return -1;
+
+  pthread_mutex_lock (&standby_lock);
+
+  for (i = 0; i < standby_batches_num; i++)
+    {
+      if (! standby_bc_arr[i].standby)
+        active++;
+    }
+
+  pthread_mutex_unlock (&standby_lock);
+
+  return active;
+}
+
+/****************************************************************************************
+* Function name - threads_standby_check
+*
+* Description - Called periodically by a loading thread to put itself on standby or
+*               to become active, as requested by the statistics thread
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - None
+****************************************************************************************/
+void threads_standby_check (batch_context* bctx)
+{
+  int standby;
+
+  if (! standby_bc_arr)
+    return;
+
+  pthread_mutex_lock (&standby_lock);
+  standby = bctx->standby;
+  pthread_mutex_unlock (&standby_lock);
+
+  if (standby && ! bctx->standby_on)
+    standby_enter (bctx);
+  else if (! standby && bctx->standby_on)
+    standby_leave (bctx);
+}
+
+/****************************************************************************************
+* Function name - threads_standby_park
+*
+* Description - Called by a loading thread on standby instead of starting a request
+*               of the client. Parks the client till the thread is activated.
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - None
+****************************************************************************************/
+void threads_standby_park (client_context* cctx)
+{
+  batch_context* bctx = cctx->bctx;
+
+  cctx->standby_next = bctx->standby_parked;
+  bctx->standby_parked = cctx;
+}
+
+/****************************************************************************************
+* Function name - threads_standby_keep_loading
+*
+* Description - Called by the thread, that has no more clients to load. When the thread
+*               is on standby, waits to be activated and tells to keep loading, or tells
+*               to complete, when all active threads have completed loading.
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - When to keep loading - 1, when not - 0
+****************************************************************************************/
+int threads_standby_keep_loading (batch_context* bctx)
+{
+  struct timespec ts;
+  int activated;
+
+  if (! bctx->standby_on)
+    return 0;
+
+  /* The totals of the thread are up to date, while it is waiting */
+  stat_publish (bctx, get_tick_count (), 1);
+
+  pthread_mutex_lock (&standby_lock);
+
+  if (bctx->standby && bctx->standby_loading)
+    {
+      bctx->standby_loading = 0;
+      standby_loading_num--;
+      pthread_cond_broadcast (&standby_cond);
+    }
+
+  while (bctx->standby && standby_loading_num > 0 && ! stop_loading)
+    {
+      clock_gettime (CLOCK_REALTIME, &ts);
+      ts.tv_nsec += STANDBY_WAIT_PERIOD * 1000000L;
+      if (ts.tv_nsec >= 1000000000L)
+        {
+          ts.tv_sec++;
+          ts.tv_nsec -= 1000000000L;
+        }
+      pthread_cond_timedwait (&standby_cond, &standby_lock, &ts);
+    }
+
+  activated = ! bctx->standby;
+
+  pthread_mutex_unlock (&standby_lock);
+
+  if (! activated)
+    return 0;
+
+  standby_leave (bctx);
+  return 1;
+}
+
+/****************************************************************************************
+* Function name - threads_standby_release
+*
+* Description - Called at the end of loading by the thread. Lets the threads on standby
+*               complete, when the thread is the last active one.
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - None
+****************************************************************************************/
+void threads_standby_release (batch_context* bctx)
+{
+  if (! standby_bc_arr)
+    return;
+
+  pthread_mutex_lock (&standby_lock);
+
+  bctx->standby_done = 1;
+
+  if (bctx->standby_loading)
+    {
+      bctx->standby_loading = 0;
+      standby_loading_num--;
+    }
+
+  pthread_cond_broadcast (&standby_cond);
+  pthread_mutex_unlock (&standby_lock);
+}
+
+/****************************************************************************************
+* Function name - standby_enter
+*
+* Description - Puts the thread on standby: pauses the ramp-up of its clients and
+*               parks its sleeping clients. Clients with requests in flight are parked,
+*               when their requests complete.
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - None
+****************************************************************************************/
+static void standby_enter (batch_context* bctx)
+{
+  int i;
+
+  bctx->standby_on = 1;
+
+  bctx->standby_gradual = bctx->do_client_num_gradual_increase;
+  bctx->do_client_num_gradual_increase = 0;
+
+  for (i = 0; i < bctx->client_num_max; i++)
+    {
+      client_context* cctx = &bctx->cctx_array[i];
+
+      /* The wake-up time is kept to respect the sleeping time */
+      if (client_sleeping_cancel (cctx) == 0)
+        threads_standby_park (cctx);
+    }
+}
+
+/****************************************************************************************
+* Function name - standby_leave
+*
+* Description - Activates the thread: schedules its parked clients to load and
+*               resumes the ramp-up of its clients
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - None
+****************************************************************************************/
+static void standby_leave (batch_context* bctx)
+{
+  const unsigned long now_time = get_tick_count ();
+  client_context* cctx;
+
+  bctx->standby_on = 0;
+
+  /* The parked clients load, when their sleeping time is over */
+  while ((cctx = bctx->standby_parked))
+    {
+      bctx->standby_parked = cctx->standby_next;
+
+      if (client_sleeping_schedule (cctx, cctx->tn.next_timer > now_time ?
+                                    cctx->tn.next_timer : now_time) == -1)
+        {
+          fprintf (stderr, "%s - error: client_sleeping_schedule () failed.\n",
+                   __func__);
+        }
+    }
+
+  bctx->do_client_num_gradual_increase |= bctx->standby_gradual;
+  bctx->standby_gradual = 0;
+
+  /* Clients of a thread, activated for the first time, start loading */
+  if (! bctx->clients_current_sched_num)
+    add_loading_clients (bctx);
+}
@@ -0,0 +1,134 @@
+/*
+*     standby.h
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef STANDBY_H
+#define STANDBY_H
+
+/*
+  Runtime number of the loading threads.
+
+  The batch is cut once to -t sub-batches, each loaded by its own thread,
+  but only -j threads start loading, while the others are on standby.
+  At run time the statistics thread activates a thread on standby or puts
+  an active thread on standby by the keyboard keys [>] and [<].
+
+  A thread on standby does not start requests. The clients of the thread
+  complete their requests in flight and are parked, as well as its sleeping
+  clients, and the ramp-up of its clients is paused. When no client of the
+  thread is active, the thread waits to be activated, and then continues to
+  load its parked clients and to schedule its clients, not scheduled yet.
+  When all active threads complete loading, the threads on standby complete
+  as well.
+*/
+
+struct batch_context;
+struct client_context;
+
+/****************************************************************************************
+* Function name - threads_standby_init
+*
+* Description - Tests, whether the loading threads may be put on standby, and, when
+*               yes, puts on standby the threads above <active_num>. Otherwise, prints
+*               the reason and keeps all threads active.
+*
+* Input -       *bc_arr - array of the batch contexts of the loading threads
+*               batches_num - number of the loading threads
+*               active_num - number of the threads to start loading, 0 for all
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int threads_standby_init (struct batch_context* bc_arr, int batches_num, int active_num);
+
+/****************************************************************************************
+* Function name - threads_standby_activate
+*
+* Description - Called by the statistics thread to activate the first thread on
+*               standby
+*
+* Return Code/Output - Index of the thread activated, or -1, when none
+****************************************************************************************/
+int threads_standby_activate (void);
+
+/****************************************************************************************
+* Function name - threads_standby_retire
+*
+* Description - Called by the statistics thread to put the last active thread on
+*               standby. The last active thread keeps loading.
+*
+* Return Code/Output - Index of the thread put on standby, or -1, when none
+****************************************************************************************/
+int threads_standby_retire (void);
+
+/****************************************************************************************
+* Function name - threads_standby_active_num
+*
+* Description - Returns the number of the threads, that are not on standby
+*
+* Return Code/Output - Number of the threads, or -1, when the standby is disabled
+****************************************************************************************/
+int threads_standby_active_num (void);
+
+/****************************************************************************************
+* Function name - threads_standby_check
+*
+* Description - Called periodically by a loading thread to put itself on standby or
+*               to become active, as requested by the statistics thread
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - None
+****************************************************************************************/
+void threads_standby_check (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - threads_standby_park
+*
+* Description - Called by a loading thread on standby instead of starting a request
+*               of the client. Parks the client till the thread is activated.
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - None
+****************************************************************************************/
+void threads_standby_park (struct client_context* cctx);
+
+/****************************************************************************************
+* Function name - threads_standby_keep_loading
+*
+* Description - Called by the thread, that has no more clients to load. When the thread
+*               is on standby, waits to be activated and tells to keep loading, or tells
+*               to complete, when all active threads have completed loading.
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - When to keep loading - 1, when not - 0
+****************************************************************************************/
+int threads_standby_keep_loading (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - threads_standby_release
+*
+* Description - Called at the end of loading by the thread. Lets the threads on standby
+*               complete, when the thread is the last active one.
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Return Code/Output - None
+****************************************************************************************/
+void threads_standby_release (struct batch_context* bctx);
+
+#endif /* STANDBY_H */
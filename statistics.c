@@ -28,6 +28,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "batch.h"
 #include "client.h"
@@ -36,6 +38,8 @@
 
 #include "statistics.h"
 #include "screen.h"
+#include "standby.h"
+#include "slab_alloc.h"
 
 #define UNSECURE_APPL_STR "H/F   "
 #define SECURE_APPL_STR "H/F/S "
@@ -70,6 +74,36 @@ static void dump_stat_to_screen (char* protocol,
 
 static void dump_clients (client_context* cctx_array);
 
+static void stat_merge_threads (batch_context* rctx, 
+                                batch_context* thr_arr,
+                                int thr_num,
+                                int final);
+
+static void stat_wait_threads (batch_context* bctx);
+
+static void print_interval (batch_context* rctx,
+                            batch_context* bc_arr,
+                            int batches_num,
+                            unsigned long now,
+                            int clients_total_num);
+
+static int print_final (batch_context* rctx, unsigned long now, int clients_total_num);
+
+static void* stat_thread_function (void* arg);
+
+/* Set, when the statistics thread reports on behalf of the loading threads */
+int stat_thread_enabled = 0;
+
+/* 
+   The statistics thread and its report context, keeping the total counters and 
+   the files of the total statistics, as the batch group leader keeps them.
+*/
+static pthread_t stat_thread_id;
+static batch_context stat_rctx;
+static batch_context* stat_bc_arr = 0;
+static int stat_batches_num = 0;
+static int stat_thread_stop_flag = 0;
+
 /****************************************************************************************
 * Function name - stat_point_add
 *
@@ -97,28 +131,53 @@ void stat_point_add (stat_point* left, stat_point* right)
   left->other_errs += right->other_errs;
   left->url_timeout_errs += right->url_timeout_errs;
   
-  const int total_points = left->appl_delay_points + right->appl_delay_points;
-
-  if (total_points > 0)
-    {
-      left->appl_delay = (left->appl_delay * left->appl_delay_points  + 
-                 right->appl_delay * right->appl_delay_points) / total_points;
-
-      left->appl_delay_points = total_points;
-    }
-  else
-      left->appl_delay = 0;
+  left->appl_delay_points += right->appl_delay_points;
+  left->appl_delay_sum += right->appl_delay_sum;
+  left->appl_delay = left->appl_delay_points > 0 ?
+    left->appl_delay_sum / left->appl_delay_points : 0;
+
+  left->appl_delay_2xx_points += right->appl_delay_2xx_points;
+  left->appl_delay_2xx_sum += right->appl_delay_2xx_sum;
+  left->appl_delay_2xx = left->appl_delay_2xx_points > 0 ?
+    left->appl_delay_2xx_sum / left->appl_delay_2xx_points : 0;
+}
 
-   const int total_points_2xx = left->appl_delay_2xx_points + right->appl_delay_2xx_points;
+/****************************************************************************************
+* Function name - stat_point_sub
+*
+* Description - Subtracts counters of one stat_point object from another
+* Input -       *left  -pointer to the stat_point, where counter will be subtracted
+*               *right -pointer to the stat_point, which counter will be 
+*                       subtracted from the <left>
+* Return Code/Output - None
+****************************************************************************************/
+void stat_point_sub (stat_point* left, stat_point* right)
+{
+  if (!left || !right)
+    return;
 
-  if (total_points_2xx > 0)
-    {
-      left->appl_delay_2xx = (left->appl_delay_2xx * left->appl_delay_2xx_points  + 
-                 right->appl_delay_2xx * right->appl_delay_2xx_points) / total_points_2xx;
-      left->appl_delay_2xx_points = total_points_2xx;
-    }
-  else
-      left->appl_delay_2xx = 0;
+  left->data_in -= right->data_in;
+  left->data_out -= right->data_out;
+  
+  left->requests -= right->requests;
+
+  left->resp_1xx -= right->resp_1xx;
+  left->resp_2xx -= right->resp_2xx;
+  left->resp_3xx -= right->resp_3xx;
+  left->resp_4xx -= right->resp_4xx;
+  left->resp_5xx -= right->resp_5xx;
+  left->other_errs -= right->other_errs;
+  left->url_timeout_errs -= right->url_timeout_errs;
+
+  left->appl_delay_points -= right->appl_delay_points;
+  left->appl_delay_sum -= right->appl_delay_sum;
+  left->appl_delay = left->appl_delay_points > 0 ?
+    left->appl_delay_sum / left->appl_delay_points : 0;
+
+  left->appl_delay_2xx_points -= right->appl_delay_2xx_points;
+  left->appl_delay_2xx_sum -= right->appl_delay_2xx_sum;
+  left->appl_delay_2xx = left->appl_delay_2xx_points > 0 ?
+    left->appl_delay_2xx_sum / left->appl_delay_2xx_points : 0;
 }
 
 /****************************************************************************************
@@ -140,6 +199,7 @@ void stat_point_reset (stat_point* p)
 
   p->appl_delay_points = p->appl_delay_2xx_points = 0;
   p->appl_delay = p->appl_delay_2xx = 0;
+  p->appl_delay_sum = p->appl_delay_2xx_sum = 0;
 
 }
 
@@ -170,6 +230,49 @@ void op_stat_point_add (op_stat_point* left, op_stat_point* right)
     }
   
   left->call_init_count += right->call_init_count;
+
+  left->pipe_requests += right->pipe_requests;
+  left->pipe_connections += right->pipe_connections;
+  left->pipe_inflight_sum += right->pipe_inflight_sum;
+  left->pipe_open_sum += right->pipe_open_sum;
+
+  if (right->pipe_depth_max > left->pipe_depth_max)
+    left->pipe_depth_max = right->pipe_depth_max;
+}
+
+/****************************************************************************************
+* Function name - op_stat_point_sub
+*
+* Description - Subtracts counters of one op_stat_point object from another.
+*               The maximal pipeline depth is left as is.
+* Input -       *left  -  pointer to the op_stat_point, where counter will be subtracted
+*               *right -  pointer to the op_stat_point, which counter will be subtracted
+*                         from the <left>
+* Return Code/Output - None
+****************************************************************************************/
+void op_stat_point_sub (op_stat_point* left, op_stat_point* right)
+{
+  size_t i;
+  
+  if (!left || !right)
+    return;
+
+  if (left->url_num != right->url_num)
+    return;
+  
+  for ( i = 0; i < left->url_num; i++)
+    {
+      left->url_ok[i] -= right->url_ok[i];
+      left->url_failed[i] -= right->url_failed[i];
+      left->url_timeouted[i] -= right->url_timeouted[i];
+    }
+  
+  left->call_init_count -= right->call_init_count;
+
+  left->pipe_requests -= right->pipe_requests;
+  left->pipe_connections -= right->pipe_connections;
+  left->pipe_inflight_sum -= right->pipe_inflight_sum;
+  left->pipe_open_sum -= right->pipe_open_sum;
 }
 
 /****************************************************************************************
@@ -195,6 +298,9 @@ void op_stat_point_reset (op_stat_point* point)
     /* Don't null point->url_num ! */
 
    point->call_init_count = 0;
+
+   point->pipe_requests = point->pipe_connections = 0;
+   point->pipe_inflight_sum = point->pipe_open_sum = point->pipe_depth_max = 0;
 }
 
 /****************************************************************************************
@@ -314,23 +420,436 @@ void op_stat_call_init_count_inc (op_stat_point* op_stat)
 }
 
 /****************************************************************************************
-* Function name - get_tick_count
+* Function name - op_stat_pipe_sample
+*
+* Description - Samples pipelining statistics at a request completion
+*
+* Input -       *op_stat         - pointer to the op_stat_point to update
+*               inflight         - number of requests in flight
+*               connections_open - number of open connections
+* Return Code/Output - None
+****************************************************************************************/
+void op_stat_pipe_sample (op_stat_point* op_stat,
+                          unsigned long inflight,
+                          unsigned long connections_open)
+{
+  unsigned long depth;
+
+  if (!op_stat)
+    return;
+
+  op_stat->pipe_requests++;
+
+  if (!connections_open)
+    return;
+
+  op_stat->pipe_inflight_sum += inflight;
+  op_stat->pipe_open_sum += connections_open;
+
+  depth = (inflight + connections_open - 1) / connections_open;
+  if (depth > op_stat->pipe_depth_max)
+    op_stat->pipe_depth_max = depth;
+}
+
+/****************************************************************************************
+* Function name - stat_snapshot_init
+*
+* Description - Initializes a statistics snapshot by allocating its url counters
+*
+* Input -       *snap   - pointer to the snapshot
+*               url_num - number of urls
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int stat_snapshot_init (stat_snapshot* snap, size_t url_num)
+{
+  memset (snap, 0, sizeof (*snap));
+
+  return op_stat_point_init (&snap->op, url_num);
+}
+
+/****************************************************************************************
+* Function name - stat_snapshot_release
+*
+* Description - Releases memory allocated by stat_snapshot_init ()
+*
+* Input -       *snap - pointer to the snapshot
+* Return Code/Output - None
+****************************************************************************************/
+void stat_snapshot_release (stat_snapshot* snap)
+{
+  op_stat_point_release (&snap->op);
+}
+
+/****************************************************************************************
+* Function name - stat_published_size
+*
+* Description - Returns size of a published snapshot with its url counters,
+*               rounded up to cache lines
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - Size in bytes
+****************************************************************************************/
+static size_t stat_published_size (batch_context* bctx)
+{
+  const size_t size = sizeof (stat_snapshot) + 
+    3 * bctx->urls_num * sizeof (unsigned long);
+
+  return (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+/****************************************************************************************
+* Function name - stat_published_init
+*
+* Description - Allocates the snapshots, published by the loading threads (or worker
+*               processes) for the batch group leader, each with its url counters
+*               at own cache lines. When <shared>, the snapshots are allocated in
+*               memory, shared with the processes to be forked.
+*
+* Input -       *bc_arr - array of the batch contexts of the threads
+*               batches_num - number of the threads
+*               shared - when true, allocates in the shared memory
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int stat_published_init (batch_context* bc_arr, int batches_num, int shared)
+{
+  const size_t size = stat_published_size (bc_arr);
+  const size_t url_num = bc_arr->urls_num;
+  char* mem;
+  int i;
+
+  /* Zeroed and page-aligned */
+  mem = mmap (NULL, size * batches_num, PROT_READ | PROT_WRITE,
+              (shared ? MAP_SHARED : MAP_PRIVATE) | MAP_ANONYMOUS, -1, 0);
+
+  if (mem == MAP_FAILED)
+    {
+      fprintf (stderr, "%s - error: mmap () failed with errno %d.\n", 
+               __func__, errno);
+      return -1;
+    }
+
+  for (i = 0; i < batches_num; i++, mem += size)
+    {
+      stat_snapshot* snap = (stat_snapshot *) mem;
+      unsigned long* counters = (unsigned long *) (snap + 1);
+
+      if (url_num)
+        {
+          snap->op.url_num = url_num;
+          snap->op.url_ok = counters;
+          snap->op.url_failed = counters + url_num;
+          snap->op.url_timeouted = counters + 2 * url_num;
+        }
+
+      bc_arr[i].stat_published = snap;
+    }
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - stat_published_release
+*
+* Description - Releases the snapshots, allocated by stat_published_init ()
+*
+* Input -       *bc_arr - array of the batch contexts of the threads
+*               batches_num - number of the threads
+* Return Code/Output - None
+****************************************************************************************/
+void stat_published_release (batch_context* bc_arr, int batches_num)
+{
+  int i;
+
+  if (! bc_arr->stat_published)
+    return;
+
+  munmap (bc_arr->stat_published, stat_published_size (bc_arr) * batches_num);
+
+  for (i = 0; i < batches_num; i++)
+    bc_arr[i].stat_published = 0;
+}
+
+/****************************************************************************************
+* Function name - stat_publish
+*
+* Description - Called by a loading thread, other than the batch group leader, to
+*               add its statistics counters to the published snapshot, and to reset 
+*               the counters. Publishes once in STAT_PUBLISH_PERIOD msec, unless forced.
+*
+* Input -       *bctx    - pointer to the batch context of the thread
+*               now_time - current time in msec
+*               force    - when true, publishes at once
+* Return Code/Output - None
+****************************************************************************************/
+void stat_publish (batch_context* bctx, unsigned long now_time, int force)
+{
+  stat_snapshot* snap = bctx->stat_published;
+
+  if (!threads_subbatches_num || is_batch_group_leader (bctx))
+    return;
+
+  if (!force && now_time - bctx->stat_published_time < STAT_PUBLISH_PERIOD)
+    return;
+
+  bctx->stat_published_time = now_time;
+
+  /* Odd sequence - the snapshot is being written */
+  __atomic_store_n (&snap->seq, snap->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+
+  stat_point_add (&snap->http, &bctx->rt->http_delta);
+  stat_point_add (&snap->https, &bctx->rt->https_delta);
+  op_stat_point_add (&snap->op, &bctx->rt->op_delta);
+  snap->clients = pending_active_and_waiting_clients_num_stat (bctx);
+
+  /* Even sequence - the snapshot is consistent */
+  __atomic_store_n (&snap->seq, snap->seq + 1, __ATOMIC_RELEASE);
+
+  /* The counters are owned by the thread, thus reset without races */
+  stat_point_reset (&bctx->rt->http_delta);
+  stat_point_reset (&bctx->rt->https_delta);
+  op_stat_point_reset (&bctx->rt->op_delta);
+}
+
+/****************************************************************************************
+* Function name - stat_publish_final
+*
+* Description - Called by a loading thread, other than the batch group leader, at the
+*               end of loading to publish the rest of its counters and to notify the
+*               leader, waiting for all threads to report before the final statistics.
+*
+* Input -       *bctx    - pointer to the batch context of the thread
+*               now_time - current time in msec
+* Return Code/Output - None
+****************************************************************************************/
+void stat_publish_final (batch_context* bctx, unsigned long now_time)
+{
+  if (!threads_subbatches_num || is_batch_group_leader (bctx))
+    return;
+
+  stat_publish (bctx, now_time, 1);
+
+  __atomic_store_n (&bctx->stat_published->final, 1, __ATOMIC_RELEASE);
+}
+
+/****************************************************************************************
+* Function name - stat_snapshot_read
+*
+* Description - Reads the snapshot, published by another thread
+*
+* Input -       *from - pointer to the published snapshot
+*               *to   - pointer to the snapshot to copy to
+* Return Code/Output - On success - 0, when the snapshot is being written -1
+****************************************************************************************/
+static int stat_snapshot_read (stat_snapshot* from, stat_snapshot* to)
+{
+  const unsigned long seq = __atomic_load_n (&from->seq, __ATOMIC_ACQUIRE);
+
+  if (seq & 1)
+    return -1;
+
+  to->http = from->http;
+  to->https = from->https;
+  op_stat_point_reset (&to->op);
+  op_stat_point_add (&to->op, &from->op);
+  to->clients = from->clients;
+
+  __atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+  return __atomic_load_n (&from->seq, __ATOMIC_RELAXED) == seq ? 0 : -1;
+}
+
+/****************************************************************************************
+* Function name - stat_published_read
+*
+* Description - Reads a consistent copy of the snapshot, published by a loading thread.
+*               Used by a distributed agent to report the snapshot to the coordinator.
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Output -      *to   - the snapshot, initialized by stat_snapshot_init ()
+* Return Code/Output - When the thread has published its final counters - 1, else 0
+****************************************************************************************/
+int stat_published_read (batch_context* bctx, stat_snapshot* to)
+{
+  /* The final flag is set after the final counters have been published */
+  const int final = __atomic_load_n (&bctx->stat_published->final, __ATOMIC_ACQUIRE);
+
+  while (stat_snapshot_read (bctx->stat_published, to) == -1)
+    ;
+
+  return (to->final = final);
+}
+
+/****************************************************************************************
+* Function name - stat_published_write
+*
+* Description - Replaces the published snapshot of a batch by the snapshot, reported
+*               by a distributed agent, loading the batch. Used by the coordinator,
+*               the only writer of the snapshot, instead of the loading thread.
+*
+* Input -       *bctx - pointer to the batch context of the agent
+*               *from - the snapshot reported by the agent
+* Return Code/Output - None
+****************************************************************************************/
+void stat_published_write (batch_context* bctx, stat_snapshot* from)
+{
+  stat_snapshot* snap = bctx->stat_published;
+
+  __atomic_store_n (&snap->seq, snap->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+
+  snap->http = from->http;
+  snap->https = from->https;
+  op_stat_point_reset (&snap->op);
+  op_stat_point_add (&snap->op, &from->op);
+  snap->clients = from->clients;
+
+  __atomic_store_n (&snap->seq, snap->seq + 1, __ATOMIC_RELEASE);
+
+  if (from->final)
+    __atomic_store_n (&snap->final, 1, __ATOMIC_RELEASE);
+}
+
+/****************************************************************************************
+* Function name - stat_merge_threads
+*
+* Description - Called by the batch group leader or by the statistics thread to add
+*               to the counters of the report context the statistics, published by 
+*               the loading threads since the latest merge. A snapshot being written 
+*               at the moment is merged next time, unless <final> is true.
+*
+* Input -       *rctx    - pointer to the report context: the leader or of the 
+*                          statistics thread
+*               *thr_arr - array of the batch contexts of the threads to merge
+*               thr_num  - number of the threads to merge
+*               final    - when true, waits for each snapshot to be consistent
+* Return Code/Output - None
+****************************************************************************************/
+static void stat_merge_threads (batch_context* rctx, 
+                                batch_context* thr_arr,
+                                int thr_num,
+                                int final)
+{
+  int i;
+
+  for (i = 0; i < thr_num; i++)
+    {
+      batch_context* thr = thr_arr + i;
+      stat_snapshot tmp;
+      int tries = 0;
+
+      while (stat_snapshot_read (thr->stat_published, &thr->stat_read) == -1)
+        {
+          if (!final && ++tries >= 4)
+            break;
+        }
+
+      if (!final && tries >= 4)
+        continue;
+
+      /* The counters since the latest merge */
+      stat_point_add (&rctx->rt->http_delta, &thr->stat_read.http);
+      stat_point_sub (&rctx->rt->http_delta, &thr->stat_merged.http);
+      stat_point_add (&rctx->rt->https_delta, &thr->stat_read.https);
+      stat_point_sub (&rctx->rt->https_delta, &thr->stat_merged.https);
+      op_stat_point_add (&rctx->rt->op_delta, &thr->stat_read.op);
+      op_stat_point_sub (&rctx->rt->op_delta, &thr->stat_merged.op);
+
+      /* The snapshot read becomes the merged one */
+      tmp = thr->stat_merged;
+      thr->stat_merged = thr->stat_read;
+      thr->stat_read = tmp;
+    }
+}
+
+/****************************************************************************************
+* Function name - stat_wait_threads
+*
+* Description - Called by the batch group leader at the end of loading to wait for
+*               all other loading threads to publish their final counters. Does not
+*               wait, when the loading is stopped by SIGINT.
+*
+* Input -       *bctx - pointer to the batch context of the leader
+* Return Code/Output - None
+****************************************************************************************/
+static void stat_wait_threads (batch_context* bctx)
+{
+  int i;
+
+  for (i = 1; i < threads_subbatches_num; i++)
+    {
+      while (! stop_loading &&
+             ! __atomic_load_n (&(bctx + i)->stat_published->final, __ATOMIC_ACQUIRE))
+        usleep (STAT_PUBLISH_PERIOD * 1000 / 10);
+    }
+}
+
+/* 
+   The latest timestamp in usec of the monotonic clock read by the thread.
+   Each loading thread runs its own event loop, thus the cache is per-loop.
+*/
+static __thread unsigned long long tick_cache_usec = 0;
+
+/****************************************************************************************
+* Function name - get_tick_count_usec
 *
-* Description - Delivers timestamp in milliseconds.
+* Description - Reads the monotonic clock, refreshes the per-thread cached timestamp
+*               and delivers it in microseconds.
 * 
-* Return Code/Output - timestamp in milliseconds or -1 on errors
+* Return Code/Output - timestamp in microseconds
 ****************************************************************************************/
-unsigned long get_tick_count ()
+unsigned long long get_tick_count_usec (void)
 {
-  struct timeval  tval;
+  struct timespec ts;
 
-  if (gettimeofday (&tval, NULL) == -1)
+  if (clock_gettime (CLOCK_MONOTONIC, &ts) == -1)
     {
-      fprintf(stderr, "%s - gettimeofday () failed with errno %d.\n", 
+      fprintf(stderr, "%s - clock_gettime () failed with errno %d.\n", 
               __func__, errno);
       exit (1);
     }
-  return tval.tv_sec * 1000 + (tval.tv_usec / 1000);
+
+  return (tick_cache_usec = 
+          (unsigned long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/****************************************************************************************
+* Function name - get_tick_count
+*
+* Description - Reads the monotonic clock, refreshes the per-thread cached timestamp
+*               and delivers it in milliseconds.
+* 
+* Return Code/Output - timestamp in milliseconds
+****************************************************************************************/
+unsigned long get_tick_count ()
+{
+  return (unsigned long) (get_tick_count_usec () / 1000);
+}
+
+/****************************************************************************************
+* Function name - cached_tick_count_usec
+*
+* Description - Delivers the per-thread cached timestamp in microseconds without
+*               reading the clock. Reads the clock only, when the cache is empty.
+* 
+* Return Code/Output - timestamp in microseconds
+****************************************************************************************/
+unsigned long long cached_tick_count_usec (void)
+{
+  return tick_cache_usec ? tick_cache_usec : get_tick_count_usec ();
+}
+
+/****************************************************************************************
+* Function name - cached_tick_count
+*
+* Description - Delivers the per-thread cached timestamp in milliseconds without
+*               reading the clock. Reads the clock only, when the cache is empty.
+* 
+* Return Code/Output - timestamp in milliseconds
+****************************************************************************************/
+unsigned long cached_tick_count (void)
+{
+  return (unsigned long) (cached_tick_count_usec () / 1000);
 }
 
 
@@ -347,104 +866,127 @@ unsigned long get_tick_count ()
 ****************************************************************************************/
 void dump_final_statistics (client_context* cctx)
 {
-  int i;
-  batch_context* bctx = cctx->bctx;
+  /* The client may have been moved to another thread by CLIENTS_BALANCE */
+  batch_context* bctx = cctx->home_bctx;
   unsigned long now = get_tick_count();
 
-  for (i = 0; i <= threads_subbatches_num; i++)
+  if (!threads_subbatches_num || is_batch_group_leader (bctx))
     {
-      if (i)
-        {
-          stat_point_add (&bctx->http_delta, &(bctx + i)->http_delta);
-          stat_point_add (&bctx->https_delta, &(bctx + i)->https_delta);
-          
-          /* Other threads statistics - reset just after collecting */
-          stat_point_reset (&(bctx + i)->http_delta); 
-          stat_point_reset (&(bctx + i)->https_delta);
-        }
+      /* All threads report, before the leader merges their final counters */
+      const int batches_num = threads_subbatches_num ? threads_subbatches_num : 1;
+
+      stat_wait_threads (bctx);
+      stat_merge_threads (bctx, bctx + 1, batches_num - 1, 1);
+    }
+  else
+    {
+      /* 
+         A thread other than the leader publishes the rest of its counters
+         and reports its own totals.
+      */
+      stat_publish_final (bctx, now);
+
+      bctx->http_total = bctx->stat_published->http;
+      bctx->https_total = bctx->stat_published->https;
+      op_stat_point_reset (&bctx->op_total);
+      op_stat_point_add (&bctx->op_total, &bctx->stat_published->op);
     }
   
-  print_snapshot_interval_statistics (now - bctx->last_measure,
-		&bctx->http_delta,  
-		&bctx->https_delta);
+  if (print_final (bctx, 
+                   now, 
+                   pending_active_and_waiting_clients_num_stat (bctx)) == -1)
+    return;
+
+  /* The allocator of libcurl is reported once for all threads */
+  if (!threads_subbatches_num || is_batch_group_leader (bctx))
+    slab_alloc_dump_statistics (stdout);
 
-  stat_point_add (&bctx->http_total, &bctx->http_delta);
-  stat_point_add (&bctx->https_total, &bctx->https_delta); 
+  dump_clients (cctx);
+  (void)fprintf (stderr, "\nExited. For details look in the files:\n"
+           "- %s.log for errors and traces;\n"
+           "- %s.txt for loading statistics;\n"
+           "- %s.ctx for virtual client based statistics.\n",
+	   bctx->batch_name, bctx->batch_name, bctx->batch_name);
+  if (bctx->dump_opstats)
+      (void)fprintf (stderr,"- %s.ops for operational statistics.\n",
+      bctx->batch_name);
+  (void)fprintf (stderr, 
+           "Add -v and -u options to the command line for "
+	   "verbose output to %s.log file.\n",bctx->batch_name);
+}
+
+/****************************************************************************************
+* Function name - print_final
+*
+* Description - Outputs the final statistics of the report context to stdout and to 
+*               the statistics files of the context.
+*
+* Input -       *rctx    - pointer to the report context: a batch or the statistics thread
+*               now      - current time in msec of the monotonic clock
+*               clients_total_num - number of clients to report
+* Return Code/Output - On success - 0, when loading has not run a second -1
+****************************************************************************************/
+static int print_final (batch_context* rctx, unsigned long now, int clients_total_num)
+{
+  print_snapshot_interval_statistics (now - rctx->last_measure,
+		&rctx->rt->http_delta,  
+		&rctx->rt->https_delta);
+
+  stat_point_add (&rctx->http_total, &rctx->rt->http_delta);
+  stat_point_add (&rctx->https_total, &rctx->rt->https_delta); 
     
   fprintf(stdout,"\n==================================================="
           "====================================\n");
-  fprintf(stdout,"End of the test for batch: %-10.10s\n", bctx->batch_name); 
+  fprintf(stdout,"End of the test for batch: %-10.10s\n", rctx->batch_name); 
   fprintf(stdout,"======================================================"
           "=================================\n\n");
   
   now = get_tick_count();
 
-  const int seconds_run = (int)(now - bctx->start_time)/ 1000;
+  const int seconds_run = (int)(now - rctx->start_time)/ 1000;
   if (!seconds_run)
-    return;
+    return -1;
   
   fprintf(stdout,"\nTest total duration was %d seconds and CAPS average %ld:\n", 
-          seconds_run, bctx->op_total.call_init_count / seconds_run);
+          seconds_run, rctx->op_total.call_init_count / seconds_run);
 
   dump_statistics (seconds_run, 
-                   &bctx->http_total,
-                   &bctx->https_total);
-
+                   &rctx->http_total,
+                   &rctx->https_total);
 
-  for (i = 0; i <= threads_subbatches_num; i++)
-    {
-      if (i)
-        {
-          op_stat_point_add (&bctx->op_delta, &(bctx + i)->op_delta );
-          
-          /* Other threads operational statistics - reset just after collecting */
-          op_stat_point_reset (&(bctx + i)->op_delta);
-        }
-    }
-  op_stat_point_add (&bctx->op_total, &bctx->op_delta);
+  op_stat_point_add (&rctx->op_total, &rctx->rt->op_delta);
   
-  print_operational_statistics (bctx->opstats_file,
-                                &bctx->op_delta, 
-                                &bctx->op_total, 
-                                bctx->url_ctx_array);
+  print_operational_statistics (rctx->opstats_file,
+                                &rctx->rt->op_delta, 
+                                &rctx->op_total, 
+                                rctx->url_ctx_array);
 
 
-  if (bctx->statistics_file)
+  if (rctx->statistics_file)
     {
 
-      print_statistics_footer_to_file (bctx->statistics_file);
-      print_statistics_header (bctx->statistics_file);
+      print_statistics_footer_to_file (rctx->statistics_file);
+      print_statistics_header (rctx->statistics_file);
 
-      const unsigned long loading_t = now - bctx->start_time;
+      const unsigned long loading_t = now - rctx->start_time;
       const unsigned long loading_time = loading_t ? loading_t : 1;
  
-      print_statistics_data_to_file (bctx->statistics_file,
+      print_statistics_data_to_file (rctx->statistics_file,
 				     loading_time/1000,
 				     UNSECURE_APPL_STR,
-				     pending_active_and_waiting_clients_num_stat (bctx),
-				     &bctx->http_total,
+				     clients_total_num,
+				     &rctx->http_total,
 				     loading_time);
 			
-      print_statistics_data_to_file (bctx->statistics_file, 
+      print_statistics_data_to_file (rctx->statistics_file, 
 				     loading_time/1000,
 				     SECURE_APPL_STR,
-				     pending_active_and_waiting_clients_num_stat (bctx),
-				     &bctx->https_total,
+				     clients_total_num,
+				     &rctx->https_total,
 				     loading_time);
     }
 
-  dump_clients (cctx);
-  (void)fprintf (stderr, "\nExited. For details look in the files:\n"
-           "- %s.log for errors and traces;\n"
-           "- %s.txt for loading statistics;\n"
-           "- %s.ctx for virtual client based statistics.\n",
-	   bctx->batch_name, bctx->batch_name, bctx->batch_name);
-  if (bctx->dump_opstats)
-      (void)fprintf (stderr,"- %s.ops for operational statistics.\n",
-      bctx->batch_name);
-  (void)fprintf (stderr, 
-           "Add -v and -u options to the command line for "
-	   "verbose output to %s.log file.\n",bctx->batch_name);
+  return 0;
 }
 
 /******
@@ -469,30 +1011,65 @@ char *ascii_time (char *tbuf)
 *
 * Description - Dumps summary statistics since the start of load
 * Input -       *bctx - pointer to batch structure
-*               now   - current time in msec since epoch
+*               now   - current time in msec of the monotonic clock
 * Return Code/Output - None
 ****************************************************************************************/
 void dump_snapshot_interval (batch_context* bctx, unsigned long now)
 {
-  if (!stop_loading)
+  if (stop_loading)
     {
-      fprintf(stdout, "\033[2J");
+      dump_final_statistics (bctx->cctx_array);
+      screen_release ();
+      exit (1); 
     }
 
   int i;
-  int total_current_clients = 0;
+  const int batches_num = threads_subbatches_num ? threads_subbatches_num : 1;
+
+  /* Collect the statistics of other threads */
+  stat_merge_threads (bctx, bctx + 1, batches_num - 1, 0);
+
+  /* Clients of other threads are taken from their published statistics */
+  int total_current_clients = pending_active_and_waiting_clients_num_stat (bctx);
 
-  for (i = 0; i <= threads_subbatches_num; i++)
+  for (i = 1; i < batches_num; i++)
     {
-      total_current_clients +=
-        pending_active_and_waiting_clients_num_stat (bctx + i);
+      total_current_clients += (bctx + i)->stat_merged.clients;
     }
 
-  dump_snapshot_interval_and_advance_total_statistics (bctx, 
+  print_interval (bctx, bctx, batches_num, now, total_current_clients);
+}
+
+/****************************************************************************************
+* Function name - print_interval
+*
+* Description - Outputs the interval and summary statistics of the report context to
+*               the screen and to the statistics files of the context and advances the 
+*               total counters. The ramp-up state is reported for the loading threads.
+*
+* Input -       *rctx       - pointer to the report context: the batch group leader 
+*                             or of the statistics thread
+*               *bc_arr     - array of the batch contexts of the loading threads
+*               batches_num - number of the loading threads
+*               now         - current time in msec of the monotonic clock
+*               clients_total_num - number of clients of all loading threads
+* Return Code/Output - None
+****************************************************************************************/
+static void print_interval (batch_context* rctx,
+                            batch_context* bc_arr,
+                            int batches_num,
+                            unsigned long now,
+                            int clients_total_num)
+{
+  int i;
+
+  fprintf(stdout, "\033[2J");
+
+  dump_snapshot_interval_and_advance_total_statistics (rctx, 
                                                        now, 
-                                                       total_current_clients);
+                                                       clients_total_num);
 
-  int seconds_run = (int)(now - bctx->start_time)/ 1000;
+  int seconds_run = (int)(now - rctx->start_time)/ 1000;
   if (!seconds_run)
     {
       seconds_run = 1;
@@ -501,11 +1078,11 @@ void dump_snapshot_interval (batch_context* bctx, unsigned long now)
   fprintf(stdout,"--------------------------------------------------------------------------------\n");
 
   fprintf(stdout,"Summary stats (runs:%d secs, CAPS-average:%ld):\n", 
-          seconds_run, bctx->op_total.call_init_count / seconds_run); 
+          seconds_run, rctx->op_total.call_init_count / seconds_run); 
   
   dump_statistics (seconds_run, 
-                   &bctx->http_total,
-                   &bctx->https_total);
+                   &rctx->http_total,
+                   &rctx->https_total);
 
   fprintf(stdout,"============================================================"
           "=====================\n");
@@ -513,29 +1090,26 @@ void dump_snapshot_interval (batch_context* bctx, unsigned long now)
   long total_clients_rampup_inc = 0;
   int total_client_num_max = 0;
   
-  for (i = 0; i <= threads_subbatches_num; i++)
+  for (i = 0; i < batches_num; i++)
     {
-      total_clients_rampup_inc += (bctx + i)->clients_rampup_inc;
-      total_client_num_max += (bctx + i)->client_num_max;
+      total_clients_rampup_inc += (bc_arr + i)->clients_rampup_inc;
+      total_client_num_max += (bc_arr + i)->client_num_max;
     }
 
-  if (bctx->do_client_num_gradual_increase && 
-      (bctx->stop_client_num_gradual_increase == 0))
+  if (bc_arr->do_client_num_gradual_increase && 
+      (bc_arr->stop_client_num_gradual_increase == 0))
     {
       fprintf(stdout," Automatic: adding %ld clients/sec. Stop inc and manual [M].\n",
               total_clients_rampup_inc);
     }
   else
     {
-      const int current_clients =
-        pending_active_and_waiting_clients_num_stat (bctx);
-
       fprintf(stdout," Manual: clients:max[%d],curr[%d]. Inc num: [+|*].",
-              total_client_num_max, total_current_clients);
+              total_client_num_max, clients_total_num);
 
-      if (bctx->stop_client_num_gradual_increase && 
-          bctx->clients_rampup_inc &&
-          current_clients < bctx->client_num_max)
+      if (bc_arr->stop_client_num_gradual_increase && 
+          bc_arr->clients_rampup_inc &&
+          clients_total_num < total_client_num_max)
         {
           fprintf(stdout," Automatic: [A].\n");
         }
@@ -545,6 +1119,15 @@ void dump_snapshot_interval (batch_context* bctx, unsigned long now)
         }
     }
 
+  /* Number of the threads, loading at the moment (-j) */
+  const int threads_active = threads_standby_active_num ();
+
+  if (threads_active >= 0)
+    {
+      fprintf(stdout," Threads: active[%d] of %d. Activate [>], standby [<].\n",
+              threads_active, batches_num);
+    }
+
   fprintf(stdout,"============================================================"
           "=====================\n");
   fflush (stdout);
@@ -582,7 +1165,7 @@ void print_snapshot_interval_statistics (unsigned long period,
 *               period and adds this statistics to the total loading counters. 
 *
 * Input -       *bctx    - pointer to batch context
-*               now_time - current time in msec since the epoch
+*               now_time - current time in msec of the monotonic clock
 *
 * Return Code/Output - None
 ****************************************************************************************/
@@ -590,38 +1173,17 @@ void dump_snapshot_interval_and_advance_total_statistics (batch_context* bctx,
                                                           unsigned long now_time,
                                                           int clients_total_num)
 {
-  int i;
   const unsigned long delta_t = now_time - bctx->last_measure; 
   const unsigned long delta_time = delta_t ? delta_t : 1;
 
-  if (stop_loading)
-    {
-      dump_final_statistics (bctx->cctx_array);
-      screen_release ();
-      exit (1); 
-    }
-
   fprintf(stdout,"============  loading batch is: %-10.10s ===================="
           "==================\n",
           bctx->batch_name);
 
-  /*Collect the operational statistics*/
-
-  for (i = 0; i <= threads_subbatches_num; i++)
-    {
-      if (i)
-        {
-          op_stat_point_add (&bctx->op_delta, &(bctx + i)->op_delta );
-
-          /* Other threads operational statistics - reset just after collecting */
-          op_stat_point_reset (&(bctx + i)->op_delta);
-        }
-    }
-
-  op_stat_point_add (&bctx->op_total, &bctx->op_delta );
+  op_stat_point_add (&bctx->op_total, &bctx->rt->op_delta );
 
   print_operational_statistics (bctx->opstats_file,
-                                &bctx->op_delta,
+                                &bctx->rt->op_delta,
                                 &bctx->op_total, 
                                 bctx->url_ctx_array);
 
@@ -630,30 +1192,16 @@ void dump_snapshot_interval_and_advance_total_statistics (batch_context* bctx,
 
   fprintf(stdout,"Interval stats (latest:%ld sec, clients:%d, CAPS-curr:%ld):\n",
           (unsigned long ) delta_time/1000, clients_total_num,
-          bctx->op_delta.call_init_count* 1000/delta_time);
+          bctx->rt->op_delta.call_init_count* 1000/delta_time);
 
-  op_stat_point_reset (&bctx->op_delta);
+  op_stat_point_reset (&bctx->rt->op_delta);
 
-
-  for (i = 0; i <= threads_subbatches_num; i++)
-    {
-      if (i)
-        {
-          stat_point_add (&bctx->http_delta, &(bctx + i)->http_delta);
-          stat_point_add (&bctx->https_delta, &(bctx + i)->https_delta);
-
-          /* Other threads statistics - reset just after collecting */
-          stat_point_reset (&(bctx + i)->http_delta); 
-          stat_point_reset (&(bctx + i)->https_delta);
-        }
-    }
-
-  stat_point_add (&bctx->http_total, &bctx->http_delta);
-  stat_point_add (&bctx->https_total, &bctx->https_delta);
+  stat_point_add (&bctx->http_total, &bctx->rt->http_delta);
+  stat_point_add (&bctx->https_total, &bctx->rt->https_delta);
 
   print_snapshot_interval_statistics(delta_time, 
-                                     &bctx->http_delta,  
-                                     &bctx->https_delta);
+                                     &bctx->rt->http_delta,  
+                                     &bctx->rt->https_delta);
 
   if (bctx->statistics_file)
     {
@@ -663,19 +1211,19 @@ void dump_snapshot_interval_and_advance_total_statistics (batch_context* bctx,
                                      timestamp_sec,
                                      UNSECURE_APPL_STR,
                                      clients_total_num,
-                                     &bctx->http_delta,
+                                     &bctx->rt->http_delta,
                                      delta_time);
     
       print_statistics_data_to_file (bctx->statistics_file, 
                                      timestamp_sec,
                                      SECURE_APPL_STR, 
                                      clients_total_num,
-                                     &bctx->https_delta,
+                                     &bctx->rt->https_delta,
                                      delta_time);
     }
 
-  stat_point_reset (&bctx->http_delta); 
-  stat_point_reset (&bctx->https_delta);
+  stat_point_reset (&bctx->rt->http_delta); 
+  stat_point_reset (&bctx->rt->https_delta);
         
   bctx->last_measure = now_time;
 }
@@ -724,10 +1272,11 @@ static void dump_stat_to_screen (char* protocol,
                                  unsigned long period)
 {
   fprintf(stdout, "%sReq:%ld,1xx:%ld,2xx:%ld,3xx:%ld,4xx:%ld,5xx:%ld,Err:%ld,T-Err:%ld,"
-          "D:%ldms,D-2xx:%ldms,Ti:%lldB/s,To:%lldB/s\n",
+          "D:%.3fms,D-2xx:%.3fms,Ti:%lldB/s,To:%lldB/s\n",
           protocol, sd->requests, sd->resp_1xx, sd->resp_2xx, sd->resp_3xx,
-          sd->resp_4xx, sd->resp_5xx, sd->other_errs, sd->url_timeout_errs, sd->appl_delay, 
-          sd->appl_delay_2xx, sd->data_in/period, sd->data_out/period);
+          sd->resp_4xx, sd->resp_5xx, sd->other_errs, sd->url_timeout_errs, 
+          sd->appl_delay / 1000.0, sd->appl_delay_2xx / 1000.0, 
+          sd->data_in/period, sd->data_out/period);
 
     //fprintf (stdout, "Appl-Delay-Points %d, Appl-Delay-2xx-Points %d \n", 
   //         sd->appl_delay_points, sd->appl_delay_2xx_points);
@@ -790,10 +1339,11 @@ static void print_statistics_data_to_file (FILE* file,
         period = 1;
       }
 
-    fprintf (file, "%ld, %s, %ld, %ld, %ld, %ld, %ld, %ld, %ld, %ld, %ld, %ld, %ld, %lld, %lld\n",
+    fprintf (file, "%ld, %s, %ld, %ld, %ld, %ld, %ld, %ld, %ld, %ld, %ld, %.3f, %.3f, %lld, %lld\n",
              timestamp, prot, clients_num, sd->requests, sd->resp_1xx, sd->resp_2xx,
              sd->resp_3xx, sd->resp_4xx, sd->resp_5xx, 
-             sd->other_errs, sd->url_timeout_errs, sd->appl_delay, sd->appl_delay_2xx, 
+             sd->other_errs, sd->url_timeout_errs, 
+             sd->appl_delay / 1000.0, sd->appl_delay_2xx / 1000.0, 
              sd->data_in/period, sd->data_out/period);
     fflush (file);
 }
@@ -810,7 +1360,7 @@ static void print_statistics_data_to_file (FILE* file,
 ****************************************************************************************/
 static void dump_clients (client_context* cctx_array)
 {
-  batch_context* bctx = cctx_array->bctx;
+  batch_context* bctx = cctx_array->home_bctx;
   char client_table_filename[BATCH_NAME_SIZE+4];
   FILE* ct_file = NULL;
   int i;
@@ -840,7 +1390,8 @@ static void dump_clients (client_context* cctx_array)
 * Function name - print_operational_statistics
 *
 * Description - writes number of login, UAS - for each URL and logoff operations
-*               success and failure numbers
+*               success and failure numbers, and, when pipelining, the pipeline
+*               depth and requests per connection
 *
 * Input -       *opstats_file - FILE pointer
 *               *osp_curr - pointer to the current operational statistics point
@@ -872,4 +1423,209 @@ static void print_operational_statistics (FILE *opstats_file,
                    osp_curr->url_timeouted[i], osp_total->url_timeouted[i]);
         }
     }
+
+  if (osp_total->pipe_requests)
+    {
+      (void)fprintf (opstats_file,
+          " Pipelining:\t\t Depth-avg\t\t Depth-max\t\tReq/conn\n");
+      (void)fprintf (opstats_file,
+          "%-16.16s\t%-6.2f %-8.2f\t\t%-6ld %-8ld\t\t%-6.2f %-8.2f\n",
+          "Pipeline",
+          osp_curr->pipe_open_sum ?
+          (double) osp_curr->pipe_inflight_sum / osp_curr->pipe_open_sum : 0.0,
+          osp_total->pipe_open_sum ?
+          (double) osp_total->pipe_inflight_sum / osp_total->pipe_open_sum : 0.0,
+          osp_curr->pipe_depth_max, osp_total->pipe_depth_max,
+          osp_curr->pipe_connections ?
+          (double) osp_curr->pipe_requests / osp_curr->pipe_connections : 0.0,
+          osp_total->pipe_connections ?
+          (double) osp_total->pipe_requests / osp_total->pipe_connections : 0.0);
+    }
+}
+
+/****************************************************************************************
+* Function name - stat_thread_start
+*
+* Description - Starts the statistics thread, which merges the statistics, published by
+*               all loading threads, and takes from the batch group leader the output 
+*               of the total statistics to the screen and to the files, as well as the 
+*               keyboard input. Thus the loading threads have the same loading path.
+*
+* Input -       *bc_arr     - array of the batch contexts of the loading threads
+*               batches_num - number of the loading threads
+*               *batch_name - name of the batch, used for the total statistics files
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int stat_thread_start (batch_context* bc_arr, int batches_num, const char* batch_name)
+{
+  batch_context* rctx = &stat_rctx;
+  int error;
+
+  strncpy (rctx->batch_name, batch_name, BATCH_NAME_SIZE - 1);
+  rctx->urls_num = bc_arr->urls_num;
+  rctx->dump_opstats = bc_arr->dump_opstats;
+
+  /* 
+     The url names for the operational statistics are copied, since the urls 
+     of the threads are released, when the threads complete loading. 
+  */
+  if (rctx->urls_num)
+    {
+      if (!(rctx->url_ctx_array = calloc (rctx->urls_num, sizeof (url_context))))
+        {
+          fprintf (stderr, "%s - error: calloc () failed.\n", __func__);
+          return -1;
+        }
+      memcpy (rctx->url_ctx_array, bc_arr->url_ctx_array, 
+              rctx->urls_num * sizeof (url_context));
+    }
+
+  if (batch_runtime_init (rctx) == -1 ||
+      op_stat_point_init (&rctx->op_total, rctx->urls_num) == -1)
+    {
+      fprintf (stderr, "%s - error: init of the counters failed.\n", __func__);
+      return -1;
+    }
+
+  (void)snprintf (rctx->batch_statistics, sizeof (rctx->batch_statistics), 
+                  "./%s.txt", batch_name);
+  if (!(rctx->statistics_file = fopen (rctx->batch_statistics, "w")))
+    {
+      fprintf (stderr, "%s - error: cannot create file \"%s\", %s\n", 
+               __func__, rctx->batch_statistics, strerror (errno));
+      return -1;
+    }
+  print_statistics_header (rctx->statistics_file);
+
+  if (rctx->dump_opstats)
+    {
+      (void)snprintf (rctx->batch_opstats, sizeof (rctx->batch_opstats), 
+                      "./%s.ops", batch_name);
+      if (!(rctx->opstats_file = fopen (rctx->batch_opstats, "w")))
+        {
+          fprintf (stderr, "%s - error: cannot create file \"%s\", %s\n", 
+                   __func__, rctx->batch_opstats, strerror (errno));
+          return -1;
+        }
+    }
+
+  stat_bc_arr = bc_arr;
+  stat_batches_num = batches_num;
+  rctx->start_time = rctx->last_measure = get_tick_count ();
+
+  /* From now the loading threads publish all their statistics */
+  stat_thread_enabled = 1;
+
+  if ((error = pthread_create (&stat_thread_id, NULL, stat_thread_function, rctx)))
+    {
+      fprintf (stderr, "%s - error: pthread_create () failed with error %d.\n", 
+               __func__, error);
+      stat_thread_enabled = 0;
+      return -1;
+    }
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - stat_thread_stop
+*
+* Description - Called, when all loading threads have been joined, thus have published
+*               their final statistics, also on SIGINT. Stops the statistics thread, 
+*               merges the final statistics of the loading threads and outputs them.
+*
+* Return Code/Output - None
+****************************************************************************************/
+void stat_thread_stop (void)
+{
+  batch_context* rctx = &stat_rctx;
+  int clients_total_num;
+  int i;
+
+  if (!stat_thread_enabled)
+    return;
+
+  __atomic_store_n (&stat_thread_stop_flag, 1, __ATOMIC_RELEASE);
+  pthread_join (stat_thread_id, NULL);
+  stat_thread_enabled = 0;
+
+  stat_merge_threads (rctx, stat_bc_arr, stat_batches_num, 1);
+
+  for (clients_total_num = 0, i = 0; i < stat_batches_num; i++)
+    {
+      clients_total_num += (stat_bc_arr + i)->stat_merged.clients;
+    }
+
+  if (print_final (rctx, get_tick_count (), clients_total_num) == 0)
+    {
+      slab_alloc_dump_statistics (stdout);
+
+      (void)fprintf (stderr, "\nTotal statistics of the batch are in the files:\n"
+                     "- %s.txt for loading statistics;\n", rctx->batch_name);
+      if (rctx->dump_opstats)
+        (void)fprintf (stderr,"- %s.ops for operational statistics.\n",
+                       rctx->batch_name);
+    }
+  fflush (stdout);
+
+  if (rctx->statistics_file)
+    fclose (rctx->statistics_file);
+  if (rctx->opstats_file)
+    fclose (rctx->opstats_file);
+
+  batch_runtime_release (rctx);
+  op_stat_point_release (&rctx->op_total);
+
+  free (rctx->url_ctx_array);
+  rctx->url_ctx_array = 0;
+}
+
+/****************************************************************************************
+* Function name - stat_thread_function
+*
+* Description - The statistics thread. Each STAT_PUBLISH_PERIOD passes the keyboard 
+*               input to the loading threads and each snapshot interval merges and 
+*               outputs the statistics of the loading threads. Returns, when stopped
+*               by stat_thread_stop () or on SIGINT. The final statistics are output 
+*               by stat_thread_stop (), when the loading threads have completed.
+*
+* Input -       *arg - pointer to the report context
+* Return Code/Output - NULL
+****************************************************************************************/
+static void* stat_thread_function (void* arg)
+{
+  batch_context* rctx = (batch_context *) arg;
+  const unsigned long snapshot_timeout = snapshot_statistics_timeout*1000;
+  unsigned long now;
+  int clients_total_num;
+  int i;
+
+  while (! __atomic_load_n (&stat_thread_stop_flag, __ATOMIC_ACQUIRE))
+    {
+      /* Clients are added only to the local threads, not to the agents (-g) */
+      screen_post_keyboard_input (stat_bc_arr, 
+                                  distrib_agents ? 1 : stat_batches_num);
+
+      usleep (STAT_PUBLISH_PERIOD * 1000);
+
+      /* On SIGINT the loading threads complete their requests in flight */
+      if (stop_loading)
+        break;
+
+      now = get_tick_count ();
+
+      if (now - rctx->last_measure <= snapshot_timeout)
+        continue;
+
+      stat_merge_threads (rctx, stat_bc_arr, stat_batches_num, 0);
+
+      for (clients_total_num = 0, i = 0; i < stat_batches_num; i++)
+        {
+          clients_total_num += (stat_bc_arr + i)->stat_merged.clients;
+        }
+
+      print_interval (rctx, stat_bc_arr, stat_batches_num, now, clients_total_num);
+    }
+
+  return NULL;
 }
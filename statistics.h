@@ -71,16 +71,20 @@ typedef struct stat_point
 
    /* Num of data points used to calculate average application delay */
   int appl_delay_points;
-  /* Average delay in msec between request and response */
+  /* Average delay in usec between request and response */
   unsigned long  appl_delay;
+  /* Sum of the delays in usec, the average is calculated from */
+  unsigned long long appl_delay_sum;
 
   /* 
      Num of data points used to calculate average application delay 
      for 2xx-OK responses.
   */
   int appl_delay_2xx_points;
-   /* Average delay in msec between request and 2xx-OK response */
+   /* Average delay in usec between request and 2xx-OK response */
   unsigned long  appl_delay_2xx;
+  /* Sum of the 2xx-OK delays in usec, the average is calculated from */
+  unsigned long long appl_delay_2xx_sum;
 
 } stat_point;
 
@@ -107,8 +111,53 @@ typedef struct op_stat_point
   /* Used for CAPS calculation */
   unsigned long call_init_count;
 
+  /* Pipelining: number of requests completed */
+  unsigned long pipe_requests;
+
+  /* Pipelining: number of connections opened */
+  unsigned long pipe_connections;
+
+  /* 
+     Pipelining: sums of requests in flight and of open connections, sampled
+     at each request completion. Their ratio is the average pipeline depth.
+  */
+  unsigned long pipe_inflight_sum;
+  unsigned long pipe_open_sum;
+
+  /* Pipelining: maximal depth sampled */
+  unsigned long pipe_depth_max;
+
 } op_stat_point;
 
+/*
+  stat_snapshot - statistics of a loading thread since the loading started.
+  With multiple threads (-t), each thread accumulates its counters in the
+  own batch context and periodically publishes them to the snapshot by
+  stat_publish (). The snapshot is written only by the owning thread and is
+  read by the batch group leader under the sequence lock, so that neither
+  the thread, nor the leader wait and no counter updates are lost.
+  With worker processes (-p) the published snapshots are in shared memory.
+*/
+typedef struct stat_snapshot
+{
+  /* Sequence lock, odd, while the owning thread is writing the snapshot */
+  unsigned long seq;
+
+  stat_point http;
+  stat_point https;
+  op_stat_point op;
+
+  /* Number of pending, active and waiting clients of the thread */
+  int clients;
+
+  /* Set, when the thread has published its final counters (or failed) */
+  int final;
+
+} stat_snapshot;
+
+/* Period in msec of publishing statistics by a loading thread */
+#define STAT_PUBLISH_PERIOD 100
+
 /*******************************************************************************
 * Function name - stat_point_add
 *
@@ -120,6 +169,17 @@ typedef struct op_stat_point
 ********************************************************************************/
 void stat_point_add (stat_point* left, stat_point* right);
 
+/*******************************************************************************
+* Function name - stat_point_sub
+*
+* Description - Subtracts counters of one stat_point object from another
+* Input -       *left  - pointer to the stat_point, where counter will be subtracted
+*               *right - pointer to the stat_point, which counter will be subtracted
+*                        from the <left>
+* Return Code/Output - None
+********************************************************************************/
+void stat_point_sub (stat_point* left, stat_point* right);
+
 /******************************************************************************
 * Function name - stat_point_reset
 *
@@ -142,6 +202,19 @@ void stat_point_reset (stat_point* point);
 ********************************************************************************/
 void op_stat_point_add (op_stat_point* left, op_stat_point* right);
 
+/*******************************************************************************
+* Function name - op_stat_point_sub
+*
+* Description - Subtracts counters of one op_stat_point object from another.
+*               The maximal pipeline depth is left as is.
+* Input -       *left  -  pointer to the op_stat_point, where counter will be 
+*                         subtracted
+*               *right -  pointer to the op_stat_point, which counter will be 
+*                         subtracted from the <left>
+* Return Code/Output - None
+********************************************************************************/
+void op_stat_point_sub (op_stat_point* left, op_stat_point* right);
+
 
 /*******************************************************************************
 * Function name - op_stat_point_reset
@@ -200,6 +273,20 @@ void op_stat_timeouted (op_stat_point* op_stat, size_t url_index);
 
 void op_stat_call_init_count_inc (op_stat_point* op_stat);
 
+/*******************************************************************************
+* Function name - op_stat_pipe_sample
+*
+* Description - Samples pipelining statistics at a request completion
+*
+* Input -       *op_stat         - pointer to the op_stat_point to update
+*               inflight         - number of requests in flight
+*               connections_open - number of open connections
+* Return Code/Output - None
+********************************************************************************/
+void op_stat_pipe_sample (op_stat_point* op_stat,
+                          unsigned long inflight,
+                          unsigned long connections_open);
+
 struct client_context;
 struct batch_context;
 
@@ -216,6 +303,105 @@ struct batch_context;
 ****************************************************************************************/
 void dump_final_statistics (struct client_context* cctx);
 
+/****************************************************************************************
+* Function name - stat_snapshot_init
+*
+* Description - Initializes a statistics snapshot by allocating its url counters
+*
+* Input -       *snap   - pointer to the snapshot
+*               url_num - number of urls
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int stat_snapshot_init (stat_snapshot* snap, size_t url_num);
+
+/****************************************************************************************
+* Function name - stat_snapshot_release
+*
+* Description - Releases memory allocated by stat_snapshot_init ()
+*
+* Input -       *snap - pointer to the snapshot
+* Return Code/Output - None
+****************************************************************************************/
+void stat_snapshot_release (stat_snapshot* snap);
+
+/****************************************************************************************
+* Function name - stat_published_init
+*
+* Description - Allocates the snapshots, published by the loading threads (or worker
+*               processes) for the batch group leader, each with its url counters
+*               at own cache lines. When <shared>, the snapshots are allocated in
+*               memory, shared with the processes to be forked.
+*
+* Input -       *bc_arr - array of the batch contexts of the threads
+*               batches_num - number of the threads
+*               shared - when true, allocates in the shared memory
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int stat_published_init (struct batch_context* bc_arr, int batches_num, int shared);
+
+/****************************************************************************************
+* Function name - stat_published_release
+*
+* Description - Releases the snapshots, allocated by stat_published_init ()
+*
+* Input -       *bc_arr - array of the batch contexts of the threads
+*               batches_num - number of the threads
+* Return Code/Output - None
+****************************************************************************************/
+void stat_published_release (struct batch_context* bc_arr, int batches_num);
+
+/****************************************************************************************
+* Function name - stat_publish
+*
+* Description - Called by a loading thread, other than the batch group leader, to
+*               add its statistics counters to the published snapshot, and to reset 
+*               the counters. Publishes once in STAT_PUBLISH_PERIOD msec, unless forced.
+*
+* Input -       *bctx    - pointer to the batch context of the thread
+*               now_time - current time in msec
+*               force    - when true, publishes at once
+* Return Code/Output - None
+****************************************************************************************/
+void stat_publish (struct batch_context* bctx, unsigned long now_time, int force);
+
+/****************************************************************************************
+* Function name - stat_publish_final
+*
+* Description - Called by a loading thread, other than the batch group leader, at the
+*               end of loading to publish the rest of its counters and to notify the
+*               leader, waiting for all threads to report before the final statistics.
+*
+* Input -       *bctx    - pointer to the batch context of the thread
+*               now_time - current time in msec
+* Return Code/Output - None
+****************************************************************************************/
+void stat_publish_final (struct batch_context* bctx, unsigned long now_time);
+
+/****************************************************************************************
+* Function name - stat_published_read
+*
+* Description - Reads a consistent copy of the snapshot, published by a loading thread.
+*               Used by a distributed agent to report the snapshot to the coordinator.
+*
+* Input -       *bctx - pointer to the batch context of the thread
+* Output -      *to   - the snapshot, initialized by stat_snapshot_init ()
+* Return Code/Output - When the thread has published its final counters - 1, else 0
+****************************************************************************************/
+int stat_published_read (struct batch_context* bctx, stat_snapshot* to);
+
+/****************************************************************************************
+* Function name - stat_published_write
+*
+* Description - Replaces the published snapshot of a batch by the snapshot, reported
+*               by a distributed agent, loading the batch. Used by the coordinator,
+*               the only writer of the snapshot, instead of the loading thread.
+*
+* Input -       *bctx - pointer to the batch context of the agent
+*               *from - the snapshot reported by the agent
+* Return Code/Output - None
+****************************************************************************************/
+void stat_published_write (struct batch_context* bctx, stat_snapshot* from);
+
 /******
 * Function name - ascii_time
 *
@@ -234,7 +420,7 @@ char *ascii_time (char *tbuf);
 * and up to the interval
 *
 * Input -       *bctx - pointer to batch structure
-*               now   - current time in msec since the epoch
+*               now   - current time in msec of the monotonic clock
 * Return Code/Output - None
 ****************************************************************************************/
 void dump_snapshot_interval (struct batch_context* bctx, unsigned long now);
@@ -265,4 +451,38 @@ void print_snapshot_interval_statistics (unsigned long period,
 ****************************************************************************************/
 void print_statistics_header (FILE* file);
 
+/* 
+   Set, when the statistics thread reports on behalf of the loading threads
+   (-t and -g), thus no loading thread is the batch group leader.
+*/
+extern int stat_thread_enabled;
+
+/****************************************************************************************
+* Function name - stat_thread_start
+*
+* Description - Starts the statistics thread, which merges the statistics, published by
+*               all loading threads, and outputs the total statistics to the screen and 
+*               to the files $batch-name.txt and $batch-name.ops. The thread also reads
+*               the keyboard input and passes it to the loading threads.
+*
+* Input -       *bc_arr     - array of the batch contexts of the loading threads
+*               batches_num - number of the loading threads
+*               *batch_name - name of the batch, used for the total statistics files
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int stat_thread_start (struct batch_context* bc_arr, 
+                       int batches_num, 
+                       const char* batch_name);
+
+/****************************************************************************************
+* Function name - stat_thread_stop
+*
+* Description - Called, when all loading threads have been joined, thus have published
+*               their final statistics, also on SIGINT. Stops the statistics thread, 
+*               merges the final statistics of the loading threads and outputs them.
+*
+* Return Code/Output - None
+****************************************************************************************/
+void stat_thread_stop (void);
+
 #endif /* STATISTICS_H */
@@ -29,7 +29,10 @@
 
 #include "timer_queue.h"
 #include "heap.h"
+#include "twheel.h"
 #include "timer_node.h"
+#include "timer_tick.h"
+#include "conf.h"
 
 #define TQ_RESOLUTION 9 /* 9 msec */
 
@@ -52,6 +55,28 @@ void timer_node_dump (hnode* const h)
     fprintf (stderr, "n_timer=%ld ", ((timer_node *) h->ctx)->next_timer);
 }
 
+/* Timing-wheel implementation of the timer queue operations */
+static long tq_wheel_schedule_timer (twheel*const tw, timer_node* const tnode);
+static int tq_wheel_cancel_timer (twheel*const tw, long timer_id);
+static int tq_wheel_remove_nearest_timer (twheel*const tw, timer_node** tnode);
+static int tq_wheel_dispatch_nearest_timer (twheel*const tw, 
+                                            void* vp_param, 
+                                            unsigned long now_time);
+
+/****************************************************************************************
+* Function name - tq_object_size
+*
+* Description - Returns size of the timer queue object to be allocated for 
+*               tq_init (), which depends on the timer queue type in use
+*
+* Input -       None
+* Return Code/Output - Size of the timer queue object in bytes
+****************************************************************************************/
+size_t tq_object_size (void)
+{
+  return timer_queue_type == TQ_TYPE_WHEEL ? sizeof (twheel) : sizeof (heap);
+}
+
 /********************************************************************************
 * Function name - tq_init
 *
@@ -78,6 +103,13 @@ int tq_init (timer_queue*const tq,
         return -1;
     }
 
+    if (timer_queue_type == TQ_TYPE_WHEEL)
+      return twheel_init ((twheel *const) tq,
+                          tq_initial_size,
+                          tq_increase_step,
+                          nodes_num_prealloc,
+                          get_tick_count ());
+
     return heap_init ((heap *const) tq,
                       tq_initial_size,
                       tq_increase_step,
@@ -96,6 +128,9 @@ int tq_init (timer_queue*const tq,
 ****************************************************************************************/
 void tq_release (timer_queue*const tq)
 {
+    if (timer_queue_type == TQ_TYPE_WHEEL)
+      return twheel_reset ((twheel*const) tq);
+
     return heap_reset ((heap*const) tq);
 }
 
@@ -133,6 +168,9 @@ long tq_schedule_timer (timer_queue*const tq,
         return -1;
     }
 
+    if (timer_queue_type == TQ_TYPE_WHEEL)
+      return (tnode->timer_id = tq_wheel_schedule_timer ((twheel *) tq, tnode));
+
     heap * h = (heap *) tq;
     hnode* new_hnode = (hnode *) mpool_take_obj (h->nodes_mpool);
 
@@ -169,15 +207,18 @@ int tq_cancel_timer (timer_queue*const tq, long timer_id)
 {
     heap* h = (heap *) tq;
 
-    if (!tq || timer_id < 0 || (size_t) timer_id > h->max_heap_size)
+    if (tq && timer_queue_type == TQ_TYPE_WHEEL)
+      return tq_wheel_cancel_timer ((twheel *) tq, timer_id);
+
+    if (!tq || timer_id < 0 || (size_t) timer_id >= h->max_heap_size)
     {
         fprintf (stderr, "%s - error: wrong input.\n", __func__);
         return -1;
     }
 
-    long node_slot = h->ids_arr[timer_id];
+    hnode* node = h->ids_arr[timer_id];
 
-    if (node_slot < 0)
+    if (!node)
     {
         //fprintf (stderr, 
         //         "%s - error: the timer-id is not valid any more (cancelled, expired?).\n", 
@@ -185,14 +226,14 @@ int tq_cancel_timer (timer_queue*const tq, long timer_id)
         return -1;
     }
 
-    if (timer_id != h->heap[node_slot]->node_id)
+    if (node != h->heap[node->slot])
     {
         fprintf (stderr, "%s - error: internal timer mismatch.\n", __func__);
         return -1;
     }
     
     // last zero means - not keeping the timer-id/slot
-    hnode* node = heap_remove_node (h, node_slot, 0);
+    node = heap_remove_node (h, node->slot, 0);
 
     if (!node)
     {
@@ -211,7 +252,10 @@ int tq_cancel_timer (timer_queue*const tq, long timer_id)
 /****************************************************************************************
 * Function name - tq_cancel_timers
 *
-* Description - Cancels all timers in timer queue, scheduled for some pointer to context
+* Description - Cancels all timers in timer queue, scheduled for some pointer to context.
+*               A timer-node is queued by a single timer at a time, the queue is 
+*               ordered by its next-timer field, thus, the timer is found in O(1) by 
+*               the timer-id kept at the timer-node.
 *
 * Input -       *tq    - pointer to a timer queue, e.g. heap
 *               *tnode - pointer to timer context (timer-node) to be searched for
@@ -220,10 +264,8 @@ int tq_cancel_timer (timer_queue*const tq, long timer_id)
 ****************************************************************************************/
 int tq_cancel_timers (timer_queue*const tq, struct timer_node* const tnode)
 {
-  hnode* node = 0;
-  size_t index = 0;
-  int counter = 0;
-  heap* h = (heap *) tq;
+  long timer_id = 0;
+  void* ctx = 0;
 
   if (!tq || !tnode)
     {
@@ -231,36 +273,28 @@ int tq_cancel_timers (timer_queue*const tq, struct timer_node* const tnode)
       return -1;
     }
 
-  for (index = 0; index < h->curr_heap_size;)
+  if ((timer_id = tnode->timer_id) < 0)
+    return 0;
+
+  if (timer_queue_type == TQ_TYPE_WHEEL)
     {
-      if (h->heap[index]->ctx == tnode)
-        {
-          node = heap_remove_node (h, index, 0);
-
-          if (node)
-            {
-              node_reset (node);
-
-              if (mpool_return_obj (h->nodes_mpool, (allocatable *) node) == -1)
-                {
-                  fprintf (stderr, "%s - error: mpool_return_obj () failed.\n", __func__);
-                  return -1;
-                }
-              counter++;
-            }
-          else
-            {
-              fprintf (stderr, "%s - error: node removal failed.\n", __func__);
-              return -1;
-            }
-        }
-      else
-        {
-          ++index;
-        }
+      twheel* tw = (twheel *) tq;
+
+      if ((size_t) timer_id < tw->max_ids_size && tw->ids_arr[timer_id])
+        ctx = tw->ids_arr[timer_id]->ctx;
     }
-    
-  return counter;
+  else
+    {
+      heap* h = (heap *) tq;
+
+      if ((size_t) timer_id < h->max_heap_size && h->ids_arr[timer_id])
+        ctx = h->ids_arr[timer_id]->ctx;
+    }
+
+  if (ctx != tnode)
+    return 0;
+
+  return tq_cancel_timer (tq, timer_id) ? -1 : 1;
 }
 
 /****************************************************************************************
@@ -279,6 +313,9 @@ unsigned long tq_time_to_nearest_timer (timer_queue*const tq)
 {
     heap* h = (heap *) tq;
 
+    if (timer_queue_type == TQ_TYPE_WHEEL)
+      return twheel_nearest ((twheel *) tq);
+
     if (! h->curr_heap_size)
         return ULONG_MAX;
 
@@ -298,8 +335,14 @@ unsigned long tq_time_to_nearest_timer (timer_queue*const tq)
 ****************************************************************************************/
 int tq_remove_nearest_timer (timer_queue*const tq, timer_node** tnode)
 {
-  heap* h = (heap *) tq;
-  hnode* node = heap_pop ((heap *const) tq, 0);
+  heap* h = 0;
+  hnode* node = 0;
+
+  if (timer_queue_type == TQ_TYPE_WHEEL)
+    return tq_wheel_remove_nearest_timer ((twheel *) tq, tnode);
+
+  h = (heap *) tq;
+  node = heap_pop (h, 0);
 
   if (!node)
     return -1;
@@ -326,7 +369,7 @@ int tq_remove_nearest_timer (timer_queue*const tq, timer_node** tnode)
 *
 * Input -       *tq       - pointer to a timer queue, e.g. heap
 *               *vp_param - void pointer passed parameter
-*               now_time  - current time since epoch in msec
+*               now_time  - current time in msec of the monotonic clock
 *
 * Return Code/Output - On success - 0, on error -1
 ****************************************************************************************/
@@ -334,6 +377,9 @@ int tq_dispatch_nearest_timer (timer_queue*const tq,
 			       void* vp_param, 
 			       unsigned long now_time)
 {
+  if (timer_queue_type == TQ_TYPE_WHEEL)
+    return tq_wheel_dispatch_nearest_timer ((twheel *) tq, vp_param, now_time);
+
   heap* h = (heap *) tq;
   hnode* top_node = heap_top_node ((heap *const) tq);
 
@@ -387,6 +433,9 @@ int tq_dispatch_nearest_timer (timer_queue*const tq,
 ****************************************************************************************/
 int tq_empty (timer_queue*const tq)
 {
+  if (timer_queue_type == TQ_TYPE_WHEEL)
+    return twheel_empty ((twheel *const) tq);
+
   return heap_empty ((heap *const) tq);
 }
 
@@ -400,6 +449,9 @@ int tq_empty (timer_queue*const tq)
 ****************************************************************************************/
 int tq_size (timer_queue*const tq)
 {
+  if (timer_queue_type == TQ_TYPE_WHEEL)
+    return twheel_size ((twheel *const) tq);
+
   return heap_size ((heap *const) tq);
 }
 
@@ -407,7 +459,20 @@ int release_kept_timer_id (timer_queue*const tq, long timer_id)
 {
   heap* h = (heap *) tq;
 
-  if (!tq || timer_id < 0 || (size_t) timer_id > h->max_heap_size)
+  if (tq && timer_queue_type == TQ_TYPE_WHEEL)
+    {
+      twheel* tw = (twheel *) tq;
+
+      if (timer_id < 0 || (size_t) timer_id >= tw->max_ids_size)
+        {
+          fprintf (stderr, "%s - error: wrong input.\n", __func__);
+          return -1;
+        }
+      twheel_release_node_id (tw, timer_id);
+      return 0;
+    }
+
+  if (!tq || timer_id < 0 || (size_t) timer_id >= h->max_heap_size)
     {
       fprintf (stderr, "%s - error: wrong input.\n", __func__);
       return -1;
@@ -417,3 +482,157 @@ int release_kept_timer_id (timer_queue*const tq, long timer_id)
 
   return 0;
 }
+
+/****************************************************************************************
+* Function name - tq_wheel_schedule_timer
+*
+* Description - Schedules timer at the timing wheel. O(1).
+*
+* Input -       *tw    - pointer to an initialized timing wheel
+*               *tnode - pointer to the user-allocated timer node
+*
+* Return Code/Output - On success - timer-id, on error -1
+****************************************************************************************/
+static long tq_wheel_schedule_timer (twheel*const tw, timer_node* const tnode)
+{
+  twnode* node = (twnode *) mpool_take_obj (tw->nodes_mpool);
+
+  if (!node)
+    {
+      fprintf (stderr, "%s - error: allocation of a new twnode from pool failed.\n",
+               __func__);
+      return -1;
+    }
+
+  node->ctx = tnode;
+  node->expires = tnode->next_timer;
+
+  return twheel_add (tw, node, 0);
+}
+
+/****************************************************************************************
+* Function name - tq_wheel_cancel_timer
+*
+* Description - Cancels timer at the timing wheel. O(1).
+*
+* Input -       *tw      - pointer to an initialized timing wheel
+*               timer_id - number returned by tq_schedule_timer ()
+*
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int tq_wheel_cancel_timer (twheel*const tw, long timer_id)
+{
+  twnode* node = twheel_remove (tw, timer_id);
+
+  if (!node)
+    {
+      return -1;
+    }
+
+  twnode_reset (node);
+  mpool_return_obj (tw->nodes_mpool, (allocatable *) node);
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - tq_wheel_remove_nearest_timer
+*
+* Description - Removes the nearest timer from the timing wheel and fills <tnode> 
+*               pointer to the timer context.
+*
+* Input -       *tw     - pointer to an initialized timing wheel
+* Input/Output- **tnode - second pointer to a timer node to be filled 
+*
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int tq_wheel_remove_nearest_timer (twheel*const tw, timer_node** tnode)
+{
+  unsigned long nearest = twheel_nearest (tw);
+  twnode* node = 0;
+
+  if (nearest == ULONG_MAX)
+    return -1;
+
+  twheel_expire (tw, nearest);
+
+  if (! (node = twheel_pop_expired (tw, 0)))
+    return -1;
+
+  *tnode = node->ctx;
+
+  twnode_reset (node);
+
+  if (mpool_return_obj (tw->nodes_mpool, (allocatable *)node) == -1)
+    {
+      return -1;
+    }
+
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - tq_wheel_dispatch_nearest_timer
+*
+* Description - Advances the timing wheel to <now_time>, takes the first expired 
+*               timer and calls for handle_timer () of its timer node. Re-schedules 
+*               periodic timers and manages memory agaist mpool, if required.
+*
+* Input -       *tw       - pointer to an initialized timing wheel
+*               *vp_param - void pointer passed parameter
+*               now_time  - current time in msec of the monotonic clock
+*
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int tq_wheel_dispatch_nearest_timer (twheel*const tw, 
+                                            void* vp_param, 
+                                            unsigned long now_time)
+{
+  twnode* node = 0;
+  timer_node* tnode = 0;
+  int rval = 0;
+
+  twheel_expire (tw, now_time);
+
+  if (! (node = twheel_expired_top (tw)))
+    {
+      return -1;
+    }
+
+  tnode = (timer_node *) node->ctx;
+  node = twheel_pop_expired (tw, tnode->period ? 1 : 0);
+
+  rval = tnode->func_timer (tnode, vp_param, now_time);
+
+  if (rval)
+    goto node_return;
+
+  if (tnode->period)
+    {
+      node->expires = tnode->next_timer = now_time + tnode->period;
+      
+      if (twheel_add (tw, node, 1) == -1)
+        {
+          fprintf (stderr, "%s - error: twheel_add () failed.\n", __func__);
+          rval = -1;
+          goto node_return;
+        }
+      return 0;
+    }
+
+ node_return:
+
+  if (tnode->period)
+    {
+      twheel_release_node_id (tw, node->node_id);
+    }
+
+  twnode_reset (node);
+  
+  if (mpool_return_obj (tw->nodes_mpool, (allocatable *)node) == -1)
+    {
+      return -1;
+    }
+
+  return rval;
+}
@@ -33,6 +33,28 @@ typedef void timer_queue;
 
 struct timer_node;
 
+/*
+  Implementations of the timer queue, selectable at startup.
+*/
+enum tq_type
+  {
+    TQ_TYPE_HEAP = 0,   /* Binary heap */
+    TQ_TYPE_WHEEL = 1,  /* Hierarchical timing wheel */
+  };
+
+#define TQ_TYPE_DEFAULT TQ_TYPE_HEAP
+
+/****************************************************************************************
+* Function name - tq_object_size
+*
+* Description - Returns size of the timer queue object to be allocated and passed 
+*               to tq_init (). Depends on the timer queue type in use.
+*
+* Input -       None
+* Return Code/Output - Size of the timer queue object in bytes
+****************************************************************************************/
+size_t tq_object_size (void);
+
 /****************************************************************************************
 * Function name - tq_init
 *
@@ -92,7 +114,8 @@ int tq_cancel_timer (timer_queue*const tq, long timer_id);
 /****************************************************************************************
 * Function name - tq_cancel_timers
 *
-* Description - Cancels all timers in timer queue, scheduled for a timer node
+* Description - Cancels all timers in timer queue, scheduled for a timer node.
+*               The timer is found by the timer-id kept at the timer node.
 *
 * Input -       *tq - pointer to a timer queue, e.g. heap
 *               *tnode -  pointer to the timer-node (timer context) to be searched for
@@ -141,7 +164,7 @@ int tq_remove_nearest_timer (timer_queue*const tq, struct timer_node** tnode);
 *
 * Input -       *tq       - pointer to a timer queue, e.g. heap
 *               *vp_param - void pointer passed parameter
-*               now_time  - current time since epoch in msec
+*               now_time  - current time in msec of the monotonic clock
 *
 * Return Code/Output - On success - 0, on error -1
 ****************************************************************************************/
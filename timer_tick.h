@@ -23,13 +23,52 @@
 #ifndef TIMER_TICK_H
 #define TIMER_TICK_H
 
+/*
+  Timestamps are taken from the monotonic clock (CLOCK_MONOTONIC), thus,
+  they are not affected by steps of the system time, e.g. by NTP. Each
+  thread keeps the latest timestamp read in a per-thread cache. Event loops
+  refresh the cache once per iteration, just after their wait for events, 
+  and the rest of the iteration uses the cached timestamp.
+*/
+
 /****************************************************************************************
 * Function name - get_tick_count
 *
-* Description - Delivers timestamp in milliseconds.
+* Description - Reads the monotonic clock, refreshes the per-thread cached timestamp
+*               and delivers it in milliseconds.
 *
-* Return Code/Output - timestamp in milliseconds or -1 on errors
+* Return Code/Output - timestamp in milliseconds
 ****************************************************************************************/
 unsigned long get_tick_count ();
 
+/****************************************************************************************
+* Function name - get_tick_count_usec
+*
+* Description - Reads the monotonic clock, refreshes the per-thread cached timestamp
+*               and delivers it in microseconds.
+*
+* Return Code/Output - timestamp in microseconds
+****************************************************************************************/
+unsigned long long get_tick_count_usec (void);
+
+/****************************************************************************************
+* Function name - cached_tick_count
+*
+* Description - Delivers the per-thread cached timestamp in milliseconds without
+*               reading the clock. Reads the clock only, when the cache is empty.
+*
+* Return Code/Output - timestamp in milliseconds
+****************************************************************************************/
+unsigned long cached_tick_count (void);
+
+/****************************************************************************************
+* Function name - cached_tick_count_usec
+*
+* Description - Delivers the per-thread cached timestamp in microseconds without
+*               reading the clock. Reads the clock only, when the cache is empty.
+*
+* Return Code/Output - timestamp in microseconds
+****************************************************************************************/
+unsigned long long cached_tick_count_usec (void);
+
 #endif /* TIMER_TICK_H */
@@ -0,0 +1,740 @@
+/*
+*     twheel.c
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+
+#include "twheel.h"
+#include "cl_alloc.h"
+
+/* Number of ticks covered by all the wheels together */
+#define TW_MAX_TICKS (1UL << (TW_ROOT_BITS + TW_LEVELS_NUM * TW_LEVEL_BITS))
+
+/* Shift of the tick to get the slot index at an upper wheel */
+#define TW_LEVEL_SHIFT(L) (TW_ROOT_BITS + (L) * TW_LEVEL_BITS)
+
+/* twnode from its link */
+#define TW_NODE(L) ((twnode *) ((char *) (L) - offsetof (twnode, link)))
+
+/* Places the node to a slot of the wheel or to the expired list */
+static void twheel_place (twheel*const tw, twnode*const nd);
+
+/* Re-distributes nodes of the current slot of an upper wheel to the lower wheels */
+static size_t twheel_cascade (twheel*const tw, int level);
+
+/* Fetches a free node-id */
+static long twheel_get_node_id (twheel*const tw);
+
+/* Increases number of the node-ids */
+static int twheel_ids_increase (twheel*const tw);
+
+
+static inline void tw_list_init (twlink*const head)
+{
+  head->next = head->prev = head;
+}
+
+static inline int tw_list_empty (twlink*const head)
+{
+  return head->next == head;
+}
+
+static inline void tw_list_add_tail (twlink*const head, twlink*const l)
+{
+  l->next = head;
+  l->prev = head->prev;
+  head->prev->next = l;
+  head->prev = l;
+}
+
+static inline void tw_list_del (twlink*const l)
+{
+  l->prev->next = l->next;
+  l->next->prev = l->prev;
+  l->next = l->prev = 0;
+}
+
+/* Moves all links of <from> to the tail of <to>, leaving <from> empty */
+static inline void tw_list_splice_tail (twlink*const from, twlink*const to)
+{
+  if (tw_list_empty (from))
+    return;
+
+  from->next->prev = to->prev;
+  to->prev->next = from->next;
+  from->prev->next = to;
+  to->prev = from->prev;
+  tw_list_init (from);
+}
+
+static inline int tw_wheels_empty (twheel*const tw)
+{
+  int i;
+
+  if (tw->root_count)
+    return 0;
+
+  for (i = 0; i < TW_LEVELS_NUM; i++)
+    {
+      if (tw->levels_count[i])
+        return 0;
+    }
+  return 1;
+}
+
+/****************************************************************************************
+* Function name - twnode_reset
+*
+* Description - Zeros the fields of twnode, that are allowed to be zeroed.
+*               Attention!!! Use this function and not memset.
+*
+* Input -       *node - pointer to a twnode object
+*
+* Return Code/Output - none
+****************************************************************************************/
+void twnode_reset (twnode*const node)
+{
+  if (!node)
+    return;
+
+  node->node_id = 0;
+  node->expires = 0;
+  node->level = 0;
+  node->ctx = 0;
+  node->link.next = node->link.prev = 0;
+  node->alloc.link.next = 0;
+}
+
+/****************************************************************************************
+* Function name - twheel_init
+*
+* Description - Performs initialization of an allocated timing wheel.
+*
+* Input -       *tw - pointer to an allocated timing wheel
+*               initial_ids_size -  initial number of node-ids
+*               increase_step -  number of node-ids to add, when all are taken
+*               nodes_prealloc -  number of twnodes to be pre-allocated at initialization
+*               now_tick - the current time in msec to start the wheel from
+*
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int twheel_init (twheel*const tw,
+                 size_t initial_ids_size,
+                 size_t increase_step,
+                 size_t nodes_prealloc,
+                 unsigned long now_tick)
+{
+  size_t i = 0;
+  int j = 0;
+
+  if (!tw || !initial_ids_size)
+    {
+      fprintf(stderr, "%s - error: wrong input\n", __func__);
+      return -1;
+    }
+
+  memset ((void*)tw, 0, sizeof (*tw));
+
+  for (i = 0; i < TW_ROOT_SIZE; i++)
+    {
+      tw_list_init (&tw->root[i]);
+    }
+
+  for (j = 0; j < TW_LEVELS_NUM; j++)
+    {
+      for (i = 0; i < TW_LEVEL_SIZE; i++)
+        {
+          tw_list_init (&tw->levels[j][i]);
+        }
+    }
+
+  tw_list_init (&tw->ready);
+
+  tw->curr_tick = now_tick;
+
+  if (! (tw->ids_arr = calloc (initial_ids_size, sizeof (twnode*))) ||
+      ! (tw->ids_free = calloc (initial_ids_size, sizeof (long))))
+    {
+      fprintf(stderr, "%s - error: alloc of nodes-ids arrays failed\n", __func__);
+      return -1;
+    }
+
+  /* All ids are free, the lowest to be taken first */
+  for (i = 0; i < initial_ids_size; i++)
+    {
+      tw->ids_free[i] = (long) (initial_ids_size - 1 - i);
+    }
+
+  tw->ids_free_num = initial_ids_size;
+  tw->max_ids_size = initial_ids_size;
+  tw->ids_increase_step = increase_step;
+
+  if (!(tw->nodes_mpool = cl_calloc (1, sizeof (mpool))))
+    {
+      fprintf(stderr, "%s - error: mpool allocation failed\n", __func__);
+      return -1;
+    }
+  else
+    {
+      if (mpool_init (tw->nodes_mpool, sizeof (twnode), nodes_prealloc) == -1)
+        {
+          fprintf(stderr, "%s - error: mpool_init () -  failed\n",  __func__);
+          return -1;
+        }
+    }
+  return 0;
+}
+
+/****************************************************************************************
+* Function name - twheel_reset
+*
+* Description - De-allocates memory and inits to the initial values the wheel,
+*               but does not deallocate the wheel itself.
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*
+* Return Code/Output - none
+****************************************************************************************/
+void twheel_reset (twheel*const tw)
+{
+  if (tw->ids_arr)
+    {
+      free (tw->ids_arr);
+    }
+  if (tw->ids_free)
+    {
+      free (tw->ids_free);
+    }
+  if (tw->nodes_mpool)
+    {
+      mpool_free (tw->nodes_mpool);
+      free (tw->nodes_mpool);
+    }
+  memset (tw, 0, sizeof (*tw));
+}
+
+/****************************************************************************************
+* Function name - twheel_add
+*
+* Description - Places the node to the wheel slot according to its <expires>
+*               field. O(1).
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*               *nd - pointer to node
+*               keep_node_id - flag, whether to respect the <node-id> from the node
+*                              (support for periodical timer)
+*
+* Return Code/Output - On success - 0 or positive node-id, on error - (-1)
+****************************************************************************************/
+long twheel_add (twheel*const tw, twnode*const nd, int keep_node_id)
+{
+  if (!tw || !nd)
+    {
+      fprintf(stderr, "%s - error: wrong input\n", __func__);
+      return -1;
+    }
+
+  if (! keep_node_id)
+    {
+      if ((nd->node_id = twheel_get_node_id (tw)) == -1)
+        {
+          fprintf(stderr, "%s - error: twheel_get_node_id () failed\n", __func__);
+          return -1;
+        }
+    }
+
+  tw->ids_arr[nd->node_id] = nd;
+
+  twheel_place (tw, nd);
+  tw->curr_size++;
+
+  if (tw->nearest_valid && nd->level >= 0 && nd->expires < tw->nearest)
+    {
+      tw->nearest = nd->expires;
+    }
+
+  return nd->node_id;
+}
+
+/****************************************************************************************
+* Function name - twheel_remove
+*
+* Description - Removes node with the node-id from the wheel and releases the
+*               node-id. O(1).
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*               node_id - id of the node to remove
+*
+* Return Code/Output - On success - the removed node, on error - 0
+****************************************************************************************/
+twnode* twheel_remove (twheel*const tw, long node_id)
+{
+  twnode* nd = 0;
+
+  if (node_id < 0 || (size_t) node_id >= tw->max_ids_size)
+    {
+      return 0;
+    }
+
+  if (! (nd = tw->ids_arr[node_id]))
+    {
+      return 0;
+    }
+
+  tw_list_del (&nd->link);
+
+  if (nd->level == 0)
+    {
+      tw->root_count--;
+    }
+  else if (nd->level > 0)
+    {
+      tw->levels_count[nd->level - 1]--;
+    }
+
+  tw->curr_size--;
+
+  if (tw->nearest_valid && nd->expires <= tw->nearest)
+    {
+      tw->nearest_valid = 0;
+    }
+
+  twheel_release_node_id (tw, node_id);
+
+  return nd;
+}
+
+/****************************************************************************************
+* Function name - twheel_expire
+*
+* Description - Advances the wheel up to and including <now_tick>, moving all
+*               expired nodes to the list of nodes to be dispatched. Each
+*               processed tick moves its whole slot at once. Ranges of ticks
+*               without any nodes at the root wheel are skipped.
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*               now_tick - the current time in msec
+*
+* Return Code/Output - none
+****************************************************************************************/
+void twheel_expire (twheel*const tw, unsigned long now_tick)
+{
+  size_t index = 0;
+  int level = 0;
+  twlink* slot = 0;
+  twlink* l = 0;
+  unsigned long next_cascade = 0;
+
+  while ((long) (now_tick - tw->curr_tick) >= 0)
+    {
+      if (tw_wheels_empty (tw))
+        {
+          tw->curr_tick = now_tick + 1;
+          break;
+        }
+
+      index = tw->curr_tick & TW_ROOT_MASK;
+
+      if (index && ! tw->root_count)
+        {
+          /* Nothing to do at the root wheel till the next cascading */
+          next_cascade = (tw->curr_tick | TW_ROOT_MASK) + 1;
+
+          if ((long) (next_cascade - now_tick) > 0)
+            {
+              tw->curr_tick = now_tick + 1;
+              break;
+            }
+
+          tw->curr_tick = next_cascade;
+          continue;
+        }
+
+      if (! index)
+        {
+          for (level = 0; level < TW_LEVELS_NUM; level++)
+            {
+              if (twheel_cascade (tw, level))
+                break;
+            }
+        }
+
+      tw->curr_tick++;
+
+      slot = &tw->root[index];
+
+      if (tw_list_empty (slot))
+        continue;
+
+      for (l = slot->next; l != slot; l = l->next)
+        {
+          TW_NODE (l)->level = -1;
+          tw->root_count--;
+        }
+
+      tw_list_splice_tail (slot, &tw->ready);
+
+      /* The nearest node is among the expired now */
+      tw->nearest_valid = 0;
+    }
+}
+
+/****************************************************************************************
+* Function name - twheel_pop_expired
+*
+* Description - Takes the first node from the list of expired nodes
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*               keep_node_id - flag, whether to keep the node-id taken
+*                              (support for periodical timer)
+*
+* Return Code/Output - On success - pointer to twnode, when no expired nodes - 0
+****************************************************************************************/
+twnode* twheel_pop_expired (twheel*const tw, int keep_node_id)
+{
+  twnode* nd = 0;
+
+  if (tw_list_empty (&tw->ready))
+    {
+      return 0;
+    }
+
+  nd = TW_NODE (tw->ready.next);
+
+  tw_list_del (&nd->link);
+  tw->curr_size--;
+
+  if (keep_node_id)
+    {
+      /*
+         The id is reserved for the node, but the node cannot be
+         cancelled, till it is added back.
+      */
+      tw->ids_arr[nd->node_id] = 0;
+    }
+  else
+    {
+      twheel_release_node_id (tw, nd->node_id);
+    }
+
+  return nd;
+}
+
+/****************************************************************************************
+* Function name - twheel_expired_top
+*
+* Description - Returns the first node in the list of expired nodes, not removing it
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*
+* Return Code/Output - On success - pointer to twnode, when no expired nodes - 0
+****************************************************************************************/
+twnode* twheel_expired_top (twheel*const tw)
+{
+  return tw_list_empty (&tw->ready) ? 0 : TW_NODE (tw->ready.next);
+}
+
+/****************************************************************************************
+* Function name - twheel_nearest
+*
+* Description - Returns the tick (msec), when the nearest node expires. The
+*               value is cached and re-calculated only after the nearest node
+*               has been removed or expired.
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*
+* Return Code/Output - The nearest expiration tick, or ULONG_MAX, when empty
+****************************************************************************************/
+unsigned long twheel_nearest (twheel*const tw)
+{
+  unsigned long best = ULONG_MAX;
+  unsigned long base = 0;
+  twlink* slot = 0;
+  twlink* l = 0;
+  size_t i = 0;
+  int level = 0;
+
+  if (! tw_list_empty (&tw->ready))
+    {
+      return TW_NODE (tw->ready.next)->expires;
+    }
+
+  if (! tw->curr_size)
+    {
+      return ULONG_MAX;
+    }
+
+  if (tw->nearest_valid)
+    {
+      return tw->nearest;
+    }
+
+  /* Slots of the root wheel are exact ticks */
+  if (tw->root_count)
+    {
+      for (i = 0; i < TW_ROOT_SIZE; i++)
+        {
+          if (! tw_list_empty (&tw->root[(tw->curr_tick + i) & TW_ROOT_MASK]))
+            {
+              best = tw->curr_tick + i;
+              break;
+            }
+        }
+    }
+
+  /*
+     Slots of the upper wheels cover ranges of ticks. Look through the
+     slots in the order of their cascading, till a slot starts later,
+     than the nearest tick found.
+  */
+  for (level = 0; level < TW_LEVELS_NUM; level++)
+    {
+      if (! tw->levels_count[level])
+        continue;
+
+      base = tw->curr_tick >> TW_LEVEL_SHIFT (level);
+
+      for (i = 0; i < TW_LEVEL_SIZE; i++)
+        {
+          if (i && ((base + i) << TW_LEVEL_SHIFT (level)) >= best)
+            break;
+
+          slot = &tw->levels[level][(base + i) & TW_LEVEL_MASK];
+
+          for (l = slot->next; l != slot; l = l->next)
+            {
+              if (TW_NODE (l)->expires < best)
+                best = TW_NODE (l)->expires;
+            }
+        }
+    }
+
+  tw->nearest = best;
+  tw->nearest_valid = 1;
+
+  return best;
+}
+
+/****************************************************************************************
+* Function name - twheel_release_node_id
+*
+* Description - Returns a node-id to the free ids
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*               node_id - the node-id to release
+*
+* Return Code/Output - none
+****************************************************************************************/
+void twheel_release_node_id (twheel*const tw, long node_id)
+{
+  tw->ids_arr[node_id] = 0;
+  tw->ids_free[tw->ids_free_num++] = node_id;
+}
+
+/****************************************************************************************
+* Function name - twheel_empty
+*
+* Description - Evaluates, whether the wheel is empty
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*
+* Return Code/Output - If empty - positive value, if not - 0
+****************************************************************************************/
+int twheel_empty (twheel*const tw)
+{
+  return tw->curr_size ? 0 : 1;
+}
+
+/****************************************************************************************
+* Function name - twheel_size
+*
+* Description - Returns number of nodes in the wheel
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*
+* Return Code/Output - On success - zero or positive number, on error - (-1)
+****************************************************************************************/
+int twheel_size (twheel*const tw)
+{
+  if (!tw)
+    return -1;
+
+  return (int) tw->curr_size;
+}
+
+/****************************************************************************************
+* Function name - twheel_place
+*
+* Description - Places the node to the slot of the wheel, covering its <expires>
+*               tick. Nodes, which are already late, are placed to the list
+*               of the expired nodes.
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*               *nd - pointer to node
+*
+* Return Code/Output - none
+****************************************************************************************/
+static void twheel_place (twheel*const tw, twnode*const nd)
+{
+  unsigned long expires = nd->expires;
+  unsigned long idx = expires - tw->curr_tick;
+  int level = 0;
+
+  if ((long) idx < 0)
+    {
+      nd->level = -1;
+      tw_list_add_tail (&tw->ready, &nd->link);
+      return;
+    }
+
+  if (idx < TW_ROOT_SIZE)
+    {
+      nd->level = 0;
+      tw->root_count++;
+      tw_list_add_tail (&tw->root[expires & TW_ROOT_MASK], &nd->link);
+      return;
+    }
+
+  for (level = 0; level < TW_LEVELS_NUM - 1; level++)
+    {
+      if (idx < (1UL << TW_LEVEL_SHIFT (level + 1)))
+        break;
+    }
+
+  if (idx >= TW_MAX_TICKS)
+    {
+      /*
+         Beyond the range of the wheels. Kept at the farest slot and
+         re-placed by each cascading of the slot.
+      */
+      expires = tw->curr_tick + TW_MAX_TICKS - 1;
+    }
+
+  nd->level = level + 1;
+  tw->levels_count[level]++;
+  tw_list_add_tail (
+    &tw->levels[level][(expires >> TW_LEVEL_SHIFT (level)) & TW_LEVEL_MASK],
+    &nd->link);
+}
+
+/****************************************************************************************
+* Function name - twheel_cascade
+*
+* Description - Re-distributes nodes of the current slot of an upper wheel
+*               to the lower wheels.
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*               level - index of the upper wheel
+*
+* Return Code/Output - Index of the cascaded slot
+****************************************************************************************/
+static size_t twheel_cascade (twheel*const tw, int level)
+{
+  size_t index = (tw->curr_tick >> TW_LEVEL_SHIFT (level)) & TW_LEVEL_MASK;
+  twlink list;
+  twlink* l = 0;
+
+  tw_list_init (&list);
+  tw_list_splice_tail (&tw->levels[level][index], &list);
+
+  while (! tw_list_empty (&list))
+    {
+      l = list.next;
+      tw_list_del (l);
+      tw->levels_count[level]--;
+      twheel_place (tw, TW_NODE (l));
+    }
+
+  return index;
+}
+
+/****************************************************************************************
+* Function name - twheel_get_node_id
+*
+* Description -  Provides a free node-id from the stack of free ids
+*
+* Input -        *tw - pointer to an initialized timing wheel
+*
+* Return Code/Output - On success - node-id, on error - (-1)
+****************************************************************************************/
+static long twheel_get_node_id (twheel*const tw)
+{
+  if (! tw->ids_free_num && twheel_ids_increase (tw) == -1)
+    {
+      return -1;
+    }
+
+  return tw->ids_free[--tw->ids_free_num];
+}
+
+/****************************************************************************************
+* Function name - twheel_ids_increase
+*
+* Description -  Adds <ids_increase_step> node-ids to the free ids
+*
+* Input -        *tw - pointer to an initialized timing wheel
+*
+* Return Code/Output - On success - 0, on error - (-1)
+****************************************************************************************/
+static int twheel_ids_increase (twheel*const tw)
+{
+  size_t new_size = tw->max_ids_size + tw->ids_increase_step;
+  twnode** ids_arr = 0;
+  long* ids_free = 0;
+  size_t i = 0;
+
+  if (! tw->ids_increase_step)
+    {
+      fprintf(stderr, "%s - error: the wheel is full.\n", __func__);
+      return -1;
+    }
+
+  if (! (ids_arr = realloc (tw->ids_arr, new_size * sizeof (twnode*))))
+    {
+      fprintf(stderr, "%s - error: realloc of nodes-ids array failed\n", __func__);
+      return -1;
+    }
+  tw->ids_arr = ids_arr;
+
+  if (! (ids_free = realloc (tw->ids_free, new_size * sizeof (long))))
+    {
+      fprintf(stderr, "%s - error: realloc of free ids array failed\n", __func__);
+      return -1;
+    }
+  tw->ids_free = ids_free;
+
+  for (i = tw->max_ids_size; i < new_size; i++)
+    {
+      tw->ids_arr[i] = 0;
+      tw->ids_free[tw->ids_free_num++] = (long) (new_size - 1 - (i - tw->max_ids_size));
+    }
+
+  tw->max_ids_size = new_size;
+
+  return 0;
+}
@@ -0,0 +1,282 @@
+/*
+*     twheel.h
+*
+* 2006-2007 Copyright (C)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef TWHEEL_H
+#define TWHEEL_H
+
+#include "mpool.h"
+
+/*
+  Hierarchical (cascading) timing wheel with a tick of 1 msec.
+
+  The root wheel keeps timers expiring within the next TW_ROOT_SIZE ticks,
+  each slot for a single tick. Each of the TW_LEVELS_NUM upper wheels covers
+  TW_LEVEL_SIZE times longer interval than the wheel below it. When the root
+  wheel wraps around, a slot of the upper wheels is cascaded down and its
+  timers are re-distributed to the more precise lower wheels.
+*/
+#define TW_ROOT_BITS 8
+#define TW_LEVEL_BITS 6
+#define TW_LEVELS_NUM 4
+
+#define TW_ROOT_SIZE (1 << TW_ROOT_BITS)
+#define TW_LEVEL_SIZE (1 << TW_LEVEL_BITS)
+#define TW_ROOT_MASK (TW_ROOT_SIZE - 1)
+#define TW_LEVEL_MASK (TW_LEVEL_SIZE - 1)
+
+/*
+  twlink - doubly-linked list link. Wheel slots are the list heads.
+*/
+typedef struct twlink
+{
+  struct twlink* next;
+  struct twlink* prev;
+} twlink;
+
+/*
+  twnode - is the housekeeping node of a timing wheel.
+*/
+typedef struct twnode
+{
+  /* Base for the "allocatable" property. */
+  allocatable alloc;
+
+  /* Link to the list of a wheel slot or to the list of expired nodes. */
+  twlink link;
+
+  /*
+     The unique id of the node. When used in timer-queue,
+     we place here timer-id.
+  */
+  long node_id;
+
+  /* The tick (msec), when the node expires. */
+  unsigned long expires;
+
+  /*
+     Wheel, where the node is kept: 0 - root, 1 .. TW_LEVELS_NUM - upper
+     wheels, -1 - the list of expired nodes.
+  */
+  int level;
+
+  /*
+     Pointer to the user-data context to keep with the node.
+     When used in timer-queue, we place here pointer to
+     timer-node.
+  */
+  void* ctx;
+
+} twnode;
+
+
+typedef struct twheel
+{
+  /* The root wheel with a slot per tick. */
+  twlink root[TW_ROOT_SIZE];
+
+  /* The upper wheels. */
+  twlink levels[TW_LEVELS_NUM][TW_LEVEL_SIZE];
+
+  /* Expired nodes, waiting to be dispatched, in the order of expiration. */
+  twlink ready;
+
+  /* The next tick to be processed by the wheel. */
+  unsigned long curr_tick;
+
+  /* Number of nodes at the root wheel and at each of the upper wheels. */
+  size_t root_count;
+  size_t levels_count[TW_LEVELS_NUM];
+
+  /* Total number of nodes, including the expired. */
+  size_t curr_size;
+
+  /*
+     The nearest expiration tick, cached. When <nearest_valid> is zero,
+     it is to be re-calculated.
+  */
+  unsigned long nearest;
+  int nearest_valid;
+
+  /*
+     Array mapping node-id to the node. NULL, when the node-id is not
+     used by any node.
+  */
+  twnode** ids_arr;
+
+  /* Size of the <ids_arr> and of the <ids_free> stack. */
+  size_t max_ids_size;
+
+  /* Number of ids to add, when all ids are taken. */
+  size_t ids_increase_step;
+
+  /* Stack of free node-ids and the number of ids in it. */
+  long* ids_free;
+  size_t ids_free_num;
+
+  /* Memory pool of twnodes */
+  struct mpool* nodes_mpool;
+
+} twheel;
+
+
+/****************************************************************************************
+* Function name - twnode_reset
+*
+* Description - Zeros the fields of twnode, that are allowed to be zeroed.
+*               Attention!!! Use this function and not memset.
+*
+* Input -       *node - pointer to a twnode object
+* Return Code/Output - none
+****************************************************************************************/
+void twnode_reset (twnode*const node);
+
+/****************************************************************************************
+* Function name - twheel_init
+*
+* Description - Performs initialization of an allocated timing wheel.
+*
+* Input -       *tw - pointer to an allocated timing wheel
+*               initial_ids_size -  initial number of node-ids
+*               increase_step -  number of node-ids to add, when all are taken
+*               nodes_prealloc -  number of twnodes to be pre-allocated at initialization
+*               now_tick - the current time in msec to start the wheel from
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+int twheel_init (twheel*const tw,
+                 size_t initial_ids_size,
+                 size_t increase_step,
+                 size_t nodes_prealloc,
+                 unsigned long now_tick);
+
+/****************************************************************************************
+* Function name - twheel_reset
+*
+* Description - De-allocates memory and inits to the initial values the wheel,
+*               but does not deallocate the wheel itself.
+*
+* Input -       *tw - pointer to an initialized timing wheel
+* Return Code/Output - none
+****************************************************************************************/
+void twheel_reset (twheel*const tw);
+
+/****************************************************************************************
+* Function name - twheel_add
+*
+* Description - Places the node to the wheel slot according to its <expires>
+*               field. O(1).
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*               *nd - pointer to node
+*               keep_node_id - flag, whether to respect the <node-id> from the node
+*                              (support for periodical timer)
+* Return Code/Output - On success - 0 or positive node-id, on error - (-1)
+****************************************************************************************/
+long twheel_add (twheel*const tw, twnode*const nd, int keep_node_id);
+
+/****************************************************************************************
+* Function name - twheel_remove
+*
+* Description - Removes node with the node-id from the wheel. O(1).
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*               node_id - id of the node to remove
+* Return Code/Output - On success - the removed node, on error - 0
+****************************************************************************************/
+twnode* twheel_remove (twheel*const tw, long node_id);
+
+/****************************************************************************************
+* Function name - twheel_expire
+*
+* Description - Advances the wheel up to and including <now_tick>, moving all
+*               expired nodes to the list of nodes to be dispatched. Each
+*               processed tick moves its whole slot at once.
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*               now_tick - the current time in msec
+* Return Code/Output - none
+****************************************************************************************/
+void twheel_expire (twheel*const tw, unsigned long now_tick);
+
+/****************************************************************************************
+* Function name - twheel_pop_expired
+*
+* Description - Takes the first node from the list of expired nodes
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*               keep_node_id - flag, whether to keep the node-id taken
+*                              (support for periodical timer)
+* Return Code/Output - On success - pointer to twnode, when no expired nodes - 0
+****************************************************************************************/
+twnode* twheel_pop_expired (twheel*const tw, int keep_node_id);
+
+/****************************************************************************************
+* Function name - twheel_expired_top
+*
+* Description - Returns the first node in the list of expired nodes, not removing it
+*
+* Input -       *tw - pointer to an initialized timing wheel
+* Return Code/Output - On success - pointer to twnode, when no expired nodes - 0
+****************************************************************************************/
+twnode* twheel_expired_top (twheel*const tw);
+
+/****************************************************************************************
+* Function name - twheel_nearest
+*
+* Description - Returns the tick (msec), when the nearest node expires
+*
+* Input -       *tw - pointer to an initialized timing wheel
+* Return Code/Output - The nearest expiration tick, or ULONG_MAX, when empty
+****************************************************************************************/
+unsigned long twheel_nearest (twheel*const tw);
+
+/****************************************************************************************
+* Function name - twheel_release_node_id
+*
+* Description - Returns a kept node-id to the free ids
+*
+* Input -       *tw - pointer to an initialized timing wheel
+*               node_id - the node-id to release
+* Return Code/Output - none
+****************************************************************************************/
+void twheel_release_node_id (twheel*const tw, long node_id);
+
+/****************************************************************************************
+* Function name - twheel_empty
+*
+* Description - Evaluates, whether the wheel is empty
+*
+* Input -       *tw - pointer to an initialized timing wheel
+* Return Code/Output - If empty - positive value, if not - 0
+****************************************************************************************/
+int twheel_empty (twheel*const tw);
+
+/****************************************************************************************
+* Function name - twheel_size
+*
+* Description - Returns number of nodes in the wheel
+*
+* Input -       *tw - pointer to an initialized timing wheel
+* Return Code/Output - On success - zero or positive number, on error - (-1)
+****************************************************************************************/
+int twheel_size (twheel*const tw);
+
+#endif /* TWHEEL_H */